@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/utility.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull::tasklet {
+
+class Fiber;
+
+} // namespace vull::tasklet
+
+namespace vull {
+
+// Handle to an entity which will be created when the EntityCommandBuffer it came from is played back.
+class PendingEntity {
+    friend class EntityCommandBuffer;
+
+private:
+    uint32_t m_buffer_index;
+    uint32_t m_index;
+
+    PendingEntity(uint32_t buffer_index, uint32_t index) : m_buffer_index(buffer_index), m_index(index) {}
+};
+
+// Records structural changes (creating and destroying entities, adding and removing components) to be applied to an
+// EntityManager later on, at a point where nothing else is accessing it. Recording is lock-free and may be done from
+// any number of tasklets at once, including during iteration of a view. Each fiber, or thread outside of a tasklet
+// context, appends to its own buffer, so a tasklet keeps its buffer even if it resumes on another thread after waiting.
+//
+// Playback applies all of the recorded commands in one pass. Entities are created first, and then the remaining
+// commands are sorted by entity, with the commands recorded by one tasklet or thread for the same entity being applied
+// in the order they were recorded. There is no ordering between different tasklets. Commands targeting an entity which
+// no longer exists are dropped, as are additions of a component the entity already has. Neither playback nor clear
+// may run concurrently with recording.
+class EntityCommandBuffer {
+    using ApplyFn = void (*)(EntityManager &, EntityId, void *);
+    using DestructFn = void (*)(void *);
+
+    struct Command {
+        uint64_t target;
+        ApplyFn apply;
+        DestructFn destruct;
+        void *data;
+    };
+
+    struct LocalBuffer {
+        LocalBuffer *next{nullptr};
+        // The fiber recording into this buffer, or null for a thread outside of a tasklet context.
+        tasklet::Fiber *owner{nullptr};
+        uint32_t index{0};
+        uint32_t created_count{0};
+        Vector<Command> commands;
+        Vector<uint8_t *> blocks;
+        size_t block_head{0};
+
+        LocalBuffer() = default;
+        LocalBuffer(const LocalBuffer &) = delete;
+        LocalBuffer(LocalBuffer &&) = delete;
+        ~LocalBuffer();
+
+        LocalBuffer &operator=(const LocalBuffer &) = delete;
+        LocalBuffer &operator=(LocalBuffer &&) = delete;
+
+        void *allocate(size_t size, size_t alignment);
+    };
+
+    Atomic<LocalBuffer *> m_head{nullptr};
+    Atomic<uint32_t> m_buffer_count{0};
+    uint64_t m_epoch;
+    Vector<Vector<EntityId>> m_created_entities;
+
+    LocalBuffer &local_buffer();
+    void record(uint64_t target, ApplyFn apply, DestructFn destruct, void *data);
+    template <typename C, typename... Args>
+    void record_add(uint64_t target, Args &&...args);
+    void discard();
+
+public:
+    EntityCommandBuffer();
+    EntityCommandBuffer(const EntityCommandBuffer &) = delete;
+    EntityCommandBuffer(EntityCommandBuffer &&) = delete;
+    ~EntityCommandBuffer();
+
+    EntityCommandBuffer &operator=(const EntityCommandBuffer &) = delete;
+    EntityCommandBuffer &operator=(EntityCommandBuffer &&) = delete;
+
+    PendingEntity create_entity();
+    void destroy_entity(EntityId id);
+    template <typename C, typename... Args>
+    void add_component(EntityId id, Args &&...args);
+    template <typename C, typename... Args>
+    void add_component(PendingEntity entity, Args &&...args);
+    template <typename C>
+    void remove_component(EntityId id);
+
+    // Applies and then clears all of the recorded commands.
+    void playback(EntityManager &manager);
+
+    // Discards all of the recorded commands without applying them.
+    void clear();
+
+    // Returns the ID of an entity created by the last playback.
+    EntityId resolve(PendingEntity entity) const;
+};
+
+template <typename C, typename... Args>
+void EntityCommandBuffer::record_add(uint64_t target, Args &&...args) {
+    static_assert(alignof(C) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    auto &buffer = local_buffer();
+    auto *component = new (buffer.allocate(sizeof(C), alignof(C))) C(vull::forward<Args>(args)...);
+    const auto apply = +[](EntityManager &manager, EntityId id, void *data) {
+        if (!manager.has_component<C>(id)) {
+            manager.add_component<C>(id, vull::move(*static_cast<C *>(data)));
+        }
+    };
+    const auto destruct = +[](void *data) {
+        static_cast<C *>(data)->~C();
+    };
+    record(target, apply, destruct, component);
+}
+
+template <typename C, typename... Args>
+void EntityCommandBuffer::add_component(EntityId id, Args &&...args) {
+    record_add<C>(id, vull::forward<Args>(args)...);
+}
+
+template <typename C, typename... Args>
+void EntityCommandBuffer::add_component(PendingEntity entity, Args &&...args) {
+    const auto target = (uint64_t(1) << 63u) | (uint64_t(entity.m_buffer_index) << 32u) | entity.m_index;
+    record_add<C>(target, vull::forward<Args>(args)...);
+}
+
+template <typename C>
+void EntityCommandBuffer::remove_component(EntityId id) {
+    const auto apply = +[](EntityManager &manager, EntityId id, void *) {
+        if (manager.has_component<C>(id)) {
+            manager.remove_component<C>(id);
+        }
+    };
+    record(id, apply, nullptr, nullptr);
+}
+
+} // namespace vull
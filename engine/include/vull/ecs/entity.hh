@@ -3,9 +3,15 @@
 #include <vull/container/vector.hh>
 #include <vull/ecs/entity_id.hh>
 #include <vull/ecs/sparse_set.hh>
+#include <vull/maths/common.hh>
 #include <vull/support/optional.hh>
+#include <vull/support/span.hh>
 #include <vull/support/tuple.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/latch.hh>
+
+#include <stdint.h>
 
 namespace vull {
 
@@ -29,18 +35,58 @@ public:
     void remove();
     template <typename C>
     Optional<C &> try_get();
+    template <typename C>
+    void mark_changed();
 
     void destroy();
     operator EntityId() const { return m_id; }
 };
 
+// View filters which only match entities whose component of type C was added, or was marked as changed, after the
+// view's since tick. Adding a component also counts as changing it. The component itself is still yielded as a C &.
+template <typename C>
+struct Added {};
+template <typename C>
+struct Changed {};
+
+template <typename T>
+struct ViewFilter {
+    using component = T;
+    static constexpr bool is_added = false;
+    static constexpr bool is_changed = false;
+};
+template <typename C>
+struct ViewFilter<Added<C>> {
+    using component = C;
+    static constexpr bool is_added = true;
+    static constexpr bool is_changed = false;
+};
+template <typename C>
+struct ViewFilter<Changed<C>> {
+    using component = C;
+    static constexpr bool is_added = false;
+    static constexpr bool is_changed = true;
+};
+
+template <typename T>
+using filter_component_t = typename ViewFilter<T>::component;
+template <typename T>
+concept ChangeFilter = ViewFilter<T>::is_added || ViewFilter<T>::is_changed;
+
 template <typename... Comps>
 class EntityIterator;
 
 template <typename... Comps>
 class EntityView;
 
+template <typename... Comps>
+class GroupIterator;
+
+template <typename... Comps>
+class GroupView;
+
 template <typename C>
+requires(!ChangeFilter<C>)
 class EntityIterator<C> {
     template <typename...>
     friend class EntityView;
@@ -59,19 +105,36 @@ public:
     Tuple<Entity, C &> operator*() const;
 };
 
+// Walks the dense array of whichever component set the view picked, skipping entities which don't have all of the
+// components, or which don't pass a change filter.
 template <typename C, typename... Comps>
-class EntityIterator<C, Comps...> : public EntityIterator<C> {
+class EntityIterator<C, Comps...> {
     template <typename...>
     friend class EntityView;
 
 private:
+    EntityManager *const m_manager;
+    EntityId *m_current_id;
     EntityId *const m_end_id;
 
-    EntityIterator(EntityManager *manager, EntityId *current_id, C *current_component);
+    // The storage of the walked set, and the position of its component in <C, Comps...>. That component is read
+    // directly, whilst the others are looked up.
+    uint8_t *m_current_storage;
+    const uint32_t m_storage_stride;
+    const uint32_t m_driving_index;
+    const uint32_t m_since_tick;
+
+    EntityIterator(EntityManager *manager, EntityId *current_id, EntityId *end_id, uint8_t *current_storage,
+                   uint32_t storage_stride, uint32_t driving_index, uint32_t since_tick);
+    template <typename T>
+    bool matches_one(uint32_t index) const;
+    bool matches() const;
+    void skip_unmatched();
 
 public:
+    bool operator==(const EntityIterator &) const;
     EntityIterator &operator++();
-    Tuple<Entity, C &, Comps &...> operator*() const;
+    Tuple<Entity, filter_component_t<C> &, filter_component_t<Comps> &...> operator*() const;
 };
 
 template <typename C, typename... Comps>
@@ -80,25 +143,90 @@ class EntityView<C, Comps...> {
 
 private:
     EntityManager *const m_manager;
-    SparseSet<EntityId> &m_component_set;
+    SparseSet<EntityId> *m_component_set;
+    uint32_t m_driving_index{0};
+    uint32_t m_since_tick;
 
-    EntityView(EntityManager *manager);
+    EntityView(EntityManager *manager, uint32_t since_tick);
 
 public:
     EntityIterator<C, Comps...> begin() const;
     EntityIterator<C, Comps...> end() const;
 };
 
+template <typename... Comps>
+class GroupIterator {
+    template <typename...>
+    friend class GroupView;
+
+private:
+    EntityManager *const m_manager;
+    const EntityId *const m_ids;
+    const Tuple<Comps *...> m_storages;
+    EntityId m_index;
+
+    GroupIterator(EntityManager *manager, const EntityId *ids, Tuple<Comps *...> storages, EntityId index)
+        : m_manager(manager), m_ids(ids), m_storages(storages), m_index(index) {}
+
+public:
+    bool operator==(const GroupIterator &other) const { return m_index == other.m_index; }
+    GroupIterator &operator++();
+    Tuple<Entity, Comps &...> operator*() const;
+};
+
+// A view over the entities of an owning group, which are packed at the start of each of the group's component sets in
+// the same order, so that iterating the group is a linear walk over each set's storage.
+template <typename... Comps>
+class GroupView {
+    friend EntityManager;
+
+private:
+    EntityManager *const m_manager;
+    const EntityId *const m_ids;
+    const EntityId m_size;
+
+    GroupView(EntityManager *manager, const EntityId *ids, EntityId size)
+        : m_manager(manager), m_ids(ids), m_size(size) {}
+
+public:
+    GroupIterator<Comps...> begin() const;
+    GroupIterator<Comps...> end() const;
+    EntityId size() const { return m_size; }
+};
+
 class EntityManager {
     template <typename... Comps>
     friend class EntityIterator;
     template <typename... Comps>
     friend class EntityView;
+    template <typename... Comps>
+    friend class GroupView;
+
+    struct Group {
+        Vector<size_t> component_ids;
+        EntityId size{0};
+    };
+    static constexpr uint32_t k_no_group = ~0u;
+
+    struct RemovedList {
+        Vector<EntityId> ids;
+        bool tracked{false};
+    };
 
 protected:
     Vector<SparseSet<EntityId>> m_component_sets;
     Vector<EntityId, EntityId> m_entities;
     EntityId m_free_head;
+    Vector<Group> m_groups;
+    Vector<uint32_t> m_component_groups;
+    Vector<RemovedList> m_removed_lists;
+    uint32_t m_change_tick{1};
+
+    uint32_t owning_group(size_t component_id) const;
+    void enter_group(uint32_t group_index, EntityId index);
+    void leave_group(uint32_t group_index, EntityId index);
+    void pack_group(uint32_t group_index);
+    void record_removed(size_t component_id, EntityId id);
 
 public:
     EntityManager();
@@ -122,12 +250,60 @@ public:
     bool has_component(EntityId id);
     template <typename C>
     void remove_component(EntityId id);
+    template <typename C>
+    EntityId component_count() const;
 
     Entity create_entity();
     void destroy_entity(EntityId id);
     bool valid(EntityId id) const;
+
+    // Moves every entity of other into this manager as newly created entities, along with their components, leaving
+    // other empty. Both managers must have the same component types registered. Entity references held by components
+    // are remapped (see SparseSet::remap_entities). Returns the new ID of each of other's entities, indexed by its old
+    // entity index, or the null ID for indices which weren't alive.
+    Vector<EntityId> merge(EntityManager &&other);
     template <typename... Comps>
     EntityView<Comps...> view();
+    template <typename... Comps>
+    EntityView<Comps...> view(uint32_t since_tick);
+
+    // Change detection. Each component records the tick at which it was added and at which it was last marked as
+    // changed, which Added<C> and Changed<C> view filters then compare against. Components are never marked as changed
+    // implicitly, besides when added. By default, views match anything stamped with the current tick, i.e. since the
+    // last advance_tick(); a system can instead pass change_tick() - 1 as of its last run as the since tick.
+    uint32_t change_tick() const { return m_change_tick; }
+    void advance_tick();
+    template <typename C>
+    void mark_changed(EntityId id);
+    template <typename C>
+    const ComponentTicks &component_ticks(EntityId id) const;
+
+    // Removals of a tracked component type, whether by remove_component or destroy_entity, are recorded until the
+    // next advance_tick(). Tracking is opt-in so that the lists can't grow forever without anyone clearing them.
+    template <typename C>
+    void track_removed();
+    template <typename C>
+    Span<const EntityId> removed() const;
+
+    // Creates an owning group over the given components. The group keeps the entities which have all of them packed at
+    // the start of each component's set, in the same order, so that group<Comps...>() can iterate them linearly. The
+    // cost is some extra swapping when the components are added or removed. A component can only be owned by one
+    // group.
+    template <typename... Comps>
+    void create_group();
+    template <typename... Comps>
+    GroupView<Comps...> group();
+
+    // Calls fn(Entity, C &, Comps &...) for every entity with all of the given components, like iterating view(), but
+    // splits the entities with a C into ranges of grain_size entities which run as tasklets on the current scheduler,
+    // returning once all ranges are done. Outside of a tasklet context everything runs inline.
+    //
+    // Each entity is visited exactly once, so fn may freely modify the components passed to it. Components named with
+    // a const type, e.g. parallel_for<RigidBody, const Transform>, are passed as const references; these, and only
+    // these, may also be read through other entities, since nothing else can be writing them. fn itself is called
+    // concurrently, and must not create or destroy entities nor add or remove components.
+    template <typename C, typename... Comps, typename F>
+    void parallel_for(F &&fn, uint32_t grain_size = 1024);
 };
 
 template <typename C, typename... Args>
@@ -155,16 +331,23 @@ Optional<C &> Entity::try_get() {
     return has<C>() ? get<C>() : Optional<C &>();
 }
 
+template <typename C>
+void Entity::mark_changed() {
+    m_manager->mark_changed<C>(m_id);
+}
+
 inline void Entity::destroy() {
     m_manager->destroy_entity(m_id);
 }
 
 template <typename C>
+requires(!ChangeFilter<C>)
 bool EntityIterator<C>::operator==(const EntityIterator &other) const {
     return m_current_id == other.m_current_id;
 }
 
 template <typename C>
+requires(!ChangeFilter<C>)
 EntityIterator<C> &EntityIterator<C>::operator++() {
     m_current_component++;
     m_current_id++;
@@ -172,61 +355,162 @@ EntityIterator<C> &EntityIterator<C>::operator++() {
 }
 
 template <typename C>
+requires(!ChangeFilter<C>)
 Tuple<Entity, C &> EntityIterator<C>::operator*() const {
     return vull::make_tuple(Entity(m_manager, *m_current_id), vull::ref(*m_current_component));
 }
 
 template <typename C, typename... Comps>
 // NOLINTNEXTLINE: clang-tidy for some reason thinks that current_id can be const.
-EntityIterator<C, Comps...>::EntityIterator(EntityManager *manager, EntityId *current_id, C *current_component)
-    : EntityIterator<C>(manager, current_id, current_component),
-      m_end_id(manager->m_component_sets[C::k_component_id].dense_end()) {
-    while (EntityIterator<C>::m_current_id < m_end_id &&
-           !EntityIterator<C>::m_manager->template has_component<Comps...>(*EntityIterator<C>::m_current_id)) {
-        EntityIterator<C>::operator++();
+EntityIterator<C, Comps...>::EntityIterator(EntityManager *manager, EntityId *current_id, EntityId *end_id,
+                                            uint8_t *current_storage, uint32_t storage_stride, uint32_t driving_index,
+                                            uint32_t since_tick)
+    : m_manager(manager), m_current_id(current_id), m_end_id(end_id), m_current_storage(current_storage),
+      m_storage_stride(storage_stride), m_driving_index(driving_index), m_since_tick(since_tick) {
+    skip_unmatched();
+}
+
+template <typename C, typename... Comps>
+template <typename T>
+bool EntityIterator<C, Comps...>::matches_one(uint32_t index) const {
+    using Component = filter_component_t<T>;
+    // The walked set is known to contain the entity.
+    if (index != m_driving_index && !m_manager->template has_component<Component>(*m_current_id)) {
+        return false;
+    }
+    if constexpr (ViewFilter<T>::is_added) {
+        return m_manager->template component_ticks<Component>(*m_current_id).added > m_since_tick;
+    } else if constexpr (ViewFilter<T>::is_changed) {
+        return m_manager->template component_ticks<Component>(*m_current_id).changed > m_since_tick;
     }
+    return true;
+}
+
+template <typename C, typename... Comps>
+bool EntityIterator<C, Comps...>::matches() const {
+    return [this]<size_t... Is>(IntegerSequence<size_t, Is...>) {
+        return (matches_one<typename std::tuple_element<Is, Tuple<C, Comps...>>::type>(Is) && ...);
+    }(tuple_sequence_t<C, Comps...>());
+}
+
+template <typename C, typename... Comps>
+void EntityIterator<C, Comps...>::skip_unmatched() {
+    while (m_current_id < m_end_id && !matches()) {
+        m_current_id++;
+        m_current_storage += m_storage_stride;
+    }
+}
+
+template <typename C, typename... Comps>
+bool EntityIterator<C, Comps...>::operator==(const EntityIterator &other) const {
+    return m_current_id == other.m_current_id;
 }
 
 template <typename C, typename... Comps>
 EntityIterator<C, Comps...> &EntityIterator<C, Comps...>::operator++() {
-    do {
-        EntityIterator<C>::operator++();
-    } while (EntityIterator<C>::m_current_id < m_end_id &&
-             !EntityIterator<C>::m_manager->template has_component<Comps...>(*EntityIterator<C>::m_current_id));
+    m_current_id++;
+    m_current_storage += m_storage_stride;
+    skip_unmatched();
     return *this;
 }
 
 template <typename C, typename... Comps>
-Tuple<Entity, C &, Comps &...> EntityIterator<C, Comps...>::operator*() const {
-    return vull::make_tuple(
-        Entity(EntityIterator<C>::m_manager, *EntityIterator<C>::m_current_id),
-        vull::ref(*EntityIterator<C>::m_current_component),
-        vull::ref(EntityIterator<C>::m_manager->template get_component<Comps>(*EntityIterator<C>::m_current_id))...);
+Tuple<Entity, filter_component_t<C> &, filter_component_t<Comps> &...>
+EntityIterator<C, Comps...>::operator*() const {
+    const auto get = [this]<typename T>(uint32_t index) -> T & {
+        if (index == m_driving_index) {
+            return *reinterpret_cast<T *>(m_current_storage);
+        }
+        return m_manager->template get_component<T>(*m_current_id);
+    };
+    return [&]<size_t... Is>(IntegerSequence<size_t, Is...>) {
+        return vull::make_tuple(Entity(m_manager, *m_current_id),
+                                vull::ref(get.template operator()<filter_component_t<C>>(0)),
+                                vull::ref(get.template operator()<filter_component_t<Comps>>(Is + 1))...);
+    }(tuple_sequence_t<Comps...>());
 }
 
 template <typename C, typename... Comps>
-EntityView<C, Comps...>::EntityView(EntityManager *manager)
-    : m_manager(manager), m_component_set(manager->m_component_sets[C::k_component_id]) {}
+EntityView<C, Comps...>::EntityView(EntityManager *manager, uint32_t since_tick)
+    : m_manager(manager), m_component_set(&manager->m_component_sets[filter_component_t<C>::k_component_id]),
+      m_since_tick(since_tick) {
+    // Every matching entity is in every participating set, so walk the smallest one.
+    [[maybe_unused]] uint32_t index = 1;
+    ([&] {
+        auto &set = manager->m_component_sets[filter_component_t<Comps>::k_component_id];
+        if (set.size() < m_component_set->size()) {
+            m_component_set = &set;
+            m_driving_index = index;
+        }
+        index++;
+    }(), ...);
+}
 
 template <typename C, typename... Comps>
 EntityIterator<C, Comps...> EntityView<C, Comps...>::begin() const {
-    return {m_manager, m_component_set.dense_begin(), m_component_set.storage_begin<C>()};
+    if constexpr (sizeof...(Comps) == 0 && !ChangeFilter<C>) {
+        return {m_manager, m_component_set->dense_begin(), m_component_set->template storage_begin<C>()};
+    } else {
+        return {m_manager,
+                m_component_set->dense_begin(),
+                m_component_set->dense_end(),
+                m_component_set->template storage_begin<uint8_t>(),
+                m_component_set->object_size(),
+                m_driving_index,
+                m_since_tick};
+    }
 }
 
 template <typename C, typename... Comps>
 EntityIterator<C, Comps...> EntityView<C, Comps...>::end() const {
-    return {m_manager, m_component_set.dense_end(), m_component_set.storage_end<C>()};
+    if constexpr (sizeof...(Comps) == 0 && !ChangeFilter<C>) {
+        return {m_manager, m_component_set->dense_end(), m_component_set->template storage_end<C>()};
+    } else {
+        return {m_manager, m_component_set->dense_end(), m_component_set->dense_end(), nullptr, 0, m_driving_index,
+                m_since_tick};
+    }
+}
+
+template <typename... Comps>
+GroupIterator<Comps...> &GroupIterator<Comps...>::operator++() {
+    m_index++;
+    return *this;
+}
+
+template <typename... Comps>
+Tuple<Entity, Comps &...> GroupIterator<Comps...>::operator*() const {
+    return [this]<size_t... Is>(IntegerSequence<size_t, Is...>) {
+        return vull::make_tuple(Entity(m_manager, m_ids[m_index]), vull::ref(vull::get<Is>(m_storages)[m_index])...);
+    }(tuple_sequence_t<Comps...>());
+}
+
+template <typename... Comps>
+GroupIterator<Comps...> GroupView<Comps...>::begin() const {
+    return {m_manager, m_ids,
+            Tuple<Comps *...>(m_manager->m_component_sets[Comps::k_component_id].template storage_begin<Comps>()...),
+            0};
+}
+
+template <typename... Comps>
+GroupIterator<Comps...> GroupView<Comps...>::end() const {
+    return {m_manager, nullptr, {}, m_size};
 }
 
 template <typename C>
 void EntityManager::register_component() {
     m_component_sets.ensure_size(C::k_component_id + 1);
     m_component_sets[C::k_component_id].template initialise<C>();
+    m_removed_lists.ensure_size(C::k_component_id + 1);
 }
 
 template <typename C, typename... Args>
 void EntityManager::add_component(EntityId id, Args &&...args) {
-    m_component_sets[C::k_component_id].template emplace<C>(entity_index(id), vull::forward<Args>(args)...);
+    auto &set = m_component_sets[C::k_component_id];
+    set.template emplace<C>(entity_index(id), vull::forward<Args>(args)...);
+    set.ticks(entity_index(id)) = {m_change_tick, m_change_tick};
+    if (const auto group_index = owning_group(C::k_component_id); group_index != k_no_group) {
+        enter_group(group_index, entity_index(id));
+    }
 }
 
 template <typename C>
@@ -244,14 +528,123 @@ bool EntityManager::has_component(EntityId id) {
     return has_component<C>(id) && has_component<D, Comps...>(id);
 }
 
+template <typename C>
+EntityId EntityManager::component_count() const {
+    return C::k_component_id < m_component_sets.size() ? m_component_sets[C::k_component_id].size() : 0;
+}
+
 template <typename C>
 void EntityManager::remove_component(EntityId id) {
+    if (const auto group_index = owning_group(C::k_component_id); group_index != k_no_group) {
+        leave_group(group_index, entity_index(id));
+    }
     m_component_sets[C::k_component_id].remove(entity_index(id));
+    record_removed(C::k_component_id, id);
 }
 
 template <typename... Comps>
 EntityView<Comps...> EntityManager::view() {
-    return {this};
+    return {this, m_change_tick - 1};
+}
+
+template <typename... Comps>
+EntityView<Comps...> EntityManager::view(uint32_t since_tick) {
+    return {this, since_tick};
+}
+
+template <typename C>
+void EntityManager::mark_changed(EntityId id) {
+    m_component_sets[C::k_component_id].ticks(entity_index(id)).changed = m_change_tick;
+}
+
+template <typename C>
+const ComponentTicks &EntityManager::component_ticks(EntityId id) const {
+    return m_component_sets[C::k_component_id].ticks(entity_index(id));
+}
+
+template <typename C>
+void EntityManager::track_removed() {
+    m_removed_lists.ensure_size(C::k_component_id + 1);
+    m_removed_lists[C::k_component_id].tracked = true;
+}
+
+template <typename C>
+Span<const EntityId> EntityManager::removed() const {
+    if (C::k_component_id >= m_removed_lists.size()) {
+        return {};
+    }
+    const auto &ids = m_removed_lists[C::k_component_id].ids;
+    return {ids.data(), ids.size()};
+}
+
+template <typename... Comps>
+void EntityManager::create_group() {
+    static_assert(sizeof...(Comps) >= 2, "A group needs at least two components");
+    const auto group_index = m_groups.size();
+    auto &group = m_groups.emplace();
+    (group.component_ids.push(Comps::k_component_id), ...);
+    for (const auto component_id : group.component_ids) {
+        if (component_id >= m_component_groups.size()) {
+            const auto old_size = m_component_groups.size();
+            m_component_groups.ensure_size(component_id + 1);
+            for (auto i = old_size; i < m_component_groups.size(); i++) {
+                m_component_groups[i] = k_no_group;
+            }
+        }
+        VULL_ASSERT(m_component_groups[component_id] == k_no_group, "Component already owned by a group");
+        m_component_groups[component_id] = group_index;
+    }
+    pack_group(group_index);
+}
+
+template <typename... Comps>
+GroupView<Comps...> EntityManager::group() {
+    const size_t component_ids[]{Comps::k_component_id...};
+    const auto group_index = owning_group(component_ids[0]);
+    VULL_ASSERT(group_index != k_no_group);
+    VULL_ASSERT(((owning_group(Comps::k_component_id) == group_index) && ...));
+    VULL_ASSERT(m_groups[group_index].component_ids.size() == sizeof...(Comps));
+    return {this, m_component_sets[component_ids[0]].dense_begin(), m_groups[group_index].size};
+}
+
+template <typename C, typename... Comps, typename F>
+void EntityManager::parallel_for(F &&fn, uint32_t grain_size) {
+    using DrivingComp = remove_cv<C>;
+    auto &component_set = m_component_sets[DrivingComp::k_component_id];
+    const EntityId *ids = component_set.dense_begin();
+    auto *storage = component_set.template storage_begin<DrivingComp>();
+    const auto run_range = [this, &fn, ids, storage](EntityId begin, EntityId end) {
+        for (EntityId i = begin; i < end; i++) {
+            if constexpr (sizeof...(Comps) != 0) {
+                if (!has_component<remove_cv<Comps>...>(ids[i])) {
+                    continue;
+                }
+            }
+            fn(Entity(this, ids[i]), static_cast<C &>(storage[i]),
+               static_cast<Comps &>(get_component<remove_cv<Comps>>(ids[i]))...);
+        }
+    };
+
+    grain_size = vull::max(grain_size, 1u);
+    const EntityId size = component_set.size();
+    const EntityId range_count = vull::ceil_div(size, grain_size);
+    if (range_count <= 1 || !tasklet::in_tasklet_context()) {
+        run_range(0, size);
+        return;
+    }
+
+    // Run the first range on the calling tasklet whilst the others are picked up by other threads.
+    tasklet::Latch latch(range_count - 1);
+    for (EntityId range = 1; range < range_count; range++) {
+        const EntityId begin = range * grain_size;
+        const EntityId end = vull::min(size, begin + grain_size);
+        tasklet::schedule([&run_range, &latch, begin, end] {
+            run_range(begin, end);
+            latch.count_down();
+        });
+    }
+    run_range(0, grain_size);
+    latch.wait();
 }
 
 } // namespace vull
@@ -1,27 +1,60 @@
 #pragma once
 
+#include <vull/container/array.hh>
 #include <vull/container/vector.hh>
 #include <vull/support/assert.hh>
 #include <vull/support/function.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
 #include <vull/support/stream.hh>
+#include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 namespace vull {
 
-// TODO: Paging.
+// The ticks at which a component was added and last marked as changed.
+struct ComponentTicks {
+    uint32_t added;
+    uint32_t changed;
+};
+
 template <typename I>
 class SparseSet {
+    // The sparse array is split into fixed-size pages which are allocated on first use and freed once none of their
+    // indices are in the set, so that a few high indices don't cost a sparse array spanning the whole index range.
+    static constexpr I k_page_size = 4096;
+    struct SparsePage {
+        Array<I, k_page_size> dense_indices;
+        I live_count{0};
+    };
+
     Vector<I, I> m_dense;
-    Vector<I, I> m_sparse;
+    Vector<ComponentTicks, I> m_ticks;
+    Vector<UniquePtr<SparsePage>, I> m_sparse_pages;
     uint8_t *m_data{nullptr};
 
     void (*m_destruct)(void *){nullptr};
     void (*m_swap)(void *, void *){nullptr};
-    void (*m_deserialise)(void *, Stream &){nullptr};
-    void (*m_serialise)(void *, Stream &){nullptr};
+    Result<void, StreamError> (*m_deserialise)(void *, Stream &){nullptr};
+    Result<void, StreamError> (*m_serialise)(void *, Stream &){nullptr};
+    void (*m_relocate)(void *, void *){nullptr};
+    void (*m_remap_entities)(void *, Span<const I>){nullptr};
     I m_object_size{0};
     I m_capacity{0};
 
+    // True if T has no custom (de)serialise functions, meaning the whole storage array can be read or written in one
+    // go.
+    bool m_raw_serialisable{false};
+
+    I &sparse_entry(I index);
+    void acquire_sparse_entry(I index, I dense_index);
+    void release_sparse_entry(I index);
+    void grow(I capacity);
+
 public:
     SparseSet() = default;
     SparseSet(const SparseSet &) = delete;
@@ -33,9 +66,17 @@ public:
 
     template <typename T>
     void initialise();
-    void deserialise(I count, Stream &stream);
+    Result<void, StreamError> deserialise(I count, Stream &stream);
     void raw_ensure_index(I index);
-    void serialise(Stream &stream);
+    void raw_ensure_indices(Span<const I> indices);
+    Result<void, StreamError> serialise(Stream &stream);
+
+    // Moves every object out of other and into this set, where indices maps each of other's indices to an index in
+    // this set. The moved objects are given the passed ticks. Other is left empty.
+    void merge(SparseSet &&other, Span<const I> indices, ComponentTicks ticks);
+
+    // Rewrites entity references held by each object, if T defines a remap_entities(Span<const I>) member function.
+    void remap_entities(Span<const I> ids);
 
     template <typename T>
     T &at(I index);
@@ -44,6 +85,15 @@ public:
     void emplace(I index, Args &&...args);
     void remove(I index);
 
+    // Swaps the objects at the given positions in the dense array.
+    void swap_dense(I lhs, I rhs);
+    I dense_index(I index) const;
+
+    // Change ticks, stored alongside the dense array. New entries start with zeroed ticks.
+    ComponentTicks &ticks(I index);
+    const ComponentTicks &ticks(I index) const;
+    void reset_ticks(ComponentTicks ticks);
+
     auto dense_begin() { return m_dense.begin(); }
     auto dense_end() { return m_dense.end(); }
     template <typename T>
@@ -55,17 +105,25 @@ public:
     bool initialised() const { return m_destruct != nullptr; }
     I size() const { return m_dense.size(); }
     uint32_t object_size() const { return m_object_size; }
+
+    // Returns the number of bytes used by the sparse array, including the page table.
+    size_t sparse_memory_usage() const;
 };
 
 template <typename I>
-SparseSet<I>::SparseSet(SparseSet &&other) : m_dense(vull::move(other.m_dense)), m_sparse(vull::move(other.m_sparse)) {
+SparseSet<I>::SparseSet(SparseSet &&other)
+    : m_dense(vull::move(other.m_dense)), m_ticks(vull::move(other.m_ticks)),
+      m_sparse_pages(vull::move(other.m_sparse_pages)) {
     m_data = vull::exchange(other.m_data, nullptr);
     m_destruct = vull::exchange(other.m_destruct, nullptr);
     m_swap = vull::exchange(other.m_swap, nullptr);
     m_deserialise = vull::exchange(other.m_deserialise, nullptr);
     m_serialise = vull::exchange(other.m_serialise, nullptr);
+    m_relocate = vull::exchange(other.m_relocate, nullptr);
+    m_remap_entities = vull::exchange(other.m_remap_entities, nullptr);
     m_object_size = vull::exchange(other.m_object_size, 0u);
     m_capacity = vull::exchange(other.m_capacity, 0u);
+    m_raw_serialisable = vull::exchange(other.m_raw_serialisable, false);
 }
 
 template <typename I>
@@ -85,52 +143,171 @@ void SparseSet<I>::initialise() {
     m_swap = +[](void *lhs, void *rhs) {
         vull::swap(*static_cast<T *>(lhs), *static_cast<T *>(rhs));
     };
-    m_deserialise = +[](void *ptr, Stream &stream) {
+    m_deserialise = +[](void *ptr, Stream &stream) -> Result<void, StreamError> {
         if constexpr (!requires(T) { T::deserialise(stream); }) {
             if constexpr (!is_trivially_copyable<T>) {
                 static_assert(!is_same<T, T>, "T has no defined deserialise function but is also not a trivial type");
             }
-            // TODO: Propagate errors.
-            VULL_EXPECT(stream.read({static_cast<uint8_t *>(ptr), sizeof(T)}));
+            if (VULL_TRY(stream.read({static_cast<uint8_t *>(ptr), sizeof(T)})) != sizeof(T)) {
+                return StreamError::Truncated;
+            }
         } else {
             new (ptr) T(T::deserialise(stream));
         }
+        return {};
     };
-    m_serialise = +[](void *ptr, Stream &stream) {
+    m_serialise = +[](void *ptr, Stream &stream) -> Result<void, StreamError> {
         if constexpr (!requires(T t) { T::serialise(t, stream); }) {
             if constexpr (!is_trivially_copyable<T>) {
                 static_assert(!is_same<T, T>, "T has no defined serialise function but is also not a trivial type");
             }
-            // TODO: Propagate errors.
-            VULL_EXPECT(stream.write({static_cast<uint8_t *>(ptr), sizeof(T)}));
+            VULL_TRY(stream.write({static_cast<uint8_t *>(ptr), sizeof(T)}));
         } else {
             T::serialise(*static_cast<T *>(ptr), stream);
         }
+        return {};
     };
+    if constexpr (!is_trivially_copyable<T>) {
+        m_relocate = +[](void *dst, void *src) {
+            new (dst) T(vull::move(*static_cast<T *>(src)));
+            static_cast<T *>(src)->~T();
+        };
+    }
+    if constexpr (requires(T t, Span<const I> ids) { t.remap_entities(ids); }) {
+        m_remap_entities = +[](void *ptr, Span<const I> ids) {
+            static_cast<T *>(ptr)->remap_entities(ids);
+        };
+    }
     m_object_size = static_cast<I>(sizeof(T));
+    constexpr bool has_deserialise = requires(Stream &stream) { T::deserialise(stream); };
+    constexpr bool has_serialise = requires(T t, Stream &stream) { T::serialise(t, stream); };
+    m_raw_serialisable = is_trivially_copyable<T> && !has_deserialise && !has_serialise;
 }
 
 template <typename I>
-void SparseSet<I>::deserialise(I count, Stream &stream) {
+Result<void, StreamError> SparseSet<I>::deserialise(I count, Stream &stream) {
     m_capacity = count;
     m_data = new uint8_t[m_capacity * m_object_size];
-    // TODO: If trivially copyable, read from stream in one go.
+    if (m_raw_serialisable) {
+        const size_t byte_count = size_t(count) * m_object_size;
+        if (VULL_TRY(stream.read({m_data, byte_count})) != byte_count) {
+            return StreamError::Truncated;
+        }
+        return {};
+    }
     for (I i = 0; i < count; i++) {
-        m_deserialise(m_data + i * m_object_size, stream);
+        VULL_TRY(m_deserialise(m_data + i * m_object_size, stream));
     }
+    return {};
+}
+
+template <typename I>
+I &SparseSet<I>::sparse_entry(I index) {
+    return m_sparse_pages[index / k_page_size]->dense_indices[index % k_page_size];
+}
+
+template <typename I>
+void SparseSet<I>::acquire_sparse_entry(I index, I dense_index) {
+    const I page_index = index / k_page_size;
+    m_sparse_pages.ensure_size(page_index + 1);
+    auto &page = m_sparse_pages[page_index];
+    if (!page) {
+        page = vull::make_unique<SparsePage>();
+    }
+    page->dense_indices[index % k_page_size] = dense_index;
+    page->live_count++;
+}
+
+template <typename I>
+void SparseSet<I>::release_sparse_entry(I index) {
+    auto &page = m_sparse_pages[index / k_page_size];
+    if (--page->live_count == 0) {
+        page.clear();
+    }
+}
+
+template <typename I>
+void SparseSet<I>::grow(I capacity) {
+    if (capacity <= m_capacity) {
+        return;
+    }
+    capacity = vull::max(m_capacity * 2 + 1, capacity);
+    auto *new_data = new uint8_t[capacity * m_object_size];
+    if (m_relocate != nullptr) {
+        for (I i = 0; i < m_dense.size(); i++) {
+            m_relocate(new_data + i * m_object_size, m_data + i * m_object_size);
+        }
+    } else if (!m_dense.empty()) {
+        memcpy(new_data, m_data, m_dense.size() * m_object_size);
+    }
+    delete[] m_data;
+    m_data = new_data;
+    m_capacity = capacity;
 }
 
 template <typename I>
 void SparseSet<I>::raw_ensure_index(I index) {
-    m_sparse.ensure_size(index + 1);
-    m_sparse[index] = m_dense.size();
+    acquire_sparse_entry(index, m_dense.size());
     m_dense.push(index);
+    m_ticks.push({});
+}
+
+template <typename I>
+void SparseSet<I>::raw_ensure_indices(Span<const I> indices) {
+    const I first_dense_index = m_dense.size();
+    m_dense.ensure_size(first_dense_index + indices.size());
+    m_ticks.ensure_size(m_dense.size());
+    memcpy(m_dense.data() + first_dense_index, indices.data(), indices.size() * sizeof(I));
+    for (I i = 0; i < indices.size(); i++) {
+        acquire_sparse_entry(indices[i], first_dense_index + i);
+    }
+}
+
+template <typename I>
+Result<void, StreamError> SparseSet<I>::serialise(Stream &stream) {
+    if (m_raw_serialisable) {
+        return stream.write({m_data, size_t(m_dense.size()) * m_object_size});
+    }
+    for (I i = 0; i < m_dense.size(); i++) {
+        VULL_TRY(m_serialise(m_data + i * m_object_size, stream));
+    }
+    return {};
+}
+
+template <typename I>
+void SparseSet<I>::merge(SparseSet &&other, Span<const I> indices, ComponentTicks ticks) {
+    VULL_ASSERT(other.m_object_size == m_object_size);
+    const I first_dense_index = m_dense.size();
+    grow(first_dense_index + other.m_dense.size());
+    for (I i = 0; i < other.m_dense.size(); i++) {
+        void *src = other.m_data + i * m_object_size;
+        void *dst = m_data + (first_dense_index + i) * m_object_size;
+        if (m_relocate != nullptr) {
+            m_relocate(dst, src);
+        } else {
+            memcpy(dst, src, m_object_size);
+        }
+
+        const I index = indices[other.m_dense[i]];
+        VULL_ASSERT(!contains(index));
+        acquire_sparse_entry(index, first_dense_index + i);
+        m_dense.push(index);
+        m_ticks.push(ticks);
+    }
+
+    // Everything has been moved out, so nothing should be destructed.
+    other.m_dense.clear();
+    other.m_ticks.clear();
+    other.m_sparse_pages.clear();
 }
 
 template <typename I>
-void SparseSet<I>::serialise(Stream &stream) {
+void SparseSet<I>::remap_entities(Span<const I> ids) {
+    if (m_remap_entities == nullptr) {
+        return;
+    }
     for (I i = 0; i < m_dense.size(); i++) {
-        m_serialise(m_data + i * m_object_size, stream);
+        m_remap_entities(m_data + i * m_object_size, ids);
     }
 }
 
@@ -139,19 +316,18 @@ template <typename T>
 T &SparseSet<I>::at(I index) {
     VULL_ASSERT(contains(index));
     VULL_ASSERT_PEDANTIC(m_object_size == sizeof(T));
-    return *reinterpret_cast<T *>(m_data + m_sparse[index] * sizeof(T));
+    return *reinterpret_cast<T *>(m_data + sparse_entry(index) * sizeof(T));
 }
 
 template <typename I>
 bool SparseSet<I>::contains(I index) const {
     // TODO: Sentinel value optimisation.
-    if (index >= m_sparse.size()) {
-        return false;
-    }
-    if (m_sparse[index] >= m_dense.size()) {
+    const I page_index = index / k_page_size;
+    if (page_index >= m_sparse_pages.size() || !m_sparse_pages[page_index]) {
         return false;
     }
-    return m_dense[m_sparse[index]] == index;
+    const I dense_index = m_sparse_pages[page_index]->dense_indices[index % k_page_size];
+    return dense_index < m_dense.size() && m_dense[dense_index] == index;
 }
 
 template <typename I>
@@ -159,8 +335,7 @@ template <typename T, typename... Args>
 void SparseSet<I>::emplace(I index, Args &&...args) {
     VULL_ASSERT(!contains(index));
     VULL_ASSERT_PEDANTIC(m_object_size == sizeof(T));
-    m_sparse.ensure_size(index + 1);
-    m_sparse[index] = m_dense.size();
+    acquire_sparse_entry(index, m_dense.size());
 
     if (auto new_capacity = m_dense.size() + 1; new_capacity > m_capacity) {
         new_capacity = vull::max(m_capacity * 2 + 1, new_capacity);
@@ -182,22 +357,70 @@ void SparseSet<I>::emplace(I index, Args &&...args) {
     // NOLINTNEXTLINE
     new (&reinterpret_cast<T *>(m_data)[m_dense.size()]) T(vull::forward<Args>(args)...);
     m_dense.push(index);
+    m_ticks.push({});
 }
 
 // TODO: Alternate templated remove function that may be slightly faster when T is known.
 template <typename I>
 void SparseSet<I>::remove(I index) {
     VULL_ASSERT(contains(index));
-    if (const I &dense_index = m_sparse[index]; m_dense[dense_index] != m_dense.last()) {
-        m_sparse[m_dense.last()] = dense_index;
+    if (const I dense_index = sparse_entry(index); m_dense[dense_index] != m_dense.last()) {
+        sparse_entry(m_dense.last()) = dense_index;
         vull::swap(m_dense[dense_index], m_dense.last());
+        m_ticks[dense_index] = m_ticks.last();
         m_swap(m_data + dense_index * m_object_size, m_data + (m_dense.size() - 1) * m_object_size);
     }
     m_dense.pop();
+    m_ticks.pop();
     m_destruct(m_data + m_dense.size() * m_object_size);
+    release_sparse_entry(index);
     // TODO: Shrink storage if desirable.
 }
 
+template <typename I>
+void SparseSet<I>::swap_dense(I lhs, I rhs) {
+    if (lhs == rhs) {
+        return;
+    }
+    vull::swap(sparse_entry(m_dense[lhs]), sparse_entry(m_dense[rhs]));
+    vull::swap(m_dense[lhs], m_dense[rhs]);
+    vull::swap(m_ticks[lhs], m_ticks[rhs]);
+    m_swap(m_data + lhs * m_object_size, m_data + rhs * m_object_size);
+}
+
+template <typename I>
+I SparseSet<I>::dense_index(I index) const {
+    VULL_ASSERT(contains(index));
+    return m_sparse_pages[index / k_page_size]->dense_indices[index % k_page_size];
+}
+
+template <typename I>
+ComponentTicks &SparseSet<I>::ticks(I index) {
+    VULL_ASSERT(contains(index));
+    return m_ticks[sparse_entry(index)];
+}
+
+template <typename I>
+const ComponentTicks &SparseSet<I>::ticks(I index) const {
+    return m_ticks[dense_index(index)];
+}
+
+template <typename I>
+void SparseSet<I>::reset_ticks(ComponentTicks ticks) {
+    for (auto &entry : m_ticks) {
+        entry = ticks;
+    }
+}
+
+template <typename I>
+size_t SparseSet<I>::sparse_memory_usage() const {
+    size_t usage = m_sparse_pages.capacity() * sizeof(UniquePtr<SparsePage>);
+    for (const auto &page : m_sparse_pages) {
+        usage += page ? sizeof(SparsePage) : 0;
+    }
+    return usage;
+}
+
 template <typename I>
 template <typename T>
 T *SparseSet<I>::storage_begin() {
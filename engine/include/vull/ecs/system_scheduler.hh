@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/function.hh>
+#include <vull/support/string.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
+
+namespace vull::tasklet {
+
+class Latch;
+
+} // namespace vull::tasklet
+
+namespace vull {
+
+class EntityManager;
+class SystemScheduler;
+
+// A unit of per-frame work over an EntityManager, along with the component types it reads and writes.
+class System {
+    friend class SystemScheduler;
+
+private:
+    SystemScheduler &m_scheduler;
+    String m_name;
+    Function<void(EntityManager &)> m_function;
+    uint64_t m_read_mask{0};
+    uint64_t m_write_mask{0};
+    bool m_exclusive{false};
+    float m_duration{0.0f};
+
+    // Built by the scheduler.
+    Vector<uint32_t> m_dependents;
+    uint32_t m_dependency_count{0};
+    Atomic<uint32_t> m_pending_count;
+
+    template <typename C>
+    static constexpr uint64_t component_bit();
+
+public:
+    System(SystemScheduler &scheduler, String name, Function<void(EntityManager &)> &&function)
+        : m_scheduler(scheduler), m_name(vull::move(name)), m_function(vull::move(function)) {}
+    System(const System &) = delete;
+    System(System &&) = delete;
+    ~System() = default;
+
+    System &operator=(const System &) = delete;
+    System &operator=(System &&) = delete;
+
+    // Declaring access after the scheduler has run causes its graph to be rebuilt on the next run.
+    template <typename... Comps>
+    System &reads();
+    template <typename... Comps>
+    System &writes();
+
+    // Marks the system as needing the whole manager to itself, e.g. because it creates or destroys entities or adds or
+    // removes components. Exclusive systems never run alongside any other system.
+    System &exclusive();
+
+    // Returns true if the two systems can't run at the same time, i.e. if either writes something the other accesses.
+    bool conflicts_with(const System &other) const;
+
+    const String &name() const { return m_name; }
+    uint32_t dependency_count() const { return m_dependency_count; }
+
+    // Returns the wall time of the system's last run in seconds.
+    float duration() const { return m_duration; }
+};
+
+// Runs a set of systems once per call to run. Systems conflicting with an earlier added system run after it, whilst
+// systems which don't conflict run concurrently as tasklets. Outside of a tasklet context, systems run in the order
+// they were added.
+class SystemScheduler {
+    friend System;
+
+private:
+    Vector<UniquePtr<System>> m_systems;
+    Vector<uint32_t> m_root_systems;
+    bool m_graph_dirty{false};
+
+    void build_graph();
+    void run_system(EntityManager &manager, uint32_t index);
+    void run_system_tasklet(EntityManager &manager, uint32_t index, tasklet::Latch &latch);
+
+public:
+    // Adds a system, returning a reference to it, valid for the lifetime of the scheduler, with which its component
+    // access can be declared.
+    System &add_system(String name, Function<void(EntityManager &)> &&function);
+
+    // Runs every system once, returning once all of them have finished. Per-system timings are also emitted as
+    // tracing zones.
+    void run(EntityManager &manager);
+
+    const Vector<UniquePtr<System>> &systems() const { return m_systems; }
+};
+
+template <typename C>
+constexpr uint64_t System::component_bit() {
+    static_assert(C::k_component_id < 64, "Component ID too large for a system access mask");
+    return uint64_t(1) << C::k_component_id;
+}
+
+template <typename... Comps>
+System &System::reads() {
+    m_read_mask |= (component_bit<Comps>() | ... | 0);
+    m_scheduler.m_graph_dirty = true;
+    return *this;
+}
+
+template <typename... Comps>
+System &System::writes() {
+    m_write_mask |= (component_bit<Comps>() | ... | 0);
+    m_scheduler.m_graph_dirty = true;
+    return *this;
+}
+
+inline System &System::exclusive() {
+    m_exclusive = true;
+    m_scheduler.m_graph_dirty = true;
+    return *this;
+}
+
+} // namespace vull
@@ -20,10 +20,20 @@ enum class WorldError {
     MissingEntry,
 };
 
+// How the entity IDs of each component set are stored in a world entry.
+enum class EntityIdEncoding {
+    // One varint per ID. Smallest on disk, but each ID must be decoded separately.
+    Varint,
+
+    // One little-endian u32 per ID, which lets a whole set's IDs be read in one go.
+    FixedWidth,
+};
+
 class World : public EntityManager {
 public:
     Result<void, StreamError, WorldError> deserialise(Stream &stream);
-    Result<void, StreamError> serialise(vpak::Writer &pack_writer, StringView name);
+    Result<void, StreamError> serialise(vpak::Writer &pack_writer, StringView name,
+                                        EntityIdEncoding id_encoding = EntityIdEncoding::Varint);
 };
 
 } // namespace vull
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/ecs2/entity.hh>
+#include <vull/maths/common.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/span.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
+
+namespace vull::ecs {
+
+using ComponentId = uint32_t;
+using ComponentMask = uint64_t;
+
+constexpr uint32_t k_max_component_count = 64;
+constexpr uint32_t k_chunk_size = 16384;
+constexpr uint32_t k_cache_line_size = 64;
+
+/**
+ * @brief Type-erased information about a component type, needed to move components between archetypes.
+ */
+struct ComponentInfo {
+    uint32_t size{0};
+    uint32_t alignment{0};
+
+    // Both null for trivially copyable types, which are moved with memcpy.
+    void (*move_construct)(void *dst, void *src){nullptr};
+    void (*destruct)(void *ptr){nullptr};
+
+    template <typename C>
+    static ComponentInfo make();
+    bool registered() const { return size != 0; }
+};
+
+/**
+ * @brief A fixed-size block of component storage. Each chunk holds up to the owning archetype's chunk capacity of
+ * entities, with one cache line aligned array per component (SoA), preceded by an array of entity handles.
+ */
+struct alignas(k_cache_line_size) Chunk {
+    uint8_t data[k_chunk_size];
+};
+
+/**
+ * @brief Storage for all entities with the same set of components.
+ *
+ * Rows are densely packed across chunks, so that row r lives in chunk r / capacity. Removing a row moves the last row
+ * into its place.
+ */
+class Archetype {
+    struct Column {
+        ComponentId id;
+        uint32_t offset;
+        ComponentInfo info;
+    };
+
+    ComponentMask m_mask;
+    Vector<Column> m_columns;
+    Vector<UniquePtr<Chunk>> m_chunks;
+    uint32_t m_chunk_capacity{0};
+    uint32_t m_size{0};
+
+    uint8_t *column_pointer(const Column &column, uint32_t row) const;
+
+public:
+    Archetype(ComponentMask mask, Span<const ComponentInfo> component_infos);
+    Archetype(const Archetype &) = delete;
+    Archetype(Archetype &&) = delete;
+    ~Archetype();
+
+    Archetype &operator=(const Archetype &) = delete;
+    Archetype &operator=(Archetype &&) = delete;
+
+    /**
+     * @brief Appends a new row for the given entity, leaving its component storage uninitialised.
+     *
+     * @return the index of the new row
+     */
+    uint32_t allocate_row(Entity entity);
+
+    /**
+     * @brief Move constructs the components of a row in another archetype into a row of this archetype, for each
+     * component the two archetypes have in common. The source components are left to be destroyed by remove_row.
+     */
+    void move_row_from(Archetype &source, uint32_t source_row, uint32_t row);
+
+    /**
+     * @brief Destroys the components of the given row and fills the hole with the last row.
+     *
+     * @return the entity which was moved into the row, or a null entity if the last row was removed
+     */
+    Entity remove_row(uint32_t row);
+
+    /**
+     * @brief Returns a pointer to the storage of the given component in the given row.
+     */
+    void *component(ComponentId id, uint32_t row) const;
+
+    /**
+     * @brief Returns a pointer to the array of the given component in the given chunk.
+     */
+    template <typename C>
+    C *column(uint32_t chunk_index) const;
+
+    uint32_t column_index(ComponentId id) const;
+    Entity *entities(uint32_t chunk_index) const;
+    uint32_t chunk_row_count(uint32_t chunk_index) const;
+
+    uint32_t chunk_capacity() const { return m_chunk_capacity; }
+    uint32_t chunk_count() const { return (m_size + m_chunk_capacity - 1) / m_chunk_capacity; }
+    ComponentMask mask() const { return m_mask; }
+    uint32_t size() const { return m_size; }
+};
+
+template <typename C>
+ComponentInfo ComponentInfo::make() {
+    static_assert(alignof(C) <= k_cache_line_size);
+    ComponentInfo info{
+        .size = sizeof(C),
+        .alignment = alignof(C),
+    };
+    if constexpr (!is_trivially_copyable<C>) {
+        info.move_construct = +[](void *dst, void *src) {
+            new (dst) C(vull::move(*static_cast<C *>(src)));
+        };
+        info.destruct = +[](void *ptr) {
+            static_cast<C *>(ptr)->~C();
+        };
+    }
+    return info;
+}
+
+template <typename C>
+C *Archetype::column(uint32_t chunk_index) const {
+    const auto &column = m_columns[column_index(C::k_component_id)];
+    VULL_ASSERT_PEDANTIC(column.info.size == sizeof(C));
+    return reinterpret_cast<C *>(m_chunks[chunk_index]->data + column.offset);
+}
+
+inline uint32_t Archetype::column_index(ComponentId id) const {
+    for (uint32_t i = 0; i < m_columns.size(); i++) {
+        if (m_columns[i].id == id) {
+            return i;
+        }
+    }
+    VULL_ENSURE_NOT_REACHED();
+}
+
+inline Entity *Archetype::entities(uint32_t chunk_index) const {
+    return reinterpret_cast<Entity *>(m_chunks[chunk_index]->data);
+}
+
+inline uint32_t Archetype::chunk_row_count(uint32_t chunk_index) const {
+    return vull::min(m_size - chunk_index * m_chunk_capacity, m_chunk_capacity);
+}
+
+} // namespace vull::ecs
@@ -1,18 +1,52 @@
 #pragma once
 
+#include <vull/container/hash_map.hh>
 #include <vull/container/vector.hh>
+#include <vull/ecs2/archetype.hh>
 #include <vull/ecs2/entity.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
 
 namespace vull::ecs {
 
 /**
  * @brief The root of the ECS.
+ *
+ * Entities are grouped by their set of components into archetypes, which store components in fixed-size SoA chunks.
+ * Queries then iterate the chunks of each matching archetype linearly. Adding or removing a component moves the
+ * entity's components to another archetype.
  */
 class World {
+    struct EntityLocation {
+        uint32_t archetype;
+        uint32_t row;
+    };
+
     Vector<Entity, EntityIndex> m_entity_list;
+    Vector<EntityLocation, EntityIndex> m_entity_locations;
     EntityIndex m_free_head{Entity::null_index()};
 
+    Vector<ComponentInfo> m_component_infos;
+    Vector<UniquePtr<Archetype>> m_archetypes;
+    HashMap<ComponentMask, uint32_t> m_archetype_indices;
+
+    template <typename C>
+    static constexpr ComponentMask component_bit();
+    uint32_t find_or_create_archetype(ComponentMask mask);
+    uint32_t move_entity(Entity entity, ComponentMask mask);
+
 public:
+    World();
+    World(const World &) = delete;
+    World(World &&) = delete;
+    ~World();
+
+    World &operator=(const World &) = delete;
+    World &operator=(World &&) = delete;
+
     /**
      * @brief Creates a new entity handle.
      *
@@ -21,7 +55,7 @@ public:
     Entity create();
 
     /**
-     * @brief Destroys the given entity and returns its index to the free pool.
+     * @brief Destroys the given entity, along with all of its components, and returns its index to the free pool.
      *
      * @param entity a valid entity handle
      */
@@ -33,6 +67,112 @@ public:
      * @param entity the handle to check
      */
     bool is_valid(Entity entity) const;
+
+    /**
+     * @brief Registers a component type. Components are registered automatically when first added.
+     */
+    template <typename C>
+    void register_component();
+
+    /**
+     * @brief Constructs a component of type C for the given entity, which must not already have one.
+     *
+     * @return a reference to the new component, valid until the entity's set of components next changes
+     */
+    template <typename C, typename... Args>
+    C &add_component(Entity entity, Args &&...args);
+
+    /**
+     * @brief Returns a reference to the component of type C of the given entity, which must have one.
+     */
+    template <typename C>
+    C &get_component(Entity entity);
+
+    /**
+     * @brief Returns true if the given entity has all of the given component types.
+     */
+    template <typename... Comps>
+    bool has_component(Entity entity) const;
+
+    /**
+     * @brief Destroys the component of type C of the given entity, which must have one.
+     */
+    template <typename C>
+    void remove_component(Entity entity);
+
+    /**
+     * @brief Calls fn(Entity, Comps &...) for every entity which has all of the given component types. Entities must
+     * not be created or destroyed, nor components added or removed, during iteration.
+     */
+    template <typename... Comps, typename F>
+    void for_each(F &&fn);
+
+    uint32_t archetype_count() const { return m_archetypes.size(); }
 };
 
+template <typename C>
+constexpr ComponentMask World::component_bit() {
+    static_assert(C::k_component_id < k_max_component_count);
+    return ComponentMask(1) << C::k_component_id;
+}
+
+template <typename C>
+void World::register_component() {
+    m_component_infos.ensure_size(C::k_component_id + 1);
+    m_component_infos[C::k_component_id] = ComponentInfo::make<C>();
+}
+
+template <typename C, typename... Args>
+C &World::add_component(Entity entity, Args &&...args) {
+    VULL_ASSERT(is_valid(entity) && !has_component<C>(entity));
+    if (C::k_component_id >= m_component_infos.size() || !m_component_infos[C::k_component_id].registered()) {
+        register_component<C>();
+    }
+    const auto &old_archetype = *m_archetypes[m_entity_locations[entity.index()].archetype];
+    const auto archetype_index = move_entity(entity, old_archetype.mask() | component_bit<C>());
+    auto *ptr = m_archetypes[archetype_index]->component(C::k_component_id, m_entity_locations[entity.index()].row);
+    return *new (ptr) C(vull::forward<Args>(args)...);
+}
+
+template <typename C>
+C &World::get_component(Entity entity) {
+    VULL_ASSERT(is_valid(entity) && has_component<C>(entity));
+    const auto location = m_entity_locations[entity.index()];
+    return *static_cast<C *>(m_archetypes[location.archetype]->component(C::k_component_id, location.row));
+}
+
+template <typename... Comps>
+bool World::has_component(Entity entity) const {
+    constexpr auto mask = (component_bit<Comps>() | ...);
+    const auto &archetype = *m_archetypes[m_entity_locations[entity.index()].archetype];
+    return (archetype.mask() & mask) == mask;
+}
+
+template <typename C>
+void World::remove_component(Entity entity) {
+    VULL_ASSERT(is_valid(entity) && has_component<C>(entity));
+    const auto &old_archetype = *m_archetypes[m_entity_locations[entity.index()].archetype];
+    move_entity(entity, old_archetype.mask() & ~component_bit<C>());
+}
+
+template <typename... Comps, typename F>
+void World::for_each(F &&fn) {
+    static_assert(sizeof...(Comps) > 0);
+    constexpr auto mask = (component_bit<Comps>() | ...);
+    for (const auto &archetype : m_archetypes) {
+        if ((archetype->mask() & mask) != mask) {
+            continue;
+        }
+        for (uint32_t chunk_index = 0; chunk_index < archetype->chunk_count(); chunk_index++) {
+            const auto row_count = archetype->chunk_row_count(chunk_index);
+            const auto *entities = archetype->entities(chunk_index);
+            [&](Comps *...columns) {
+                for (uint32_t row = 0; row < row_count; row++) {
+                    fn(entities[row], columns[row]...);
+                }
+            }(archetype->template column<Comps>(chunk_index)...);
+        }
+    }
+}
+
 } // namespace vull::ecs
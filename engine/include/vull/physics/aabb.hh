@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vull/maths/relational.hh>
+#include <vull/maths/vec.hh>
+
+namespace vull {
+
+// An axis-aligned bounding box in world space.
+struct Aabb {
+    Vec3f min;
+    Vec3f max;
+
+    bool contains(const Aabb &other) const;
+    bool overlaps(const Aabb &other) const;
+    Aabb fattened(float margin) const;
+    Aabb merged(const Aabb &other) const;
+
+    // Half of the surface area is all that's needed to compare insertion costs.
+    float half_surface_area() const;
+};
+
+inline bool Aabb::contains(const Aabb &other) const {
+    return vull::all(vull::less_than_equal(min, other.min)) && vull::all(vull::greater_than_equal(max, other.max));
+}
+
+inline bool Aabb::overlaps(const Aabb &other) const {
+    return vull::all(vull::less_than_equal(min, other.max)) && vull::all(vull::greater_than_equal(max, other.min));
+}
+
+inline Aabb Aabb::fattened(float margin) const {
+    return {min - margin, max + margin};
+}
+
+inline Aabb Aabb::merged(const Aabb &other) const {
+    return {vull::min(min, other.min), vull::max(max, other.max)};
+}
+
+inline float Aabb::half_surface_area() const {
+    const auto extents = max - min;
+    return extents.x() * extents.y() + extents.y() * extents.z() + extents.z() * extents.x();
+}
+
+} // namespace vull
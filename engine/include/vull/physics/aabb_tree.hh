@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vull/container/array.hh>
+#include <vull/container/vector.hh>
+#include <vull/maths/vec.hh>
+#include <vull/physics/aabb.hh>
+#include <vull/support/assert.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+// A dynamic bounding volume hierarchy over fattened AABBs, kept balanced with tree rotations. Each leaf is a proxy
+// for some object, identified by the proxy ID returned from create_proxy. Because the stored AABBs are fattened, a
+// proxy only needs reinserting once its object moves outside of its fat AABB.
+class AabbTree {
+public:
+    static constexpr uint32_t k_null_proxy = ~0u;
+
+    // How far AABBs are fattened by in each direction.
+    static constexpr float k_margin = 0.1f;
+
+    // How many times a proxy's displacement its fat AABB is extended by along the direction of movement.
+    static constexpr float k_displacement_multiplier = 4.0f;
+
+private:
+    struct Node {
+        Aabb aabb;
+        // The next free node if the node is free.
+        uint32_t parent{k_null_proxy};
+        uint32_t left{k_null_proxy};
+        uint32_t right{k_null_proxy};
+        // Zero for leaves and -1 for free nodes.
+        int32_t height{0};
+        uint32_t user_data{0};
+
+        bool is_leaf() const { return left == k_null_proxy; }
+    };
+
+    Vector<Node> m_nodes;
+    uint32_t m_root{k_null_proxy};
+    uint32_t m_free_head{k_null_proxy};
+    uint32_t m_proxy_count{0};
+
+    uint32_t allocate_node();
+    void free_node(uint32_t index);
+    void insert_leaf(uint32_t leaf);
+    void remove_leaf(uint32_t leaf);
+    uint32_t balance(uint32_t index);
+    void refit_ancestors(uint32_t index);
+
+public:
+    uint32_t create_proxy(const Aabb &aabb, uint32_t user_data);
+    void destroy_proxy(uint32_t proxy);
+
+    // Updates a proxy with its new tight AABB, reinserting it if it has left its fat AABB. Returns true if the proxy
+    // was reinserted.
+    bool move_proxy(uint32_t proxy, const Aabb &aabb, const Vec3f &displacement);
+
+    // Calls callback(proxy) for every proxy whose fat AABB overlaps the given AABB. The callback may return false to
+    // stop the query early.
+    template <typename F>
+    void query(const Aabb &aabb, F &&callback) const;
+
+    const Aabb &fat_aabb(uint32_t proxy) const { return m_nodes[proxy].aabb; }
+    uint32_t user_data(uint32_t proxy) const { return m_nodes[proxy].user_data; }
+    uint32_t proxy_count() const { return m_proxy_count; }
+    int32_t height() const { return m_root != k_null_proxy ? m_nodes[m_root].height : 0; }
+};
+
+template <typename F>
+void AabbTree::query(const Aabb &aabb, F &&callback) const {
+    if (m_root == k_null_proxy) {
+        return;
+    }
+    // The tree is balanced, so its height stays small.
+    Array<uint32_t, 128> stack;
+    uint32_t stack_size = 0;
+    stack[stack_size++] = m_root;
+    while (stack_size != 0) {
+        const auto &node = m_nodes[stack[--stack_size]];
+        if (!node.aabb.overlaps(aabb)) {
+            continue;
+        }
+        if (!node.is_leaf()) {
+            VULL_ASSERT(stack_size + 2 <= stack.size());
+            stack[stack_size++] = node.left;
+            stack[stack_size++] = node.right;
+            continue;
+        }
+        if (!callback(static_cast<uint32_t>(&node - m_nodes.data()))) {
+            return;
+        }
+    }
+}
+
+} // namespace vull
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vull/container/array.hh>
+#include <vull/maths/vec.hh>
+#include <vull/physics/shape.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+class Transform;
+
+// The contact points found by a specialised collision test. Each point has a position on the surface of both shapes,
+// and the normal points from the second shape towards the first, as with ContactManifold.
+struct CollisionResult {
+    Vec3f normal;
+    Array<Vec3f, 8> points1;
+    Array<Vec3f, 8> points2;
+    uint32_t point_count{0};
+
+    void add_point(const Vec3f &point1, const Vec3f &point2);
+};
+
+// Returns true if there is a specialised collision test for the given pair of shape types. Any other pair must fall
+// back to MPR.
+bool has_collision_test(ShapeType type1, ShapeType type2);
+
+// Runs the specialised collision test for the given pair of shapes, returning false if they aren't touching.
+bool collide(const Shape &s1, const Transform &t1, const Shape &s2, const Transform &t2, CollisionResult &result);
+
+} // namespace vull
@@ -3,22 +3,51 @@
 #include <vull/container/array.hh>
 #include <vull/maths/vec.hh>
 
+#include <stdint.h>
+
 namespace vull {
 
+class Transform;
+
+struct Contact {
+    Vec3f position;
+    Vec3f normal;
+    float penetration;
+};
+
 struct ContactPoint {
+    // The deepest point of each body in that body's local space.
+    Vec3f local_point1;
+    Vec3f local_point2;
     Vec3f position;
     float penetration;
+
+    // Accumulated impulses, kept between steps for warm starting.
+    float normal_impulse{0.0f};
+    float tangent_impulse1{0.0f};
+    float tangent_impulse2{0.0f};
+
+    static ContactPoint from_contact(const Contact &contact, const Transform &t1, const Transform &t2);
+    static ContactPoint from_points(const Vec3f &point1, const Vec3f &point2, const Vec3f &normal, const Transform &t1,
+                                    const Transform &t2);
 };
 
+// A persistent set of up to four contact points between a pair of shapes. The normal points from the second shape
+// towards the first.
 struct ContactManifold {
+    // How far points may separate or slide apart before they are dropped.
+    static constexpr float k_breaking_threshold = 0.02f;
+
     Array<ContactPoint, 4> points;
+    uint32_t point_count{0};
     Vec3f normal;
-};
 
-struct Contact {
-    Vec3f position;
-    Vec3f normal;
-    float penetration;
+    // Recomputes the world space position and penetration of each point, dropping any that have separated or drifted.
+    void refresh(const Transform &t1, const Transform &t2);
+
+    // Adds a new point, unless there is already a nearby point. When the manifold is full, the deepest point is kept
+    // and the replaced point is chosen to maximise the contact area.
+    void add_point(const ContactPoint &point);
 };
 
 } // namespace vull
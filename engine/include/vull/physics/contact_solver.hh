@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vull/container/array.hh>
+#include <vull/container/vector.hh>
+#include <vull/maths/vec.hh>
+#include <vull/support/optional.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+class RigidBody;
+class Transform;
+struct ContactManifold;
+
+// A sequential impulse solver over contact manifolds with friction. Each manifold's accumulated impulses are applied up
+// front to warm start the solver, and are updated in place for the next step. Penetration is resolved separately with
+// pseudo velocities so that pushing bodies apart doesn't add energy.
+//
+// Manifolds are greedily coloured into batches in which no two manifolds share a body, so that each batch can be
+// solved in parallel. Batches are always solved in the same order, which keeps the result the same regardless of how
+// many threads are used.
+class ContactSolver {
+public:
+    // Passed in place of a body index for manifolds against static colliders.
+    static constexpr uint32_t k_static_body = ~0u;
+
+private:
+    struct PointConstraint {
+        Vec3f r1;
+        Vec3f r2;
+        float normal_mass;
+        float tangent_mass1;
+        float tangent_mass2;
+        float velocity_bias;
+        float position_bias;
+        float pseudo_impulse{0.0f};
+    };
+
+    struct ManifoldConstraint {
+        ContactManifold &manifold;
+        RigidBody &b1;
+        Optional<RigidBody &> b2;
+        uint32_t body_index1;
+        uint32_t body_index2;
+        Vec3f tangent1;
+        Vec3f tangent2;
+        Array<PointConstraint, 4> points;
+    };
+
+    Vector<ManifoldConstraint> m_constraints;
+
+    // Offsets into m_constraints of the start of each colour batch. Any manifolds which couldn't be coloured come after
+    // m_overflow_offset, and are solved serially.
+    Vector<uint32_t> m_batch_offsets;
+    uint32_t m_overflow_offset{0};
+    float m_friction;
+    float m_restitution;
+
+    static float inverse_mass_along(const RigidBody &body, const Vec3f &r, const Vec3f &direction);
+    static void apply_impulse(ManifoldConstraint &constraint, const PointConstraint &point, const Vec3f &impulse);
+    void solve_velocities(ManifoldConstraint &constraint) const;
+    static void solve_positions(ManifoldConstraint &constraint);
+    template <typename F>
+    void for_each_constraint(F &&fn);
+
+public:
+    // Friction is the coefficient bounding tangential impulses relative to normal impulses, and restitution the
+    // fraction of the closing speed of hard impacts which bounces the bodies apart again.
+    ContactSolver(float friction, float restitution) : m_friction(friction), m_restitution(restitution) {}
+
+    void add_manifold(ContactManifold &manifold, uint32_t body_index1, RigidBody &b1, const Transform &t1,
+                      uint32_t body_index2, Optional<RigidBody &> b2, const Transform &t2, float time_step);
+
+    // Colours the added manifolds into batches. Must be called after all manifolds are added and before solving.
+    void build_batches();
+
+    // Applies the impulses accumulated in the previous step, scaled by the ratio of the current and previous time
+    // steps.
+    void warm_start(float time_step_ratio);
+    void solve_velocities();
+    void solve_positions();
+
+    uint32_t batch_count() const { return m_batch_offsets.size(); }
+    uint32_t constraint_count() const { return m_constraints.size(); }
+};
+
+} // namespace vull
@@ -1,13 +1,90 @@
 #pragma once
 
+#include <vull/container/hash_map.hh>
+#include <vull/container/vector.hh>
+#include <vull/physics/aabb.hh>
+#include <vull/physics/aabb_tree.hh>
+#include <vull/physics/contact.hh>
+#include <vull/support/span.hh>
+
+#include <stdint.h>
+
 namespace vull {
 
+struct Shape;
+class Transform;
 class World;
 
 class PhysicsEngine {
+    // Broadphase state for a collider, indexed by entity index.
+    struct ColliderProxy {
+        uint32_t proxy{AabbTree::k_null_proxy};
+        uint32_t sync_stamp{0};
+        Aabb aabb;
+    };
+
+    // A persistent manifold between the collider of a body and another collider, keyed on both entity indices.
+    struct PairManifold {
+        uint32_t index1;
+        uint32_t index2;
+        ContactManifold manifold;
+    };
+
+    // A contact between two bodies, which puts them in the same island.
+    struct IslandEdge {
+        uint32_t index1;
+        uint32_t index2;
+    };
+
+    // Per-worker output of the narrowphase.
+    struct NarrowphaseBuffer {
+        Vector<PairManifold> manifolds;
+        Vector<IslandEdge> island_edges;
+        Vector<uint32_t> woken_islands;
+    };
+
+    AabbTree m_broadphase;
+    Vector<ColliderProxy> m_proxies;
+    uint32_t m_sync_stamp{0};
+
+    Vector<PairManifold> m_manifolds;
+    HashMap<uint64_t, uint32_t> m_manifold_indices;
+    uint32_t m_solver_iterations{8};
+    float m_friction{0.5f};
+    float m_restitution{0.1f};
+    float m_previous_time_step{0.0f};
+
+    // Union-find forest over the entity indices of awake bodies, rebuilt every substep.
+    Vector<uint32_t> m_island_parents;
+    Vector<float> m_island_sleep_times;
+
+    // Entity indices of the members of each sleeping island.
+    Vector<Vector<uint32_t>> m_sleeping_islands;
+    Vector<uint32_t> m_free_islands;
+    uint32_t m_island_sweep_index{0};
+
+    void update_broadphase(World &world, float time_step);
+    static bool update_manifold(ContactManifold &manifold, const Shape &s1, const Transform &t1, const Aabb &aabb1,
+                                const Shape &s2, const Transform &t2, const Aabb &aabb2);
+    void narrowphase(World &world, Span<const uint32_t> bodies, NarrowphaseBuffer &buffer) const;
+    uint32_t find_island_root(uint32_t index);
+    void wake_island(World &world, uint32_t island);
+    void sweep_sleeping_island(World &world);
+    void update_islands(World &world, Span<const IslandEdge> edges, float time_step);
     void sub_step(World &world, float time_step);
 
 public:
+    // Sets how many velocity and position iterations the contact solver performs each substep. More iterations give
+    // stiffer stacks at a higher cost.
+    void set_solver_iterations(uint32_t solver_iterations) { m_solver_iterations = solver_iterations; }
+
+    // Sets the friction coefficient and restitution used for every contact.
+    void set_friction(float friction) { m_friction = friction; }
+    void set_restitution(float restitution) { m_restitution = restitution; }
+
+    const AabbTree &broadphase() const { return m_broadphase; }
+    uint32_t manifold_count() const { return m_manifolds.size(); }
+    uint32_t sleeping_island_count() const { return m_sleeping_islands.size() - m_free_islands.size(); }
     void step(World &world, float dt);
 };
 
@@ -5,12 +5,16 @@
 #include <vull/maths/mat.hh>
 #include <vull/maths/vec.hh>
 
+#include <stdint.h>
+
 namespace vull {
 
+class ContactSolver;
 class PhysicsEngine;
 struct Shape;
 
 class RigidBody {
+    friend ContactSolver;
     friend PhysicsEngine;
     VULL_DECLARE_COMPONENT(BuiltinComponents::RigidBody);
 
@@ -24,7 +28,15 @@ private:
     Vec3f m_force;
     Vec3f m_torque;
     float m_inv_mass;
+    // How long the body has been below the sleep velocity threshold.
+    float m_sleep_time{0.0f};
+    // Index of the sleeping island the body belongs to, if any.
+    uint32_t m_island{~0u};
     bool m_ignore_rotation{false};
+    bool m_sleeping{false};
+
+    // Applies an impulse without waking the body, for use by the solver.
+    void add_impulse(const Vec3f &impulse, const Vec3f &point);
 
 public:
     RigidBody(float mass) : m_inv_mass(1.0f / mass) {}
@@ -34,11 +46,17 @@ public:
     void apply_impulse(const Vec3f &impulse, const Vec3f &point);
     void apply_psuedo_impulse(const Vec3f &impulse, const Vec3f &point);
     void set_ignore_rotation(bool ignore_rotation);
+    void set_linear_velocity(const Vec3f &velocity);
     void set_shape(const Shape &shape);
     Vec3f velocity_at_point(const Vec3f &point) const;
 
-    void set_linear_velocity(const Vec3f &velocity) { m_linear_velocity = velocity; }
+    // Wakes the body up if it is sleeping. Applying a force or impulse, or setting a non-zero velocity, also wakes the
+    // body. Bodies in contact with it are woken by the physics engine.
+    void wake();
+
     Vec3f linear_velocity() const { return m_linear_velocity; }
+    Vec3f angular_velocity() const { return m_angular_velocity; }
+    bool is_sleeping() const { return m_sleeping; }
 };
 
 } // namespace vull
@@ -1,12 +1,31 @@
 #pragma once
 
+#include <vull/container/vector.hh>
 #include <vull/maths/mat.hh>
 #include <vull/maths/vec.hh>
+#include <vull/physics/aabb.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
 
 namespace vull {
 
+class Transform;
+
+// Used to pick a specialised collision test for a pair of shapes.
+enum class ShapeType : uint8_t {
+    Box,
+    Sphere,
+    Capsule,
+    ConvexHull,
+};
+
 struct Shape {
-    Shape() = default;
+private:
+    const ShapeType m_type;
+
+public:
+    explicit Shape(ShapeType type) : m_type(type) {}
     Shape(const Shape &) = delete;
     Shape(Shape &&) = delete;
     virtual ~Shape() = default;
@@ -16,16 +35,73 @@ struct Shape {
 
     virtual Vec3f furthest_point(const Vec3f &direction) const = 0;
     virtual Mat3f inertia_tensor(float mass) const = 0;
+
+    // Returns the tight world space bounding box of the shape. The default implementation finds the furthest point
+    // along each world axis, but shapes may override it with something cheaper.
+    virtual Aabb world_aabb(const Transform &transform) const;
+
+    ShapeType type() const { return m_type; }
 };
 
 class BoxShape : public Shape {
     Vec3f m_half_extents;
 
 public:
-    BoxShape(const Vec3f &half_extents) : m_half_extents(half_extents) {}
+    BoxShape(const Vec3f &half_extents) : Shape(ShapeType::Box), m_half_extents(half_extents) {}
+
+    Vec3f furthest_point(const Vec3f &direction) const override;
+    Mat3f inertia_tensor(float mass) const override;
+    Aabb world_aabb(const Transform &transform) const override;
+
+    const Vec3f &half_extents() const { return m_half_extents; }
+};
+
+class SphereShape : public Shape {
+    float m_radius;
+
+public:
+    explicit SphereShape(float radius) : Shape(ShapeType::Sphere), m_radius(radius) {}
+
+    Vec3f furthest_point(const Vec3f &direction) const override;
+    Mat3f inertia_tensor(float mass) const override;
+    Aabb world_aabb(const Transform &transform) const override;
+
+    float radius() const { return m_radius; }
+};
+
+// A capsule aligned with the local Y axis, made up of a line segment from -half_height to half_height swept by a
+// sphere of the given radius.
+class CapsuleShape : public Shape {
+    float m_half_height;
+    float m_radius;
+
+public:
+    CapsuleShape(float half_height, float radius)
+        : Shape(ShapeType::Capsule), m_half_height(half_height), m_radius(radius) {}
 
     Vec3f furthest_point(const Vec3f &direction) const override;
     Mat3f inertia_tensor(float mass) const override;
+    Aabb world_aabb(const Transform &transform) const override;
+
+    // Returns the world space end points of the capsule's line segment.
+    void segment(const Transform &transform, Vec3f &a, Vec3f &b) const;
+
+    float half_height() const { return m_half_height; }
+    float radius() const { return m_radius; }
+};
+
+// The convex hull of a set of points in local space, which should be centred on the centre of mass. The points don't
+// need to be on the hull itself, but any interior points are wasted work in furthest_point.
+class ConvexHullShape : public Shape {
+    Vector<Vec3f> m_points;
+
+public:
+    explicit ConvexHullShape(Vector<Vec3f> &&points) : Shape(ShapeType::ConvexHull), m_points(vull::move(points)) {}
+
+    Vec3f furthest_point(const Vec3f &direction) const override;
+    Mat3f inertia_tensor(float mass) const override;
+
+    const Vector<Vec3f> &points() const { return m_points; }
 };
 
 } // namespace vull
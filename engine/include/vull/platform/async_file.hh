@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vull/platform/file.hh>
+#include <vull/support/result.hh>
+#include <vull/support/shared_ptr.hh>
+#include <vull/support/span.hh>
+#include <vull/support/string.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/future.hh>
+#include <vull/tasklet/io.hh>
+
+#include <stdint.h>
+
+namespace vull::platform {
+
+// A file whose reads and writes are submitted to the tasklet IO queue rather than blocking the calling thread. All
+// operations are positional and may only be started from a tasklet context. The returned future resolves to the
+// number of bytes transferred, or a negative errno value on failure. Any buffers passed in must outlive the request.
+//
+// The file can optionally be registered in the IO ring's file table, in which case fixed reads refer to it by its slot
+// index, saving the kernel from looking up the file descriptor on every request. A registered file destroyed inside a
+// tasklet context unregisters itself; one destroyed outside only drops its slot index.
+class AsyncFile {
+    File m_file;
+    int32_t m_fixed_index{-1};
+
+public:
+    static Result<AsyncFile, OpenError> open(String path, OpenModes modes);
+
+    AsyncFile() = default;
+    explicit AsyncFile(File &&file) : m_file(vull::move(file)) {}
+    AsyncFile(const AsyncFile &) = delete;
+    AsyncFile(AsyncFile &&other)
+        : m_file(vull::move(other.m_file)), m_fixed_index(vull::exchange(other.m_fixed_index, -1)) {}
+    ~AsyncFile();
+
+    AsyncFile &operator=(const AsyncFile &) = delete;
+    AsyncFile &operator=(AsyncFile &&);
+
+    // Registers the file in the IO ring's file table. Returns false if the table is full or wasn't reserved.
+    bool register_fixed();
+    void unregister_fixed();
+    tasklet::Future<tasklet::IoResult> read_fixed(const tasklet::FixedBuffer &buffer, uint32_t size,
+                                                  uint64_t offset) const;
+
+    // Makes a fixed read request without submitting it, so that several can be submitted together with
+    // tasklet::submit_io_requests.
+    SharedPtr<tasklet::ReadFixedRequest> make_read_fixed(const tasklet::FixedBuffer &buffer, uint32_t size,
+                                                         uint64_t offset) const;
+
+    // Vectored requests take at most tasklet::k_max_io_vectors buffers.
+    tasklet::Future<tasklet::IoResult> read(Span<void> buffer, uint64_t offset) const;
+    tasklet::Future<tasklet::IoResult> read_vectored(Span<const Span<void>> buffers, uint64_t offset) const;
+    tasklet::Future<tasklet::IoResult> write(Span<const void> data, uint64_t offset) const;
+    tasklet::Future<tasklet::IoResult> write_vectored(Span<const Span<const void>> buffers, uint64_t offset) const;
+    Result<uint64_t, FileError> size() const;
+
+    explicit operator bool() const { return static_cast<bool>(m_file); }
+    const File &file() const { return m_file; }
+    int fd() const { return m_file.fd(); }
+    bool is_fixed() const { return m_fixed_index >= 0; }
+};
+
+} // namespace vull::platform
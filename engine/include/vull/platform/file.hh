@@ -5,10 +5,12 @@
 #include <vull/support/enum.hh>
 #include <vull/support/flag_bitset.hh>
 #include <vull/support/result.hh>
+#include <vull/support/span.hh>
 #include <vull/support/string.hh>
 #include <vull/support/string_view.hh>
 #include <vull/support/utility.hh>
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace vull::platform {
@@ -36,6 +38,8 @@ enum class OpenMode : uint32_t {
 
 using OpenModes = FlagBitset<OpenMode>;
 
+class MappedFile;
+
 class File {
     int m_fd{-1};
 
@@ -51,15 +55,47 @@ public:
     File &operator=(const File &) = delete;
     File &operator=(File &&);
 
+    // Returns a new handle to the same open file, which is invalid if the descriptor couldn't be duplicated.
+    File duplicate() const;
     FileStream create_stream() const;
     Result<void, FileError> copy_to(const File &target, int64_t &src_offset, int64_t &dst_offset) const;
+    Result<void, FileError> copy_to(const File &target, int64_t &src_offset, int64_t &dst_offset, size_t size) const;
     Result<void, FileError> link_to(String path) const;
+    Result<MappedFile, FileError> map_read_only() const;
+    Result<uint64_t, FileError> size() const;
     Result<void, FileError> sync() const;
 
     explicit operator bool() const { return m_fd != -1; }
     int fd() const { return m_fd; }
 };
 
+// A read-only shared memory mapping of a whole file.
+class MappedFile {
+    uint8_t *m_data{nullptr};
+    size_t m_size{0};
+
+    MappedFile(uint8_t *data, size_t size) : m_data(data), m_size(size) {}
+
+public:
+    static MappedFile from_raw(uint8_t *data, size_t size) { return {data, size}; }
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other)
+        : m_data(vull::exchange(other.m_data, nullptr)), m_size(vull::exchange(other.m_size, 0u)) {}
+    ~MappedFile();
+
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&);
+
+    // Hints to the kernel that the given range will be accessed soon, so that it can start reading it in.
+    void prefetch(size_t offset, size_t size) const;
+
+    explicit operator bool() const { return m_data != nullptr; }
+    Span<const uint8_t> span() const { return {m_data, m_size}; }
+    const uint8_t *data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
 String dir_path(String path);
 Result<void, FileError> unlink_path(String path);
 
@@ -16,6 +16,8 @@ struct IoQueue;
 namespace vull::platform {
 
 uint8_t *allocate_fiber_memory(size_t size);
+uint8_t *allocate_io_buffer_memory(size_t size);
+void free_io_buffer_memory(uint8_t *memory, size_t size);
 void spawn_tasklet_io_dispatcher(tasklet::IoQueue &queue);
 void take_over_main_thread(tasklet::Future<void> &&future, Function<void()> stop_fn);
 
@@ -1,14 +1,18 @@
 #pragma once
 
-#include <vull/ecs/entity_id.hh>
 #include <vull/ecs/world.hh>
-#include <vull/maths/mat.hh>
+#include <vull/maths/vec.hh>
+#include <vull/scene/transform_hierarchy.hh>
+#include <vull/scene/world_streamer.hh>
 #include <vull/support/string_view.hh>
+#include <vull/support/unique_ptr.hh>
 
 namespace vull {
 
 class Scene {
     World m_world;
+    TransformHierarchy m_transform_hierarchy;
+    UniquePtr<WorldStreamer> m_streamer;
 
 public:
     Scene() = default;
@@ -19,10 +23,22 @@ public:
     Scene &operator=(const Scene &) = delete;
     Scene &operator=(Scene &&) = delete;
 
-    Mat4f get_transform_matrix(EntityId entity);
+    // Registers the component types stored in scene entries.
+    static void register_components(World &world);
+
+    // Loads the named scene, either in one go, or, if it was written as cells, by streaming cells in around the
+    // position passed to update_streaming.
     void load(StringView scene_name);
 
+    // Streams cells of a partitioned scene in and out around the given position. Does nothing for other scenes.
+    void update_streaming(const Vec3f &position);
+
+    // Brings the WorldTransform of every entity up to date. Should be called after modifying transforms and before
+    // rendering.
+    void update_transforms();
+
     World &world() { return m_world; }
+    WorldStreamer *streamer() const { return m_streamer.ptr(); }
 };
 
 } // namespace vull
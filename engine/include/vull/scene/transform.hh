@@ -6,9 +6,14 @@
 #include <vull/maths/mat.hh>
 #include <vull/maths/quat.hh>
 #include <vull/maths/vec.hh>
+#include <vull/support/span.hh>
 
 namespace vull {
 
+class Entity;
+
+// Transforms are serialised as raw bytes, so must only hold persistent state. The setters take the entity owning the
+// transform so that they can mark it as changed for TransformHierarchy to pick up.
 class Transform {
     VULL_DECLARE_COMPONENT(BuiltinComponents::Transform);
 
@@ -27,9 +32,17 @@ public:
     Vec3f up() const;
     Mat4f matrix() const;
 
-    void set_position(const Vec3f &position) { m_position = position; }
-    void set_rotation(const Quatf &rotation) { m_rotation = rotation; }
-    void set_scale(const Vec3f &scale) { m_scale = scale; }
+    void set_position(Entity entity, const Vec3f &position);
+    void set_rotation(Entity entity, const Quatf &rotation);
+    void set_scale(Entity entity, const Vec3f &scale);
+
+    // Called when merged into another EntityManager. Parents outside of the merged entities are dropped.
+    void remap_entities(Span<const EntityId> ids) {
+        if (m_parent != ~EntityId(0)) {
+            const auto index = entity_index(m_parent);
+            m_parent = index < ids.size() ? ids[index] : ~EntityId(0);
+        }
+    }
 
     EntityId parent() const { return m_parent; }
     const Vec3f &position() const { return m_position; }
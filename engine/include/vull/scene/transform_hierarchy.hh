@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity_id.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+class World;
+
+// Keeps the WorldTransform of every entity with a Transform up to date. Entities are kept sorted parent-before-child,
+// with each root's subtree stored contiguously, so that an update is a linear walk which only recomputes the subtrees
+// below a changed Transform. Separate trees are independent and are updated in parallel when in a tasklet context.
+class TransformHierarchy {
+    static constexpr uint32_t k_root_slot = ~0u;
+
+    struct Node {
+        EntityId entity;
+        uint32_t parent_slot;
+    };
+
+    Vector<Node> m_nodes;
+    Vector<uint8_t> m_changed;
+
+    // Slot ranges of consecutive trees which together make up at least a grain's worth of nodes.
+    struct Batch {
+        uint32_t begin;
+        uint32_t end;
+    };
+    Vector<Batch> m_batches;
+    uint32_t m_since_tick{0};
+    bool m_needs_rebuild{true};
+
+    bool needs_rebuild(World &world) const;
+    void rebuild(World &world, uint32_t grain_size);
+    void update_range(World &world, uint32_t begin, uint32_t end, bool force);
+
+public:
+    // Updates the WorldTransform of every entity whose Transform, or that of any of its ancestors, has been marked as
+    // changed since the last update, adding WorldTransforms to any new entities. Entities with a parent that has no
+    // Transform are treated as roots. Transforms marked in the same tick as an update are also seen by the next update,
+    // so that changes marked after an update aren't missed. Must not run concurrently with anything else modifying
+    // transforms.
+    void update(World &world, uint32_t grain_size = 1024);
+
+    // Forces the hierarchy to be resorted on the next update. Adding or removing transforms, including doing both in
+    // the same tick, is detected automatically.
+    void invalidate() { m_needs_rebuild = true; }
+};
+
+} // namespace vull
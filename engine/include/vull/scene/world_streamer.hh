@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/vec.hh>
+#include <vull/support/function.hh>
+#include <vull/support/result.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/future.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull {
+
+enum class StreamError;
+enum class WorldError;
+class World;
+
+// A partitioned scene is stored as one world entry per grid cell on the XZ plane, named <scene>/cells/<x>.<z>, along
+// with a manifest blob entry named <scene>/cells:
+//
+//   u32 (LE): cell size (bits of a float)
+//   varint: cell count
+//   for each cell:
+//     u32 (LE): cell x (i32)
+//     u32 (LE): cell z (i32)
+//
+// Whole entity hierarchies belong to a single cell, so cells don't reference each other's entities.
+struct WorldCellManifest {
+    float cell_size;
+    Vector<Vec2i> cells;
+
+    static Result<WorldCellManifest, StreamError, WorldError> load(StringView scene_name);
+    static String manifest_name(StringView scene_name);
+    static String cell_name(StringView scene_name, Vec2i cell);
+};
+
+// Loads and unloads the cells of a partitioned scene around a position. Cells are deserialised asynchronously into
+// their own World, which is then merged into the live world on the next update. Outside of a tasklet context, cells
+// are loaded synchronously instead. Loads still in flight must be waited for with wait_idle, from a tasklet, before
+// the streamer is destroyed. Budgets are checked against the (uncompressed) entry size of each cell, which is a
+// reasonable estimate of the memory its components take up. Each cell must fit in the cell budget, otherwise it is
+// never loaded, and all of the resident cells together must fit in the memory budget.
+class WorldStreamer {
+    using LoadResult = Result<UniquePtr<World>, StreamError, WorldError>;
+
+    enum class CellState {
+        Unloaded,
+        Loading,
+        Loaded,
+    };
+
+    struct Cell {
+        Vec2i coord;
+        String entry_name;
+        size_t cost;
+        CellState state{CellState::Unloaded};
+        bool over_budget_warned{false};
+        tasklet::Future<LoadResult> future;
+        Vector<EntityId> entities;
+    };
+
+    Function<void(World &)> m_register_components;
+    Vector<Cell> m_cells;
+    float m_cell_size;
+    float m_load_radius;
+    float m_unload_radius;
+    size_t m_memory_budget{256ul * 1024 * 1024};
+    size_t m_cell_budget{64ul * 1024 * 1024};
+    size_t m_resident_bytes{0};
+
+    float distance_to(const Cell &cell, Vec3f position) const;
+    void start_load(World &world, Cell &cell, Vec3f position);
+    void finish_load(World &world, Cell &cell, LoadResult &&result, Vec3f position);
+    void unload(World &world, Cell &cell);
+
+public:
+    // Opens a scene written as cells. register_components should register the scene's component types on a new world.
+    static Result<UniquePtr<WorldStreamer>, StreamError, WorldError>
+    open(StringView scene_name, Function<void(World &)> &&register_components);
+
+    WorldStreamer(const WorldCellManifest &manifest, StringView scene_name,
+                  Function<void(World &)> &&register_components);
+    WorldStreamer(const WorldStreamer &) = delete;
+    WorldStreamer(WorldStreamer &&) = delete;
+    ~WorldStreamer();
+
+    WorldStreamer &operator=(const WorldStreamer &) = delete;
+    WorldStreamer &operator=(WorldStreamer &&) = delete;
+
+    // Merges finished loads into world, unloads cells beyond the unload radius, and starts loading cells within the
+    // load radius, nearest first, whilst they fit in the memory budget. Cells over the cell budget are skipped with a
+    // warning.
+    void update(World &world, Vec3f position);
+
+    // Waits for all in-flight loads and merges them in.
+    void flush(World &world, Vec3f position);
+
+    // Waits for all in-flight loads and discards them without merging them in.
+    void wait_idle();
+
+    // Radii are measured on the XZ plane from the position to the cell's centre. The unload radius should be larger
+    // than the load radius to avoid cells near the boundary thrashing.
+    void set_load_radius(float load_radius) { m_load_radius = load_radius; }
+    void set_unload_radius(float unload_radius) { m_unload_radius = unload_radius; }
+    void set_memory_budget(size_t memory_budget) { m_memory_budget = memory_budget; }
+    void set_cell_budget(size_t cell_budget) { m_cell_budget = cell_budget; }
+
+    float cell_size() const { return m_cell_size; }
+    uint32_t cell_count() const { return m_cells.size(); }
+    uint32_t loaded_cell_count() const;
+    size_t resident_bytes() const { return m_resident_bytes; }
+};
+
+} // namespace vull
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vull/core/builtin_components.hh>
+#include <vull/ecs/component.hh>
+#include <vull/maths/mat.hh>
+#include <vull/maths/vec.hh>
+
+namespace vull {
+
+// Cached model-to-world matrix of an entity, being the product of its Transform's matrix and those of all its
+// ancestors. Added and kept up to date by TransformHierarchy.
+class WorldTransform {
+    VULL_DECLARE_COMPONENT(BuiltinComponents::WorldTransform);
+
+private:
+    Mat4f m_matrix;
+
+public:
+    explicit WorldTransform(const Mat4f &matrix) : m_matrix(matrix) {}
+
+    void set_matrix(const Mat4f &matrix) { m_matrix = matrix; }
+
+    const Mat4f &matrix() const { return m_matrix; }
+    Vec3f position() const { return Vec3f(m_matrix[3]); }
+};
+
+} // namespace vull
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vull/support/shared_ptr.hh>
+#include <vull/support/span.hh>
 #include <vull/support/utility.hh>
 #include <vull/tasklet/future.hh>
 #include <vull/tasklet/io.hh>
@@ -40,7 +41,8 @@ bool in_tasklet_context();
  * from a non-tasklet context, the calling thread will block until there is sufficient space.
  *
  * Any new tasklets which are scheduled are guaranteed to be started in a FIFO order, with respect to other new
- * tasklets.
+ * tasklets, unless the scheduler is in work-stealing mode, in which case tasklets scheduled from a worker thread are
+ * started in a LIFO order by that worker.
  *
  * @param tasklet the tasklet to schedule
  */
@@ -54,7 +56,7 @@ void schedule(Tasklet *tasklet);
  * non-tasklet context, the calling thread will block until there is sufficient space.
  *
  * New tasklets which are scheduled are guaranteed to be started in a FIFO order, with respect to other new
- * tasklets.
+ * tasklets, unless the scheduler is in work-stealing mode.
  *
  * @tparam F the callable type
  * @param callable the callable to schedule
@@ -77,6 +79,16 @@ auto schedule(F &&callable) {
  */
 void submit_io_request(SharedPtr<IoRequest> request);
 
+/**
+ * @brief Adds the given `IoRequest`s to the IO queue together, so that the IO thread picks them up and hands them to
+ * the kernel in one go rather than being woken for each. Suspends the calling tasklet if the queue is full.
+ *
+ * This function may only be called from a tasklet context.
+ *
+ * @param requests the `IoRequest`s to submit
+ */
+void submit_io_requests(Span<const SharedPtr<IoRequest>> requests);
+
 /**
  * @brief Constructs and submits a typed IO request to the IO queue and returns a `Future` associated with its
  * completion. Suspends the calling tasklet if the queue is full.
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <vull/container/array.hh>
+#include <vull/support/assert.hh>
 #include <vull/support/span.hh>
 #include <vull/tasklet/promise.hh>
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace vull::platform {
@@ -28,8 +31,40 @@ enum class IoRequestKind {
     PollEvent,
     WaitEvent,
     WaitVkFence,
+    ReadFile,
+    WriteFile,
+    ReadFixed,
+    RegisterFile,
+    UnregisterFile,
 };
 
+// A staging buffer registered with the IO ring. Fixed buffers are acquired from and released back to the scheduler's
+// pool, and avoid the kernel having to pin and map the buffer's pages for every request.
+class FixedBuffer {
+    uint8_t *m_data{nullptr};
+    uint32_t m_size{0};
+    uint32_t m_index{0};
+
+public:
+    FixedBuffer() = default;
+    FixedBuffer(uint8_t *data, uint32_t size, uint32_t index) : m_data(data), m_size(size), m_index(index) {}
+
+    Span<uint8_t> span() const { return {m_data, m_size}; }
+    uint8_t *data() const { return m_data; }
+    uint32_t size() const { return m_size; }
+    uint32_t index() const { return m_index; }
+};
+
+// One buffer of a vectored file request. The layout matches the platform's scatter/gather element so that an array of
+// them can be handed to the kernel directly.
+struct IoVector {
+    void *data;
+    size_t size;
+};
+
+// The maximum number of buffers in a vectored file request, which are stored inline in the request.
+constexpr uint32_t k_max_io_vectors = 16;
+
 // Inheriting from SharedPromise like this means that all IO request types must be trivially destructible.
 class IoRequest : public SharedPromise<IoResult> {
     const IoRequestKind m_kind;
@@ -82,4 +117,105 @@ public:
     int fd() const { return m_fd; }
 };
 
+// Positional read of the file into either a single buffer or, if buffers is non-empty, a list of up to
+// k_max_io_vectors buffers which are filled in order. The buffers must stay alive until the request has completed, but
+// the list itself is copied into the request.
+class ReadFileRequest : public IoRequest {
+    int m_fd;
+    uint64_t m_offset;
+    Span<void> m_buffer;
+    Array<IoVector, k_max_io_vectors> m_vectors{};
+    uint32_t m_vector_count{0};
+
+public:
+    ReadFileRequest(int fd, Span<void> buffer, uint64_t offset)
+        : IoRequest(IoRequestKind::ReadFile), m_fd(fd), m_offset(offset), m_buffer(buffer) {}
+    ReadFileRequest(int fd, Span<const Span<void>> buffers, uint64_t offset)
+        : IoRequest(IoRequestKind::ReadFile), m_fd(fd), m_offset(offset) {
+        VULL_ASSERT(buffers.size() <= k_max_io_vectors);
+        for (const auto buffer : buffers) {
+            m_vectors[m_vector_count++] = {buffer.data(), buffer.size()};
+        }
+    }
+
+    int fd() const { return m_fd; }
+    uint64_t offset() const { return m_offset; }
+    Span<void> buffer() const { return m_buffer; }
+    Span<const IoVector> vectors() const { return {m_vectors.data(), m_vector_count}; }
+    bool is_vectored() const { return m_vector_count != 0; }
+};
+
+// Positional write to the file from either a single buffer or, if buffers is non-empty, a list of up to
+// k_max_io_vectors buffers which are written in order. The buffers must stay alive until the request has completed,
+// but the list itself is copied into the request.
+class WriteFileRequest : public IoRequest {
+    int m_fd;
+    uint64_t m_offset;
+    Span<const void> m_data;
+    Array<IoVector, k_max_io_vectors> m_vectors{};
+    uint32_t m_vector_count{0};
+
+public:
+    WriteFileRequest(int fd, Span<const void> data, uint64_t offset)
+        : IoRequest(IoRequestKind::WriteFile), m_fd(fd), m_offset(offset), m_data(data) {}
+    WriteFileRequest(int fd, Span<const Span<const void>> buffers, uint64_t offset)
+        : IoRequest(IoRequestKind::WriteFile), m_fd(fd), m_offset(offset) {
+        VULL_ASSERT(buffers.size() <= k_max_io_vectors);
+        for (const auto buffer : buffers) {
+            // The kernel only reads from the buffers of a write.
+            m_vectors[m_vector_count++] = {const_cast<void *>(buffer.data()), buffer.size()};
+        }
+    }
+
+    int fd() const { return m_fd; }
+    uint64_t offset() const { return m_offset; }
+    Span<const void> data() const { return m_data; }
+    Span<const IoVector> vectors() const { return {m_vectors.data(), m_vector_count}; }
+    bool is_vectored() const { return m_vector_count != 0; }
+};
+
+// Positional read of the file into the first size bytes of a fixed buffer. If fixed_file is true, file is an index
+// into the registered file table rather than a file descriptor.
+class ReadFixedRequest : public IoRequest {
+    int m_file;
+    bool m_fixed_file;
+    uint32_t m_size;
+    uint64_t m_offset;
+    FixedBuffer m_buffer;
+
+public:
+    ReadFixedRequest(int file, bool fixed_file, FixedBuffer buffer, uint32_t size, uint64_t offset)
+        : IoRequest(IoRequestKind::ReadFixed), m_file(file), m_fixed_file(fixed_file), m_size(size), m_offset(offset),
+          m_buffer(buffer) {}
+
+    int file() const { return m_file; }
+    bool fixed_file() const { return m_fixed_file; }
+    uint32_t size() const { return m_size; }
+    uint64_t offset() const { return m_offset; }
+    const FixedBuffer &buffer() const { return m_buffer; }
+};
+
+// Registers a file descriptor in a free slot of the IO ring's file table. The result is the allocated slot index.
+class RegisterFileRequest : public IoRequest {
+    int m_fd;
+
+public:
+    explicit RegisterFileRequest(int fd) : IoRequest(IoRequestKind::RegisterFile), m_fd(fd) {}
+
+    // The kernel writes the allocated slot index back in place of the descriptor.
+    int &fd() { return m_fd; }
+};
+
+// Clears a slot of the IO ring's file table previously allocated by a RegisterFileRequest.
+class UnregisterFileRequest : public IoRequest {
+    uint32_t m_index;
+    int m_fd{-1};
+
+public:
+    explicit UnregisterFileRequest(uint32_t index) : IoRequest(IoRequestKind::UnregisterFile), m_index(index) {}
+
+    uint32_t index() const { return m_index; }
+    int &fd() { return m_fd; }
+};
+
 } // namespace vull::tasklet
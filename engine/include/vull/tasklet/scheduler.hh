@@ -8,7 +8,9 @@
 #include <vull/support/assert.hh>
 #include <vull/support/atomic.hh>
 #include <vull/support/function.hh>
+#include <vull/support/optional.hh>
 #include <vull/support/shared_ptr.hh> // IWYU pragma: keep
+#include <vull/support/span.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 #include <vull/tasklet/promise.hh>
@@ -20,24 +22,58 @@ namespace vull::tasklet {
 
 class Fiber;
 class FiberQueue;
+class FixedBuffer;
 class IoRequest;
 class TaskletQueue;
+class WorkerQueue;
+
+struct IoConfig {
+    // The number of submission queue entries in the IO ring.
+    uint32_t ring_size{256};
+
+    // The number of slots to reserve in the ring's registered file table.
+    uint32_t fixed_file_count{0};
+
+    // The number and size in bytes of the staging buffers to register with the ring.
+    uint32_t fixed_buffer_count{0};
+    uint32_t fixed_buffer_size{0};
+
+    // Whether to have a kernel thread poll the submission queue, and how long it should stay awake for when idle.
+    bool sqpoll{false};
+    uint32_t sqpoll_idle_ms{1000};
+};
 
 struct IoQueue : MpmcQueue<IoRequest *, 11> {
     platform::Event quit_event;
     platform::Event submit_event;
     Atomic<uint32_t> pending;
+    IoConfig config;
+    uint8_t *fixed_buffer_memory{nullptr};
+    MpmcQueue<uint32_t, 10> free_fixed_buffers;
+};
+
+enum class SchedulingMode {
+    // All worker threads pull new tasklets from a single shared queue.
+    Shared,
+
+    // Each worker thread pushes locally spawned tasklets onto its own queue, with idle workers stealing from others.
+    WorkStealing,
 };
 
 class Scheduler {
     uint32_t m_fiber_limit;
+    SchedulingMode m_mode;
     UniquePtr<FiberQueue> m_ready_fiber_queue;
     UniquePtr<FiberQueue> m_free_fiber_queue;
     UniquePtr<TaskletQueue> m_tasklet_queue;
     UniquePtr<IoQueue> m_io_queue;
+    Vector<UniquePtr<WorkerQueue>> m_worker_queues;
     Vector<platform::Thread> m_worker_threads;
     platform::Thread m_io_thread;
-    platform::Semaphore m_work_available;
+    Atomic<uint32_t> m_idle_epoch;
+    Atomic<uint32_t> m_sleeping_worker_count;
+    Atomic<uint64_t> m_wake_count;
+    Atomic<bool> m_wake_pending;
     Atomic<uint32_t> m_alive_worker_count;
     Atomic<uint32_t> m_created_fiber_count;
     Atomic<uint32_t> m_ready_fiber_count;
@@ -47,7 +83,8 @@ class Scheduler {
 public:
     static Scheduler &current();
 
-    Scheduler(uint32_t thread_count, uint32_t fiber_limit, bool pin_threads);
+    Scheduler(uint32_t thread_count, uint32_t fiber_limit, bool pin_threads,
+              SchedulingMode mode = SchedulingMode::Shared, const IoConfig &io_config = {});
     Scheduler(const Scheduler &) = delete;
     Scheduler(Scheduler &&) = delete;
     ~Scheduler();
@@ -57,6 +94,8 @@ public:
 
     void decrease_worker_count() { m_alive_worker_count.fetch_sub(1); }
     void join();
+    void park_worker();
+    void notify_worker();
     Fiber *request_fiber();
     void return_fiber(Fiber *fiber);
     template <typename F>
@@ -64,9 +103,17 @@ public:
     void setup_thread();
     void enqueue(Tasklet *tasklet);
     void submit_io_request(SharedPtr<IoRequest> request);
+    void submit_io_requests(Span<const SharedPtr<IoRequest>> requests);
+    Optional<FixedBuffer> try_acquire_fixed_buffer();
+    FixedBuffer acquire_fixed_buffer();
+    void release_fixed_buffer(const FixedBuffer &buffer);
 
+    SchedulingMode mode() const { return m_mode; }
+    const IoConfig &io_config() const { return m_io_queue->config; }
     uint32_t thread_count() const { return m_worker_threads.size(); }
     uint32_t queued_tasklet_count() const;
+    uint64_t wake_count() const { return m_wake_count.load(vull::memory_order_relaxed); }
+    bool has_ready_work() const;
     bool is_running() const;
 };
 
@@ -8,6 +8,7 @@ namespace vull::vpak {
 
 constexpr uint64_t k_header_size = 24;
 constexpr uint32_t k_magic_number = 0x8186564bu;
+constexpr uint32_t k_format_version = 2;
 constexpr uint32_t k_entry_limit = 1u << 20u;
 
 enum class EntryType : uint8_t {
@@ -16,6 +17,12 @@ enum class EntryType : uint8_t {
     World = 2,
 };
 
+enum class EntryCodec : uint8_t {
+    Raw = 0,
+    Zstd = 1,
+    ZstdDict = 2,
+};
+
 enum class ImageFormat : uint8_t {
     Bc1Srgb = 0,
     Bc3Srgba = 1,
@@ -43,9 +50,11 @@ enum class ImageWrapMode : uint8_t {
 // Struct to represent an entry in memory, note not the same representation on disk.
 struct Entry {
     String name;
+    String dictionary_name;
     uint64_t first_block;
     uint32_t size;
     EntryType type;
+    EntryCodec codec;
 };
 
 enum class CompressionLevel {
@@ -54,10 +63,30 @@ enum class CompressionLevel {
     Ultra,
 };
 
+enum class ReadMode {
+    // Each opened entry reads its blocks through its own file stream.
+    Stream,
+
+    // The pack file is mapped into memory once and entries are decompressed straight out of the mapping.
+    Mapped,
+};
+
+enum class WriteMode {
+    // Live entry data is copied into a new file, which replaces the pack file once finished.
+    Copy,
+
+    // New entry data and the entry table are appended to the existing file. The header is rewritten last, so the old
+    // entry table stays valid until then. The old table is left behind until the pack file is compacted.
+    InPlace,
+};
+
 enum class VpakError {
     BadMagic,
     BadVersion,
     BadFlags,
+    BadCodec,
+    BadDictionary,
+    MissingDictionary,
     TooManyEntries,
 };
 
@@ -10,7 +10,10 @@ namespace vull::vpak {
 
 class ReadStream;
 
-void load_vpak(StringView name, String path);
+// Loads a vpak into the global file system. Entries in later loaded vpaks override those of the same name in earlier
+// ones. Lookups go through a single index merged across all loaded vpaks, which is rebuilt on the first lookup after a
+// load. Loading must not race with lookups.
+void load_vpak(StringView name, String path, ReadMode read_mode = ReadMode::Stream);
 UniquePtr<ReadStream> open(StringView name);
 Optional<Entry> stat(StringView name);
 
@@ -5,18 +5,23 @@
 #include <vull/support/optional.hh>
 #include <vull/support/perfect_hasher.hh>
 #include <vull/support/result.hh>
+#include <vull/support/shared_ptr.hh>
+#include <vull/support/span.hh>
 #include <vull/support/string.hh>
 #include <vull/support/string_view.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 #include <vull/vpak/defs.hh>
+#include <vull/vpak/stream.hh>
 
 #include <stdint.h>
 
+using ZSTD_DDict = struct ZSTD_DDict_s;
+
 /*
  * struct {
  *     u32 magic = 0x8186564b;
- *     u32 version = 1;
+ *     u32 version = 2;
  *     u32 flags = 0;
  *     u32 entry_count;
  *     u64 entry_table_offset;
@@ -29,8 +34,15 @@
  *     u8 name[name_length];
  *     v32 size; // uncompressed size in bytes
  *     v64 first_block;
+ *     EntryCodec(u8) codec; // not present in version 1, where all entries are zstd
+ *     v64 dictionary_name_length; // only present for zstd with dictionary
+ *     u8 dictionary_name[dictionary_name_length];
  * };
  *
+ * Zstd entries are stored as a chain of blocks, each being a zstd frame of at most 128 KiB of uncompressed data
+ * followed by a u64 offset to the next block (UINT64_MAX if the last block). Raw entries are stored contiguously at
+ * first_block. Dictionaries are stored as raw entries.
+ *
  * struct EntryTable {
  *     u32 hash_seeds[entry_count];
  *     EntryHeader entries[entry_count];
@@ -57,9 +69,11 @@
  *     struct ComponentSet {
  *         v32 entity_count;
  *         u8 serialised_data[];
- *         v32 entity_ids[entity_count];
+ *         v32 or u32 entity_ids[entity_count];
  *     };
- *     v32 entity_count;
+ *     // Bits 0-23 hold the entity count. Bit 31 is set if entity_ids are stored as fixed-width u32s rather than
+ *     // varints.
+ *     v32 entity_count_and_flags;
  *     v32 set_count;
  *     ComponentSet sets[set_count];
  * };
@@ -73,42 +87,78 @@ enum class StreamError;
 
 namespace vull::vpak {
 
-class ReadStream;
 class Writer;
 
 class PackFile {
+    struct Dictionary {
+        String name;
+        ZSTD_DDict *ddict;
+    };
+
     String m_path;
     platform::File m_file;
+    // Shared with the streams opened from the mapping, so that remapping after a write leaves them valid.
+    SharedPtr<const SharedMapping> m_mapping;
     Vector<Entry> m_entries;
+    Vector<Dictionary> m_dictionaries;
     PerfectHasher m_phf;
+    ReadMode m_read_mode;
+    uint64_t m_entry_table_offset{k_header_size};
 
-    PackFile(String &&path, platform::File &&file) : m_path(vull::move(path)), m_file(vull::move(file)) {}
+    PackFile(String &&path, platform::File &&file, ReadMode read_mode)
+        : m_path(vull::move(path)), m_file(vull::move(file)), m_read_mode(read_mode) {}
 
+    Result<uint64_t, platform::FileError, platform::OpenError, StreamError, VpakError>
+    finish_writing(Writer &&writer, Vector<Entry> &&entries);
+    Result<void, StreamError> copy_block_chain(platform::FileStream &dst_stream, Writer &writer, Entry &entry) const;
+    Result<void, platform::FileError, StreamError> copy_live_entries(Writer &writer) const;
     Result<void, StreamError, VpakError> read_existing();
+    Result<void, StreamError, VpakError> load_dictionaries();
+    const ZSTD_DDict *find_dictionary(StringView name) const;
+    void map_file();
 
 public:
-    static Result<PackFile, platform::OpenError, StreamError, VpakError> open(String path);
+    static Result<PackFile, platform::OpenError, StreamError, VpakError> open(String path,
+                                                                             ReadMode read_mode = ReadMode::Stream);
 
     PackFile(const PackFile &) = delete;
     PackFile(PackFile &&) = default;
-    ~PackFile() = default;
+    ~PackFile();
 
     PackFile &operator=(const PackFile &) = delete;
     PackFile &operator=(PackFile &&) = delete;
 
     bool exists(StringView name) const;
     UniquePtr<ReadStream> open_entry(StringView name) const;
+
+    /**
+     * @brief Opens an entry already looked up from this pack file's entries, skipping the name lookup.
+     */
+    UniquePtr<ReadStream> open_entry(const Entry &entry) const;
     Optional<Entry> stat(StringView name) const;
 
     /**
-     * @brief Makes and returns a new Writer for this pack file with the given compression level.
+     * @brief Returns a view of the data of an entry stored uncompressed in a memory mapped pack file, which stays valid
+     * until the pack file is next written to or destroyed.
+     *
+     * @param name the name of the entry
+     * @return Span<const uint8_t> if the entry exists, is stored raw, and the pack file is mapped
+     * @return nullopt otherwise
+     */
+    Optional<Span<const uint8_t>> raw_view(StringView name) const;
+
+    /**
+     * @brief Makes and returns a new Writer for this pack file with the given compression level. In copy mode, the data
+     * of existing entries which weren't replaced is carried over to the new file when the writer is finished, dropping
+     * replaced entry data and stale entry tables as compact does.
      *
      * @param compression_level the compression level to use
+     * @param write_mode whether to write a new copy of the pack file or append to it in place
      * @return Writer if successful
-     * @return FileError if copying existing entry data to a new file failed
-     * @return OpenError if creating a temporary file failed
+     * @return OpenError if creating a temporary file or reopening the pack file failed
      */
-    Result<Writer, platform::FileError, platform::OpenError> make_writer(CompressionLevel compression_level);
+    Result<Writer, platform::FileError, platform::OpenError>
+    make_writer(CompressionLevel compression_level, WriteMode write_mode = WriteMode::Copy);
 
     /**
      * @brief Commits the changes made by the given writer to this PackFile object, and writes out a new vpak to disk.
@@ -116,13 +166,29 @@ public:
      *
      * @param writer a moved reference to a writer
      * @return uint64_t the number of bytes written to disk, if successful
-     * @return FileError if syncing or renaming the file on disk failed
+     * @return FileError if syncing or renaming the file on disk, or copying existing raw entry data, failed
      * @return OpenError if opening the parent directory failed
-     * @return StreamError if writing the header or entry table to disk failed
+     * @return StreamError if copying existing compressed entry data, or writing the header or entry table to disk,
+     * failed
+     * @return VpakError if a dictionary referenced by the new entries is missing or fails to load
+     */
+    Result<uint64_t, platform::FileError, platform::OpenError, StreamError, VpakError> finish_writing(Writer &&writer);
+
+    /**
+     * @brief Rewrites the pack file with only the data of live entries, dropping the data of replaced entries and any
+     * stale entry tables left behind by in-place writes. Compressed data is copied as is.
+     *
+     * @return uint64_t the new size of the pack file, if successful
+     * @return FileError if syncing, renaming, or copying raw entry data failed
+     * @return OpenError if creating a temporary file or opening the parent directory failed
+     * @return StreamError if copying compressed entry data or writing the entry table failed
+     * @return VpakError if a dictionary referenced by an entry is missing or fails to load
      */
-    Result<uint64_t, platform::FileError, platform::OpenError, StreamError> finish_writing(Writer &&writer);
+    Result<uint64_t, platform::FileError, platform::OpenError, StreamError, VpakError> compact();
 
     const Vector<Entry> &entries() const { return m_entries; }
+    ReadMode read_mode() const { return m_read_mode; }
+    bool is_mapped() const { return static_cast<bool>(m_mapping); }
 };
 
 } // namespace vull::vpak
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <vull/container/vector.hh>
+#include <vull/platform/async_file.hh>
+#include <vull/platform/file.hh>
+#include <vull/support/atomic.hh>
 #include <vull/support/result.hh>
+#include <vull/support/shared_ptr.hh>
 #include <vull/support/span.hh>
 #include <vull/support/stream.hh>
 #include <vull/support/string.hh>
 #include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/future.hh>
+#include <vull/tasklet/io.hh>
 #include <vull/vpak/defs.hh>
 
 #include <stddef.h>
@@ -12,26 +19,106 @@
 
 using ZSTD_CCtx = struct ZSTD_CCtx_s;
 using ZSTD_DCtx = struct ZSTD_DCtx_s;
+using ZSTD_DDict = struct ZSTD_DDict_s;
 
 namespace vull::vpak {
 
 class Writer;
 
+// A memory mapping of a pack file shared between the pack file and the streams reading from it. Writing to the pack
+// file maps it afresh, and the old mapping is only unmapped once the last stream reading from it is destroyed.
+class SharedMapping {
+    platform::MappedFile m_mapping;
+    mutable Atomic<uint32_t> m_ref_count{0};
+
+public:
+    explicit SharedMapping(platform::MappedFile &&mapping) : m_mapping(vull::move(mapping)) {}
+    SharedMapping(const SharedMapping &) = delete;
+    SharedMapping(SharedMapping &&) = delete;
+    ~SharedMapping() = default;
+
+    SharedMapping &operator=(const SharedMapping &) = delete;
+    SharedMapping &operator=(SharedMapping &&) = delete;
+
+    void add_ref() const;
+    void sub_ref() const;
+
+    const platform::MappedFile &mapping() const { return m_mapping; }
+};
+
 class ReadStream final : public Stream {
+    // A block being decompressed ahead of the reader by another tasklet.
+    struct ReadaheadSlot {
+        ZSTD_DCtx *dctx;
+        uint8_t *in_buffer;
+        uint8_t *out_buffer;
+        tasklet::Future<size_t> decompressed_size;
+    };
+
+    // A consecutive range of the pack file being read into a fixed buffer ahead of the readahead blocks.
+    struct FixedWindow {
+        tasklet::FixedBuffer buffer;
+        uint64_t offset{0};
+        uint32_t size{0};
+        tasklet::Future<tasklet::IoResult> bytes_read;
+    };
+
     UniquePtr<Stream> m_stream;
 
+    // When readahead is enabled on a stream opened from a pack file, blocks are fetched through the IO queue into a
+    // ring of windows over the block chain instead of with blocking reads from m_stream. The windows cover one
+    // consecutive range, which moves forward as blocks are consumed, and is restarted when the chain jumps outside of
+    // it. The windows' reads are submitted together.
+    platform::AsyncFile m_file;
+    Vector<FixedWindow> m_fixed_windows;
+    uint32_t m_fixed_window_head{0};
+    uint64_t m_fixed_window_end{0};
+
+    // Used instead of m_stream when reading from a memory mapped pack file. The span points into the shared mapping,
+    // which is kept alive for as long as the stream.
+    SharedPtr<const SharedMapping> m_shared_mapping;
+    Span<const uint8_t> m_mapping;
+    uint64_t m_mapped_block_offset{0};
+
+    // Only acquired for compressed entries.
     ZSTD_DCtx *m_dctx{nullptr};
+    const ZSTD_DDict *m_ddict;
     uint8_t *m_in_buffer{nullptr};
     uint8_t *m_out_buffer{nullptr};
 
+    // Ring of blocks in flight when readahead is enabled.
+    Vector<ReadaheadSlot> m_readahead_slots;
+    uint64_t m_readahead_offset{0};
+    uint32_t m_readahead_head{0};
+    uint32_t m_readahead_consuming{UINT32_MAX};
+    uint32_t m_blocks_to_fetch{0};
+
+    EntryCodec m_codec;
+    uint32_t m_entry_size;
+    uint64_t m_raw_remaining{0};
+    const uint8_t *m_block_data{nullptr};
     uint64_t m_block_size{0};
     uint64_t m_block_head{0};
     bool m_at_end{false};
 
+    void acquire_context();
+    void setup_fixed_windows(uint32_t block_count);
+    void restart_fixed_windows(uint64_t offset);
+    void advance_fixed_windows(uint64_t offset);
+    Result<size_t, StreamError> read_fixed(uint64_t offset, Span<uint8_t> data);
+    Result<uint64_t, StreamError> read_mapped_link(uint64_t offset) const;
+    Result<void, StreamError> fetch_readahead_block(ReadaheadSlot &slot);
     Result<void, StreamError> read_next_block();
+    Result<void, StreamError> read_next_mapped_block();
+    Result<void, StreamError> read_next_readahead_block();
+    Result<size_t, StreamError> read_raw(Span<void> data);
 
 public:
-    ReadStream(UniquePtr<Stream> &&stream);
+    static uint64_t max_encoded_size(uint64_t size);
+
+    ReadStream(UniquePtr<Stream> &&stream, const Entry &entry, const ZSTD_DDict *ddict = nullptr);
+    ReadStream(platform::File &&file, const Entry &entry, const ZSTD_DDict *ddict = nullptr);
+    ReadStream(SharedPtr<const SharedMapping> mapping, const Entry &entry, const ZSTD_DDict *ddict = nullptr);
     ReadStream(const ReadStream &) = delete;
     ReadStream(ReadStream &&) = delete;
     ~ReadStream() override;
@@ -39,26 +126,53 @@ public:
     ReadStream &operator=(const ReadStream &) = delete;
     ReadStream &operator=(ReadStream &&) = delete;
 
+    // Decompresses up to block_count blocks ahead of the reader on other tasklets. Must be called from a tasklet
+    // context before the first read, and has no effect on raw entries or outside of a tasklet context. Streams opened
+    // from a file read the blocks with fixed reads if the scheduler has fixed buffers to spare.
+    void enable_readahead(uint32_t block_count);
+
     Result<size_t, StreamError> read(Span<void> data) override;
     Result<uint8_t, StreamError> read_byte() override;
 };
 
 class WriteStream final : public Stream {
+    // A block being filled, or being compressed by another tasklet.
+    struct BlockSlot {
+        ZSTD_CCtx *cctx;
+        uint8_t *in_buffer;
+        uint8_t *out_buffer;
+        uint32_t size{0};
+        tasklet::Future<size_t> compressed_size;
+    };
+
     Writer &m_writer;
     UniquePtr<Stream> m_stream;
 
-    ZSTD_CCtx *m_cctx{nullptr};
+    // Ring of blocks, of which all but the one being filled may be in flight. Blocks are always emitted in order.
+    Vector<BlockSlot> m_slots;
+    uint32_t m_slot_limit{1};
+    uint32_t m_fill_index{0};
     uint8_t *m_in_buffer{nullptr};
-    uint8_t *m_out_buffer{nullptr};
+
+    // Whether to store the entry raw is decided from the compression ratio of its first block. Raw entries are
+    // accumulated in full since they must be contiguous.
+    Vector<uint8_t> m_raw_data;
+    bool m_may_store_raw{false};
+    bool m_store_raw{false};
 
     uint64_t m_block_link_offset{0};
     uint32_t m_compress_head{0};
     Entry m_entry{};
 
+    void acquire_slot();
+    Result<void, StreamError> emit_block(const BlockSlot &slot, size_t compressed_size);
+    Result<void, StreamError> emit_pending_block(BlockSlot &slot);
     Result<void, StreamError> flush_block();
+    Result<void, StreamError> write_block(Span<const uint8_t> block);
+    Result<void, StreamError> write_raw();
 
 public:
-    WriteStream(Writer &writer, UniquePtr<Stream> &&stream, String &&name, EntryType type);
+    WriteStream(Writer &writer, UniquePtr<Stream> &&stream, String &&name, EntryType type, EntryCodec codec);
     WriteStream(const WriteStream &) = delete;
     WriteStream(WriteStream &&) = delete;
     ~WriteStream() override;
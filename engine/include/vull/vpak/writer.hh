@@ -1,9 +1,11 @@
 #pragma once
 
 #include <vull/container/vector.hh>
+#include <vull/maths/common.hh>
 #include <vull/platform/file.hh>
 #include <vull/support/atomic.hh>
 #include <vull/support/result.hh>
+#include <vull/support/span.hh>
 #include <vull/support/stream.hh>
 #include <vull/support/string.hh>
 #include <vull/support/utility.hh>
@@ -12,6 +14,14 @@
 
 #include <stdint.h>
 
+using ZSTD_CDict = struct ZSTD_CDict_s;
+
+namespace vull {
+
+class PerfectHasher;
+
+} // namespace vull
+
 namespace vull::vpak {
 
 class PackFile;
@@ -27,25 +37,70 @@ private:
     Vector<Entry> m_new_entries;
     tasklet::Mutex m_mutex;
     const CompressionLevel m_compression_level;
+    float m_raw_threshold{0.0f};
+    uint32_t m_block_parallelism{0};
+    ZSTD_CDict *m_dictionary{nullptr};
+    String m_dictionary_name;
+    uint64_t m_entry_table_offset{0};
+    const WriteMode m_write_mode;
 
-    Writer(platform::File &&write_file, uint64_t head, CompressionLevel compression_level)
-        : m_write_file(vull::move(write_file)), m_head(head), m_compression_level(compression_level) {}
+    Writer(platform::File &&write_file, uint64_t head, CompressionLevel compression_level, WriteMode write_mode)
+        : m_write_file(vull::move(write_file)), m_head(head), m_compression_level(compression_level),
+          m_write_mode(write_mode) {}
 
     void add_finished_entry(Entry &&entry);
     uint64_t allocate_space(uint64_t size);
-    Result<uint64_t, StreamError> finish(Vector<Entry> &entries);
+    int zstd_compression_level() const;
+    Result<uint64_t, StreamError> finish(Vector<Entry> &entries, PerfectHasher &phf);
+    Result<void, StreamError> write_header(uint32_t entry_count);
 
 public:
     Writer(const Writer &) = delete;
     Writer(Writer &&other)
         : m_write_file(vull::move(other.m_write_file)), m_head(other.m_head.exchange(0)),
-          m_compression_level(other.m_compression_level) {}
-    ~Writer() = default;
+          m_compression_level(other.m_compression_level), m_raw_threshold(other.m_raw_threshold),
+          m_block_parallelism(other.m_block_parallelism),
+          m_dictionary(vull::exchange(other.m_dictionary, nullptr)),
+          m_dictionary_name(vull::move(other.m_dictionary_name)), m_entry_table_offset(other.m_entry_table_offset),
+          m_write_mode(other.m_write_mode) {}
+    ~Writer();
 
     Writer &operator=(const Writer &) = delete;
     Writer &operator=(Writer &&) = delete;
 
-    WriteStream add_entry(String name, EntryType type);
+    /**
+     * @brief Adds a raw entry containing the given zstd dictionary, which subsequent entries added with
+     * EntryCodec::ZstdDict are compressed with.
+     *
+     * @param name the name of the dictionary entry
+     * @param data the dictionary, e.g. as trained by ZDICT_trainFromBuffer
+     * @return StreamError if writing the dictionary entry failed
+     * @return VpakError if zstd failed to load the dictionary
+     */
+    Result<void, StreamError, VpakError> add_dictionary(String name, Span<const void> data);
+
+    /**
+     * @brief Adds a new entry to be written with the given codec. If an entry with the same name already exists, it is
+     * replaced once the writer is finished, although its data is only reclaimed by PackFile::compact.
+     */
+    WriteStream add_entry(String name, EntryType type, EntryCodec codec = EntryCodec::Zstd);
+
+    /**
+     * @brief Sets the compression ratio (uncompressed size over compressed size) below which compressed entries get
+     * stored raw instead. Zero, the default, disables this. The ratio is taken from an entry's first block of up to 128
+     * KiB rather than the whole entry, so that the compressed blocks of other entries can still be streamed straight
+     * to disk, and only entries being stored raw have to be held in memory until they are finished. An entry whose
+     * first block is unrepresentative, such as a header followed by incompressible data, may therefore be misjudged.
+     */
+    void set_raw_threshold(float threshold) { m_raw_threshold = threshold; }
+
+    /**
+     * @brief Sets the maximum number of blocks of a single entry which may be compressed in parallel by other
+     * tasklets. Blocks are still written in order, so the compressed data is the same either way. A value of one
+     * compresses inline, which is also what happens outside of a tasklet context. The default is one more than the
+     * scheduler's worker thread count.
+     */
+    void set_block_parallelism(uint32_t block_count) { m_block_parallelism = vull::max(block_count, 1u); }
 };
 
 } // namespace vull::vpak
@@ -14,6 +14,7 @@
 #include <vull/support/utility.hh>
 #include <vull/tasklet/functions.hh>
 #include <vull/tasklet/scheduler.hh>
+#include <vull/vpak/defs.hh>
 #include <vull/vpak/file_system.hh>
 
 #include <dirent.h>
@@ -34,6 +35,8 @@ int start_application(int argc, char **argv, ArgsParser &args_parser, Function<v
     uint32_t fiber_limit = 256;
     uint32_t thread_count = vull::max(platform::core_count() / 2, 2);
     String vpak_directory_path;
+    bool map_vpaks = false;
+    args_parser.add_flag(map_vpaks, "Memory map vpaks instead of streaming them", "mmap-vpaks");
     args_parser.add_option(fiber_limit, "Tasklet fiber limit", "fiber-limit");
     args_parser.add_option(thread_count, "Tasklet worker thread count", "threads");
     args_parser.add_option(vpak_directory_path, "Vpak directory path", "vpak-dir");
@@ -62,9 +65,10 @@ int start_application(int argc, char **argv, ArgsParser &args_parser, Function<v
         return EXIT_FAILURE;
     }
 
+    const auto vpak_read_mode = map_vpaks ? vpak::ReadMode::Mapped : vpak::ReadMode::Stream;
     for (int i = 0; i < entry_count; i++) {
         StringView name(static_cast<const char *>(entry_list[i]->d_name));
-        vpak::load_vpak(name, vull::format("{}/{}", vpak_directory_path, name));
+        vpak::load_vpak(name, vull::format("{}/{}", vpak_directory_path, name), vpak_read_mode);
         free(entry_list[i]);
     }
     free(entry_list);
@@ -0,0 +1,198 @@
+#include <vull/ecs/command_buffer.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/common.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/fiber.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull {
+namespace {
+
+constexpr size_t k_block_size = 16384;
+constexpr uint64_t k_pending_bit = uint64_t(1) << 63u;
+
+// Each command buffer, and each playback or clear of it, gets a new epoch so that stale buffer pointers are never
+// reused.
+VULL_GLOBAL(Atomic<uint64_t> s_next_epoch{1});
+
+struct CachedBuffer {
+    uint64_t epoch;
+    tasklet::Fiber *fiber;
+    void *buffer;
+};
+VULL_GLOBAL(thread_local CachedBuffer s_cached_buffer{});
+
+struct SortedCommand {
+    EntityId id;
+    uint32_t buffer_index;
+    uint32_t command_index;
+};
+
+} // namespace
+
+EntityCommandBuffer::LocalBuffer::~LocalBuffer() {
+    for (uint8_t *block : blocks) {
+        delete[] block;
+    }
+}
+
+void *EntityCommandBuffer::LocalBuffer::allocate(size_t size, size_t alignment) {
+    if (size > k_block_size / 4) {
+        // Give large objects their own block, keeping the current one last.
+        blocks.push(new uint8_t[size]);
+        if (blocks.size() == 1) {
+            block_head = k_block_size;
+            return blocks.last();
+        }
+        vull::swap(blocks[blocks.size() - 2], blocks.last());
+        return blocks[blocks.size() - 2];
+    }
+
+    block_head = vull::align_up(block_head, alignment);
+    if (blocks.empty() || block_head + size > k_block_size) {
+        blocks.push(new uint8_t[k_block_size]);
+        block_head = 0;
+    }
+    auto *ptr = blocks.last() + block_head;
+    block_head += size;
+    return ptr;
+}
+
+EntityCommandBuffer::EntityCommandBuffer() : m_epoch(s_next_epoch.fetch_add(1, vull::memory_order_relaxed)) {}
+
+EntityCommandBuffer::~EntityCommandBuffer() {
+    discard();
+}
+
+EntityCommandBuffer::LocalBuffer &EntityCommandBuffer::local_buffer() {
+    auto *fiber = tasklet::Fiber::current();
+    if (s_cached_buffer.epoch == m_epoch && s_cached_buffer.fiber == fiber) {
+        return *static_cast<LocalBuffer *>(s_cached_buffer.buffer);
+    }
+
+    // A tasklet may have recorded on another thread before being suspended, in which case it must keep using the same
+    // buffer to preserve its order.
+    if (fiber != nullptr) {
+        for (auto *buffer = m_head.load(vull::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+            if (buffer->owner == fiber) {
+                s_cached_buffer = {m_epoch, fiber, buffer};
+                return *buffer;
+            }
+        }
+    }
+
+    // First command from this fiber or thread since the last playback, register a new buffer.
+    auto *buffer = new LocalBuffer;
+    buffer->owner = fiber;
+    buffer->index = m_buffer_count.fetch_add(1, vull::memory_order_relaxed);
+    buffer->next = m_head.load(vull::memory_order_relaxed);
+    while (!m_head.compare_exchange_weak(buffer->next, buffer, vull::memory_order_release,
+                                         vull::memory_order_relaxed)) {
+    }
+    s_cached_buffer = {m_epoch, fiber, buffer};
+    return *buffer;
+}
+
+void EntityCommandBuffer::record(uint64_t target, ApplyFn apply, DestructFn destruct, void *data) {
+    local_buffer().commands.push({target, apply, destruct, data});
+}
+
+PendingEntity EntityCommandBuffer::create_entity() {
+    auto &buffer = local_buffer();
+    return {buffer.index, buffer.created_count++};
+}
+
+void EntityCommandBuffer::destroy_entity(EntityId id) {
+    const auto apply = +[](EntityManager &manager, EntityId id, void *) {
+        manager.destroy_entity(id);
+    };
+    record(id, apply, nullptr, nullptr);
+}
+
+void EntityCommandBuffer::discard() {
+    auto *buffer = m_head.exchange(nullptr, vull::memory_order_acquire);
+    while (buffer != nullptr) {
+        for (const auto &command : buffer->commands) {
+            if (command.destruct != nullptr) {
+                command.destruct(command.data);
+            }
+        }
+        delete vull::exchange(buffer, buffer->next);
+    }
+    m_buffer_count.store(0, vull::memory_order_relaxed);
+    m_epoch = s_next_epoch.fetch_add(1, vull::memory_order_relaxed);
+}
+
+void EntityCommandBuffer::playback(EntityManager &manager) {
+    // Gather the buffers in registration order.
+    Vector<LocalBuffer *> buffers(m_buffer_count.load(vull::memory_order_relaxed));
+    for (auto *buffer = m_head.load(vull::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+        buffers[buffer->index] = buffer;
+    }
+
+    // Create all of the new entities up front so that commands can refer to them.
+    m_created_entities.clear();
+    m_created_entities.ensure_size(buffers.size());
+    for (auto *buffer : buffers) {
+        auto &created = m_created_entities[buffer->index];
+        created.ensure_capacity(buffer->created_count);
+        for (uint32_t i = 0; i < buffer->created_count; i++) {
+            created.push(manager.create_entity());
+        }
+    }
+
+    // Sort by entity to apply all of the changes to one entity together, keeping the recorded order per buffer.
+    Vector<SortedCommand> sorted;
+    for (auto *buffer : buffers) {
+        for (uint32_t i = 0; i < buffer->commands.size(); i++) {
+            const auto target = buffer->commands[i].target;
+            EntityId id = static_cast<EntityId>(target);
+            if ((target & k_pending_bit) != 0) {
+                const auto buffer_index = static_cast<uint32_t>((target & ~k_pending_bit) >> 32u);
+                id = m_created_entities[buffer_index][static_cast<uint32_t>(target)];
+            }
+            sorted.push({id, buffer->index, i});
+        }
+    }
+    vull::sort(sorted, [](const SortedCommand &lhs, const SortedCommand &rhs) {
+        if (entity_index(lhs.id) != entity_index(rhs.id)) {
+            return entity_index(lhs.id) > entity_index(rhs.id);
+        }
+        if (lhs.buffer_index != rhs.buffer_index) {
+            return lhs.buffer_index > rhs.buffer_index;
+        }
+        return lhs.command_index > rhs.command_index;
+    });
+
+    for (const auto &entry : sorted) {
+        auto &command = buffers[entry.buffer_index]->commands[entry.command_index];
+        if (manager.valid(entry.id)) {
+            command.apply(manager, entry.id, command.data);
+        }
+        if (command.destruct != nullptr) {
+            command.destruct(command.data);
+            command.destruct = nullptr;
+        }
+    }
+    discard();
+}
+
+void EntityCommandBuffer::clear() {
+    discard();
+    m_created_entities.clear();
+}
+
+EntityId EntityCommandBuffer::resolve(PendingEntity entity) const {
+    VULL_ASSERT(entity.m_buffer_index < m_created_entities.size());
+    return m_created_entities[entity.m_buffer_index][entity.m_index];
+}
+
+} // namespace vull
@@ -6,6 +6,9 @@
 #include <vull/support/assert.hh>
 #include <vull/support/utility.hh>
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace vull {
 
 constexpr auto k_reserved_index = entity_index(~EntityId(0));
@@ -25,19 +28,125 @@ Entity EntityManager::create_entity() {
     return {this, next_index};
 }
 
+uint32_t EntityManager::owning_group(size_t component_id) const {
+    return component_id < m_component_groups.size() ? m_component_groups[component_id] : k_no_group;
+}
+
+void EntityManager::enter_group(uint32_t group_index, EntityId index) {
+    auto &group = m_groups[group_index];
+    for (const auto component_id : group.component_ids) {
+        if (!m_component_sets[component_id].contains(index)) {
+            return;
+        }
+    }
+    if (m_component_sets[group.component_ids.first()].dense_index(index) < group.size) {
+        // Already in the group.
+        return;
+    }
+    for (const auto component_id : group.component_ids) {
+        auto &set = m_component_sets[component_id];
+        set.swap_dense(set.dense_index(index), group.size);
+    }
+    group.size++;
+}
+
+void EntityManager::leave_group(uint32_t group_index, EntityId index) {
+    auto &group = m_groups[group_index];
+    const auto &first_set = m_component_sets[group.component_ids.first()];
+    if (!first_set.contains(index) || first_set.dense_index(index) >= group.size) {
+        return;
+    }
+    group.size--;
+    for (const auto component_id : group.component_ids) {
+        auto &set = m_component_sets[component_id];
+        set.swap_dense(set.dense_index(index), group.size);
+    }
+}
+
+void EntityManager::pack_group(uint32_t group_index) {
+    // Gather all of the entities with the group's components from scratch. Entering the group only swaps with entities
+    // already visited.
+    auto &group = m_groups[group_index];
+    group.size = 0;
+    auto &first_set = m_component_sets[group.component_ids.first()];
+    for (EntityId i = 0; i < first_set.size(); i++) {
+        enter_group(group_index, first_set.dense_begin()[i]);
+    }
+}
+
 void EntityManager::destroy_entity(EntityId id) {
     const auto index = entity_index(id);
-    for (auto &set : m_component_sets) {
-        if (set.contains(index)) {
+    for (uint32_t i = 0; i < m_groups.size(); i++) {
+        leave_group(i, index);
+    }
+    for (size_t component_id = 0; component_id < m_component_sets.size(); component_id++) {
+        if (auto &set = m_component_sets[component_id]; set.contains(index)) {
             set.remove(index);
+            record_removed(component_id, id);
         }
     }
     m_entities[index] = entity_id(m_free_head, entity_version(id) + 1);
     m_free_head = index;
 }
 
+void EntityManager::record_removed(size_t component_id, EntityId id) {
+    if (component_id < m_removed_lists.size() && m_removed_lists[component_id].tracked) {
+        m_removed_lists[component_id].ids.push(id);
+    }
+}
+
+void EntityManager::advance_tick() {
+    m_change_tick++;
+    for (auto &list : m_removed_lists) {
+        list.ids.clear();
+    }
+}
+
+Vector<EntityId> EntityManager::merge(EntityManager &&other) {
+    for (size_t component_id = 0; component_id < other.m_component_sets.size(); component_id++) {
+        const auto &other_set = other.m_component_sets[component_id];
+        if (other_set.size() == 0) {
+            continue;
+        }
+        VULL_ENSURE(component_id < m_component_sets.size() && m_component_sets[component_id].initialised());
+        VULL_ENSURE(m_component_sets[component_id].object_size() == other_set.object_size());
+    }
+
+    // Free slots hold the index of the next free slot instead of their own.
+    Vector<EntityId> ids;
+    Vector<EntityId> indices;
+    ids.ensure_size(other.m_entities.size(), ~EntityId(0));
+    indices.ensure_size(other.m_entities.size(), k_reserved_index);
+    for (EntityId index = 0; index < other.m_entities.size(); index++) {
+        if (entity_index(other.m_entities[index]) == index) {
+            ids[index] = create_entity();
+            indices[index] = entity_index(ids[index]);
+        }
+    }
+
+    for (size_t component_id = 0; component_id < other.m_component_sets.size(); component_id++) {
+        auto &other_set = other.m_component_sets[component_id];
+        if (other_set.size() == 0) {
+            continue;
+        }
+        other_set.remap_entities(ids.span());
+        m_component_sets[component_id].merge(vull::move(other_set), indices.span(), {m_change_tick, m_change_tick});
+    }
+    for (uint32_t group_index = 0; group_index < m_groups.size(); group_index++) {
+        for (const auto index : indices) {
+            if (index != k_reserved_index) {
+                enter_group(group_index, index);
+            }
+        }
+    }
+
+    other.m_entities.clear();
+    other.m_free_head = k_reserved_index;
+    return ids;
+}
+
 bool EntityManager::valid(EntityId id) const {
-    return id < m_entities.size() && m_entities[entity_index(id)] == id;
+    return entity_index(id) < m_entities.size() && m_entities[entity_index(id)] == id;
 }
 
 } // namespace vull
@@ -0,0 +1,106 @@
+#include <vull/ecs/system_scheduler.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/core/tracing.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/function.hh>
+#include <vull/support/string.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/latch.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+bool System::conflicts_with(const System &other) const {
+    if (m_exclusive || other.m_exclusive) {
+        return true;
+    }
+    const auto accessed = m_read_mask | m_write_mask;
+    const auto other_accessed = other.m_read_mask | other.m_write_mask;
+    return (m_write_mask & other_accessed) != 0 || (other.m_write_mask & accessed) != 0;
+}
+
+System &SystemScheduler::add_system(String name, Function<void(EntityManager &)> &&function) {
+    m_graph_dirty = true;
+    m_systems.push(vull::make_unique<System>(*this, vull::move(name), vull::move(function)));
+    return *m_systems.last();
+}
+
+void SystemScheduler::build_graph() {
+    m_root_systems.clear();
+    for (auto &system : m_systems) {
+        system->m_dependents.clear();
+        system->m_dependency_count = 0;
+    }
+
+    // Each system depends on every earlier system it conflicts with, which keeps the order in which conflicting
+    // systems were added.
+    for (uint32_t i = 0; i < m_systems.size(); i++) {
+        auto &system = *m_systems[i];
+        for (uint32_t j = 0; j < i; j++) {
+            if (system.conflicts_with(*m_systems[j])) {
+                m_systems[j]->m_dependents.push(i);
+                system.m_dependency_count++;
+            }
+        }
+        if (system.m_dependency_count == 0) {
+            m_root_systems.push(i);
+        }
+    }
+    m_graph_dirty = false;
+}
+
+void SystemScheduler::run_system(EntityManager &manager, uint32_t index) {
+    auto &system = *m_systems[index];
+    tracing::ScopedTrace trace(system.m_name);
+    platform::Timer timer;
+    system.m_function(manager);
+    system.m_duration = timer.elapsed();
+}
+
+void SystemScheduler::run_system_tasklet(EntityManager &manager, uint32_t index, tasklet::Latch &latch) {
+    run_system(manager, index);
+    for (const auto dependent_index : m_systems[index]->m_dependents) {
+        auto &dependent = *m_systems[dependent_index];
+        if (dependent.m_pending_count.fetch_sub(1, vull::memory_order_acq_rel) == 1) {
+            tasklet::schedule([this, &manager, dependent_index, &latch] {
+                run_system_tasklet(manager, dependent_index, latch);
+            });
+        }
+    }
+    latch.count_down();
+}
+
+void SystemScheduler::run(EntityManager &manager) {
+    if (m_graph_dirty) {
+        build_graph();
+    }
+    if (m_systems.empty()) {
+        return;
+    }
+
+    if (!tasklet::in_tasklet_context()) {
+        for (uint32_t i = 0; i < m_systems.size(); i++) {
+            run_system(manager, i);
+        }
+        return;
+    }
+
+    for (auto &system : m_systems) {
+        system->m_pending_count.store(system->m_dependency_count, vull::memory_order_relaxed);
+    }
+    tasklet::Latch latch(m_systems.size());
+    for (const auto index : m_root_systems) {
+        tasklet::schedule([this, &manager, index, &latch] {
+            run_system_tasklet(manager, index, latch);
+        });
+    }
+    latch.wait();
+}
+
+} // namespace vull
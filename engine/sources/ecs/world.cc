@@ -4,6 +4,7 @@
 #include <vull/core/log.hh>
 #include <vull/ecs/entity_id.hh>
 #include <vull/ecs/sparse_set.hh>
+#include <vull/platform/platform.hh>
 #include <vull/support/algorithm.hh>
 #include <vull/support/result.hh>
 #include <vull/support/stream.hh>
@@ -15,14 +16,23 @@
 #include <stdint.h>
 
 namespace vull {
+namespace {
+
+// Flags are stored above the entity count, which never needs more than the 24 index bits.
+constexpr EntityId k_fixed_width_ids_flag = 1u << 31u;
+
+} // namespace
 
 Result<void, StreamError, WorldError> World::deserialise(Stream &stream) {
-    const auto entity_count = VULL_TRY(stream.read_varint<EntityId>());
+    const auto count_and_flags = VULL_TRY(stream.read_varint<EntityId>());
+    const auto entity_count = entity_index(count_and_flags);
+    const bool fixed_width_ids = (count_and_flags & k_fixed_width_ids_flag) != 0;
     m_entities.ensure_capacity(entity_count);
     for (EntityId i = 0; i < entity_count; i++) {
         m_entities.push(i);
     }
 
+    Vector<EntityId> ids;
     const auto set_count = VULL_TRY(stream.read_varint<uint32_t>());
     for (uint32_t i = 0; i < set_count; i++) {
         const auto set_entity_count = VULL_TRY(stream.read_varint<EntityId>());
@@ -34,26 +44,53 @@ Result<void, StreamError, WorldError> World::deserialise(Stream &stream) {
             return WorldError::InvalidComponent;
         }
         auto &set = m_component_sets[i];
-        set.deserialise(set_entity_count, stream);
-        for (EntityId j = 0; j < set_entity_count; j++) {
-            set.raw_ensure_index(VULL_TRY(stream.read_varint<EntityId>()));
+        VULL_TRY(set.deserialise(set_entity_count, stream));
+        if (!fixed_width_ids) {
+            for (EntityId j = 0; j < set_entity_count; j++) {
+                set.raw_ensure_index(VULL_TRY(stream.read_varint<EntityId>()));
+            }
+            continue;
+        }
+
+        // The IDs are stored little-endian, so can be read straight into memory.
+        static_assert(platform::is_little_endian());
+        ids.ensure_size(set_entity_count);
+        const auto id_bytes = set_entity_count * sizeof(EntityId);
+        if (VULL_TRY(stream.read(ids.span().subspan(0, set_entity_count))) != id_bytes) {
+            return StreamError::Truncated;
         }
+        set.raw_ensure_indices(ids.span().subspan(0, set_entity_count));
+    }
+
+    // Everything loaded counts as newly added.
+    for (auto &set : m_component_sets) {
+        set.reset_ticks({m_change_tick, m_change_tick});
+    }
+
+    // The sets were filled without going through enter_group, so any groups need packing afresh.
+    for (uint32_t group_index = 0; group_index < m_groups.size(); group_index++) {
+        pack_group(group_index);
     }
     return {};
 }
 
-Result<void, StreamError> World::serialise(vpak::Writer &pack_writer, StringView name) {
+Result<void, StreamError> World::serialise(vpak::Writer &pack_writer, StringView name, EntityIdEncoding id_encoding) {
+    const bool fixed_width_ids = id_encoding == EntityIdEncoding::FixedWidth;
     auto entry = pack_writer.add_entry(name, vpak::EntryType::World);
-    VULL_TRY(entry.write_varint(m_entities.size()));
+    VULL_TRY(entry.write_varint(m_entities.size() | (fixed_width_ids ? k_fixed_width_ids_flag : 0u)));
     VULL_TRY(entry.write_varint(m_component_sets.size()));
     for (auto &set : m_component_sets) {
         VULL_TRY(entry.write_varint(set.size()));
         if (!set.initialised()) {
             continue;
         }
-        set.serialise(entry);
+        VULL_TRY(set.serialise(entry));
         for (EntityId id : vull::make_range(set.dense_begin(), set.dense_end())) {
-            VULL_TRY(entry.write_varint(id));
+            if (fixed_width_ids) {
+                VULL_TRY(entry.write_le(id));
+            } else {
+                VULL_TRY(entry.write_varint(id));
+            }
         }
     }
     VULL_TRY(entry.finish());
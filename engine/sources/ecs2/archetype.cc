@@ -0,0 +1,129 @@
+#include <vull/ecs2/archetype.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs2/entity.hh>
+#include <vull/maths/common.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/span.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace vull::ecs {
+
+Archetype::Archetype(ComponentMask mask, Span<const ComponentInfo> component_infos) : m_mask(mask) {
+    uint32_t row_size = sizeof(Entity);
+    for (ComponentId id = 0; id < k_max_component_count; id++) {
+        if ((mask & (ComponentMask(1) << id)) != 0) {
+            VULL_ASSERT(id < component_infos.size() && component_infos[id].registered());
+            m_columns.push({.id = id, .info = component_infos[id]});
+            row_size += component_infos[id].size;
+        }
+    }
+
+    // Find the largest capacity for which all of the cache line aligned arrays fit in a chunk.
+    const auto layout_size = [this](uint32_t capacity) {
+        uint32_t offset = vull::align_up(capacity * uint32_t(sizeof(Entity)), k_cache_line_size);
+        for (auto &column : m_columns) {
+            column.offset = offset;
+            offset += vull::align_up(capacity * column.info.size, k_cache_line_size);
+        }
+        return offset;
+    };
+    m_chunk_capacity = k_chunk_size / row_size;
+    while (m_chunk_capacity > 0 && layout_size(m_chunk_capacity) > k_chunk_size) {
+        m_chunk_capacity--;
+    }
+    VULL_ENSURE(m_chunk_capacity != 0, "Archetype row too large for a chunk");
+    layout_size(m_chunk_capacity);
+}
+
+Archetype::~Archetype() {
+    for (uint32_t row = m_size; row > 0; row--) {
+        for (const auto &column : m_columns) {
+            if (column.info.destruct != nullptr) {
+                column.info.destruct(column_pointer(column, row - 1));
+            }
+        }
+    }
+}
+
+uint8_t *Archetype::column_pointer(const Column &column, uint32_t row) const {
+    auto &chunk = *m_chunks[row / m_chunk_capacity];
+    return chunk.data + column.offset + (row % m_chunk_capacity) * column.info.size;
+}
+
+uint32_t Archetype::allocate_row(Entity entity) {
+    const uint32_t row = m_size++;
+    if (row / m_chunk_capacity == m_chunks.size()) {
+        m_chunks.push(vull::make_unique<Chunk>());
+    }
+    entities(row / m_chunk_capacity)[row % m_chunk_capacity] = entity;
+    return row;
+}
+
+void Archetype::move_row_from(Archetype &source, uint32_t source_row, uint32_t row) {
+    // Both column lists are sorted by component ID, so walk them together.
+    uint32_t source_index = 0;
+    for (const auto &column : m_columns) {
+        while (source_index < source.m_columns.size() && source.m_columns[source_index].id < column.id) {
+            source_index++;
+        }
+        if (source_index == source.m_columns.size()) {
+            break;
+        }
+        const auto &source_column = source.m_columns[source_index];
+        if (source_column.id != column.id) {
+            continue;
+        }
+        auto *dst = column_pointer(column, row);
+        auto *src = source.column_pointer(source_column, source_row);
+        if (column.info.move_construct != nullptr) {
+            column.info.move_construct(dst, src);
+        } else {
+            memcpy(dst, src, column.info.size);
+        }
+    }
+}
+
+Entity Archetype::remove_row(uint32_t row) {
+    VULL_ASSERT(row < m_size);
+    const uint32_t last_row = --m_size;
+    for (const auto &column : m_columns) {
+        auto *ptr = column_pointer(column, row);
+        if (column.info.destruct != nullptr) {
+            column.info.destruct(ptr);
+        }
+        if (row == last_row) {
+            continue;
+        }
+        auto *last_ptr = column_pointer(column, last_row);
+        if (column.info.move_construct != nullptr) {
+            column.info.move_construct(ptr, last_ptr);
+            column.info.destruct(last_ptr);
+        } else {
+            memcpy(ptr, last_ptr, column.info.size);
+        }
+    }
+
+    Entity moved_entity = Entity::null();
+    if (row != last_row) {
+        moved_entity = entities(last_row / m_chunk_capacity)[last_row % m_chunk_capacity];
+        entities(row / m_chunk_capacity)[row % m_chunk_capacity] = moved_entity;
+    }
+
+    // Keep one empty chunk around to avoid thrashing at a chunk boundary.
+    if (m_chunks.size() > chunk_count() + 1) {
+        m_chunks.pop();
+    }
+    return moved_entity;
+}
+
+void *Archetype::component(ComponentId id, uint32_t row) const {
+    VULL_ASSERT(row < m_size);
+    return column_pointer(m_columns[column_index(id)], row);
+}
+
+} // namespace vull::ecs
@@ -1,26 +1,71 @@
 #include <vull/ecs2/world.hh>
 
 #include <vull/container/vector.hh>
+#include <vull/ecs2/archetype.hh>
 #include <vull/ecs2/entity.hh>
 #include <vull/support/assert.hh>
+#include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 
+#include <stdint.h>
+
 namespace vull::ecs {
 
+World::World() {
+    // Entities without any components live in the root archetype.
+    find_or_create_archetype(0);
+}
+
+World::~World() = default;
+
+uint32_t World::find_or_create_archetype(ComponentMask mask) {
+    if (auto index = m_archetype_indices.get(mask)) {
+        return *index;
+    }
+    const auto index = m_archetypes.size();
+    m_archetypes.push(vull::make_unique<Archetype>(mask, m_component_infos.span()));
+    m_archetype_indices.set(mask, index);
+    return index;
+}
+
+uint32_t World::move_entity(Entity entity, ComponentMask mask) {
+    const auto archetype_index = find_or_create_archetype(mask);
+    auto &location = m_entity_locations[entity.index()];
+    auto &old_archetype = *m_archetypes[location.archetype];
+    auto &new_archetype = *m_archetypes[archetype_index];
+    const auto row = new_archetype.allocate_row(entity);
+    new_archetype.move_row_from(old_archetype, location.row, row);
+    if (const auto moved_entity = old_archetype.remove_row(location.row); moved_entity != Entity::null()) {
+        m_entity_locations[moved_entity.index()].row = location.row;
+    }
+    location = {archetype_index, row};
+    return archetype_index;
+}
+
 Entity World::create() {
     if (m_free_head == Entity::null_index()) {
         // There are no entity ids available to recycle, so make a new one.
-        return m_entity_list.emplace(m_entity_list.size());
+        const auto entity = m_entity_list.emplace(m_entity_list.size());
+        m_entity_locations.push({0, m_archetypes[0]->allocate_row(entity)});
+        return entity;
     }
 
     const auto index = m_free_head;
     m_free_head = m_entity_list[index].index();
-    return (m_entity_list[index] = Entity::make(index, m_entity_list[index].version()));
+    const auto entity = (m_entity_list[index] = Entity::make(index, m_entity_list[index].version()));
+    m_entity_locations[index] = {0, m_archetypes[0]->allocate_row(entity)};
+    return entity;
 }
 
 void World::destroy(Entity entity) {
     VULL_ASSERT(is_valid(entity));
     const auto index = entity.index();
+    const auto location = m_entity_locations[index];
+    if (const auto moved_entity = m_archetypes[location.archetype]->remove_row(location.row);
+        moved_entity != Entity::null()) {
+        m_entity_locations[moved_entity.index()].row = location.row;
+    }
+
     if (entity.version() == Entity::null_version()) {
         // Version limit reached, retire this index.
         m_entity_list[index] = Entity::null();
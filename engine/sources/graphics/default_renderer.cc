@@ -17,6 +17,7 @@
 #include <vull/maths/vec.hh>
 #include <vull/scene/camera.hh>
 #include <vull/scene/scene.hh>
+#include <vull/scene/world_transform.hh>
 #include <vull/support/assert.hh>
 #include <vull/support/function.hh>
 #include <vull/support/optional.hh>
@@ -283,7 +284,7 @@ void DefaultRenderer::record_draws(vk::CommandBuffer &cmd_buf, const vk::Buffer
 
 vk::ResourceId DefaultRenderer::build_pass(vk::RenderGraph &graph, GBuffer &gbuffer, Scene &scene, Camera &camera) {
     Vector<Object> objects;
-    for (auto [entity, mesh] : scene.world().view<Mesh>()) {
+    for (auto [entity, mesh, world_transform] : scene.world().view<Mesh, WorldTransform>()) {
         // TODO: Assuming fallback indices here.
         uint32_t albedo_index = 0;
         uint32_t normal_index = 1;
@@ -299,7 +300,7 @@ vk::ResourceId DefaultRenderer::build_pass(vk::RenderGraph &graph, GBuffer &gbuf
 
         auto bounding_sphere = entity.try_get<BoundingSphere>();
         objects.push({
-            .transform = scene.get_transform_matrix(entity),
+            .transform = world_transform.matrix(),
             .center = bounding_sphere ? bounding_sphere->center() : Vec3f(0.0f),
             .radius = bounding_sphere ? bounding_sphere->radius() : FLT_MAX,
             .albedo_index = albedo_index,
@@ -30,6 +30,9 @@ namespace {
 
 constexpr uint32_t k_in_flight_limit = 32;
 
+// Number of vpak blocks to decompress ahead when loading large entries.
+constexpr uint32_t k_readahead_block_count = 4;
+
 } // namespace
 
 MeshStreamer::MeshStreamer(vk::Context &context, vkb::DeviceSize vertex_size)
@@ -55,6 +58,7 @@ MeshInfo MeshStreamer::load_mesh(const String &name) {
         vull::error("[graphics] Failed to find mesh '{}'", name);
         return {};
     }
+    data_stream->enable_readahead(k_readahead_block_count);
 
     const auto vertices_size = VULL_EXPECT(data_stream->read_varint<uint64_t>());
     const auto indices_size = VULL_EXPECT(data_stream->read_varint<uint64_t>());
@@ -39,6 +39,9 @@ namespace {
 
 constexpr uint32_t k_in_flight_limit = 16;
 
+// Mip chains span many blocks, so have them decompressed in parallel.
+constexpr uint32_t k_readahead_block_count = 4;
+
 struct FormatInfo {
     vkb::Format format;
     uint32_t unit_size;
@@ -315,6 +318,7 @@ uint32_t TextureStreamer::load_texture(const String &name, uint32_t fallback_ind
         vull::error("[graphics] Failed to find texture {}", name);
         return fallback_index;
     }
+    stream->enable_readahead(k_readahead_block_count);
 
     if (auto index = load_texture(*stream).to_optional()) {
         return *index;
@@ -0,0 +1,214 @@
+#include <vull/physics/aabb_tree.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/vec.hh>
+#include <vull/physics/aabb.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+uint32_t AabbTree::allocate_node() {
+    if (m_free_head == k_null_proxy) {
+        m_nodes.emplace();
+        return m_nodes.size() - 1;
+    }
+    const auto index = m_free_head;
+    m_free_head = m_nodes[index].parent;
+    m_nodes[index] = {};
+    return index;
+}
+
+void AabbTree::free_node(uint32_t index) {
+    m_nodes[index].parent = m_free_head;
+    m_nodes[index].height = -1;
+    m_free_head = index;
+}
+
+uint32_t AabbTree::create_proxy(const Aabb &aabb, uint32_t user_data) {
+    const auto proxy = allocate_node();
+    auto &node = m_nodes[proxy];
+    node.aabb = aabb.fattened(k_margin);
+    node.user_data = user_data;
+    insert_leaf(proxy);
+    m_proxy_count++;
+    return proxy;
+}
+
+void AabbTree::destroy_proxy(uint32_t proxy) {
+    VULL_ASSERT(m_nodes[proxy].is_leaf());
+    remove_leaf(proxy);
+    free_node(proxy);
+    m_proxy_count--;
+}
+
+bool AabbTree::move_proxy(uint32_t proxy, const Aabb &aabb, const Vec3f &displacement) {
+    VULL_ASSERT(m_nodes[proxy].is_leaf());
+    if (m_nodes[proxy].aabb.contains(aabb)) {
+        return false;
+    }
+
+    // Predict where the object is heading so that it doesn't need reinserting again next time.
+    auto fat_aabb = aabb.fattened(k_margin);
+    const auto predicted = displacement * k_displacement_multiplier;
+    fat_aabb.min += vull::min(predicted, Vec3f(0.0f));
+    fat_aabb.max += vull::max(predicted, Vec3f(0.0f));
+
+    remove_leaf(proxy);
+    m_nodes[proxy].aabb = fat_aabb;
+    insert_leaf(proxy);
+    return true;
+}
+
+void AabbTree::insert_leaf(uint32_t leaf) {
+    if (m_root == k_null_proxy) {
+        m_root = leaf;
+        m_nodes[leaf].parent = k_null_proxy;
+        return;
+    }
+
+    // Find the best sibling by descending whilst it's cheaper than pairing with the current node.
+    const auto leaf_aabb = m_nodes[leaf].aabb;
+    uint32_t index = m_root;
+    while (!m_nodes[index].is_leaf()) {
+        const auto &node = m_nodes[index];
+        const float area = node.aabb.half_surface_area();
+        const float combined_area = node.aabb.merged(leaf_aabb).half_surface_area();
+
+        // Cost of creating a new parent for this node and the leaf, and the minimum cost of pushing the leaf further
+        // down, which enlarges this node.
+        const float cost = 2.0f * combined_area;
+        const float inheritance_cost = 2.0f * (combined_area - area);
+
+        const auto child_cost = [&](uint32_t child_index) {
+            const auto &child = m_nodes[child_index];
+            const float merged_area = child.aabb.merged(leaf_aabb).half_surface_area();
+            if (child.is_leaf()) {
+                return merged_area + inheritance_cost;
+            }
+            return merged_area - child.aabb.half_surface_area() + inheritance_cost;
+        };
+        const float left_cost = child_cost(node.left);
+        const float right_cost = child_cost(node.right);
+        if (cost < left_cost && cost < right_cost) {
+            break;
+        }
+        index = left_cost < right_cost ? node.left : node.right;
+    }
+
+    // Create a new parent for the sibling and the leaf.
+    const auto sibling = index;
+    const auto old_parent = m_nodes[sibling].parent;
+    const auto new_parent = allocate_node();
+    m_nodes[new_parent].parent = old_parent;
+    m_nodes[new_parent].aabb = leaf_aabb.merged(m_nodes[sibling].aabb);
+    m_nodes[new_parent].height = m_nodes[sibling].height + 1;
+    m_nodes[new_parent].left = sibling;
+    m_nodes[new_parent].right = leaf;
+    m_nodes[sibling].parent = new_parent;
+    m_nodes[leaf].parent = new_parent;
+    if (old_parent == k_null_proxy) {
+        m_root = new_parent;
+    } else if (m_nodes[old_parent].left == sibling) {
+        m_nodes[old_parent].left = new_parent;
+    } else {
+        m_nodes[old_parent].right = new_parent;
+    }
+    refit_ancestors(new_parent);
+}
+
+void AabbTree::remove_leaf(uint32_t leaf) {
+    if (leaf == m_root) {
+        m_root = k_null_proxy;
+        return;
+    }
+
+    // Replace the parent with the sibling.
+    const auto parent = m_nodes[leaf].parent;
+    const auto grandparent = m_nodes[parent].parent;
+    const auto sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+    free_node(parent);
+    m_nodes[sibling].parent = grandparent;
+    if (grandparent == k_null_proxy) {
+        m_root = sibling;
+        return;
+    }
+    if (m_nodes[grandparent].left == parent) {
+        m_nodes[grandparent].left = sibling;
+    } else {
+        m_nodes[grandparent].right = sibling;
+    }
+    refit_ancestors(grandparent);
+}
+
+void AabbTree::refit_ancestors(uint32_t index) {
+    while (index != k_null_proxy) {
+        index = balance(index);
+        auto &node = m_nodes[index];
+        const auto &left = m_nodes[node.left];
+        const auto &right = m_nodes[node.right];
+        node.height = vull::max(left.height, right.height) + 1;
+        node.aabb = left.aabb.merged(right.aabb);
+        index = node.parent;
+    }
+}
+
+// Performs a left or right rotation if the subtree rooted at the given node is imbalanced, returning the index of the
+// subtree's new root.
+uint32_t AabbTree::balance(uint32_t a_index) {
+    auto &a = m_nodes[a_index];
+    if (a.is_leaf() || a.height < 2) {
+        return a_index;
+    }
+
+    const auto b_index = a.left;
+    const auto c_index = a.right;
+    const int32_t balance = m_nodes[c_index].height - m_nodes[b_index].height;
+    if (balance >= -1 && balance <= 1) {
+        return a_index;
+    }
+
+    // Rotate the taller child up. Its taller child stays beneath it, whilst the shorter is given to the old root.
+    const bool rotate_right = balance > 1;
+    const auto up_index = rotate_right ? c_index : b_index;
+    const auto other_index = rotate_right ? b_index : c_index;
+    auto &up = m_nodes[up_index];
+    const auto f_index = up.left;
+    const auto g_index = up.right;
+    auto &f = m_nodes[f_index];
+    auto &g = m_nodes[g_index];
+
+    // Swap a and up.
+    up.left = a_index;
+    up.parent = a.parent;
+    a.parent = up_index;
+    if (up.parent == k_null_proxy) {
+        m_root = up_index;
+    } else if (m_nodes[up.parent].left == a_index) {
+        m_nodes[up.parent].left = up_index;
+    } else {
+        m_nodes[up.parent].right = up_index;
+    }
+
+    const auto &other = m_nodes[other_index];
+    const bool f_taller = f.height > g.height;
+    const auto keep_index = f_taller ? f_index : g_index;
+    const auto give_index = f_taller ? g_index : f_index;
+    up.right = keep_index;
+    if (rotate_right) {
+        a.right = give_index;
+    } else {
+        a.left = give_index;
+    }
+    m_nodes[give_index].parent = a_index;
+    a.aabb = other.aabb.merged(m_nodes[give_index].aabb);
+    a.height = vull::max(other.height, m_nodes[give_index].height) + 1;
+    up.aabb = a.aabb.merged(m_nodes[keep_index].aabb);
+    up.height = vull::max(a.height, m_nodes[keep_index].height) + 1;
+    return up_index;
+}
+
+} // namespace vull
@@ -0,0 +1,441 @@
+#include <vull/physics/collision.hh>
+
+#include <vull/container/array.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/quat.hh>
+#include <vull/maths/vec.hh>
+#include <vull/physics/shape.hh>
+#include <vull/scene/transform.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/utility.hh>
+
+#include <stdint.h>
+
+namespace vull {
+namespace {
+
+constexpr float k_epsilon = 1e-6f;
+
+// In box-box tests, the second box's faces only win over the first's, and edge axes only win over face axes, if they
+// are significantly better. This keeps the contact from flip-flopping between frames when two axes are close.
+constexpr float k_relative_tolerance = 0.95f;
+constexpr float k_absolute_tolerance = 0.01f;
+
+bool significantly_better(float separation, float other_separation) {
+    return separation > other_separation * k_relative_tolerance + k_absolute_tolerance;
+}
+
+using CollisionFn = bool (*)(const Shape &, const Transform &, const Shape &, const Transform &, CollisionResult &);
+
+// Adds the contact between two spheres, if they overlap.
+bool add_sphere_contact(const Vec3f &centre1, float radius1, const Vec3f &centre2, float radius2,
+                        CollisionResult &result) {
+    const auto offset = centre1 - centre2;
+    const float distance_squared = vull::square_magnitude(offset);
+    const float radius_sum = radius1 + radius2;
+    if (distance_squared > radius_sum * radius_sum) {
+        return false;
+    }
+
+    // Pick an arbitrary normal for coincident centres.
+    const float distance = vull::sqrt(distance_squared);
+    const auto normal = distance > k_epsilon ? offset / distance : Vec3f(0.0f, 1.0f, 0.0f);
+    result.normal = normal;
+    result.add_point(centre1 - normal * radius1, centre2 + normal * radius2);
+    return true;
+}
+
+Vec3f closest_point_on_segment(const Vec3f &point, const Vec3f &a, const Vec3f &b) {
+    const auto ab = b - a;
+    const float length_squared = vull::square_magnitude(ab);
+    if (length_squared < k_epsilon) {
+        return a;
+    }
+    return a + ab * vull::clamp(vull::dot(point - a, ab) / length_squared, 0.0f, 1.0f);
+}
+
+// Finds the closest points between the segments p1-q1 and p2-q2, from Real-Time Collision Detection (Ericson, 2004).
+void closest_points_between_segments(const Vec3f &p1, const Vec3f &q1, const Vec3f &p2, const Vec3f &q2, Vec3f &c1,
+                                     Vec3f &c2) {
+    const auto d1 = q1 - p1;
+    const auto d2 = q2 - p2;
+    const auto r = p1 - p2;
+    const float a = vull::dot(d1, d1);
+    const float e = vull::dot(d2, d2);
+    const float f = vull::dot(d2, r);
+
+    float s = 0.0f;
+    float t = 0.0f;
+    if (a <= k_epsilon && e > k_epsilon) {
+        t = vull::clamp(f / e, 0.0f, 1.0f);
+    } else if (a > k_epsilon) {
+        const float c = vull::dot(d1, r);
+        if (e <= k_epsilon) {
+            s = vull::clamp(-c / a, 0.0f, 1.0f);
+        } else {
+            // Parallel segments have a zero denominator, in which case any s works.
+            const float b = vull::dot(d1, d2);
+            const float denominator = a * e - b * b;
+            s = denominator != 0.0f ? vull::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = vull::clamp(-c / a, 0.0f, 1.0f);
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = vull::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+}
+
+bool sphere_sphere(const SphereShape &sphere1, const Transform &t1, const SphereShape &sphere2, const Transform &t2,
+                   CollisionResult &result) {
+    return add_sphere_contact(t1.position(), sphere1.radius(), t2.position(), sphere2.radius(), result);
+}
+
+bool sphere_box(const SphereShape &sphere, const Transform &t1, const BoxShape &box, const Transform &t2,
+                CollisionResult &result) {
+    // Work in the box's local space.
+    const auto inverse_rotation = vull::conjugate(t2.rotation());
+    const auto centre = vull::rotate(inverse_rotation, t1.position() - t2.position());
+    const auto &half_extents = box.half_extents();
+    const auto closest = vull::min(vull::max(centre, -half_extents), half_extents);
+    const auto offset = centre - closest;
+    const float distance_squared = vull::square_magnitude(offset);
+    if (distance_squared > sphere.radius() * sphere.radius()) {
+        return false;
+    }
+
+    Vec3f local_normal;
+    Vec3f surface_point = closest;
+    if (distance_squared > k_epsilon * k_epsilon) {
+        local_normal = offset / vull::sqrt(distance_squared);
+    } else {
+        // The centre is inside the box, so push out through the nearest face.
+        unsigned axis = 0;
+        float min_depth = half_extents.x() - vull::abs(centre.x());
+        for (unsigned i = 1; i < 3; i++) {
+            const float depth = half_extents[i] - vull::abs(centre[i]);
+            if (depth < min_depth) {
+                axis = i;
+                min_depth = depth;
+            }
+        }
+        const float side = centre[axis] >= 0.0f ? 1.0f : -1.0f;
+        local_normal[axis] = side;
+        surface_point[axis] = half_extents[axis] * side;
+    }
+
+    const auto normal = vull::rotate(t2.rotation(), local_normal);
+    result.normal = normal;
+    result.add_point(t1.position() - normal * sphere.radius(), t2 * surface_point);
+    return true;
+}
+
+bool sphere_capsule(const SphereShape &sphere, const Transform &t1, const CapsuleShape &capsule, const Transform &t2,
+                    CollisionResult &result) {
+    Vec3f a;
+    Vec3f b;
+    capsule.segment(t2, a, b);
+    const auto closest = closest_point_on_segment(t1.position(), a, b);
+    return add_sphere_contact(t1.position(), sphere.radius(), closest, capsule.radius(), result);
+}
+
+bool capsule_capsule(const CapsuleShape &capsule1, const Transform &t1, const CapsuleShape &capsule2,
+                     const Transform &t2, CollisionResult &result) {
+    Vec3f p1;
+    Vec3f q1;
+    Vec3f p2;
+    Vec3f q2;
+    capsule1.segment(t1, p1, q1);
+    capsule2.segment(t2, p2, q2);
+
+    // Parallel capsules lying alongside each other get a contact at each end of their overlap so that they can rest
+    // stably on each other.
+    const auto d1 = q1 - p1;
+    const auto d2 = q2 - p2;
+    const float length_squared1 = vull::square_magnitude(d1);
+    const float length_squared2 = vull::square_magnitude(d2);
+    if (length_squared1 > k_epsilon && length_squared2 > k_epsilon &&
+        vull::square_magnitude(vull::cross(d1, d2)) < 1e-4f * length_squared1 * length_squared2) {
+        const float ta = vull::dot(p2 - p1, d1) / length_squared1;
+        const float tb = vull::dot(q2 - p1, d1) / length_squared1;
+        const float begin = vull::max(vull::min(ta, tb), 0.0f);
+        const float end = vull::min(vull::max(ta, tb), 1.0f);
+        if (end - begin > 1e-3f) {
+            bool touching = false;
+            for (const float s : Array<float, 2>{begin, end}) {
+                const auto point = p1 + d1 * s;
+                const auto closest = closest_point_on_segment(point, p2, q2);
+                touching |= add_sphere_contact(point, capsule1.radius(), closest, capsule2.radius(), result);
+            }
+            return touching;
+        }
+    }
+
+    Vec3f c1;
+    Vec3f c2;
+    closest_points_between_segments(p1, q1, p2, q2, c1, c2);
+    return add_sphere_contact(c1, capsule1.radius(), c2, capsule2.radius(), result);
+}
+
+struct OrientedBox {
+    Array<Vec3f, 3> axes;
+    Vec3f half_extents;
+    Vec3f centre;
+
+    OrientedBox(const BoxShape &box, const Transform &transform);
+
+    // Returns the radius of the box projected onto the given axis.
+    float projected_radius(const Vec3f &axis) const;
+};
+
+OrientedBox::OrientedBox(const BoxShape &box, const Transform &transform)
+    : half_extents(box.half_extents()), centre(transform.position()) {
+    for (unsigned i = 0; i < 3; i++) {
+        Vec3f axis;
+        axis[i] = 1.0f;
+        axes[i] = vull::rotate(transform.rotation(), axis);
+    }
+}
+
+float OrientedBox::projected_radius(const Vec3f &axis) const {
+    return half_extents.x() * vull::abs(vull::dot(axes[0], axis)) +
+           half_extents.y() * vull::abs(vull::dot(axes[1], axis)) +
+           half_extents.z() * vull::abs(vull::dot(axes[2], axis));
+}
+
+// Clips a polygon against the plane dot(p, normal) <= distance, using Sutherland-Hodgman.
+void clip_polygon(Array<Vec3f, 8> &polygon, uint32_t &vertex_count, const Vec3f &normal, float distance) {
+    Array<Vec3f, 8> clipped;
+    uint32_t clipped_count = 0;
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        const auto &a = polygon[i];
+        const auto &b = polygon[(i + 1) % vertex_count];
+        const float da = vull::dot(a, normal) - distance;
+        const float db = vull::dot(b, normal) - distance;
+        if (da <= 0.0f) {
+            clipped[clipped_count++] = a;
+        }
+        if ((da < 0.0f && db > 0.0f) || (da > 0.0f && db < 0.0f)) {
+            clipped[clipped_count++] = a + (b - a) * (da / (da - db));
+        }
+    }
+    polygon = clipped;
+    vertex_count = clipped_count;
+}
+
+// Generates contacts by clipping the face of the incident box most facing the reference face against the side planes
+// of the reference face. The normal points out of the reference face towards the incident box.
+void box_face_contact(const OrientedBox &reference, uint32_t reference_axis, const OrientedBox &incident,
+                      const Vec3f &normal, bool reference_first, CollisionResult &result) {
+    uint32_t incident_axis = 0;
+    float max_alignment = 0.0f;
+    for (uint32_t i = 0; i < 3; i++) {
+        const float alignment = vull::abs(vull::dot(incident.axes[i], normal));
+        if (alignment > max_alignment) {
+            incident_axis = i;
+            max_alignment = alignment;
+        }
+    }
+
+    const auto incident_normal = vull::dot(incident.axes[incident_axis], normal) > 0.0f
+                                     ? -incident.axes[incident_axis]
+                                     : incident.axes[incident_axis];
+    const auto incident_centre = incident.centre + incident_normal * incident.half_extents[incident_axis];
+    const auto u = incident.axes[(incident_axis + 1) % 3] * incident.half_extents[(incident_axis + 1) % 3];
+    const auto v = incident.axes[(incident_axis + 2) % 3] * incident.half_extents[(incident_axis + 2) % 3];
+    Array<Vec3f, 8> polygon{incident_centre + u + v, incident_centre - u + v, incident_centre - u - v,
+                            incident_centre + u - v};
+    uint32_t vertex_count = 4;
+    for (uint32_t i = 1; i < 3 && vertex_count != 0; i++) {
+        const auto &side = reference.axes[(reference_axis + i) % 3];
+        const float extent = reference.half_extents[(reference_axis + i) % 3];
+        const float centre_distance = vull::dot(reference.centre, side);
+        clip_polygon(polygon, vertex_count, side, centre_distance + extent);
+        clip_polygon(polygon, vertex_count, -side, extent - centre_distance);
+    }
+
+    // Keep the points behind the reference face, projecting them onto it for the reference box's point.
+    const float face_distance = vull::dot(reference.centre, normal) + reference.half_extents[reference_axis];
+    result.normal = reference_first ? -normal : normal;
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        const float separation = vull::dot(polygon[i], normal) - face_distance;
+        if (separation > 0.0f) {
+            continue;
+        }
+        const auto projected = polygon[i] - normal * separation;
+        if (reference_first) {
+            result.add_point(projected, polygon[i]);
+        } else {
+            result.add_point(polygon[i], projected);
+        }
+    }
+}
+
+bool box_box(const BoxShape &shape1, const Transform &t1, const BoxShape &shape2, const Transform &t2,
+             CollisionResult &result) {
+    const OrientedBox box1(shape1, t1);
+    const OrientedBox box2(shape2, t2);
+    const auto offset = box2.centre - box1.centre;
+
+    // Returns the separation along the given axis, flipping the axis to point from the first box to the second.
+    const auto separation = [&](Vec3f &axis) {
+        if (vull::dot(offset, axis) < 0.0f) {
+            axis = -axis;
+        }
+        return vull::dot(offset, axis) - box1.projected_radius(axis) - box2.projected_radius(axis);
+    };
+
+    // Find the face axis of each box, and the pair of edge axes, with the least penetration. Any separating axis means
+    // no contact.
+    Array<float, 2> face_separations;
+    Array<uint32_t, 2> face_indices;
+    Array<Vec3f, 2> face_axes;
+    for (uint32_t i = 0; i < 6; i++) {
+        const uint32_t box_index = i / 3;
+        auto axis = box_index == 0 ? box1.axes[i] : box2.axes[i - 3];
+        const float axis_separation = separation(axis);
+        if (axis_separation > 0.0f) {
+            return false;
+        }
+        if (i % 3 == 0 || axis_separation > face_separations[box_index]) {
+            face_separations[box_index] = axis_separation;
+            face_indices[box_index] = i % 3;
+            face_axes[box_index] = axis;
+        }
+    }
+    const bool second_face = significantly_better(face_separations[1], face_separations[0]);
+    const float face_separation = face_separations[second_face ? 1 : 0];
+
+    bool has_edge_axis = false;
+    float edge_separation = 0.0f;
+    uint32_t edge_index1 = 0;
+    uint32_t edge_index2 = 0;
+    Vec3f edge_axis;
+    for (uint32_t i = 0; i < 3; i++) {
+        for (uint32_t j = 0; j < 3; j++) {
+            // Skip near-parallel edges, whose cross product is degenerate. These are covered by the face axes.
+            auto axis = vull::cross(box1.axes[i], box2.axes[j]);
+            const float length_squared = vull::square_magnitude(axis);
+            if (length_squared < 1e-6f) {
+                continue;
+            }
+            axis /= vull::sqrt(length_squared);
+            const float axis_separation = separation(axis);
+            if (axis_separation > 0.0f) {
+                return false;
+            }
+            if (!has_edge_axis || axis_separation > edge_separation) {
+                has_edge_axis = true;
+                edge_separation = axis_separation;
+                edge_index1 = i;
+                edge_index2 = j;
+                edge_axis = axis;
+            }
+        }
+    }
+
+    if (!has_edge_axis || !significantly_better(edge_separation, face_separation)) {
+        if (second_face) {
+            box_face_contact(box2, face_indices[1], box1, -face_axes[1], false, result);
+        } else {
+            box_face_contact(box1, face_indices[0], box2, face_axes[0], true, result);
+        }
+        return result.point_count != 0;
+    }
+
+    // Edge-edge contact. Find the edge of each box which is furthest towards the other box along the axis, and take the
+    // closest points between them.
+    auto edge_centre1 = box1.centre;
+    auto edge_centre2 = box2.centre;
+    for (uint32_t i = 0; i < 3; i++) {
+        if (i != edge_index1) {
+            const float side = vull::dot(box1.axes[i], edge_axis) >= 0.0f ? 1.0f : -1.0f;
+            edge_centre1 += box1.axes[i] * (box1.half_extents[i] * side);
+        }
+        if (i != edge_index2) {
+            const float side = vull::dot(box2.axes[i], edge_axis) >= 0.0f ? 1.0f : -1.0f;
+            edge_centre2 -= box2.axes[i] * (box2.half_extents[i] * side);
+        }
+    }
+    const auto edge1 = box1.axes[edge_index1] * box1.half_extents[edge_index1];
+    const auto edge2 = box2.axes[edge_index2] * box2.half_extents[edge_index2];
+    Vec3f point1;
+    Vec3f point2;
+    closest_points_between_segments(edge_centre1 - edge1, edge_centre1 + edge1, edge_centre2 - edge2,
+                                    edge_centre2 + edge2, point1, point2);
+    result.normal = -edge_axis;
+    result.add_point(point1, point2);
+    return true;
+}
+
+template <typename S1, typename S2, bool (*Fn)(const S1 &, const Transform &, const S2 &, const Transform &,
+                                               CollisionResult &)>
+bool invoke(const Shape &s1, const Transform &t1, const Shape &s2, const Transform &t2, CollisionResult &result) {
+    return Fn(static_cast<const S1 &>(s1), t1, static_cast<const S2 &>(s2), t2, result);
+}
+
+struct CollisionTest {
+    CollisionFn fn{nullptr};
+    // Whether the test is written for the shapes in the opposite order.
+    bool swapped{false};
+};
+
+constexpr uint32_t k_shape_type_count = 4;
+
+constexpr auto build_collision_matrix() {
+    Array<Array<CollisionTest, k_shape_type_count>, k_shape_type_count> matrix{};
+    const auto set = [&](ShapeType type1, ShapeType type2, CollisionFn fn) {
+        matrix[static_cast<uint32_t>(type1)][static_cast<uint32_t>(type2)] = {fn, false};
+        if (type1 != type2) {
+            matrix[static_cast<uint32_t>(type2)][static_cast<uint32_t>(type1)] = {fn, true};
+        }
+    };
+    set(ShapeType::Sphere, ShapeType::Sphere, &invoke<SphereShape, SphereShape, &sphere_sphere>);
+    set(ShapeType::Sphere, ShapeType::Box, &invoke<SphereShape, BoxShape, &sphere_box>);
+    set(ShapeType::Sphere, ShapeType::Capsule, &invoke<SphereShape, CapsuleShape, &sphere_capsule>);
+    set(ShapeType::Capsule, ShapeType::Capsule, &invoke<CapsuleShape, CapsuleShape, &capsule_capsule>);
+    set(ShapeType::Box, ShapeType::Box, &invoke<BoxShape, BoxShape, &box_box>);
+    return matrix;
+}
+
+constexpr auto k_collision_matrix = build_collision_matrix();
+
+const CollisionTest &collision_test(ShapeType type1, ShapeType type2) {
+    return k_collision_matrix[static_cast<uint32_t>(type1)][static_cast<uint32_t>(type2)];
+}
+
+} // namespace
+
+void CollisionResult::add_point(const Vec3f &point1, const Vec3f &point2) {
+    VULL_ASSERT(point_count < points1.size());
+    points1[point_count] = point1;
+    points2[point_count] = point2;
+    point_count++;
+}
+
+bool has_collision_test(ShapeType type1, ShapeType type2) {
+    return collision_test(type1, type2).fn != nullptr;
+}
+
+bool collide(const Shape &s1, const Transform &t1, const Shape &s2, const Transform &t2, CollisionResult &result) {
+    const auto &test = collision_test(s1.type(), s2.type());
+    VULL_ASSERT(test.fn != nullptr);
+    if (!test.swapped) {
+        return test.fn(s1, t1, s2, t2, result);
+    }
+    if (!test.fn(s2, t2, s1, t1, result)) {
+        return false;
+    }
+    result.normal = -result.normal;
+    for (uint32_t i = 0; i < result.point_count; i++) {
+        vull::swap(result.points1[i], result.points2[i]);
+    }
+    return true;
+}
+
+} // namespace vull
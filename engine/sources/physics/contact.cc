@@ -0,0 +1,102 @@
+#include <vull/physics/contact.hh>
+
+#include <vull/maths/common.hh>
+#include <vull/maths/quat.hh>
+#include <vull/maths/vec.hh>
+#include <vull/scene/transform.hh>
+
+#include <stdint.h>
+
+namespace vull {
+namespace {
+
+Vec3f to_local(const Transform &transform, const Vec3f &point) {
+    return vull::rotate(vull::conjugate(transform.rotation()), point - transform.position());
+}
+
+// Returns a measure of the area of the quadrilateral formed by the given points, in any order.
+float quad_area(const Vec3f &a, const Vec3f &b, const Vec3f &c, const Vec3f &d) {
+    const float area1 = vull::square_magnitude(vull::cross(a - b, c - d));
+    const float area2 = vull::square_magnitude(vull::cross(a - c, b - d));
+    const float area3 = vull::square_magnitude(vull::cross(a - d, b - c));
+    return vull::max(vull::max(area1, area2), area3);
+}
+
+} // namespace
+
+ContactPoint ContactPoint::from_contact(const Contact &contact, const Transform &t1, const Transform &t2) {
+    const auto half_penetration = contact.normal * (contact.penetration * 0.5f);
+    return from_points(contact.position - half_penetration, contact.position + half_penetration, contact.normal, t1,
+                       t2);
+}
+
+ContactPoint ContactPoint::from_points(const Vec3f &point1, const Vec3f &point2, const Vec3f &normal,
+                                       const Transform &t1, const Transform &t2) {
+    return {
+        .local_point1 = to_local(t1, point1),
+        .local_point2 = to_local(t2, point2),
+        .position = (point1 + point2) * 0.5f,
+        .penetration = vull::dot(point2 - point1, normal),
+    };
+}
+
+void ContactManifold::refresh(const Transform &t1, const Transform &t2) {
+    for (uint32_t i = 0; i < point_count;) {
+        auto &point = points[i];
+        const auto world_point1 = t1 * point.local_point1;
+        const auto world_point2 = t2 * point.local_point2;
+        point.position = (world_point1 + world_point2) * 0.5f;
+        point.penetration = vull::dot(world_point2 - world_point1, normal);
+
+        const auto drift = world_point1 - world_point2 + normal * point.penetration;
+        if (point.penetration < -k_breaking_threshold ||
+            vull::square_magnitude(drift) > k_breaking_threshold * k_breaking_threshold) {
+            points[i] = points[--point_count];
+            continue;
+        }
+        i++;
+    }
+}
+
+void ContactManifold::add_point(const ContactPoint &point) {
+    // Keep an existing nearby point as it is, since it has already been refreshed and re-anchoring it every step lets
+    // resting contacts creep.
+    for (uint32_t i = 0; i < point_count; i++) {
+        if (vull::square_magnitude(points[i].position - point.position) <
+            k_breaking_threshold * k_breaking_threshold) {
+            return;
+        }
+    }
+
+    if (point_count < points.size()) {
+        points[point_count++] = point;
+        return;
+    }
+
+    uint32_t deepest = 0;
+    for (uint32_t i = 1; i < point_count; i++) {
+        if (points[i].penetration > points[deepest].penetration) {
+            deepest = i;
+        }
+    }
+
+    uint32_t replace = deepest == 0 ? 1 : 0;
+    float best_area = -1.0f;
+    for (uint32_t i = 0; i < point_count; i++) {
+        if (i == deepest && point.penetration <= points[deepest].penetration) {
+            continue;
+        }
+        Array<Vec3f, 4> positions;
+        for (uint32_t j = 0; j < point_count; j++) {
+            positions[j] = j == i ? point.position : points[j].position;
+        }
+        const float area = quad_area(positions[0], positions[1], positions[2], positions[3]);
+        if (area > best_area) {
+            best_area = area;
+            replace = i;
+        }
+    }
+    points[replace] = point;
+}
+
+} // namespace vull
@@ -0,0 +1,269 @@
+#include <vull/physics/contact_solver.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/mat.hh>
+#include <vull/maths/vec.hh>
+#include <vull/physics/contact.hh>
+#include <vull/physics/rigid_body.hh>
+#include <vull/scene/transform.hh>
+#include <vull/support/optional.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/latch.hh>
+
+#include <stdint.h>
+
+namespace vull {
+namespace {
+
+// Closing speed below which restitution is ignored, so that resting contacts don't bounce.
+constexpr float k_restitution_threshold = 1.0f;
+
+// Fraction of the penetration resolved each substep, and the penetration left alone to keep contacts stable.
+constexpr float k_position_correction = 0.2f;
+constexpr float k_linear_slop = 0.005f;
+
+// Manifolds are coloured with a bitmask per body, which limits the number of batches.
+constexpr uint32_t k_max_batch_count = 64;
+
+// How many manifolds of a batch are solved by each tasklet.
+constexpr uint32_t k_batch_grain = 64;
+
+} // namespace
+
+float ContactSolver::inverse_mass_along(const RigidBody &body, const Vec3f &r, const Vec3f &direction) {
+    const auto w = vull::cross(r, direction);
+    return body.m_inv_mass + vull::dot(w * body.m_inertia_tensor_world, w);
+}
+
+void ContactSolver::apply_impulse(ManifoldConstraint &constraint, const PointConstraint &point, const Vec3f &impulse) {
+    constraint.b1.add_impulse(impulse, point.r1);
+    if (constraint.b2) {
+        constraint.b2->add_impulse(-impulse, point.r2);
+    }
+}
+
+void ContactSolver::add_manifold(ContactManifold &manifold, uint32_t body_index1, RigidBody &b1, const Transform &t1,
+                                 uint32_t body_index2, Optional<RigidBody &> b2, const Transform &t2, float time_step) {
+    // Build an orthonormal basis around the normal for friction.
+    const auto &normal = manifold.normal;
+    const auto perpendicular = vull::abs(normal.x()) > 0.57735f ? Vec3f(normal.y(), -normal.x(), 0.0f)
+                                                                  : Vec3f(0.0f, normal.z(), -normal.y());
+    const auto tangent1 = vull::normalise(perpendicular);
+    const auto tangent2 = vull::cross(normal, tangent1);
+    auto &constraint = m_constraints.emplace(
+        ManifoldConstraint{manifold, b1, b2, body_index1, body_index2, tangent1, tangent2, {}});
+
+    for (uint32_t i = 0; i < manifold.point_count; i++) {
+        const auto &point = manifold.points[i];
+        auto &point_constraint = constraint.points[i];
+        point_constraint.r1 = point.position - t1.position();
+        point_constraint.r2 = point.position - t2.position();
+        point_constraint.pseudo_impulse = 0.0f;
+
+        const auto inverse_mass = [&](const Vec3f &direction) {
+            float mass = inverse_mass_along(b1, point_constraint.r1, direction);
+            if (b2) {
+                mass += inverse_mass_along(*b2, point_constraint.r2, direction);
+            }
+            return 1.0f / mass;
+        };
+        point_constraint.normal_mass = inverse_mass(normal);
+        point_constraint.tangent_mass1 = inverse_mass(tangent1);
+        point_constraint.tangent_mass2 = inverse_mass(tangent2);
+
+        // Points which haven't touched yet allow the bodies to close the gap within this substep, otherwise apply
+        // restitution on hard impacts.
+        const auto relative_velocity =
+            b1.velocity_at_point(point_constraint.r1) - (b2 ? b2->velocity_at_point(point_constraint.r2) : Vec3f());
+        const float normal_velocity = vull::dot(relative_velocity, normal);
+        point_constraint.velocity_bias = 0.0f;
+        if (point.penetration < 0.0f) {
+            point_constraint.velocity_bias = point.penetration / time_step;
+        } else if (normal_velocity < -k_restitution_threshold) {
+            point_constraint.velocity_bias = -m_restitution * normal_velocity;
+        }
+        point_constraint.position_bias = k_position_correction * vull::max(point.penetration - k_linear_slop, 0.0f);
+    }
+}
+
+void ContactSolver::build_batches() {
+    // Give each manifold the lowest colour not yet used by either of its bodies. Static colliders never conflict.
+    Vector<uint64_t> body_colours;
+    Vector<uint32_t> colours(m_constraints.size());
+    Array<uint32_t, k_max_batch_count + 1> batch_sizes{};
+    for (uint32_t i = 0; i < m_constraints.size(); i++) {
+        const auto &constraint = m_constraints[i];
+        body_colours.ensure_size(constraint.body_index1 + 1);
+        uint64_t used_colours = body_colours[constraint.body_index1];
+        if (constraint.body_index2 != k_static_body) {
+            body_colours.ensure_size(constraint.body_index2 + 1);
+            used_colours |= body_colours[constraint.body_index2];
+        }
+
+        const auto colour = ~used_colours != 0 ? vull::ffs(~used_colours) : k_max_batch_count;
+        colours[i] = static_cast<uint32_t>(colour);
+        batch_sizes[colour]++;
+        if (colour != k_max_batch_count) {
+            body_colours[constraint.body_index1] |= 1ull << colour;
+            if (constraint.body_index2 != k_static_body) {
+                body_colours[constraint.body_index2] |= 1ull << colour;
+            }
+        }
+    }
+
+    // Stably sort the constraints by colour, dropping empty batches.
+    Array<uint32_t, k_max_batch_count + 1> batch_offsets{};
+    m_batch_offsets.clear();
+    uint32_t offset = 0;
+    for (uint32_t colour = 0; colour <= k_max_batch_count; colour++) {
+        batch_offsets[colour] = offset;
+        if (colour == k_max_batch_count) {
+            m_overflow_offset = offset;
+        } else if (batch_sizes[colour] != 0) {
+            m_batch_offsets.push(offset);
+        }
+        offset += batch_sizes[colour];
+    }
+
+    Vector<ManifoldConstraint> sorted;
+    sorted.ensure_capacity(m_constraints.size());
+    Vector<uint32_t> order(m_constraints.size());
+    for (uint32_t i = 0; i < m_constraints.size(); i++) {
+        order[batch_offsets[colours[i]]++] = i;
+    }
+    for (const auto index : order) {
+        sorted.push(m_constraints[index]);
+    }
+    m_constraints = vull::move(sorted);
+}
+
+template <typename F>
+void ContactSolver::for_each_constraint(F &&fn) {
+    for (uint32_t batch = 0; batch < m_batch_offsets.size(); batch++) {
+        const auto begin = m_batch_offsets[batch];
+        const auto end = batch + 1 < m_batch_offsets.size() ? m_batch_offsets[batch + 1] : m_overflow_offset;
+        const auto run_range = [this, &fn](uint32_t range_begin, uint32_t range_end) {
+            for (uint32_t i = range_begin; i < range_end; i++) {
+                fn(m_constraints[i]);
+            }
+        };
+
+        const auto range_count = vull::ceil_div(end - begin, k_batch_grain);
+        if (range_count <= 1 || !tasklet::in_tasklet_context()) {
+            run_range(begin, end);
+            continue;
+        }
+
+        // No two manifolds in a batch share a body, so the ranges can be solved in any order.
+        tasklet::Latch latch(range_count - 1);
+        for (uint32_t range = 1; range < range_count; range++) {
+            const auto range_begin = begin + range * k_batch_grain;
+            const auto range_end = vull::min(end, range_begin + k_batch_grain);
+            tasklet::schedule([&run_range, &latch, range_begin, range_end] {
+                run_range(range_begin, range_end);
+                latch.count_down();
+            });
+        }
+        run_range(begin, begin + k_batch_grain);
+        latch.wait();
+    }
+
+    for (uint32_t i = m_overflow_offset; i < m_constraints.size(); i++) {
+        fn(m_constraints[i]);
+    }
+}
+
+void ContactSolver::warm_start(float time_step_ratio) {
+    for_each_constraint([time_step_ratio](ManifoldConstraint &constraint) {
+        auto &manifold = constraint.manifold;
+        for (uint32_t i = 0; i < manifold.point_count; i++) {
+            auto &point = manifold.points[i];
+            point.normal_impulse *= time_step_ratio;
+            point.tangent_impulse1 *= time_step_ratio;
+            point.tangent_impulse2 *= time_step_ratio;
+            const auto impulse = manifold.normal * point.normal_impulse + constraint.tangent1 * point.tangent_impulse1 +
+                                 constraint.tangent2 * point.tangent_impulse2;
+            apply_impulse(constraint, constraint.points[i], impulse);
+        }
+    });
+}
+
+void ContactSolver::solve_velocities(ManifoldConstraint &constraint) const {
+    auto &manifold = constraint.manifold;
+    const auto relative_velocity = [&](const PointConstraint &point_constraint) {
+        auto velocity = constraint.b1.velocity_at_point(point_constraint.r1);
+        if (constraint.b2) {
+            velocity -= constraint.b2->velocity_at_point(point_constraint.r2);
+        }
+        return velocity;
+    };
+
+    // Solve friction for every point first since it's less important than non-penetration. Its impulse is bounded by
+    // the current normal impulse. Interleaving friction and normal impulses per point biases full face contacts
+    // towards the first point, which makes stacks lean.
+    for (uint32_t i = 0; i < manifold.point_count; i++) {
+        auto &point = manifold.points[i];
+        const auto &point_constraint = constraint.points[i];
+        const float max_friction = m_friction * point.normal_impulse;
+        const auto solve_tangent = [&](const Vec3f &tangent, float mass, float &accumulated) {
+            const float lambda = -vull::dot(relative_velocity(point_constraint), tangent) * mass;
+            const float new_impulse = vull::clamp(accumulated + lambda, -max_friction, max_friction);
+            apply_impulse(constraint, point_constraint, tangent * (new_impulse - accumulated));
+            accumulated = new_impulse;
+        };
+        solve_tangent(constraint.tangent1, point_constraint.tangent_mass1, point.tangent_impulse1);
+        solve_tangent(constraint.tangent2, point_constraint.tangent_mass2, point.tangent_impulse2);
+    }
+
+    // The accumulated normal impulse may only push the bodies apart.
+    for (uint32_t i = 0; i < manifold.point_count; i++) {
+        auto &point = manifold.points[i];
+        const auto &point_constraint = constraint.points[i];
+        const float normal_velocity = vull::dot(relative_velocity(point_constraint), manifold.normal);
+        const float lambda = (point_constraint.velocity_bias - normal_velocity) * point_constraint.normal_mass;
+        const float new_impulse = vull::max(point.normal_impulse + lambda, 0.0f);
+        apply_impulse(constraint, point_constraint, manifold.normal * (new_impulse - point.normal_impulse));
+        point.normal_impulse = new_impulse;
+    }
+}
+
+void ContactSolver::solve_positions(ManifoldConstraint &constraint) {
+    const auto &manifold = constraint.manifold;
+    auto &b1 = constraint.b1;
+    auto &b2 = constraint.b2;
+    for (uint32_t i = 0; i < manifold.point_count; i++) {
+        auto &point_constraint = constraint.points[i];
+        auto pseudo_velocity =
+            b1.m_pseudo_linear_velocity + vull::cross(b1.m_pseudo_angular_velocity, point_constraint.r1);
+        if (b2) {
+            pseudo_velocity -=
+                b2->m_pseudo_linear_velocity + vull::cross(b2->m_pseudo_angular_velocity, point_constraint.r2);
+        }
+
+        const float normal_velocity = vull::dot(pseudo_velocity, manifold.normal);
+        const float lambda = (point_constraint.position_bias - normal_velocity) * point_constraint.normal_mass;
+        const float new_impulse = vull::max(point_constraint.pseudo_impulse + lambda, 0.0f);
+        const auto impulse = manifold.normal * (new_impulse - point_constraint.pseudo_impulse);
+        point_constraint.pseudo_impulse = new_impulse;
+        b1.apply_psuedo_impulse(impulse, point_constraint.r1);
+        if (b2) {
+            b2->apply_psuedo_impulse(-impulse, point_constraint.r2);
+        }
+    }
+}
+
+void ContactSolver::solve_velocities() {
+    for_each_constraint([this](ManifoldConstraint &constraint) {
+        solve_velocities(constraint);
+    });
+}
+
+void ContactSolver::solve_positions() {
+    for_each_constraint([](ManifoldConstraint &constraint) {
+        solve_positions(constraint);
+    });
+}
+
+} // namespace vull
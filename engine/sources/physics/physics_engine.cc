@@ -1,5 +1,6 @@
 #include <vull/physics/physics_engine.hh>
 
+#include <vull/container/hash_map.hh>
 #include <vull/container/vector.hh>
 #include <vull/ecs/entity.hh>
 #include <vull/ecs/world.hh>
@@ -7,143 +8,429 @@
 #include <vull/maths/mat.hh>
 #include <vull/maths/quat.hh>
 #include <vull/maths/vec.hh>
+#include <vull/physics/aabb.hh>
+#include <vull/physics/aabb_tree.hh>
 #include <vull/physics/collider.hh>
+#include <vull/physics/collision.hh>
 #include <vull/physics/contact.hh>
+#include <vull/physics/contact_solver.hh>
 #include <vull/physics/mpr.hh>
 #include <vull/physics/rigid_body.hh>
 #include <vull/physics/shape.hh>
 #include <vull/scene/transform.hh>
 #include <vull/support/optional.hh>
+#include <vull/support/span.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+
+#include <stdint.h>
 
 namespace vull {
 
-constexpr float k_fixed_timestep = 1.0f / 200.0f;
-constexpr unsigned k_max_substeps = 10;
+constexpr float k_fixed_timestep = 1.0f / 120.0f;
+constexpr uint32_t k_max_substeps = 8;
+
+// Bodies moving slower than these thresholds for long enough are put to sleep, along with the rest of their island.
+// The thresholds are fairly generous since resting contacts leave some residual velocity behind.
+constexpr float k_sleep_linear_velocity = 0.1f;
+constexpr float k_sleep_angular_velocity = 0.2f;
+constexpr float k_time_to_sleep = 0.5f;
+
+// How many times, and by how much, the smaller shape of a pair is tilted to find more contact points.
+constexpr uint32_t k_perturbation_count = 4;
+constexpr float k_perturbation_angle = 0.05f;
+
+// The minimum number of bodies worth handing to another thread for narrowphase.
+constexpr uint32_t k_narrowphase_grain = 32;
 
 Collider::Collider(UniquePtr<Shape> &&shape) : m_shape(vull::move(shape)) {}
 Collider::~Collider() = default;
 
-// NOLINTNEXTLINE
-void PhysicsEngine::sub_step(World &world, float time_step) {
-    // Integrate.
-    for (auto [entity, body, transform] : world.view<RigidBody, Transform>()) {
-        Vec3f acceleration = body.m_force * body.m_inv_mass;
-        body.m_linear_velocity += acceleration * time_step;
-        transform.set_position(transform.position() + body.m_linear_velocity * time_step);
-
-        if (body.m_ignore_rotation) {
+void PhysicsEngine::update_broadphase(World &world, float time_step) {
+    m_sync_stamp++;
+    for (auto [entity, collider, transform] : world.view<Collider, Transform>()) {
+        const auto index = static_cast<uint32_t>(entity_index(entity));
+        m_proxies.ensure_size(index + 1);
+        auto &proxy = m_proxies[index];
+        proxy.sync_stamp = m_sync_stamp;
+        const auto body = entity.try_get<RigidBody>();
+        if (body && body->m_sleeping && proxy.proxy != AabbTree::k_null_proxy) {
+            // Sleeping bodies don't move.
+            continue;
+        }
+        proxy.aabb = collider.shape().world_aabb(transform);
+        if (proxy.proxy == AabbTree::k_null_proxy) {
+            proxy.proxy = m_broadphase.create_proxy(proxy.aabb, index);
             continue;
         }
+        const auto displacement = body ? body->linear_velocity() * time_step : Vec3f(0.0f);
+        m_broadphase.move_proxy(proxy.proxy, proxy.aabb, displacement);
+    }
 
-        auto mat_rotation = vull::to_mat3(transform.rotation());
-        body.m_inertia_tensor_world = mat_rotation * body.m_inertia_tensor * vull::transpose(mat_rotation);
-        body.m_angular_velocity += body.m_inertia_tensor_world * body.m_torque * time_step;
+    // Destroy the proxies of colliders which have gone away.
+    for (auto &proxy : m_proxies) {
+        if (proxy.proxy != AabbTree::k_null_proxy && proxy.sync_stamp != m_sync_stamp) {
+            m_broadphase.destroy_proxy(vull::exchange(proxy.proxy, AabbTree::k_null_proxy));
+        }
+    }
+}
 
-        Quatf delta_rotation = Quatf(body.m_angular_velocity, 0.0f) * transform.rotation() * 0.5f * time_step;
-        transform.set_rotation(transform.rotation() + delta_rotation);
+uint32_t PhysicsEngine::find_island_root(uint32_t index) {
+    while (m_island_parents[index] != index) {
+        // Path halving.
+        m_island_parents[index] = m_island_parents[m_island_parents[index]];
+        index = m_island_parents[index];
     }
+    return index;
+}
 
-    struct ContactInfo {
-        Contact contact;
-        Transform &t1;
-        Transform &t2;
-        RigidBody &b1;
-        Optional<RigidBody &> b2;
-    };
+void PhysicsEngine::wake_island(World &world, uint32_t island) {
+    for (auto index : m_sleeping_islands[island]) {
+        // Members may have since been destroyed, or woken individually and replaced by another body.
+        Entity entity(&world, index);
+        auto body = entity.try_get<RigidBody>();
+        if (body && body->m_island == island) {
+            body->wake();
+        }
+    }
+    m_sleeping_islands[island].clear();
+    m_free_islands.push(island);
+}
 
-    Vector<ContactInfo> contacts;
-    for (auto [e1, b1, c1, t1] : world.view<RigidBody, Collider, Transform>()) {
-        for (auto [e2, c2, t2] : world.view<Collider, Transform>()) {
-            if (e1 == e2) {
-                continue;
-            }
-            if (auto contact = mpr_test(c1.shape(), t1, c2.shape(), t2)) {
-                contacts.push({*contact, t1, t2, b1, e2.try_get<RigidBody>()});
-            }
+void PhysicsEngine::sweep_sleeping_island(World &world) {
+    if (m_sleeping_islands.empty()) {
+        return;
+    }
+
+    // Check one island per substep for members which have since been destroyed or woken individually, which wouldn't
+    // otherwise be noticed, so that islands with no sleeping members left get freed.
+    const auto island = m_island_sweep_index++ % m_sleeping_islands.size();
+    auto &members = m_sleeping_islands[island];
+    if (members.empty()) {
+        return;
+    }
+    for (uint32_t i = 0; i < members.size();) {
+        Entity entity(&world, members[i]);
+        auto body = entity.try_get<RigidBody>();
+        if (body && body->m_island == island) {
+            i++;
+            continue;
         }
+        members[i] = members.last();
+        members.pop();
     }
+    if (members.empty()) {
+        m_free_islands.push(island);
+    }
+}
 
-    for (auto [contact, t1, t2, b1, b2] : contacts) {
-        // Get contact position in both bodies' local spacees.
-        Vec3f r1 = contact.position - t1.position();
-        Vec3f r2 = contact.position - t2.position();
+void PhysicsEngine::update_islands(World &world, Span<const IslandEdge> edges, float time_step) {
+    sweep_sleeping_island(world);
+    for (auto [entity, body] : world.view<RigidBody>()) {
+        if (body.m_sleeping) {
+            continue;
+        }
+        const auto index = static_cast<uint32_t>(entity_index(entity));
+        m_island_parents.ensure_size(index + 1);
+        m_island_sleep_times.ensure_size(index + 1);
+        m_island_parents[index] = index;
 
-        Vec3f relative_velocity = b1.velocity_at_point(r1) - (b2 ? b2->velocity_at_point(r2) : Vec3f());
-        float velocity_projection = vull::dot(relative_velocity, contact.normal);
-        if (velocity_projection > 0.0f) {
-            // Bodies already separating.
+        const bool slow =
+            vull::square_magnitude(body.m_linear_velocity) < k_sleep_linear_velocity * k_sleep_linear_velocity &&
+            vull::square_magnitude(body.m_angular_velocity) < k_sleep_angular_velocity * k_sleep_angular_velocity;
+        body.m_sleep_time = slow ? body.m_sleep_time + time_step : 0.0f;
+        m_island_sleep_times[index] = body.m_sleep_time;
+    }
+
+    // Join bodies in contact into islands, tracking the smallest sleep time of each island at its root.
+    for (const auto &edge : edges) {
+        const auto root1 = find_island_root(edge.index1);
+        const auto root2 = find_island_root(edge.index2);
+        if (root1 != root2) {
+            m_island_parents[root2] = root1;
+            m_island_sleep_times[root1] = vull::min(m_island_sleep_times[root1], m_island_sleep_times[root2]);
+        }
+    }
+
+    // Put islands that have all been slow for long enough to sleep.
+    HashMap<uint32_t, uint32_t> root_islands;
+    for (auto [entity, body] : world.view<RigidBody>()) {
+        if (body.m_sleeping) {
             continue;
         }
+        const auto index = static_cast<uint32_t>(entity_index(entity));
+        const auto root = find_island_root(index);
+        if (m_island_sleep_times[root] < k_time_to_sleep) {
+            continue;
+        }
+
+        uint32_t island;
+        if (auto existing = root_islands.get(root)) {
+            island = *existing;
+        } else if (!m_free_islands.empty()) {
+            island = m_free_islands.take_last();
+            root_islands.set(root, island);
+        } else {
+            island = m_sleeping_islands.size();
+            m_sleeping_islands.emplace();
+            root_islands.set(root, island);
+        }
+        m_sleeping_islands[island].push(index);
+        body.m_island = island;
+        body.m_sleeping = true;
+        body.m_linear_velocity = {};
+        body.m_angular_velocity = {};
+    }
+}
+
+bool PhysicsEngine::update_manifold(ContactManifold &manifold, const Shape &s1, const Transform &t1, const Aabb &aabb1,
+                                    const Shape &s2, const Transform &t2, const Aabb &aabb2) {
+    // Use a specialised test if there is one for this pair of shapes, since they're much cheaper than MPR and give all
+    // of the contact points at once.
+    if (has_collision_test(s1.type(), s2.type())) {
+        CollisionResult result;
+        if (!collide(s1, t1, s2, t2, result)) {
+            return false;
+        }
+        manifold.normal = result.normal;
+        manifold.refresh(t1, t2);
+        for (uint32_t i = 0; i < result.point_count; i++) {
+            manifold.add_point(ContactPoint::from_points(result.points1[i], result.points2[i], result.normal, t1, t2));
+        }
+        return true;
+    }
+
+    auto contact = mpr_test(s1, t1, s2, t2);
+    if (!contact) {
+        return false;
+    }
+    manifold.normal = contact->normal;
+    manifold.refresh(t1, t2);
+    manifold.add_point(ContactPoint::from_contact(*contact, t1, t2));
+    if (manifold.point_count == manifold.points.size()) {
+        return true;
+    }
 
-        // TODO: Configurable.
-        float restitution = 0.1f;
-        float C = vull::max(-restitution * velocity_projection - 0.9f, 0.0f);
+    // MPR only finds a single point, so fill out the manifold quicker by tilting the smaller shape slightly in a few
+    // directions and taking its deepest point along the normal, which finds the corners of a box's face. The tilt axes
+    // are taken diagonally from the shape's own axes so that boxes tip onto a corner rather than an edge. The contact
+    // region is assumed to be roughly planar, so each point is projected onto the deepest plane of both shapes, and
+    // discarded if it falls outside of the other shape's bounds.
+    const auto &normal = manifold.normal;
+    const float plane1 =
+        vull::dot(t1 * s1.furthest_point(vull::rotate(vull::conjugate(t1.rotation()), -normal)), normal);
+    const float plane2 =
+        vull::dot(t2 * s2.furthest_point(vull::rotate(vull::conjugate(t2.rotation()), normal)), normal);
+    const bool tilt_first = aabb1.half_surface_area() <= aabb2.half_surface_area();
+    const auto &shape = tilt_first ? s1 : s2;
+    const auto &transform = tilt_first ? t1 : t2;
+    const auto direction = tilt_first ? -normal : normal;
+    const auto other_aabb = (tilt_first ? aabb2 : aabb1).fattened(ContactManifold::k_breaking_threshold);
 
-        Vec3f w1 = vull::cross(contact.normal, r1);
-        Vec3f w2 = vull::cross(-contact.normal, r2);
-        float effective_mass = b1.m_inv_mass + vull::dot(w1 * b1.m_inertia_tensor_world, w1);
-        if (b2) {
-            effective_mass += b2->m_inv_mass + vull::dot(w2 * b2->m_inertia_tensor_world, w2);
+    auto perpendicular = vull::rotate(transform.rotation(), Vec3f(1.0f, 0.0f, 0.0f));
+    if (vull::abs(vull::dot(perpendicular, normal)) > 0.9f) {
+        perpendicular = vull::rotate(transform.rotation(), Vec3f(0.0f, 0.0f, 1.0f));
+    }
+    perpendicular = vull::normalise(perpendicular - normal * vull::dot(perpendicular, normal));
+    for (uint32_t i = 0; i < k_perturbation_count; i++) {
+        const auto angle = (float(i) + 0.5f) * (2.0f * vull::pi<float> / float(k_perturbation_count));
+        const auto axis = vull::rotate(vull::angle_axis(angle, normal), perpendicular);
+        const auto rotation = vull::angle_axis(k_perturbation_angle, axis) * transform.rotation();
+        const auto position = transform * shape.furthest_point(vull::rotate(vull::conjugate(rotation), direction));
+        const float distance = vull::dot(position, normal);
+        const auto point1 = position + normal * (plane1 - distance);
+        const auto point2 = position + normal * (plane2 - distance);
+        if (other_aabb.contains(Aabb{position, position})) {
+            manifold.add_point(ContactPoint::from_points(point1, point2, normal, t1, t2));
         }
+    }
+    return true;
+}
+
+void PhysicsEngine::narrowphase(World &world, Span<const uint32_t> bodies, NarrowphaseBuffer &buffer) const {
+    for (const auto index : bodies) {
+        Entity e1(&world, index);
+        auto &c1 = e1.get<Collider>();
+        auto &t1 = e1.get<Transform>();
+        const auto &aabb = m_proxies[index].aabb;
+        m_broadphase.query(aabb, [&](uint32_t proxy) {
+            const auto other_index = m_broadphase.user_data(proxy);
+            if (other_index == index || !m_proxies[other_index].aabb.overlaps(aabb)) {
+                return true;
+            }
+            Entity e2(&world, other_index);
+            auto b2 = e2.try_get<RigidBody>();
+            if (b2 && !b2->m_sleeping && other_index < index) {
+                return true;
+            }
+
+            const auto key = (static_cast<uint64_t>(index) << 32u) | other_index;
+            ContactManifold manifold;
+            if (auto existing = m_manifold_indices.get(key)) {
+                manifold = m_manifolds[*existing].manifold;
+            }
+            if (!update_manifold(manifold, c1.shape(), t1, aabb, e2.get<Collider>().shape(), e2.get<Transform>(),
+                                 m_proxies[other_index].aabb)) {
+                return true;
+            }
+
+            buffer.manifolds.push({index, other_index, manifold});
+            if (b2) {
+                buffer.island_edges.push({index, other_index});
+                if (b2->m_sleeping) {
+                    buffer.woken_islands.push(b2->m_island);
+                }
+            }
+            return true;
+        });
+    }
+}
 
-        float impulse_magnitude = (C - velocity_projection + 0.01f) / effective_mass;
-        Vec3f impulse = contact.normal * impulse_magnitude;
-        b1.apply_impulse(impulse, r1);
-        if (b2) {
-            b2->apply_impulse(-impulse, r2);
+// NOLINTNEXTLINE
+void PhysicsEngine::sub_step(World &world, float time_step) {
+    // Only narrowphase test pairs whose bounding boxes overlap. Pairs of awake bodies are tested once, from the body
+    // with the lower entity index. Sleeping bodies are only tested against awake bodies, and are woken up, along with
+    // the rest of their island, if they are touched. Manifolds of pairs which are no longer touching are dropped,
+    // whilst those of sleeping bodies are kept as they are so that the solver can be warm started when the island
+    // wakes.
+    update_broadphase(world, time_step);
+    Vector<uint32_t> awake_bodies;
+    for (auto [entity, body, collider, transform] : world.view<RigidBody, Collider, Transform>()) {
+        if (!body.m_sleeping) {
+            awake_bodies.push(static_cast<uint32_t>(entity_index(entity)));
         }
+    }
 
-        if (contact.penetration <= 0.0f) {
-            // No position correction needed.
-            continue;
+    // The awake bodies are split into contiguous ranges, one per worker thread, with each range writing into its own
+    // buffer. The buffers are then merged in order, so the result is the same as testing every body serially.
+    uint32_t worker_count = 1;
+    if (tasklet::in_tasklet_context()) {
+        worker_count = vull::min(tasklet::Scheduler::current().thread_count(),
+                                 vull::ceil_div(awake_bodies.size(), k_narrowphase_grain));
+        worker_count = vull::max(worker_count, 1u);
+    }
+    Vector<NarrowphaseBuffer> buffers(worker_count);
+    const auto range_size = vull::ceil_div(awake_bodies.size(), worker_count);
+    const auto body_range = [&](uint32_t worker) {
+        const auto begin = vull::min(worker * range_size, awake_bodies.size());
+        const auto end = vull::min(begin + range_size, awake_bodies.size());
+        return awake_bodies.span().subspan(begin, end - begin);
+    };
+    if (worker_count > 1) {
+        tasklet::Latch latch(worker_count - 1);
+        for (uint32_t worker = 1; worker < worker_count; worker++) {
+            tasklet::schedule([this, &world, &buffers, &body_range, &latch, worker] {
+                narrowphase(world, body_range(worker), buffers[worker]);
+                latch.count_down();
+            });
         }
+        narrowphase(world, body_range(0), buffers[0]);
+        latch.wait();
+    } else {
+        narrowphase(world, body_range(0), buffers[0]);
+    }
 
-        Vec3f prv = b1.m_pseudo_linear_velocity + vull::cross(b1.m_pseudo_angular_velocity, r1);
-        if (b2) {
-            prv -= b2->m_pseudo_linear_velocity + vull::cross(b2->m_pseudo_angular_velocity, r2);
+    Vector<PairManifold> manifolds;
+    for (const auto &pair : m_manifolds) {
+        auto body = Entity(&world, pair.index1).try_get<RigidBody>();
+        if (body && body->m_sleeping) {
+            manifolds.push(pair);
         }
+    }
+    const auto first_contact = manifolds.size();
+    Vector<IslandEdge> island_edges;
+    Vector<uint32_t> woken_islands;
+    for (auto &buffer : buffers) {
+        manifolds.extend(buffer.manifolds);
+        island_edges.extend(buffer.island_edges);
+        woken_islands.extend(buffer.woken_islands);
+    }
+    m_manifolds = vull::move(manifolds);
+    m_manifold_indices.clear();
+    for (uint32_t i = 0; i < m_manifolds.size(); i++) {
+        const auto &pair = m_manifolds[i];
+        m_manifold_indices.set((static_cast<uint64_t>(pair.index1) << 32u) | pair.index2, i);
+    }
 
-        float pvp = vull::dot(prv, contact.normal);
-        if (pvp >= contact.penetration) {
-            continue;
+    for (auto island : woken_islands) {
+        if (!m_sleeping_islands[island].empty()) {
+            wake_island(world, island);
         }
+    }
 
-        float pseudo_impulse_magnitude = (contact.penetration - pvp) / effective_mass;
-        Vec3f pseudo_impulse = contact.normal * pseudo_impulse_magnitude;
-        b1.apply_psuedo_impulse(pseudo_impulse, r1);
-        if (b2) {
-            b2->apply_psuedo_impulse(-pseudo_impulse, r2);
+    // Integrate forces. Bodies are independent here, so split them across threads.
+    world.parallel_for<RigidBody, Transform>([time_step](Entity, RigidBody &body, Transform &transform) {
+        if (body.m_sleeping) {
+            return;
+        }
+        Vec3f acceleration = body.m_force * body.m_inv_mass;
+        body.m_linear_velocity += acceleration * time_step;
+        if (body.m_ignore_rotation) {
+            return;
         }
+
+        auto mat_rotation = vull::to_mat3(transform.rotation());
+        body.m_inertia_tensor_world = mat_rotation * body.m_inertia_tensor * vull::transpose(mat_rotation);
+        body.m_angular_velocity += body.m_inertia_tensor_world * body.m_torque * time_step;
+    });
+
+    ContactSolver solver(m_friction, m_restitution);
+    for (uint32_t i = first_contact; i < m_manifolds.size(); i++) {
+        auto &pair = m_manifolds[i];
+        Entity e1(&world, pair.index1);
+        Entity e2(&world, pair.index2);
+        auto b2 = e2.try_get<RigidBody>();
+        solver.add_manifold(pair.manifold, pair.index1, e1.get<RigidBody>(), e1.get<Transform>(),
+                            b2 ? pair.index2 : ContactSolver::k_static_body, b2, e2.get<Transform>(), time_step);
+    }
+    solver.build_batches();
+    solver.warm_start(m_previous_time_step > 0.0f ? time_step / m_previous_time_step : 1.0f);
+    m_previous_time_step = time_step;
+    for (uint32_t i = 0; i < m_solver_iterations; i++) {
+        solver.solve_velocities();
+    }
+    for (uint32_t i = 0; i < m_solver_iterations; i++) {
+        solver.solve_positions();
     }
 
-    for (auto [entity, body, transform] : world.view<RigidBody, Transform>()) {
-        transform.set_position(transform.position() + body.m_pseudo_linear_velocity);
+    // Integrate velocities and pseudo velocities.
+    world.parallel_for<RigidBody, Transform>([time_step](Entity entity, RigidBody &body, Transform &transform) {
+        if (body.m_sleeping) {
+            return;
+        }
+        transform.set_position(entity, transform.position() + body.m_linear_velocity * time_step +
+                                           body.m_pseudo_linear_velocity);
 
-        Quatf delta_rotation = Quatf(body.m_pseudo_angular_velocity, 0.0f) * transform.rotation() * 0.5f;
-        transform.set_rotation(transform.rotation() + delta_rotation);
+        const auto angular_displacement = body.m_angular_velocity * time_step + body.m_pseudo_angular_velocity;
+        Quatf delta_rotation = Quatf(angular_displacement, 0.0f) * transform.rotation() * 0.5f;
 
         // Renormalise rotation to avoid quaternion drift - the magnitude drifting away from 1 as floating point error
         // builds up.
-        transform.set_rotation(vull::normalise(transform.rotation()));
+        transform.set_rotation(entity, vull::normalise(transform.rotation() + delta_rotation));
 
         body.m_pseudo_linear_velocity = {};
         body.m_pseudo_angular_velocity = {};
-    }
+    });
+
+    update_islands(world, island_edges.span(), time_step);
 }
 
 void PhysicsEngine::step(World &world, float dt) {
-    // Apply gravity.
+    // Apply gravity. Sleeping bodies are left alone so that they stay asleep.
     for (auto [entity, body] : world.view<RigidBody>()) {
-        body.apply_central_force(Vec3f(0.0f, -9.81f, 0.0f) / body.m_inv_mass);
+        if (!body.m_sleeping) {
+            body.m_force += Vec3f(0.0f, -9.81f, 0.0f) / body.m_inv_mass;
+        }
     }
 
-    // Perform substeps.
-    for (unsigned i = 0; i < k_max_substeps && dt > 0.0f; i++) {
-        float time_step = vull::min(dt, k_fixed_timestep);
+    // Perform equally sized substeps so that warm starting stays accurate.
+    const auto substep_count = vull::min(static_cast<uint32_t>(vull::ceil(dt / k_fixed_timestep)), k_max_substeps);
+    const float time_step = vull::min(dt / float(substep_count), k_fixed_timestep);
+    for (uint32_t i = 0; i < substep_count; i++) {
         sub_step(world, time_step);
-        dt -= time_step;
     }
 
     // Clear forces.
@@ -1,10 +1,30 @@
 #include <vull/physics/shape.hh>
 
+#include <vull/container/vector.hh>
+#include <vull/maths/common.hh>
 #include <vull/maths/mat.hh>
+#include <vull/maths/quat.hh>
 #include <vull/maths/vec.hh>
+#include <vull/physics/aabb.hh>
+#include <vull/scene/transform.hh>
+#include <vull/support/assert.hh>
+
+#include <stdint.h>
 
 namespace vull {
 
+Aabb Shape::world_aabb(const Transform &transform) const {
+    Aabb aabb;
+    const auto inverse_rotation = vull::conjugate(transform.rotation());
+    for (unsigned i = 0; i < 3; i++) {
+        Vec3f axis;
+        axis[i] = 1.0f;
+        aabb.min[i] = (transform * furthest_point(vull::rotate(inverse_rotation, -axis)))[i];
+        aabb.max[i] = (transform * furthest_point(vull::rotate(inverse_rotation, axis)))[i];
+    }
+    return aabb;
+}
+
 Vec3f BoxShape::furthest_point(const Vec3f &direction) const {
     return m_half_extents * vull::sign(direction);
 }
@@ -18,4 +38,97 @@ Mat3f BoxShape::inertia_tensor(float mass) const {
     }};
 }
 
+Aabb BoxShape::world_aabb(const Transform &transform) const {
+    // The world extents are the sum of the absolute rotated half extents.
+    Vec3f extents;
+    for (unsigned i = 0; i < 3; i++) {
+        Vec3f axis;
+        axis[i] = m_half_extents[i];
+        extents += vull::abs(vull::rotate(transform.rotation(), axis));
+    }
+    return {transform.position() - extents, transform.position() + extents};
+}
+
+Vec3f SphereShape::furthest_point(const Vec3f &direction) const {
+    const float length = vull::magnitude(direction);
+    return length > 0.0f ? direction * (m_radius / length) : Vec3f(0.0f, m_radius, 0.0f);
+}
+
+Mat3f SphereShape::inertia_tensor(float mass) const {
+    const float inertia = 0.4f * mass * m_radius * m_radius;
+    return Mat3f{{
+        Vec3f{inertia, 0.0f, 0.0f},
+        Vec3f{0.0f, inertia, 0.0f},
+        Vec3f{0.0f, 0.0f, inertia},
+    }};
+}
+
+Aabb SphereShape::world_aabb(const Transform &transform) const {
+    return {transform.position() - m_radius, transform.position() + m_radius};
+}
+
+Vec3f CapsuleShape::furthest_point(const Vec3f &direction) const {
+    const float length = vull::magnitude(direction);
+    const float end = direction.y() >= 0.0f ? m_half_height : -m_half_height;
+    return Vec3f(0.0f, end, 0.0f) + (length > 0.0f ? direction * (m_radius / length) : Vec3f(0.0f));
+}
+
+Mat3f CapsuleShape::inertia_tensor(float mass) const {
+    // Split the mass between the cylinder and the two hemispherical caps by volume.
+    const float height = m_half_height * 2.0f;
+    const float r2 = m_radius * m_radius;
+    const float cylinder_volume = vull::pi<float> * r2 * height;
+    const float sphere_volume = 4.0f / 3.0f * vull::pi<float> * r2 * m_radius;
+    const float cylinder_mass = mass * cylinder_volume / (cylinder_volume + sphere_volume);
+    const float sphere_mass = mass - cylinder_mass;
+
+    const float axial = cylinder_mass * r2 * 0.5f + sphere_mass * r2 * 0.4f;
+    const float radial = cylinder_mass * (height * height / 12.0f + r2 * 0.25f) +
+                         sphere_mass * (r2 * 0.4f + height * height * 0.25f + height * m_radius * 0.375f);
+    return Mat3f{{
+        Vec3f{radial, 0.0f, 0.0f},
+        Vec3f{0.0f, axial, 0.0f},
+        Vec3f{0.0f, 0.0f, radial},
+    }};
+}
+
+Aabb CapsuleShape::world_aabb(const Transform &transform) const {
+    Vec3f a;
+    Vec3f b;
+    segment(transform, a, b);
+    return {vull::min(a, b) - m_radius, vull::max(a, b) + m_radius};
+}
+
+void CapsuleShape::segment(const Transform &transform, Vec3f &a, Vec3f &b) const {
+    const auto axis = vull::rotate(transform.rotation(), Vec3f(0.0f, m_half_height, 0.0f));
+    a = transform.position() - axis;
+    b = transform.position() + axis;
+}
+
+Vec3f ConvexHullShape::furthest_point(const Vec3f &direction) const {
+    Vec3f furthest;
+    float furthest_distance = 0.0f;
+    for (uint32_t i = 0; i < m_points.size(); i++) {
+        const float distance = vull::dot(m_points[i], direction);
+        if (i == 0 || distance > furthest_distance) {
+            furthest = m_points[i];
+            furthest_distance = distance;
+        }
+    }
+    return furthest;
+}
+
+Mat3f ConvexHullShape::inertia_tensor(float mass) const {
+    // Only the points are known rather than the faces, so approximate the hull with its bounding box.
+    VULL_ASSERT(!m_points.empty());
+    Vec3f min = m_points.first();
+    Vec3f max = m_points.first();
+    for (const auto &point : m_points) {
+        min = vull::min(min, point);
+        max = vull::max(max, point);
+    }
+    BoxShape box((max - min) * 0.5f);
+    return box.inertia_tensor(mass);
+}
+
 } // namespace vull
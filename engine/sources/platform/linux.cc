@@ -1,3 +1,4 @@
+#include <vull/platform/async_file.hh>
 #include <vull/platform/event.hh>
 #include <vull/platform/file.hh>
 #include <vull/platform/file_stream.hh>
@@ -19,6 +20,7 @@
 #include <vull/support/function.hh>
 #include <vull/support/optional.hh>
 #include <vull/support/result.hh>
+#include <vull/support/shared_ptr.hh>
 #include <vull/support/span.hh>
 #include <vull/support/stream.hh>
 #include <vull/support/string.hh>
@@ -26,6 +28,7 @@
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
 #include <vull/tasklet/fiber.hh>
+#include <vull/tasklet/functions.hh>
 #include <vull/tasklet/future.hh>
 #include <vull/tasklet/io.hh>
 #include <vull/tasklet/scheduler.hh>
@@ -44,6 +47,7 @@
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -55,6 +59,7 @@
 #include <sys/syscall.h>
 #include <sys/timerfd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -80,6 +85,10 @@ File &File::operator=(File &&other) {
     return *this;
 }
 
+File File::duplicate() const {
+    return File(dup(m_fd));
+}
+
 FileStream File::create_stream() const {
     struct stat stat_buf{};
     fstat(m_fd, &stat_buf);
@@ -92,12 +101,32 @@ Result<void, FileError> File::copy_to(const File &target, int64_t &src_offset, i
         return FileError::Unknown;
     }
     const auto size = static_cast<size_t>(stat_buf.st_size);
-    if (copy_file_range(m_fd, &src_offset, target.fd(), &dst_offset, size, 0) < 0) {
-        return FileError::Unknown;
+    return copy_to(target, src_offset, dst_offset, size - vull::min(size, static_cast<size_t>(src_offset)));
+}
+
+Result<void, FileError> File::copy_to(const File &target, int64_t &src_offset, int64_t &dst_offset,
+                                      size_t size) const {
+    // copy_file_range may copy less than asked for. On filesystems which support it, it shares the extents (a reflink)
+    // rather than copying any data.
+    while (size > 0) {
+        const auto copied = copy_file_range(m_fd, &src_offset, target.fd(), &dst_offset, size, 0);
+        if (copied <= 0) {
+            // Either an error or the source file is shorter than expected.
+            return FileError::Unknown;
+        }
+        size -= static_cast<size_t>(copied);
     }
     return {};
 }
 
+Result<uint64_t, FileError> File::size() const {
+    struct stat stat_buf{};
+    if (fstat(m_fd, &stat_buf) < 0) {
+        return FileError::Unknown;
+    }
+    return static_cast<uint64_t>(stat_buf.st_size);
+}
+
 Result<void, FileError> File::link_to(String path) const {
     // linkat with AT_EMPTY_PATH requires a capability, so use procfs instead.
     auto fd_path = vull::format("/proc/self/fd/{}", m_fd);
@@ -108,6 +137,25 @@ Result<void, FileError> File::link_to(String path) const {
     return {};
 }
 
+Result<MappedFile, FileError> File::map_read_only() const {
+    struct stat stat_buf{};
+    if (fstat(m_fd, &stat_buf) < 0) {
+        return FileError::Unknown;
+    }
+
+    // mmap doesn't allow empty mappings.
+    const auto size = static_cast<size_t>(stat_buf.st_size);
+    if (size == 0) {
+        return MappedFile();
+    }
+
+    void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+        return errno == EACCES ? FileError::BadAccess : FileError::Unknown;
+    }
+    return MappedFile::from_raw(static_cast<uint8_t *>(data), size);
+}
+
 Result<void, FileError> File::sync() const {
     if (fsync(m_fd) < 0) {
         return FileError::Unknown;
@@ -115,6 +163,102 @@ Result<void, FileError> File::sync() const {
     return {};
 }
 
+Result<AsyncFile, OpenError> AsyncFile::open(String path, OpenModes modes) {
+    return AsyncFile(VULL_TRY(open_file(vull::move(path), modes)));
+}
+
+AsyncFile::~AsyncFile() {
+    // Outside of a tasklet context there's no IO queue to submit to, and the ring's file table goes away with the
+    // scheduler anyway.
+    if (tasklet::in_tasklet_context()) {
+        unregister_fixed();
+    }
+}
+
+AsyncFile &AsyncFile::operator=(AsyncFile &&other) {
+    AsyncFile moved(vull::move(other));
+    vull::swap(m_file, moved.m_file);
+    vull::swap(m_fixed_index, moved.m_fixed_index);
+    return *this;
+}
+
+bool AsyncFile::register_fixed() {
+    VULL_ASSERT(!is_fixed());
+    const auto result = tasklet::submit_io_request<tasklet::RegisterFileRequest>(m_file.fd()).await();
+    if (result < 0) {
+        return false;
+    }
+    m_fixed_index = result;
+    return true;
+}
+
+void AsyncFile::unregister_fixed() {
+    if (is_fixed()) {
+        // The request keeps itself alive until completion, so there's no need to wait.
+        const auto index = static_cast<uint32_t>(vull::exchange(m_fixed_index, -1));
+        tasklet::submit_io_request<tasklet::UnregisterFileRequest>(index);
+    }
+}
+
+tasklet::Future<tasklet::IoResult> AsyncFile::read_fixed(const tasklet::FixedBuffer &buffer, uint32_t size,
+                                                         uint64_t offset) const {
+    auto request = make_read_fixed(buffer, size, offset);
+    tasklet::submit_io_request(request);
+    return tasklet::Future<tasklet::IoResult>(vull::move(request));
+}
+
+SharedPtr<tasklet::ReadFixedRequest> AsyncFile::make_read_fixed(const tasklet::FixedBuffer &buffer, uint32_t size,
+                                                                uint64_t offset) const {
+    const int file = is_fixed() ? m_fixed_index : m_file.fd();
+    return vull::adopt_shared(new tasklet::ReadFixedRequest(file, is_fixed(), buffer, size, offset));
+}
+
+tasklet::Future<tasklet::IoResult> AsyncFile::read(Span<void> buffer, uint64_t offset) const {
+    return tasklet::submit_io_request<tasklet::ReadFileRequest>(m_file.fd(), buffer, offset);
+}
+
+tasklet::Future<tasklet::IoResult> AsyncFile::read_vectored(Span<const Span<void>> buffers, uint64_t offset) const {
+    return tasklet::submit_io_request<tasklet::ReadFileRequest>(m_file.fd(), buffers, offset);
+}
+
+tasklet::Future<tasklet::IoResult> AsyncFile::write(Span<const void> data, uint64_t offset) const {
+    return tasklet::submit_io_request<tasklet::WriteFileRequest>(m_file.fd(), data, offset);
+}
+
+tasklet::Future<tasklet::IoResult> AsyncFile::write_vectored(Span<const Span<const void>> buffers,
+                                                             uint64_t offset) const {
+    return tasklet::submit_io_request<tasklet::WriteFileRequest>(m_file.fd(), buffers, offset);
+}
+
+Result<uint64_t, FileError> AsyncFile::size() const {
+    return m_file.size();
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr) {
+        munmap(m_data, m_size);
+    }
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+    MappedFile moved(vull::move(other));
+    vull::swap(m_data, moved.m_data);
+    vull::swap(m_size, moved.m_size);
+    return *this;
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const {
+    if (offset >= m_size) {
+        return;
+    }
+
+    // madvise requires a page aligned address.
+    const auto page_size = static_cast<size_t>(getpagesize());
+    const auto aligned_offset = offset & ~(page_size - 1);
+    size = vull::min(size, m_size - offset) + (offset - aligned_offset);
+    madvise(m_data + aligned_offset, size, MADV_WILLNEED);
+}
+
 String dir_path(String path) {
     return dirname(path.data());
 }
@@ -538,6 +682,18 @@ uint8_t *allocate_fiber_memory(size_t size) {
     return end;
 }
 
+uint8_t *allocate_io_buffer_memory(size_t size) {
+    void *result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (result == MAP_FAILED) {
+        return nullptr;
+    }
+    return static_cast<uint8_t *>(result);
+}
+
+void free_io_buffer_memory(uint8_t *memory, size_t size) {
+    munmap(memory, size);
+}
+
 static bool probe_flag(uint32_t flag) {
     io_uring ring;
     if (io_uring_queue_init(1, &ring, flag) == 0) {
@@ -547,7 +703,16 @@ static bool probe_flag(uint32_t flag) {
     return false;
 }
 
-static void queue_io_request(io_uring *ring, tasklet::IoRequest *request) {
+// Vectored file requests pass their IoVector arrays straight through as iovec arrays, which is only valid if the two
+// structs are laid out identically.
+static_assert(sizeof(tasklet::IoVector) == sizeof(iovec));
+static_assert(alignof(tasklet::IoVector) == alignof(iovec));
+static_assert(offsetof(tasklet::IoVector, data) == offsetof(iovec, iov_base));
+static_assert(offsetof(tasklet::IoVector, size) == offsetof(iovec, iov_len));
+static_assert(vull::is_same<decltype(tasklet::IoVector::data), decltype(iovec::iov_base)>);
+static_assert(vull::is_same<decltype(tasklet::IoVector::size), decltype(iovec::iov_len)>);
+
+static void queue_io_request(io_uring *ring, tasklet::IoRequest *request, bool has_fixed_buffers) {
     auto *sqe = io_uring_get_sqe(ring);
     io_uring_sqe_set_data(sqe, request);
     switch (request->kind()) {
@@ -587,10 +752,66 @@ static void queue_io_request(io_uring *ring, tasklet::IoRequest *request) {
         }
         break;
     }
+    case ReadFile: {
+        auto *read_file = static_cast<tasklet::ReadFileRequest *>(request);
+        if (read_file->is_vectored()) {
+            auto vectors = read_file->vectors();
+            io_uring_prep_readv(sqe, read_file->fd(), reinterpret_cast<const iovec *>(vectors.data()),
+                                static_cast<uint32_t>(vectors.size()), read_file->offset());
+        } else {
+            auto buffer = read_file->buffer();
+            VULL_ASSERT(buffer.size() <= UINT32_MAX);
+            io_uring_prep_read(sqe, read_file->fd(), buffer.data(), static_cast<uint32_t>(buffer.size()),
+                               read_file->offset());
+        }
+        break;
+    }
+    case WriteFile: {
+        auto *write_file = static_cast<tasklet::WriteFileRequest *>(request);
+        if (write_file->is_vectored()) {
+            auto vectors = write_file->vectors();
+            io_uring_prep_writev(sqe, write_file->fd(), reinterpret_cast<const iovec *>(vectors.data()),
+                                 static_cast<uint32_t>(vectors.size()), write_file->offset());
+        } else {
+            auto data = write_file->data();
+            VULL_ASSERT(data.size() <= UINT32_MAX);
+            io_uring_prep_write(sqe, write_file->fd(), data.data(), static_cast<uint32_t>(data.size()),
+                                write_file->offset());
+        }
+        break;
+    }
+    case ReadFixed: {
+        auto *read_fixed = static_cast<tasklet::ReadFixedRequest *>(request);
+        const auto &buffer = read_fixed->buffer();
+        VULL_ASSERT(read_fixed->size() <= buffer.size());
+        if (has_fixed_buffers) {
+            io_uring_prep_read_fixed(sqe, read_fixed->file(), buffer.data(), read_fixed->size(), read_fixed->offset(),
+                                     static_cast<int>(buffer.index()));
+        } else {
+            // Buffer registration failed, fall back to a regular read.
+            io_uring_prep_read(sqe, read_fixed->file(), buffer.data(), read_fixed->size(), read_fixed->offset());
+        }
+        if (read_fixed->fixed_file()) {
+            io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        }
+        break;
+    }
+    case RegisterFile: {
+        auto *register_file = static_cast<tasklet::RegisterFileRequest *>(request);
+        io_uring_prep_files_update(sqe, &register_file->fd(), 1, static_cast<int>(IORING_FILE_INDEX_ALLOC));
+        break;
+    }
+    case UnregisterFile: {
+        auto *unregister_file = static_cast<tasklet::UnregisterFileRequest *>(request);
+        io_uring_prep_files_update(sqe, &unregister_file->fd(), 1, static_cast<int>(unregister_file->index()));
+        break;
+    }
     }
 }
 
 void spawn_tasklet_io_dispatcher(tasklet::IoQueue &queue) {
+    const auto &config = queue.config;
+
     // Build ring flags.
     // TODO: Use IORING_SETUP_TASKRUN_FLAG?
     uint32_t ring_flags = 0;
@@ -607,7 +828,23 @@ void spawn_tasklet_io_dispatcher(tasklet::IoQueue &queue) {
     }
 
     io_uring ring;
-    if (int rc = io_uring_queue_init(256, &ring, ring_flags); rc < 0) {
+    io_uring_params params{};
+    int rc = -1;
+    if (config.sqpoll) {
+        // Task running flags don't apply with SQPOLL since completions are run by the kernel thread.
+        params.flags = (ring_flags & ~IORING_SETUP_COOP_TASKRUN) | IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = config.sqpoll_idle_ms;
+        rc = io_uring_queue_init_params(config.ring_size, &ring, &params);
+        if (rc < 0) {
+            vull::warn("[platform] Failed to create io_uring with SQPOLL: {}", strerror(-rc));
+        }
+    }
+    if (rc < 0) {
+        params = {};
+        params.flags = ring_flags;
+        rc = io_uring_queue_init_params(config.ring_size, &ring, &params);
+    }
+    if (rc < 0) {
         vull::error("[platform] Failed to create io_uring: {}", strerror(-rc));
         vull::close_log();
         _Exit(1);
@@ -621,12 +858,41 @@ void spawn_tasklet_io_dispatcher(tasklet::IoQueue &queue) {
         vull::warn("[platform] IORING_FEAT_FAST_POLL is not supported");
     }
 
+    // Reserve a sparse file table which RegisterFileRequests allocate slots from.
+    if (config.fixed_file_count != 0) {
+        rc = io_uring_register_files_sparse(&ring, config.fixed_file_count);
+        if (rc < 0) {
+            vull::warn("[platform] Failed to register file table: {}", strerror(-rc));
+        }
+    }
+
+    // Register the fixed buffer pool.
+    bool has_fixed_buffers = false;
+    if (config.fixed_buffer_count != 0) {
+        Vector<iovec> iovecs;
+        iovecs.ensure_capacity(config.fixed_buffer_count);
+        for (uint32_t i = 0; i < config.fixed_buffer_count; i++) {
+            iovecs.push({
+                .iov_base = queue.fixed_buffer_memory + static_cast<size_t>(i) * config.fixed_buffer_size,
+                .iov_len = config.fixed_buffer_size,
+            });
+        }
+        rc = io_uring_register_buffers(&ring, iovecs.data(), iovecs.size());
+        if (rc < 0) {
+            vull::warn("[platform] Failed to register fixed buffers: {}", strerror(-rc));
+        } else {
+            has_fixed_buffers = true;
+        }
+    }
+    vull::debug("[platform] Created io_uring with {} entries{}", params.sq_entries,
+                (params.flags & IORING_SETUP_SQPOLL) != 0 ? " (SQPOLL)" : "");
+
     // Add the two events to the ring.
     // TODO: Would a multishot read be better?
     tasklet::PollEventRequest poll_quit_event(queue.quit_event, false);
     tasklet::PollEventRequest poll_submit_event(queue.submit_event, true);
-    queue_io_request(&ring, &poll_quit_event);
-    queue_io_request(&ring, &poll_submit_event);
+    queue_io_request(&ring, &poll_quit_event, has_fixed_buffers);
+    queue_io_request(&ring, &poll_submit_event, has_fixed_buffers);
 
     uint32_t pending_completion_count = 0;
     for (bool running = true; running;) {
@@ -646,7 +912,7 @@ void spawn_tasklet_io_dispatcher(tasklet::IoQueue &queue) {
                 // Requeue the event poll if the multishot was lost. This probably never happens.
                 queue.submit_event.reset();
                 if ((cqe->flags & IORING_CQE_F_MORE) == 0) {
-                    queue_io_request(&ring, &poll_submit_event);
+                    queue_io_request(&ring, &poll_submit_event, has_fixed_buffers);
                 }
             } else {
                 // Close fence syncfd.
@@ -654,8 +920,14 @@ void spawn_tasklet_io_dispatcher(tasklet::IoQueue &queue) {
                     close(static_cast<tasklet::WaitVkFenceRequest *>(request)->fd());
                 }
 
+                // Return the allocated slot rather than the number of files updated.
+                auto result = cqe->res;
+                if (request->kind() == tasklet::IoRequestKind::RegisterFile && result >= 0) {
+                    result = static_cast<tasklet::RegisterFileRequest *>(request)->fd();
+                }
+
                 // Resume the suspended tasklet.
-                request->fulfill(cqe->res);
+                request->fulfill(result);
                 request->sub_ref();
                 pending_completion_count--;
             }
@@ -667,7 +939,7 @@ void spawn_tasklet_io_dispatcher(tasklet::IoQueue &queue) {
         const auto pending_count = queue.pending.exchange(0, vull::memory_order_relaxed);
         const auto to_queue_count = vull::min(pending_count, io_uring_sq_space_left(&ring));
         for (uint32_t i = 0; i < to_queue_count; i++) {
-            queue_io_request(&ring, queue.dequeue(platform::Thread::yield));
+            queue_io_request(&ring, queue.dequeue(platform::Thread::yield), has_fixed_buffers);
         }
 
         // Resubmit the event if the amount we submitted was truncated.
@@ -3,12 +3,14 @@
 #include <vull/core/bounding_box.hh>
 #include <vull/core/bounding_sphere.hh>
 #include <vull/core/log.hh>
-#include <vull/ecs/entity_id.hh>
 #include <vull/ecs/world.hh>
 #include <vull/graphics/material.hh>
 #include <vull/graphics/mesh.hh>
-#include <vull/maths/mat.hh>
+#include <vull/maths/vec.hh>
 #include <vull/scene/transform.hh>
+#include <vull/scene/transform_hierarchy.hh>
+#include <vull/scene/world_streamer.hh>
+#include <vull/scene/world_transform.hh>
 #include <vull/support/result.hh>
 #include <vull/support/string_view.hh>
 #include <vull/support/unique_ptr.hh>
@@ -18,30 +20,39 @@
 
 namespace vull {
 
-Mat4f Scene::get_transform_matrix(EntityId entity) {
-    const auto &transform = m_world.get_component<Transform>(entity);
-    if (transform.parent() == ~vull::EntityId(0)) {
-        // Root node.
-        return transform.matrix();
-    }
-    const auto parent_matrix = get_transform_matrix(transform.parent());
-    return parent_matrix * transform.matrix();
+void Scene::register_components(World &world) {
+    // Note that the order currently matters.
+    world.register_component<Transform>();
+    world.register_component<Mesh>();
+    world.register_component<Material>();
+    world.register_component<BoundingBox>();
+    world.register_component<BoundingSphere>();
+    world.register_component<WorldTransform>();
 }
 
 void Scene::load(StringView scene_name) {
-    // Register default components. Note that the order currently matters.
-    m_world.register_component<Transform>();
-    m_world.register_component<Mesh>();
-    m_world.register_component<Material>();
-    m_world.register_component<BoundingBox>();
-    m_world.register_component<BoundingSphere>();
+    register_components(m_world);
 
     // Load world.
     if (auto world_entry = vpak::open(scene_name)) {
         VULL_EXPECT(m_world.deserialise(*world_entry));
+    } else if (auto streamer = WorldStreamer::open(scene_name, &Scene::register_components); !streamer.is_error()) {
+        vull::info("[scene] Streaming {} cells of {}", streamer.value()->cell_count(), scene_name);
+        m_streamer = vull::move(streamer.value());
     } else {
         vull::error("[scene] No scene named {}", scene_name);
     }
+    update_transforms();
+}
+
+void Scene::update_streaming(const Vec3f &position) {
+    if (m_streamer) {
+        m_streamer->update(m_world, position);
+    }
+}
+
+void Scene::update_transforms() {
+    m_transform_hierarchy.update(m_world);
 }
 
 } // namespace vull
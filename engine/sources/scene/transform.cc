@@ -1,8 +1,10 @@
 #include <vull/scene/transform.hh>
 
+#include <vull/ecs/entity.hh>
 #include <vull/maths/mat.hh>
 #include <vull/maths/quat.hh>
 #include <vull/maths/vec.hh>
+#include <vull/support/assert.hh>
 
 namespace vull {
 
@@ -28,4 +30,22 @@ Mat4f Transform::matrix() const {
     return ret;
 }
 
+void Transform::set_position(Entity entity, const Vec3f &position) {
+    VULL_ASSERT(&entity.get<Transform>() == this);
+    m_position = position;
+    entity.mark_changed<Transform>();
+}
+
+void Transform::set_rotation(Entity entity, const Quatf &rotation) {
+    VULL_ASSERT(&entity.get<Transform>() == this);
+    m_rotation = rotation;
+    entity.mark_changed<Transform>();
+}
+
+void Transform::set_scale(Entity entity, const Vec3f &scale) {
+    VULL_ASSERT(&entity.get<Transform>() == this);
+    m_scale = scale;
+    entity.mark_changed<Transform>();
+}
+
 } // namespace vull
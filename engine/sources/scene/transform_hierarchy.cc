@@ -0,0 +1,146 @@
+#include <vull/scene/transform_hierarchy.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/ecs/world.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/mat.hh>
+#include <vull/scene/transform.hh>
+#include <vull/scene/world_transform.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/latch.hh>
+
+#include <stdint.h>
+
+namespace vull {
+
+bool TransformHierarchy::needs_rebuild(World &world) const {
+    // Destroyed entities lose both components, whilst new entities won't have a WorldTransform yet.
+    const auto transform_count = world.component_count<Transform>();
+    if (m_needs_rebuild || m_nodes.size() != transform_count ||
+        world.component_count<WorldTransform>() != transform_count) {
+        return true;
+    }
+
+    // The counts can still match if one transform was removed and another added since the last update, so look for
+    // any added since then. If none were, the set of transforms can only have shrunk, which the count would show.
+    auto added = world.view<Added<Transform>>(m_since_tick);
+    return added.begin() != added.end();
+}
+
+void TransformHierarchy::rebuild(World &world, uint32_t grain_size) {
+    m_nodes.clear();
+    m_changed.clear();
+    m_batches.clear();
+    m_needs_rebuild = false;
+
+    // Drop any stale world transforms.
+    Vector<EntityId> stale_entities;
+    for (auto [entity, world_transform] : world.view<WorldTransform>()) {
+        if (!entity.has<Transform>()) {
+            stale_entities.push(entity);
+        }
+    }
+    for (EntityId entity : stale_entities) {
+        world.remove_component<WorldTransform>(entity);
+    }
+
+    // Build intrusive child lists, indexed by entity index.
+    constexpr uint32_t k_none = ~0u;
+    Vector<EntityId> roots;
+    Vector<uint32_t> first_child;
+    Vector<uint32_t> next_sibling;
+    for (auto [entity, transform] : world.view<Transform>()) {
+        const auto index = entity_index(entity);
+        first_child.ensure_size(index + 1, k_none);
+        next_sibling.ensure_size(index + 1, k_none);
+        const auto parent = transform.parent();
+        if (parent == ~EntityId(0) || !world.has_component<Transform>(parent)) {
+            roots.push(index);
+            continue;
+        }
+        const auto parent_index = entity_index(parent);
+        first_child.ensure_size(parent_index + 1, k_none);
+        next_sibling.ensure_size(parent_index + 1, k_none);
+        next_sibling[index] = vull::exchange(first_child[parent_index], index);
+    }
+
+    // Lay out each tree depth first so that parents come before their children, and group whole trees into batches.
+    m_nodes.ensure_capacity(world.component_count<Transform>());
+    Vector<Node> stack;
+    uint32_t batch_begin = 0;
+    for (EntityId root : roots) {
+        stack.push({root, k_root_slot});
+        while (!stack.empty()) {
+            const auto node = stack.take_last();
+            const auto slot = m_nodes.size();
+            m_nodes.push(node);
+            for (auto child = first_child[node.entity]; child != k_none; child = next_sibling[child]) {
+                stack.push({child, slot});
+            }
+        }
+        if (m_nodes.size() - batch_begin >= grain_size) {
+            m_batches.push({batch_begin, m_nodes.size()});
+            batch_begin = m_nodes.size();
+        }
+    }
+    if (batch_begin != m_nodes.size()) {
+        m_batches.push({batch_begin, m_nodes.size()});
+    }
+    m_changed.ensure_size(m_nodes.size());
+
+    for (const auto &node : m_nodes) {
+        if (!world.has_component<WorldTransform>(node.entity)) {
+            world.add_component<WorldTransform>(node.entity, Mat4f(1.0f));
+        }
+    }
+}
+
+void TransformHierarchy::update_range(World &world, uint32_t begin, uint32_t end, bool force) {
+    for (uint32_t slot = begin; slot < end; slot++) {
+        const auto &node = m_nodes[slot];
+        const bool is_root = node.parent_slot == k_root_slot;
+        const bool changed = force || world.component_ticks<Transform>(node.entity).changed > m_since_tick ||
+                             (!is_root && m_changed[node.parent_slot] != 0);
+        m_changed[slot] = changed ? 1 : 0;
+        if (!changed) {
+            continue;
+        }
+
+        auto matrix = world.get_component<Transform>(node.entity).matrix();
+        if (!is_root) {
+            matrix = world.get_component<WorldTransform>(m_nodes[node.parent_slot].entity).matrix() * matrix;
+        }
+        world.get_component<WorldTransform>(node.entity).set_matrix(matrix);
+        world.mark_changed<WorldTransform>(node.entity);
+    }
+}
+
+void TransformHierarchy::update(World &world, uint32_t grain_size) {
+    const bool force = needs_rebuild(world);
+    if (force) {
+        rebuild(world, vull::max(grain_size, 1u));
+    }
+
+    if (m_batches.size() <= 1 || !tasklet::in_tasklet_context()) {
+        update_range(world, 0, m_nodes.size(), force);
+    } else {
+        // Batches never split a tree, so each can be walked independently. Run the first on the calling tasklet.
+        tasklet::Latch latch(m_batches.size() - 1);
+        for (uint32_t i = 1; i < m_batches.size(); i++) {
+            const auto batch = m_batches[i];
+            tasklet::schedule([this, &world, &latch, batch, force] {
+                update_range(world, batch.begin, batch.end, force);
+                latch.count_down();
+            });
+        }
+        update_range(world, m_batches.first().begin, m_batches.first().end, force);
+        latch.wait();
+    }
+
+    // Transforms marked later on in the current tick are picked up by the next update as well.
+    m_since_tick = world.change_tick() - 1;
+}
+
+} // namespace vull
@@ -0,0 +1,220 @@
+#include <vull/scene/world_streamer.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/core/log.hh>
+#include <vull/core/tracing.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/ecs/world.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/vec.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/function.hh>
+#include <vull/support/result.hh>
+#include <vull/support/stream.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/vpak/file_system.hh>
+#include <vull/vpak/stream.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vull {
+namespace {
+
+Result<UniquePtr<World>, StreamError, WorldError> load_cell(StringView entry_name,
+                                                            const Function<void(World &)> &register_components) {
+    tracing::ScopedTrace trace("Load World Cell");
+    trace.add_text(entry_name);
+    auto stream = vpak::open(entry_name);
+    if (!stream) {
+        return WorldError::MissingEntry;
+    }
+    auto world = vull::make_unique<World>();
+    register_components(*world);
+    VULL_TRY(world->deserialise(*stream));
+    return vull::move(world);
+}
+
+} // namespace
+
+Result<WorldCellManifest, StreamError, WorldError> WorldCellManifest::load(StringView scene_name) {
+    auto stream = vpak::open(manifest_name(scene_name));
+    if (!stream) {
+        return WorldError::MissingEntry;
+    }
+    WorldCellManifest manifest;
+    manifest.cell_size = vull::bit_cast<float>(VULL_TRY(stream->read_le<uint32_t>()));
+    const auto cell_count = VULL_TRY(stream->read_varint<uint32_t>());
+    manifest.cells.ensure_capacity(cell_count);
+    for (uint32_t i = 0; i < cell_count; i++) {
+        const auto x = static_cast<int32_t>(VULL_TRY(stream->read_le<uint32_t>()));
+        const auto z = static_cast<int32_t>(VULL_TRY(stream->read_le<uint32_t>()));
+        manifest.cells.push(Vec2i(x, z));
+    }
+    return manifest;
+}
+
+String WorldCellManifest::manifest_name(StringView scene_name) {
+    return vull::format("{}/cells", scene_name);
+}
+
+String WorldCellManifest::cell_name(StringView scene_name, Vec2i cell) {
+    // Coordinates are written as their unsigned bit patterns.
+    return vull::format("{}/cells/{}.{}", scene_name, static_cast<uint32_t>(cell.x()),
+                        static_cast<uint32_t>(cell.y()));
+}
+
+Result<UniquePtr<WorldStreamer>, StreamError, WorldError>
+WorldStreamer::open(StringView scene_name, Function<void(World &)> &&register_components) {
+    const auto manifest = VULL_TRY(WorldCellManifest::load(scene_name));
+    return vull::make_unique<WorldStreamer>(manifest, scene_name, vull::move(register_components));
+}
+
+WorldStreamer::WorldStreamer(const WorldCellManifest &manifest, StringView scene_name,
+                             Function<void(World &)> &&register_components)
+    : m_register_components(vull::move(register_components)), m_cell_size(manifest.cell_size),
+      m_load_radius(manifest.cell_size * 2.0f), m_unload_radius(manifest.cell_size * 3.0f) {
+    m_cells.ensure_capacity(manifest.cells.size());
+    for (const auto coord : manifest.cells) {
+        auto entry_name = WorldCellManifest::cell_name(scene_name, coord);
+        const auto entry = vpak::stat(entry_name);
+        if (!entry) {
+            vull::warn("[scene] Missing world cell {}", entry_name);
+            continue;
+        }
+        m_cells.push({
+            .coord = coord,
+            .entry_name = vull::move(entry_name),
+            .cost = entry->size,
+        });
+    }
+}
+
+WorldStreamer::~WorldStreamer() {
+    // Loads reference the streamer, and awaiting them here could block a thread outside of a tasklet context.
+    for ([[maybe_unused]] const auto &cell : m_cells) {
+        VULL_ASSERT(cell.state != CellState::Loading, "WorldStreamer destroyed with loads in flight");
+    }
+}
+
+float WorldStreamer::distance_to(const Cell &cell, Vec3f position) const {
+    const auto centre = (Vec2f(cell.coord) + 0.5f) * m_cell_size;
+    return vull::distance(centre, Vec2f(position.x(), position.z()));
+}
+
+void WorldStreamer::start_load(World &world, Cell &cell, Vec3f position) {
+    cell.state = CellState::Loading;
+    m_resident_bytes += cell.cost;
+    if (!tasklet::in_tasklet_context()) {
+        finish_load(world, cell, load_cell(cell.entry_name, m_register_components), position);
+        return;
+    }
+    cell.future = tasklet::schedule([this, &cell] {
+        return load_cell(cell.entry_name, m_register_components);
+    });
+}
+
+void WorldStreamer::finish_load(World &world, Cell &cell, LoadResult &&result, Vec3f position) {
+    cell.future = {};
+    if (result.is_error()) {
+        vull::error("[scene] Failed to load world cell {}", cell.entry_name);
+        cell.state = CellState::Unloaded;
+        m_resident_bytes -= cell.cost;
+        return;
+    }
+
+    // The cell may have gone out of range whilst loading.
+    if (distance_to(cell, position) > m_unload_radius) {
+        cell.state = CellState::Unloaded;
+        m_resident_bytes -= cell.cost;
+        return;
+    }
+
+    tracing::ScopedTrace trace("Merge World Cell");
+    cell.entities = world.merge(vull::move(*result.value()));
+    cell.state = CellState::Loaded;
+}
+
+void WorldStreamer::unload(World &world, Cell &cell) {
+    tracing::ScopedTrace trace("Unload World Cell");
+    for (const auto id : cell.entities) {
+        // Entities may have already been destroyed by something else.
+        if (world.valid(id)) {
+            world.destroy_entity(id);
+        }
+    }
+    cell.entities.clear();
+    cell.state = CellState::Unloaded;
+    m_resident_bytes -= cell.cost;
+}
+
+void WorldStreamer::update(World &world, Vec3f position) {
+    tracing::ScopedTrace trace("Stream World Cells");
+    Vector<Cell *> candidates;
+    for (auto &cell : m_cells) {
+        if (cell.state == CellState::Loading && cell.future.is_complete()) {
+            finish_load(world, cell, cell.future.await(), position);
+        }
+
+        const auto distance = distance_to(cell, position);
+        if (cell.state == CellState::Loaded && distance > m_unload_radius) {
+            unload(world, cell);
+        }
+        if (cell.state == CellState::Unloaded && distance <= m_load_radius) {
+            candidates.push(&cell);
+        }
+    }
+
+    // Load the nearest cells first.
+    vull::sort(candidates, [&](const Cell *lhs, const Cell *rhs) {
+        return distance_to(*lhs, position) > distance_to(*rhs, position);
+    });
+    for (auto *cell : candidates) {
+        if (cell->cost > m_cell_budget) {
+            if (!vull::exchange(cell->over_budget_warned, true)) {
+                vull::warn("[scene] World cell {} is over the cell budget ({} > {} bytes)", cell->entry_name,
+                           cell->cost, m_cell_budget);
+            }
+            continue;
+        }
+        if (m_resident_bytes + cell->cost <= m_memory_budget) {
+            start_load(world, *cell, position);
+        }
+    }
+}
+
+void WorldStreamer::flush(World &world, Vec3f position) {
+    for (auto &cell : m_cells) {
+        if (cell.state == CellState::Loading) {
+            finish_load(world, cell, cell.future.await(), position);
+        }
+    }
+}
+
+void WorldStreamer::wait_idle() {
+    for (auto &cell : m_cells) {
+        if (cell.state == CellState::Loading) {
+            VULL_IGNORE(cell.future.await());
+            cell.future = {};
+            cell.state = CellState::Unloaded;
+            m_resident_bytes -= cell.cost;
+        }
+    }
+}
+
+uint32_t WorldStreamer::loaded_cell_count() const {
+    uint32_t count = 0;
+    for (const auto &cell : m_cells) {
+        count += cell.state == CellState::Loaded ? 1 : 0;
+    }
+    return count;
+}
+
+} // namespace vull
@@ -3,17 +3,20 @@
 #include <vull/container/array.hh>
 #include <vull/container/mpmc_queue.hh>
 #include <vull/container/vector.hh>
+#include <vull/container/work_stealing_queue.hh>
 #include <vull/core/log.hh>
 #include <vull/core/tracing.hh>
 #include <vull/maths/common.hh>
 #include <vull/platform/event.hh>
-#include <vull/platform/semaphore.hh>
+#include <vull/platform/platform.hh>
 #include <vull/platform/tasklet.hh>
 #include <vull/platform/thread.hh>
 #include <vull/support/assert.hh>
 #include <vull/support/atomic.hh>
+#include <vull/support/optional.hh>
 #include <vull/support/result.hh>
 #include <vull/support/shared_ptr.hh>
+#include <vull/support/span.hh>
 #include <vull/support/string_builder.hh>
 #include <vull/support/string_view.hh>
 #include <vull/support/unique_ptr.hh>
@@ -23,12 +26,14 @@
 #include <vull/tasklet/io.hh>
 #include <vull/tasklet/tasklet.hh>
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace vull::tasklet {
 
 class FiberQueue : public MpmcQueue<Fiber *, 9> {};
 class TaskletQueue : public MpmcQueue<Tasklet *, 11> {};
+class WorkerQueue : public WorkStealingQueue<Tasklet *, 10> {};
 
 namespace {
 
@@ -37,17 +42,22 @@ constexpr Array k_priority_weights{
     1u,
 };
 
+// Number of times an idle worker polls for new work before parking itself.
+constexpr uint32_t k_idle_spin_count = 128;
+
 // Shared between all worker threads of the same scheduler.
 VULL_GLOBAL(thread_local FiberQueue *s_fiber_queue = nullptr);
 VULL_GLOBAL(thread_local TaskletQueue *s_tasklet_queue = nullptr);
 VULL_GLOBAL(thread_local Scheduler *s_scheduler = nullptr);
-VULL_GLOBAL(thread_local platform::Semaphore *s_work_available = nullptr);
 VULL_GLOBAL(thread_local Atomic<uint32_t> *s_ready_fiber_count = nullptr);
 VULL_GLOBAL(thread_local Atomic<uint32_t> *s_ready_tasklet_count = nullptr);
+VULL_GLOBAL(thread_local const Vector<UniquePtr<WorkerQueue>> *s_worker_queues = nullptr);
 
 // Per worker thread.
 VULL_GLOBAL(thread_local Fiber *s_helper_fiber = nullptr);
 VULL_GLOBAL(thread_local Fiber *s_cleanup_fiber = nullptr);
+VULL_GLOBAL(thread_local WorkerQueue *s_worker_queue = nullptr);
+VULL_GLOBAL(thread_local uint32_t s_steal_seed = 0);
 
 Fiber *pick_ready_fiber() {
     uint32_t count = s_ready_fiber_count->load(vull::memory_order_relaxed);
@@ -63,7 +73,7 @@ Fiber *pick_ready_fiber() {
     }
 }
 
-Tasklet *pick_ready_tasklet() {
+Tasklet *pick_shared_tasklet() {
     uint32_t count = s_ready_tasklet_count->load(vull::memory_order_relaxed);
     while (true) {
         if (count == 0) {
@@ -75,17 +85,65 @@ Tasklet *pick_ready_tasklet() {
     }
 }
 
+Tasklet *steal_tasklet() {
+    const auto &queues = *s_worker_queues;
+    const auto queue_count = queues.size();
+
+    // Start at a random victim to avoid all thieves converging on the same queue. A steal can fail when racing against
+    // another thief, but in that case the victim still appears non-empty and so we won't park.
+    s_steal_seed ^= s_steal_seed << 13;
+    s_steal_seed ^= s_steal_seed >> 17;
+    s_steal_seed ^= s_steal_seed << 5;
+    const auto start_index = s_steal_seed % queue_count;
+    for (uint32_t i = 0; i < queue_count; i++) {
+        auto &victim = *queues[(start_index + i) % queue_count];
+        if (&victim == s_worker_queue || victim.empty()) {
+            continue;
+        }
+        if (auto *tasklet = victim.steal()) {
+            return tasklet;
+        }
+    }
+    return nullptr;
+}
+
+Tasklet *pick_ready_tasklet() {
+    // Only worker threads of a work-stealing scheduler have a local queue.
+    if (s_worker_queue == nullptr) {
+        return pick_shared_tasklet();
+    }
+
+    // Prefer the most recently spawned local tasklet since its data is most likely still in cache, then anything
+    // scheduled from outside of the workers, and finally the oldest tasklet of another worker.
+    if (auto *tasklet = s_worker_queue->dequeue()) {
+        return tasklet;
+    }
+    if (auto *tasklet = pick_shared_tasklet()) {
+        return tasklet;
+    }
+    return steal_tasklet();
+}
+
+void wait_for_work() {
+    tracing::ScopedTrace idle_trace("Idle", 0x555555);
+
+    // Spin for a short while first since new work often arrives soon after running out, and parking costs a syscall on
+    // both the sleeping and the waking side.
+    for (uint32_t i = 0; i < k_idle_spin_count; i++) {
+        if (s_scheduler->has_ready_work() || !s_scheduler->is_running()) {
+            return;
+        }
+        __builtin_ia32_pause();
+    }
+    s_scheduler->park_worker();
+}
+
 [[noreturn]] void fiber_loop() {
     auto *running_fiber = Fiber::current();
     Fiber::finish_switch(running_fiber);
+    bool was_idle = false;
     while (s_scheduler->is_running()) {
-        // Wait for new work.
-        tracing::ScopedTrace idle_trace("Idle", 0x555555);
-        s_work_available->wait();
-        idle_trace.finish();
-
-        // Prioritise getting either a fiber or tasklet first but try to make sure we always get something since we've
-        // decremented the semaphore.
+        // Prioritise getting either a fiber or tasklet first but try to make sure we always get something.
         Fiber *fiber = nullptr;
         Tasklet *tasklet = nullptr;
         if (Fiber::current()->advance_priority(k_priority_weights.span()) == 0) {
@@ -100,6 +158,13 @@ Tasklet *pick_ready_tasklet() {
             }
         }
 
+        // Only one worker is woken at a time, so if we've just come out of idle with more work still queued, wake
+        // another worker to help out.
+        if ((fiber != nullptr || tasklet != nullptr) && vull::exchange(was_idle, false) &&
+            s_scheduler->has_ready_work()) {
+            s_scheduler->notify_worker();
+        }
+
         if (fiber != nullptr) {
             VULL_ASSERT(fiber != running_fiber);
 
@@ -120,9 +185,9 @@ Tasklet *pick_ready_tasklet() {
             tasklet->invoke();
             running_fiber->set_current_tasklet(nullptr);
         } else {
-            // If we got here, than the semaphore had a higher count than the number of jobs available, probably because
-            // of the ready fiber getting in the helper fiber.
-            // TODO: Using a counting semaphore like this is suboptimal.
+            // No work available, go idle until more is queued.
+            wait_for_work();
+            was_idle = true;
         }
     }
 
@@ -142,7 +207,7 @@ void unsuspend_fiber(Fiber *fiber) {
     VULL_ASSERT(old_state == FiberState::Suspended);
     s_fiber_queue->enqueue(fiber, [] {});
     s_ready_fiber_count->fetch_add(1, vull::memory_order_release);
-    s_work_available->post();
+    s_scheduler->notify_worker();
 }
 
 [[noreturn]] void helper_fiber() {
@@ -192,7 +257,9 @@ Scheduler &Scheduler::current() {
     return *s_scheduler;
 }
 
-Scheduler::Scheduler(uint32_t thread_count, uint32_t fiber_limit, bool pin_threads) {
+Scheduler::Scheduler(uint32_t thread_count, uint32_t fiber_limit, bool pin_threads, SchedulingMode mode,
+                     const IoConfig &io_config)
+    : m_mode(mode) {
     m_fiber_limit = vull::clamp(fiber_limit, thread_count + 1, FiberQueue::capacity());
     if (fiber_limit != m_fiber_limit) {
         vull::warn("[tasklet] Fiber limit clamped to {}", m_fiber_limit);
@@ -204,12 +271,42 @@ Scheduler::Scheduler(uint32_t thread_count, uint32_t fiber_limit, bool pin_threa
     m_free_fiber_queue = vull::make_unique<FiberQueue>();
     m_tasklet_queue = vull::make_unique<TaskletQueue>();
     m_io_queue = vull::make_unique<IoQueue>();
+    m_io_queue->config = io_config;
+
+    // Allocate the fixed buffer pool upfront so that it can be registered when the IO ring is created.
+    auto &config = m_io_queue->config;
+    if (config.fixed_buffer_count > decltype(IoQueue::free_fixed_buffers)::capacity()) {
+        config.fixed_buffer_count = decltype(IoQueue::free_fixed_buffers)::capacity();
+        vull::warn("[tasklet] Fixed buffer count clamped to {}", config.fixed_buffer_count);
+    }
+    if (config.fixed_buffer_count != 0 && config.fixed_buffer_size != 0) {
+        const auto pool_size = static_cast<size_t>(config.fixed_buffer_count) * config.fixed_buffer_size;
+        m_io_queue->fixed_buffer_memory = platform::allocate_io_buffer_memory(pool_size);
+        VULL_ENSURE(m_io_queue->fixed_buffer_memory != nullptr);
+        for (uint32_t i = 0; i < config.fixed_buffer_count; i++) {
+            VULL_ENSURE(m_io_queue->free_fixed_buffers.try_enqueue(i));
+        }
+    } else {
+        config.fixed_buffer_count = 0;
+        config.fixed_buffer_size = 0;
+    }
+
+    // Create all of the worker queues upfront since any worker can steal from any other.
+    if (mode == SchedulingMode::WorkStealing) {
+        for (uint32_t i = 0; i < thread_count; i++) {
+            m_worker_queues.push(vull::make_unique<WorkerQueue>());
+        }
+    }
 
     for (uint32_t i = 0; i < thread_count; i++) {
-        auto thread = VULL_EXPECT(platform::Thread::create([this] {
+        auto thread = VULL_EXPECT(platform::Thread::create([this, i] {
             // Setup per-thread data.
             setup_thread();
             VULL_EXPECT(platform::Thread::setup_signal_stack());
+            if (m_mode == SchedulingMode::WorkStealing) {
+                s_worker_queue = m_worker_queues[i].ptr();
+                s_steal_seed = i + 1;
+            }
 
             // Create a helper fiber per thread.
             const auto worker_index = m_alive_worker_count.fetch_add(1);
@@ -222,7 +319,8 @@ Scheduler::Scheduler(uint32_t thread_count, uint32_t fiber_limit, bool pin_threa
         }
         m_worker_threads.push(vull::move(thread));
     }
-    vull::info("[tasklet] Created {} worker threads", m_worker_threads.size());
+    vull::info("[tasklet] Created {} {}worker threads", m_worker_threads.size(),
+               mode == SchedulingMode::WorkStealing ? "work-stealing " : "");
 
     m_io_thread = VULL_EXPECT(platform::Thread::create([this] {
         setup_thread();
@@ -240,13 +338,21 @@ void Scheduler::join() {
     // Join worker threads.
     m_running.store(false, vull::memory_order_release);
     while (m_alive_worker_count.load() != 0) {
-        m_work_available.post();
+        m_idle_epoch.fetch_add(1, vull::memory_order_release);
+        platform::wake_address_all(m_idle_epoch.raw_ptr());
     }
     m_worker_threads.clear();
 
     // Join the IO thread last in case there are tasklets waiting for IO.
     m_io_queue->quit_event.set();
     VULL_EXPECT(m_io_thread.join());
+
+    // Free the fixed buffer pool now that the ring has been torn down.
+    if (auto *memory = vull::exchange(m_io_queue->fixed_buffer_memory, nullptr)) {
+        const auto &config = m_io_queue->config;
+        platform::free_io_buffer_memory(memory, static_cast<size_t>(config.fixed_buffer_count) *
+                                                    config.fixed_buffer_size);
+    }
 }
 
 Fiber *Scheduler::request_fiber() {
@@ -278,15 +384,57 @@ void Scheduler::setup_thread() {
     s_scheduler = this;
     s_fiber_queue = m_ready_fiber_queue.ptr();
     s_tasklet_queue = m_tasklet_queue.ptr();
-    s_work_available = &m_work_available;
     s_ready_fiber_count = &m_ready_fiber_count;
     s_ready_tasklet_count = &m_ready_tasklet_count;
+    s_worker_queues = &m_worker_queues;
 }
 
 void Scheduler::enqueue(Tasklet *tasklet) {
+    // Tasklets spawned by a worker go onto its local queue, unless it is full.
+    if (s_worker_queue != nullptr && s_scheduler == this && s_worker_queue->enqueue(tasklet)) {
+        notify_worker();
+        return;
+    }
     m_tasklet_queue->enqueue(tasklet, tasklet::yield);
     m_ready_tasklet_count.fetch_add(1, vull::memory_order_release);
-    m_work_available.post();
+    notify_worker();
+}
+
+void Scheduler::park_worker() {
+    // Allow producers to wake a worker again. A wake which got in before this point either still has a worker to wake,
+    // or its work will be seen by the check below.
+    m_wake_pending.store(false, vull::memory_order_seq_cst);
+
+    // Take a snapshot of the epoch before announcing that we're going to sleep. Any wake from this point onwards bumps
+    // the epoch, which makes the futex wait return straight away.
+    const auto epoch = m_idle_epoch.load(vull::memory_order_seq_cst);
+    m_sleeping_worker_count.fetch_add(1, vull::memory_order_relaxed);
+
+    // Check for work again now that producers can see us. Either we see the newly queued work here, or the producer
+    // sees us as sleeping in notify_worker. Pairs with the fence in notify_worker.
+    vull::atomic_thread_fence(vull::memory_order_seq_cst);
+    if (!has_ready_work() && is_running()) {
+        platform::wait_address(m_idle_epoch.raw_ptr(), epoch);
+    }
+    m_sleeping_worker_count.fetch_sub(1, vull::memory_order_relaxed);
+    m_wake_pending.store(false, vull::memory_order_seq_cst);
+}
+
+void Scheduler::notify_worker() {
+    // Avoid the syscall entirely if no workers are parked, which is the common case when under load.
+    vull::atomic_thread_fence(vull::memory_order_seq_cst);
+    if (m_sleeping_worker_count.load(vull::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    // Also avoid waking more than one worker at a time. The woken worker will pick up any work queued in the meantime,
+    // and wakes another worker itself if there is more than it can handle.
+    if (m_wake_pending.exchange(true, vull::memory_order_seq_cst)) {
+        return;
+    }
+    m_idle_epoch.fetch_add(1, vull::memory_order_seq_cst);
+    platform::wake_address_single(m_idle_epoch.raw_ptr());
+    m_wake_count.fetch_add(1, vull::memory_order_relaxed);
 }
 
 void Scheduler::submit_io_request(SharedPtr<IoRequest> request) {
@@ -296,8 +444,63 @@ void Scheduler::submit_io_request(SharedPtr<IoRequest> request) {
     }
 }
 
+void Scheduler::submit_io_requests(Span<const SharedPtr<IoRequest>> requests) {
+    if (requests.empty()) {
+        return;
+    }
+
+    // Only count the requests as pending once they are all queued, so that the IO thread dequeues them in one pass.
+    for (const auto &request : requests) {
+        m_io_queue->enqueue(SharedPtr<IoRequest>(request).disown(), tasklet::yield);
+    }
+    if (m_io_queue->pending.fetch_add(requests.size(), vull::memory_order_relaxed) == 0) {
+        m_io_queue->submit_event.set();
+    }
+}
+
+Optional<FixedBuffer> Scheduler::try_acquire_fixed_buffer() {
+    auto index = m_io_queue->free_fixed_buffers.try_dequeue();
+    if (!index) {
+        return {};
+    }
+    const auto size = m_io_queue->config.fixed_buffer_size;
+    return FixedBuffer(m_io_queue->fixed_buffer_memory + static_cast<size_t>(*index) * size, size, *index);
+}
+
+FixedBuffer Scheduler::acquire_fixed_buffer() {
+    VULL_ASSERT(m_io_queue->config.fixed_buffer_count != 0);
+    auto buffer = try_acquire_fixed_buffer();
+    while (!buffer) {
+        tasklet::yield();
+        buffer = try_acquire_fixed_buffer();
+    }
+    return *buffer;
+}
+
+void Scheduler::release_fixed_buffer(const FixedBuffer &buffer) {
+    VULL_ASSERT(buffer.index() < m_io_queue->config.fixed_buffer_count);
+    m_io_queue->free_fixed_buffers.enqueue(buffer.index(), tasklet::yield);
+}
+
 uint32_t Scheduler::queued_tasklet_count() const {
-    return m_tasklet_queue->size();
+    uint32_t count = m_tasklet_queue->size();
+    for (const auto &queue : m_worker_queues) {
+        count += static_cast<uint32_t>(queue->size());
+    }
+    return count;
+}
+
+bool Scheduler::has_ready_work() const {
+    if (m_ready_fiber_count.load(vull::memory_order_relaxed) != 0 ||
+        m_ready_tasklet_count.load(vull::memory_order_relaxed) != 0) {
+        return true;
+    }
+    for (const auto &queue : m_worker_queues) {
+        if (!queue->empty()) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool Scheduler::is_running() const {
@@ -324,6 +527,11 @@ void submit_io_request(SharedPtr<IoRequest> request) {
     s_scheduler->submit_io_request(vull::move(request));
 }
 
+void submit_io_requests(Span<const SharedPtr<IoRequest>> requests) {
+    VULL_ASSERT(in_tasklet_context());
+    s_scheduler->submit_io_requests(requests);
+}
+
 void suspend() {
     // Switch to the helper fiber.
     VULL_ASSERT(in_tasklet_context());
@@ -1,30 +1,116 @@
 #include <vull/vpak/file_system.hh>
 
+#include <vull/container/hash_map.hh>
 #include <vull/container/vector.hh>
 #include <vull/core/log.hh>
+#include <vull/support/atomic.hh>
 #include <vull/support/optional.hh>
+#include <vull/support/perfect_hasher.hh>
 #include <vull/support/result.hh>
 #include <vull/support/string.hh>
 #include <vull/support/string_view.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/functions.hh>
 #include <vull/vpak/defs.hh>
 #include <vull/vpak/pack_file.hh>
 #include <vull/vpak/stream.hh>
 
+#include <stdint.h>
+
 namespace vull::vpak {
 namespace {
 
+struct IndexSlot {
+    const Entry *entry;
+    const PackFile *pack_file;
+};
+
+enum class IndexState : uint32_t {
+    Valid,
+    Dirty,
+    Building,
+};
+
 VULL_GLOBAL(Vector<UniquePtr<PackFile>> s_loaded_vpaks);
+VULL_GLOBAL(Vector<IndexSlot> s_index);
+VULL_GLOBAL(PerfectHasher s_index_phf);
+VULL_GLOBAL(Atomic<IndexState> s_index_state);
+
+void build_index() {
+    // Merge the entries of all packs, with later packs overriding entries of the same name in earlier ones.
+    Vector<IndexSlot> slots;
+    HashMap<StringView, uint32_t> slot_indices;
+    for (const auto &pack_file : s_loaded_vpaks) {
+        for (const auto &entry : pack_file->entries()) {
+            const IndexSlot slot{&entry, pack_file.ptr()};
+            if (auto index = slot_indices.get(entry.name.view())) {
+                slots[*index] = slot;
+                continue;
+            }
+            slot_indices.set(entry.name.view(), slots.size());
+            slots.push(slot);
+        }
+    }
+
+    Vector<StringView> keys;
+    keys.ensure_capacity(slots.size());
+    for (const auto &slot : slots) {
+        keys.push(slot.entry->name.view());
+    }
+
+    s_index_phf = {};
+    s_index.clear();
+    if (slots.empty()) {
+        return;
+    }
+    s_index_phf.build(keys);
+    s_index.ensure_size(slots.size());
+    for (const auto &slot : slots) {
+        s_index[s_index_phf.hash(slot.entry->name.view())] = slot;
+    }
+    vull::debug("[vpak] Built name index ({} entries from {} vpaks)", s_index.size(), s_loaded_vpaks.size());
+}
+
+// Rebuilds the index if any vpaks have been loaded since it was last built. The first lookup to see the index dirty
+// rebuilds it, whilst any others wait for it to finish.
+void ensure_index() {
+    auto state = s_index_state.load(vull::memory_order_acquire);
+    while (state != IndexState::Valid) {
+        if (state == IndexState::Dirty &&
+            s_index_state.compare_exchange(state, IndexState::Building, vull::memory_order_acquire)) {
+            build_index();
+            s_index_state.store(IndexState::Valid, vull::memory_order_release);
+            return;
+        }
+        tasklet::yield();
+        state = s_index_state.load(vull::memory_order_acquire);
+    }
+}
+
+Optional<const IndexSlot &> lookup(StringView name) {
+    ensure_index();
+    if (s_index.empty()) {
+        return vull::nullopt;
+    }
+    const auto &slot = s_index[s_index_phf.hash(name)];
+    if (slot.entry->name.view() != name) {
+        return vull::nullopt;
+    }
+    return slot;
+}
 
 } // namespace
 
-void load_vpak(StringView name, String path) {
-    auto pack_file_or_error = PackFile::open(vull::move(path));
+void load_vpak(StringView name, String path, ReadMode read_mode) {
+    auto pack_file_or_error = PackFile::open(vull::move(path), read_mode);
     if (!pack_file_or_error.is_error()) {
         auto pack_file = vull::adopt_unique(pack_file_or_error.disown_value());
         vull::info("[vpak] Loaded vpak '{}' ({} entries)", name, pack_file->entries().size());
         s_loaded_vpaks.push(vull::move(pack_file));
+
+        // Defer rebuilding the index to the next lookup so that loading many vpaks in a row only builds it once.
+        s_index_state.store(IndexState::Dirty, vull::memory_order_release);
         return;
     }
     // TODO: Print error details.
@@ -32,21 +118,15 @@ void load_vpak(StringView name, String path) {
 }
 
 UniquePtr<ReadStream> open(StringView name) {
-    // TODO: This is hashing name for every vpak.
-    for (const auto &pack_file : s_loaded_vpaks) {
-        if (auto stream = pack_file->open_entry(name)) {
-            return vull::move(stream);
-        }
+    if (auto slot = lookup(name)) {
+        return slot->pack_file->open_entry(*slot->entry);
     }
     return {};
 }
 
 Optional<Entry> stat(StringView name) {
-    // TODO: This is hashing name for every vpak.
-    for (const auto &pack_file : s_loaded_vpaks) {
-        if (auto entry = pack_file->stat(name)) {
-            return *entry;
-        }
+    if (auto slot = lookup(name)) {
+        return *slot->entry;
     }
     return {};
 }
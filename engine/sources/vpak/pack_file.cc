@@ -1,11 +1,16 @@
 #include <vull/vpak/pack_file.hh>
 
+#include <vull/container/hash_set.hh>
 #include <vull/container/vector.hh>
+#include <vull/core/log.hh>
 #include <vull/platform/file.hh>
 #include <vull/platform/file_stream.hh>
+#include <vull/support/algorithm.hh>
 #include <vull/support/optional.hh>
 #include <vull/support/perfect_hasher.hh>
 #include <vull/support/result.hh>
+#include <vull/support/shared_ptr.hh>
+#include <vull/support/span.hh>
 #include <vull/support/stream.hh>
 #include <vull/support/string.hh>
 #include <vull/support/string_view.hh>
@@ -16,10 +21,11 @@
 #include <vull/vpak/writer.hh>
 
 #include <stdint.h>
+#include <zstd.h>
 
 namespace vull::vpak {
 
-Result<PackFile, platform::OpenError, StreamError, VpakError> PackFile::open(String path) {
+Result<PackFile, platform::OpenError, StreamError, VpakError> PackFile::open(String path, ReadMode read_mode) {
     auto file_or_error = platform::open_file(path, platform::OpenMode::Read);
     auto file = file_or_error.to_optional().value_or(platform::File());
     if (!file && file_or_error.error() != platform::OpenError::NonExistent) {
@@ -28,19 +34,40 @@ Result<PackFile, platform::OpenError, StreamError, VpakError> PackFile::open(Str
 
     // TODO: Don't read if file empty (e.g. if created by touch).
     const bool should_read = !!file;
-    PackFile pack_file(vull::move(path), vull::move(file));
+    PackFile pack_file(vull::move(path), vull::move(file), read_mode);
     if (should_read) {
         VULL_TRY(pack_file.read_existing());
+        pack_file.map_file();
     }
     return pack_file;
 }
 
+void PackFile::map_file() {
+    m_mapping.clear();
+    if (m_read_mode != ReadMode::Mapped) {
+        return;
+    }
+    auto mapping_or_error = m_file.map_read_only();
+    if (mapping_or_error.is_error()) {
+        vull::warn("[vpak] Failed to map '{}', falling back to streaming", m_path);
+        return;
+    }
+    m_mapping = vull::adopt_shared(new SharedMapping(mapping_or_error.disown_value()));
+}
+
+PackFile::~PackFile() {
+    for (const auto &dictionary : m_dictionaries) {
+        ZSTD_freeDDict(dictionary.ddict);
+    }
+}
+
 Result<void, StreamError, VpakError> PackFile::read_existing() {
     auto stream = m_file.create_stream();
     if (VULL_TRY(stream.read_be<uint32_t>()) != k_magic_number) {
         return VpakError::BadMagic;
     }
-    if (VULL_TRY(stream.read_be<uint32_t>()) != 1u) {
+    const auto version = VULL_TRY(stream.read_be<uint32_t>());
+    if (version != 1u && version != k_format_version) {
         return VpakError::BadVersion;
     }
     if (VULL_TRY(stream.read_be<uint32_t>()) != 0u) {
@@ -52,8 +79,8 @@ Result<void, StreamError, VpakError> PackFile::read_existing() {
         return VpakError::TooManyEntries;
     }
 
-    const auto entry_table_offset = VULL_TRY(stream.read_be<uint64_t>());
-    VULL_TRY(stream.seek(entry_table_offset, SeekMode::Set));
+    m_entry_table_offset = VULL_TRY(stream.read_be<uint64_t>());
+    VULL_TRY(stream.seek(m_entry_table_offset, SeekMode::Set));
 
     Vector<int32_t> seeds;
     seeds.ensure_capacity(entry_count);
@@ -69,10 +96,56 @@ Result<void, StreamError, VpakError> PackFile::read_existing() {
         entry.name = VULL_TRY(stream.read_string());
         entry.size = VULL_TRY(stream.read_varint<uint32_t>());
         entry.first_block = VULL_TRY(stream.read_varint<uint64_t>());
+
+        // Version 1 always used zstd.
+        entry.codec = version == 1u ? EntryCodec::Zstd : static_cast<EntryCodec>(VULL_TRY(stream.read_byte()));
+        if (entry.codec == EntryCodec::ZstdDict) {
+            entry.dictionary_name = VULL_TRY(stream.read_string());
+        } else if (entry.codec != EntryCodec::Raw && entry.codec != EntryCodec::Zstd) {
+            return VpakError::BadCodec;
+        }
+    }
+    return load_dictionaries();
+}
+
+Result<void, StreamError, VpakError> PackFile::load_dictionaries() {
+    for (const auto &entry : m_entries) {
+        if (entry.codec != EntryCodec::ZstdDict || find_dictionary(entry.dictionary_name) != nullptr) {
+            continue;
+        }
+
+        // Dictionaries are stored as raw entries.
+        auto dictionary_entry = stat(entry.dictionary_name);
+        if (!dictionary_entry || dictionary_entry->codec != EntryCodec::Raw) {
+            return VpakError::MissingDictionary;
+        }
+        Vector<uint8_t> data(dictionary_entry->size);
+        auto stream = m_file.create_stream();
+        VULL_TRY(stream.seek(dictionary_entry->first_block, SeekMode::Set));
+        if (VULL_TRY(stream.read(data.span())) != data.size()) {
+            return StreamError::Truncated;
+        }
+        auto *ddict = ZSTD_createDDict(data.data(), data.size());
+        if (ddict == nullptr) {
+            return VpakError::BadDictionary;
+        }
+        m_dictionaries.push({
+            .name = entry.dictionary_name,
+            .ddict = ddict,
+        });
     }
     return {};
 }
 
+const ZSTD_DDict *PackFile::find_dictionary(StringView name) const {
+    for (const auto &dictionary : m_dictionaries) {
+        if (dictionary.name.view() == name) {
+            return dictionary.ddict;
+        }
+    }
+    return nullptr;
+}
+
 bool PackFile::exists(StringView name) const {
     return !m_entries.empty() && m_entries[m_phf.hash(name)].name.view() == name;
 }
@@ -82,10 +155,23 @@ UniquePtr<ReadStream> PackFile::open_entry(StringView name) const {
         return {};
     }
     const auto &entry = m_entries[m_phf.hash(name)];
-    auto stream = m_file.create_stream();
-    VULL_ASSUME(stream.seek(entry.first_block, SeekMode::Set));
-    return entry.name.view() == name ? vull::make_unique<ReadStream>(vull::adopt_unique(vull::move(stream)))
-                                     : UniquePtr<ReadStream>();
+    if (entry.name.view() != name) {
+        return {};
+    }
+    return open_entry(entry);
+}
+
+UniquePtr<ReadStream> PackFile::open_entry(const Entry &entry) const {
+    const auto *ddict = entry.codec == EntryCodec::ZstdDict ? find_dictionary(entry.dictionary_name) : nullptr;
+    if (m_mapping) {
+        // Start reading in the entry's blocks. They are usually contiguous unless written in parallel with others.
+        const auto encoded_size =
+            entry.codec == EntryCodec::Raw ? entry.size : ReadStream::max_encoded_size(entry.size);
+        m_mapping->mapping().prefetch(entry.first_block, encoded_size);
+        return vull::make_unique<ReadStream>(m_mapping, entry, ddict);
+    }
+    // The stream gets its own file descriptor, so it keeps reading the old file if a write replaces it.
+    return vull::make_unique<ReadStream>(m_file.duplicate(), entry, ddict);
 }
 
 Optional<Entry> PackFile::stat(StringView name) const {
@@ -96,42 +182,171 @@ Optional<Entry> PackFile::stat(StringView name) const {
     return entry.name.view() == name ? entry : Optional<Entry>();
 }
 
-Result<Writer, platform::FileError, platform::OpenError> PackFile::make_writer(CompressionLevel compression_level) {
+Optional<Span<const uint8_t>> PackFile::raw_view(StringView name) const {
+    auto entry = stat(name);
+    if (!m_mapping || !entry || entry->codec != EntryCodec::Raw) {
+        return vull::nullopt;
+    }
+    const auto &mapping = m_mapping->mapping();
+    if (entry->first_block + entry->size > mapping.size()) {
+        return vull::nullopt;
+    }
+    return mapping.span().subspan(entry->first_block, entry->size);
+}
+
+Result<Writer, platform::FileError, platform::OpenError> PackFile::make_writer(CompressionLevel compression_level,
+                                                                             WriteMode write_mode) {
+    if (write_mode == WriteMode::InPlace && m_file) {
+        // Reopen the pack file for writing and append to it. The existing file handle may be read-only.
+        auto write_file = VULL_TRY(
+            platform::open_file(m_path, platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Write)));
+        const auto head = VULL_TRY(write_file.size());
+        return Writer(vull::move(write_file), head, compression_level, WriteMode::InPlace);
+    }
+
     auto write_file = VULL_TRY(platform::open_file(
-        platform::dir_path(m_path), platform::OpenModes(platform::OpenMode::TempFile, platform::OpenMode::Write)));
-    int64_t dst_offset = k_header_size;
-    if (m_file) {
-        // Copy existing entry data to write file, skipping the old header.
-        // TODO: Don't copy old entry table.
-        // TODO: Investigate vacuuming, i.e. removing old unreferenced entry data.
-        int64_t src_offset = k_header_size;
-        VULL_TRY(m_file.copy_to(write_file, src_offset, dst_offset));
+        platform::dir_path(m_path),
+        platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Write, platform::OpenMode::TempFile)));
+    // Existing entries are copied over once the writer is finished, when it's known which of them were replaced.
+    return Writer(vull::move(write_file), k_header_size, compression_level, WriteMode::Copy);
+}
+
+Result<uint64_t, platform::FileError, platform::OpenError, StreamError, VpakError>
+PackFile::finish_writing(Writer &&writer) {
+    if (writer.m_write_mode == WriteMode::Copy) {
+        // Carry over the data of live entries which weren't replaced, leaving behind everything else.
+        VULL_TRY(copy_live_entries(writer));
+        return finish_writing(vull::move(writer), {});
     }
-    return Writer(vull::move(write_file), static_cast<uint64_t>(dst_offset), compression_level);
+    return finish_writing(vull::move(writer), Vector<Entry>(m_entries.begin(), m_entries.end()));
 }
 
-Result<uint64_t, platform::FileError, platform::OpenError, StreamError> PackFile::finish_writing(Writer &&writer) {
-    // TODO: Re-assign to m_entries after write to disk is successful.
-    const auto bytes_written = VULL_TRY(writer.finish(m_entries));
-    m_file = vull::move(writer.m_write_file);
+Result<uint64_t, platform::FileError, platform::OpenError, StreamError, VpakError>
+PackFile::finish_writing(Writer &&writer, Vector<Entry> &&entries) {
+    // Build the new entry table separately so that nothing changes if writing it out fails.
+    PerfectHasher phf;
+    const auto bytes_written = VULL_TRY(writer.finish(entries, phf));
+
+    if (writer.m_write_mode == WriteMode::InPlace) {
+        // Make sure the new entry data and table are on disk before the header points at them.
+        VULL_TRY(writer.m_write_file.sync());
+        VULL_TRY(writer.write_header(entries.size()));
+        VULL_TRY(writer.m_write_file.sync());
+    } else {
+        VULL_TRY(writer.write_header(entries.size()));
 
-    // Sync temporary file data.
-    VULL_TRY(m_file.sync());
+        // Sync temporary file data.
+        VULL_TRY(writer.m_write_file.sync());
 
-    // Open parent directory now.
-    auto parent_directory = VULL_TRY(platform::open_file(
-        platform::dir_path(m_path), platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Directory)));
+        // Open parent directory now.
+        auto parent_directory = VULL_TRY(platform::open_file(
+            platform::dir_path(m_path), platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Directory)));
 
-    // Can't use renameat with an O_TMPFILE, so this isn't truly atomic :(.
-    if (auto result = platform::unlink_path(m_path);
-        result.is_error() && result.error() != platform::FileError::NonExistent) {
-        return result.error();
+        // Can't use renameat with an O_TMPFILE, so this isn't truly atomic :(.
+        if (auto result = platform::unlink_path(m_path);
+            result.is_error() && result.error() != platform::FileError::NonExistent) {
+            return result.error();
+        }
+        VULL_TRY(writer.m_write_file.link_to(m_path));
+
+        // Sync parent directory. Don't signal failure if this doesn't work, since we've already done the rename now.
+        static_cast<void>(parent_directory.sync());
     }
-    VULL_TRY(m_file.link_to(m_path));
 
-    // Sync parent directory. Don't signal failure if this doesn't work, since we've already done the rename now.
-    static_cast<void>(parent_directory.sync());
+    // The file on disk now has the new entry table.
+    m_file = vull::move(writer.m_write_file);
+    m_entries = vull::move(entries);
+    m_phf = vull::move(phf);
+    m_entry_table_offset = writer.m_entry_table_offset;
+
+    // The file has either grown or been replaced, so it needs remapping, and there may be new dictionaries.
+    map_file();
+    VULL_TRY(load_dictionaries());
     return bytes_written;
 }
 
+Result<void, StreamError> PackFile::copy_block_chain(platform::FileStream &dst_stream, Writer &writer,
+                                                     Entry &entry) const {
+    // Blocks are copied without being decompressed, but since they are laid out back to back in the new file, the
+    // links to the next block need rewriting.
+    auto src_stream = m_file.create_stream();
+    Vector<uint8_t> buffer(static_cast<uint32_t>(ReadStream::max_encoded_size(1)));
+    uint64_t block_offset = entry.first_block;
+    entry.first_block = 0;
+    while (true) {
+        VULL_TRY(src_stream.seek(block_offset, SeekMode::Set));
+        const auto chunk_size = VULL_TRY(src_stream.read(buffer.span()));
+        const auto compressed_size = ZSTD_findFrameCompressedSize(buffer.data(), chunk_size);
+        if (ZSTD_isError(compressed_size) != 0u) {
+            return StreamError::Unknown;
+        }
+        if (compressed_size + sizeof(uint64_t) > chunk_size) {
+            return StreamError::Truncated;
+        }
+        uint64_t next_block_offset = 0;
+        for (uint32_t i = 0; i < sizeof(uint64_t); i++) {
+            next_block_offset = (next_block_offset << 8u) | buffer[static_cast<uint32_t>(compressed_size) + i];
+        }
+
+        const auto new_offset = writer.allocate_space(compressed_size + sizeof(uint64_t));
+        if (entry.first_block == 0) {
+            entry.first_block = new_offset;
+        }
+        const auto new_link =
+            next_block_offset == UINT64_MAX ? UINT64_MAX : new_offset + compressed_size + sizeof(uint64_t);
+        VULL_TRY(dst_stream.seek(new_offset, SeekMode::Set));
+        VULL_TRY(dst_stream.write({buffer.data(), compressed_size}));
+        VULL_TRY(dst_stream.write_be(new_link));
+        if (next_block_offset == UINT64_MAX) {
+            return {};
+        }
+        block_offset = next_block_offset;
+    }
+}
+
+Result<void, platform::FileError, StreamError> PackFile::copy_live_entries(Writer &writer) const {
+    if (!m_file) {
+        return {};
+    }
+    auto dst_stream = writer.m_write_file.create_stream();
+    HashSet<StringView> replaced;
+    for (const auto &entry : writer.m_new_entries) {
+        replaced.add(entry.name.view());
+    }
+
+    // Copy entries in their existing order on disk to preserve locality.
+    Vector<uint32_t> order;
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        if (!replaced.contains(m_entries[i].name.view())) {
+            order.push(i);
+        }
+    }
+    vull::sort(order, [&](uint32_t lhs, uint32_t rhs) {
+        return m_entries[lhs].first_block > m_entries[rhs].first_block;
+    });
+
+    for (uint32_t index : order) {
+        Entry entry(m_entries[index]);
+        if (entry.codec == EntryCodec::Raw) {
+            // Raw data can be copied by the kernel, or shared with the old file on filesystems supporting reflinks.
+            auto src_offset = static_cast<int64_t>(entry.first_block);
+            auto dst_offset = static_cast<int64_t>(writer.allocate_space(entry.size));
+            entry.first_block = static_cast<uint64_t>(dst_offset);
+            VULL_TRY(m_file.copy_to(writer.m_write_file, src_offset, dst_offset, entry.size));
+        } else if (entry.size != 0) {
+            VULL_TRY(copy_block_chain(dst_stream, writer, entry));
+        } else {
+            entry.first_block = 0;
+        }
+        writer.add_finished_entry(vull::move(entry));
+    }
+    return {};
+}
+
+Result<uint64_t, platform::FileError, platform::OpenError, StreamError, VpakError> PackFile::compact() {
+    // Finishing an empty copy writer leaves only the data of live entries behind.
+    auto writer = VULL_TRY(make_writer(CompressionLevel::Normal, WriteMode::Copy));
+    return VULL_TRY(finish_writing(vull::move(writer)));
+}
+
 } // namespace vull::vpak
@@ -1,14 +1,23 @@
 #include <vull/vpak/stream.hh>
 
+#include <vull/container/array.hh>
 #include <vull/container/vector.hh>
 #include <vull/maths/common.hh>
+#include <vull/platform/async_file.hh>
+#include <vull/platform/file.hh>
 #include <vull/support/assert.hh>
+#include <vull/support/atomic.hh>
 #include <vull/support/result.hh>
+#include <vull/support/shared_ptr.hh>
 #include <vull/support/span.hh>
 #include <vull/support/stream.hh>
 #include <vull/support/string.hh>
 #include <vull/support/unique_ptr.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/future.hh>
+#include <vull/tasklet/io.hh>
+#include <vull/tasklet/scheduler.hh>
 #include <vull/vpak/defs.hh>
 #include <vull/vpak/writer.hh>
 
@@ -23,6 +32,14 @@ namespace {
 constexpr size_t k_input_block_size = 1u << 17u;
 constexpr size_t k_output_block_size = ZSTD_COMPRESSBOUND(1u << 17u) + 3;
 
+// The maximum number of fixed buffers a stream reads ahead into.
+constexpr uint32_t k_max_fixed_windows = 8;
+
+// The maximum number of compression contexts kept around per thread. Contexts at high compression levels hold on to
+// large workspaces, and streams may finish on a different thread to the one they started on, so any beyond this are
+// freed rather than cached.
+constexpr uint32_t k_max_cached_write_contexts = 4;
+
 struct ReadContext {
     ZSTD_DCtx *dctx;
     uint8_t *in_buffer;
@@ -94,9 +111,75 @@ WriteContext::~WriteContext() {
     }
 }
 
+size_t decompress_block(ZSTD_DCtx *dctx, const ZSTD_DDict *ddict, uint8_t *dst, const uint8_t *src, size_t size) {
+    if (ddict != nullptr) {
+        return ZSTD_decompress_usingDDict(dctx, dst, k_input_block_size, src, size, ddict);
+    }
+    return ZSTD_decompressDCtx(dctx, dst, k_input_block_size, src, size);
+}
+
 } // namespace
 
-ReadStream::ReadStream(UniquePtr<Stream> &&stream) : m_stream(vull::move(stream)) {
+void SharedMapping::add_ref() const {
+    m_ref_count.fetch_add(1, vull::memory_order_relaxed);
+}
+
+void SharedMapping::sub_ref() const {
+    if (m_ref_count.fetch_sub(1, vull::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+uint64_t ReadStream::max_encoded_size(uint64_t size) {
+    // Worst case compressed size of every block plus its block link.
+    const auto block_count = vull::max(vull::ceil_div(size, uint64_t(k_input_block_size)), uint64_t(1));
+    return block_count * (k_output_block_size + sizeof(uint64_t));
+}
+
+ReadStream::ReadStream(UniquePtr<Stream> &&stream, const Entry &entry, const ZSTD_DDict *ddict)
+    : m_stream(vull::move(stream)), m_ddict(ddict), m_codec(entry.codec), m_entry_size(entry.size),
+      m_raw_remaining(entry.size), m_at_end(entry.size == 0) {
+    VULL_ASSUME(m_stream->seek(entry.first_block, SeekMode::Set));
+    acquire_context();
+}
+
+ReadStream::ReadStream(platform::File &&file, const Entry &entry, const ZSTD_DDict *ddict)
+    : ReadStream(vull::adopt_unique(file.create_stream()), entry, ddict) {
+    m_file = platform::AsyncFile(vull::move(file));
+}
+
+ReadStream::ReadStream(SharedPtr<const SharedMapping> mapping, const Entry &entry, const ZSTD_DDict *ddict)
+    : m_shared_mapping(vull::move(mapping)), m_mapping(m_shared_mapping->mapping().span()),
+      m_mapped_block_offset(entry.first_block), m_ddict(ddict), m_codec(entry.codec), m_entry_size(entry.size),
+      m_raw_remaining(entry.size), m_at_end(entry.size == 0) {
+    acquire_context();
+}
+
+ReadStream::~ReadStream() {
+    // Wait for any blocks still being decompressed before giving their buffers back.
+    for (auto &slot : m_readahead_slots) {
+        if (slot.decompressed_size.is_valid()) {
+            slot.decompressed_size.await();
+        }
+        s_read_contexts.emplace(slot.dctx, slot.in_buffer, slot.out_buffer);
+    }
+    for (auto &window : m_fixed_windows) {
+        if (window.bytes_read.is_valid()) {
+            window.bytes_read.await();
+        }
+        tasklet::Scheduler::current().release_fixed_buffer(window.buffer);
+    }
+    if (m_dctx != nullptr) {
+        s_read_contexts.emplace(m_dctx, m_in_buffer, m_out_buffer);
+    }
+}
+
+void ReadStream::acquire_context() {
+    // Raw entries are read straight into the caller's buffer.
+    if (m_codec == EntryCodec::Raw) {
+        return;
+    }
+
     if (s_read_contexts.empty()) {
         s_read_contexts.emplace();
     }
@@ -107,14 +190,223 @@ ReadStream::ReadStream(UniquePtr<Stream> &&stream) : m_stream(vull::move(stream)
     m_out_buffer = vull::exchange(context.out_buffer, nullptr);
 }
 
-ReadStream::~ReadStream() {
-    s_read_contexts.emplace(m_dctx, m_in_buffer, m_out_buffer);
+void ReadStream::enable_readahead(uint32_t block_count) {
+    VULL_ASSERT(m_block_data == nullptr, "Readahead must be enabled before the first read");
+    const auto entry_block_count = static_cast<uint32_t>(vull::ceil_div(m_entry_size, uint32_t(k_input_block_size)));
+    if (m_codec == EntryCodec::Raw || !tasklet::in_tasklet_context() || entry_block_count <= 1) {
+        return;
+    }
+
+    m_blocks_to_fetch = entry_block_count;
+    m_readahead_offset = m_stream ? VULL_EXPECT(m_stream->seek(0, SeekMode::Add)) : m_mapped_block_offset;
+    block_count = vull::min(block_count, entry_block_count);
+    if (m_file) {
+        setup_fixed_windows(block_count);
+    }
+    for (uint32_t i = 0; i < block_count; i++) {
+        if (s_read_contexts.empty()) {
+            s_read_contexts.emplace();
+        }
+        auto context = s_read_contexts.take_last();
+        m_readahead_slots.push({
+            .dctx = vull::exchange(context.dctx, nullptr),
+            .in_buffer = vull::exchange(context.in_buffer, nullptr),
+            .out_buffer = vull::exchange(context.out_buffer, nullptr),
+        });
+        if (fetch_readahead_block(m_readahead_slots.last()).is_error()) {
+            // Let the error surface on the read of the offending block.
+            break;
+        }
+    }
+}
+
+void ReadStream::setup_fixed_windows(uint32_t block_count) {
+    auto &scheduler = tasklet::Scheduler::current();
+    const uint64_t buffer_size = scheduler.io_config().fixed_buffer_size;
+    if (buffer_size == 0) {
+        return;
+    }
+
+    // Aim to cover at least two worst-case blocks so that the next block is usually already in a window.
+    const auto covered_size = uint64_t(vull::max(block_count, 2u)) * k_output_block_size;
+    const auto window_count = static_cast<uint32_t>(vull::min(vull::ceil_div(covered_size, buffer_size),
+                                                              uint64_t(k_max_fixed_windows)));
+    for (uint32_t i = 0; i < window_count; i++) {
+        // Other streams may be holding the rest of the pool, in which case make do with fewer windows, or fall back
+        // to blocking reads if there are none.
+        auto buffer = scheduler.try_acquire_fixed_buffer();
+        if (!buffer) {
+            break;
+        }
+        m_fixed_windows.push({.buffer = *buffer});
+    }
+    if (m_fixed_windows.empty()) {
+        return;
+    }
+
+    if (scheduler.io_config().fixed_file_count != 0) {
+        // Not being able to register the file only costs a file descriptor lookup per read.
+        static_cast<void>(m_file.register_fixed());
+    }
+    restart_fixed_windows(m_readahead_offset);
+}
+
+void ReadStream::restart_fixed_windows(uint64_t offset) {
+    Array<SharedPtr<tasklet::IoRequest>, k_max_fixed_windows> requests;
+    for (uint32_t i = 0; i < m_fixed_windows.size(); i++) {
+        // A read may still be in flight into the buffer.
+        auto &window = m_fixed_windows[i];
+        if (window.bytes_read.is_valid()) {
+            window.bytes_read.await();
+        }
+        requests[i] = m_file.make_read_fixed(window.buffer, window.buffer.size(), offset);
+        window.offset = offset;
+        window.size = 0;
+        window.bytes_read = tasklet::Future<tasklet::IoResult>(requests[i]);
+        offset += window.buffer.size();
+    }
+    m_fixed_window_head = 0;
+    m_fixed_window_end = offset;
+    tasklet::submit_io_requests({requests.data(), m_fixed_windows.size()});
+}
+
+void ReadStream::advance_fixed_windows(uint64_t offset) {
+    if (offset < m_fixed_windows[m_fixed_window_head].offset || offset >= m_fixed_window_end) {
+        // The chain jumped outside of the windows, for example past blocks of another entry written at the same time.
+        restart_fixed_windows(offset);
+        return;
+    }
+
+    // Move the windows which are wholly behind the offset onto the end of the range.
+    Array<SharedPtr<tasklet::IoRequest>, k_max_fixed_windows> requests;
+    uint32_t request_count = 0;
+    while (true) {
+        auto &window = m_fixed_windows[m_fixed_window_head];
+        if (offset < window.offset + window.buffer.size()) {
+            break;
+        }
+        if (window.bytes_read.is_valid()) {
+            window.bytes_read.await();
+        }
+        requests[request_count] = m_file.make_read_fixed(window.buffer, window.buffer.size(), m_fixed_window_end);
+        window.offset = m_fixed_window_end;
+        window.size = 0;
+        window.bytes_read = tasklet::Future<tasklet::IoResult>(requests[request_count++]);
+        m_fixed_window_end += window.buffer.size();
+        m_fixed_window_head = (m_fixed_window_head + 1) % m_fixed_windows.size();
+    }
+    tasklet::submit_io_requests({requests.data(), request_count});
+}
+
+Result<size_t, StreamError> ReadStream::read_fixed(uint64_t offset, Span<uint8_t> data) {
+    advance_fixed_windows(offset);
+    size_t copied = 0;
+    while (copied < data.size()) {
+        // Only restart past the end of the range if there aren't enough windows to cover the whole read.
+        const uint64_t position = offset + copied;
+        if (position >= m_fixed_window_end) {
+            restart_fixed_windows(position);
+        }
+
+        // The windows are all the same size and cover one consecutive range, starting at the head.
+        const auto &head = m_fixed_windows[m_fixed_window_head];
+        const auto window_index = (position - head.offset) / head.buffer.size();
+        auto &window = m_fixed_windows[(m_fixed_window_head + window_index) % m_fixed_windows.size()];
+        if (window.bytes_read.is_valid()) {
+            const auto bytes_read = window.bytes_read.await();
+            window.bytes_read = {};
+            if (bytes_read < 0) {
+                return StreamError::Unknown;
+            }
+            window.size = static_cast<uint32_t>(bytes_read);
+        }
+
+        const uint64_t window_offset = position - window.offset;
+        if (window_offset >= window.size) {
+            // Reached the end of the file.
+            break;
+        }
+        const auto to_copy = vull::min(window.size - window_offset, uint64_t(data.size() - copied));
+        memcpy(data.data() + copied, window.buffer.data() + window_offset, to_copy);
+        copied += to_copy;
+    }
+    return copied;
+}
+
+Result<uint64_t, StreamError> ReadStream::read_mapped_link(uint64_t offset) const {
+    // Read the big endian link to the next block which follows the compressed data.
+    if (offset + sizeof(uint64_t) > m_mapping.size()) {
+        return StreamError::Truncated;
+    }
+    uint64_t next_block_offset = 0;
+    for (uint32_t i = 0; i < sizeof(uint64_t); i++) {
+        next_block_offset = (next_block_offset << 8u) | m_mapping[offset + i];
+    }
+    return next_block_offset;
+}
+
+Result<void, StreamError> ReadStream::fetch_readahead_block(ReadaheadSlot &slot) {
+    // Unlike the synchronous path, the block count is known up front from the entry size, so the chain can be walked
+    // without waiting for each block to be decompressed.
+    const uint8_t *block_data;
+    uint64_t available;
+    if (!m_fixed_windows.empty()) {
+        block_data = slot.in_buffer;
+        available = VULL_TRY(read_fixed(m_readahead_offset, {slot.in_buffer, k_output_block_size}));
+    } else if (m_stream) {
+        VULL_TRY(m_stream->seek(m_readahead_offset, SeekMode::Set));
+        block_data = slot.in_buffer;
+        available = VULL_TRY(m_stream->read({slot.in_buffer, k_output_block_size}));
+    } else {
+        if (m_readahead_offset >= m_mapping.size()) {
+            return StreamError::Truncated;
+        }
+        block_data = m_mapping.data() + m_readahead_offset;
+        available = vull::min(m_mapping.size() - m_readahead_offset, k_output_block_size);
+    }
+
+    const uint64_t compressed_size = ZSTD_findFrameCompressedSize(block_data, available);
+    if (ZSTD_isError(compressed_size) != 0u) {
+        return StreamError::Unknown;
+    }
+
+    if (--m_blocks_to_fetch > 0) {
+        const uint64_t link_offset = m_readahead_offset + compressed_size;
+        if (!m_fixed_windows.empty()) {
+            Array<uint8_t, sizeof(uint64_t)> link;
+            if (VULL_TRY(read_fixed(link_offset, link.span())) != link.size()) {
+                return StreamError::Truncated;
+            }
+            m_readahead_offset = 0;
+            for (uint8_t byte : link) {
+                m_readahead_offset = (m_readahead_offset << 8u) | byte;
+            }
+        } else if (m_stream) {
+            VULL_TRY(m_stream->seek(link_offset, SeekMode::Set));
+            m_readahead_offset = VULL_TRY(m_stream->read_be<uint64_t>());
+        } else {
+            m_readahead_offset = VULL_TRY(read_mapped_link(link_offset));
+        }
+    }
+
+    // The slot's context is owned by this stream, so the tasklet needn't go through the thread local pool.
+    slot.decompressed_size = tasklet::schedule([dctx = slot.dctx, ddict = m_ddict, out_buffer = slot.out_buffer,
+                                                block_data, compressed_size] {
+        return decompress_block(dctx, ddict, out_buffer, block_data, compressed_size);
+    });
+    return {};
 }
 
 Result<void, StreamError> ReadStream::read_next_block() {
     if (m_at_end) {
         return {};
     }
+    if (!m_readahead_slots.empty()) {
+        return read_next_readahead_block();
+    }
+    if (!m_stream) {
+        return read_next_mapped_block();
+    }
 
     // Read the worst-case block size.
     uint64_t chunk_size = VULL_TRY(m_stream->read({m_in_buffer, k_output_block_size}));
@@ -131,8 +423,13 @@ Result<void, StreamError> ReadStream::read_next_block() {
     }
 
     // Decompress into another buffer.
-    m_block_size = ZSTD_decompressDCtx(m_dctx, m_out_buffer, k_input_block_size, m_in_buffer, compressed_size);
+    m_block_data = m_out_buffer;
+    m_block_size = decompress_block(m_dctx, m_ddict, m_out_buffer, m_in_buffer, compressed_size);
     m_block_head = 0;
+    if (ZSTD_isError(m_block_size) != 0u) {
+        m_block_size = 0;
+        return StreamError::Unknown;
+    }
 
     VULL_ASSERT(m_block_size <= k_input_block_size);
     if (m_block_size != k_input_block_size) {
@@ -155,7 +452,106 @@ Result<void, StreamError> ReadStream::read_next_block() {
     return {};
 }
 
+Result<void, StreamError> ReadStream::read_next_mapped_block() {
+    if (m_mapped_block_offset >= m_mapping.size()) {
+        m_at_end = true;
+        return {};
+    }
+
+    // Decompress straight out of the mapping, skipping the copy into the input buffer.
+    const auto *block_data = m_mapping.data() + m_mapped_block_offset;
+    const auto available = vull::min(m_mapping.size() - m_mapped_block_offset, k_output_block_size);
+    uint64_t compressed_size = ZSTD_findFrameCompressedSize(block_data, available);
+    if (ZSTD_isError(compressed_size) != 0u) {
+        return StreamError::Unknown;
+    }
+    m_block_data = m_out_buffer;
+    m_block_size = decompress_block(m_dctx, m_ddict, m_out_buffer, block_data, compressed_size);
+    m_block_head = 0;
+    if (ZSTD_isError(m_block_size) != 0u) {
+        m_block_size = 0;
+        return StreamError::Unknown;
+    }
+
+    VULL_ASSERT(m_block_size <= k_input_block_size);
+    if (m_block_size != k_input_block_size) {
+        // Block wasn't a full block, so this must be the last block.
+        m_at_end = true;
+        return {};
+    }
+
+    const auto next_block_offset = VULL_TRY(read_mapped_link(m_mapped_block_offset + compressed_size));
+    if (next_block_offset == UINT64_MAX) {
+        // Edge case of a full block size multiple entry size, this is actually the last block.
+        m_at_end = true;
+        return {};
+    }
+    m_mapped_block_offset = next_block_offset;
+    return {};
+}
+
+Result<void, StreamError> ReadStream::read_next_readahead_block() {
+    // The block just consumed is free to be refilled with the next unfetched block, which keeps the ring in order.
+    if (m_readahead_consuming != UINT32_MAX && m_blocks_to_fetch > 0) {
+        VULL_TRY(fetch_readahead_block(m_readahead_slots[m_readahead_consuming]));
+    }
+
+    auto &slot = m_readahead_slots[m_readahead_head];
+    if (!slot.decompressed_size.is_valid()) {
+        // Either all blocks have been consumed or fetching a block failed.
+        m_at_end = true;
+        return m_blocks_to_fetch > 0 ? StreamError::Unknown : Result<void, StreamError>{};
+    }
+
+    m_block_data = slot.out_buffer;
+    m_block_size = slot.decompressed_size.await();
+    slot.decompressed_size = {};
+    m_block_head = 0;
+    m_readahead_consuming = m_readahead_head;
+    m_readahead_head = (m_readahead_head + 1) % m_readahead_slots.size();
+    if (ZSTD_isError(m_block_size) != 0u) {
+        m_block_size = 0;
+        return StreamError::Unknown;
+    }
+    VULL_ASSERT(m_block_size <= k_input_block_size);
+    return {};
+}
+
+Result<size_t, StreamError> ReadStream::read_raw(Span<void> data) {
+    const auto to_read = vull::min(uint64_t(data.size()), m_raw_remaining);
+    if (to_read == 0) {
+        return 0u;
+    }
+    if (!m_stream) {
+        if (m_mapped_block_offset + to_read > m_mapping.size()) {
+            return StreamError::Truncated;
+        }
+        memcpy(data.data(), m_mapping.data() + m_mapped_block_offset, to_read);
+        m_mapped_block_offset += to_read;
+        m_raw_remaining -= to_read;
+        return to_read;
+    }
+
+    // Positional read straight into the caller's buffer.
+    const auto bytes_read = VULL_TRY(m_stream->read({data.data(), to_read}));
+    m_raw_remaining -= bytes_read;
+    return bytes_read;
+}
+
 Result<size_t, StreamError> ReadStream::read(Span<void> data) {
+    if (m_codec == EntryCodec::Raw) {
+        // Loop in case of a short read.
+        size_t bytes_read = 0;
+        while (bytes_read < data.size()) {
+            const auto chunk_size = VULL_TRY(read_raw({data.byte_offset(bytes_read), data.size() - bytes_read}));
+            if (chunk_size == 0) {
+                break;
+            }
+            bytes_read += chunk_size;
+        }
+        return bytes_read;
+    }
+
     size_t to_read = data.size();
     while (to_read > 0) {
         if (m_block_head == m_block_size) {
@@ -165,7 +561,7 @@ Result<size_t, StreamError> ReadStream::read(Span<void> data) {
         if (to_copy == 0) {
             break;
         }
-        memcpy(data.byte_offset(data.size() - to_read), m_out_buffer + m_block_head, to_copy);
+        memcpy(data.byte_offset(data.size() - to_read), m_block_data + m_block_head, to_copy);
         m_block_head += to_copy;
         to_read -= to_copy;
     }
@@ -173,62 +569,143 @@ Result<size_t, StreamError> ReadStream::read(Span<void> data) {
 }
 
 Result<uint8_t, StreamError> ReadStream::read_byte() {
+    if (m_codec == EntryCodec::Raw) {
+        uint8_t byte;
+        if (VULL_TRY(read_raw({&byte, 1})) != 1) {
+            return StreamError::Truncated;
+        }
+        return byte;
+    }
+
     if (m_block_head == m_block_size) {
         VULL_TRY(read_next_block());
         if (m_block_head == m_block_size) {
             return StreamError::Truncated;
         }
     }
-    return m_out_buffer[m_block_head++];
+    return m_block_data[m_block_head++];
 }
 
-WriteStream::WriteStream(Writer &writer, UniquePtr<Stream> &&stream, String &&name, EntryType type)
+WriteStream::WriteStream(Writer &writer, UniquePtr<Stream> &&stream, String &&name, EntryType type, EntryCodec codec)
     : m_writer(writer), m_stream(vull::move(stream)) {
     m_entry.name = vull::move(name);
     m_entry.type = type;
+    m_entry.codec = codec;
+
+    // Raw entries bypass compression entirely.
+    if (codec == EntryCodec::Raw) {
+        return;
+    }
+    m_may_store_raw = writer.m_raw_threshold > 0.0f;
+    if (codec == EntryCodec::ZstdDict) {
+        VULL_ASSERT(writer.m_dictionary != nullptr);
+        m_entry.dictionary_name = String(writer.m_dictionary_name);
+    }
 
+    // Blocks can only be handed off to other tasklets from a tasklet context. By default, allow enough blocks in flight
+    // to keep every worker busy while the next block is filled, but no more, since each holds a compression context.
+    if (tasklet::in_tasklet_context()) {
+        m_slot_limit = writer.m_block_parallelism;
+        if (m_slot_limit == 0) {
+            m_slot_limit = tasklet::Scheduler::current().thread_count() + 1;
+        }
+    }
+    acquire_slot();
+    m_in_buffer = m_slots.first().in_buffer;
+}
+
+WriteStream::~WriteStream() {
+    // Ensure that all data has been flushed.
+    VULL_ASSERT(m_compress_head == 0);
+
+    // Blocks may still be in flight if an error occurred.
+    for (auto &slot : m_slots) {
+        if (slot.compressed_size.is_valid()) {
+            slot.compressed_size.await();
+        }
+        ZSTD_CCtx_refCDict(slot.cctx, nullptr);
+        WriteContext context(slot.cctx, slot.in_buffer, slot.out_buffer);
+        if (s_write_contexts.size() < k_max_cached_write_contexts) {
+            s_write_contexts.push(vull::move(context));
+        }
+    }
+}
+
+void WriteStream::acquire_slot() {
     if (s_write_contexts.empty()) {
         s_write_contexts.emplace();
     }
 
     auto context = s_write_contexts.take_last();
-    m_cctx = vull::exchange(context.cctx, nullptr);
-    m_in_buffer = vull::exchange(context.in_buffer, nullptr);
-    m_out_buffer = vull::exchange(context.out_buffer, nullptr);
+    auto *cctx = vull::exchange(context.cctx, nullptr);
 
-    // Set ZSTD compression level.
-    switch (writer.m_compression_level) {
-    case CompressionLevel::Fast:
-        ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, 12);
-        break;
-    case CompressionLevel::Normal:
-        ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, 18);
-        break;
-    case CompressionLevel::Ultra:
-        ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, 19);
-        break;
+    // Set ZSTD compression level, or use the writer's dictionary which has the level baked in.
+    if (m_entry.codec == EntryCodec::ZstdDict) {
+        ZSTD_CCtx_refCDict(cctx, m_writer.m_dictionary);
+    } else {
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, m_writer.zstd_compression_level());
     }
+    m_slots.push({
+        .cctx = cctx,
+        .in_buffer = vull::exchange(context.in_buffer, nullptr),
+        .out_buffer = vull::exchange(context.out_buffer, nullptr),
+    });
 }
 
-WriteStream::~WriteStream() {
-    // Ensure that all data has been flushed.
-    VULL_ASSERT(m_compress_head == 0);
-    s_write_contexts.emplace(m_cctx, m_in_buffer, m_out_buffer);
+Result<void, StreamError> WriteStream::emit_block(const BlockSlot &slot, size_t compressed_size) {
+    if (ZSTD_isError(compressed_size) != 0u) {
+        return StreamError::Unknown;
+    }
+
+    // Blocks are emitted in order, so the first one decides whether the entry is stored raw.
+    if (vull::exchange(m_may_store_raw, false)) {
+        const auto ratio = static_cast<float>(slot.size) / static_cast<float>(compressed_size);
+        m_store_raw = ratio < m_writer.m_raw_threshold;
+    }
+    if (m_store_raw) {
+        m_raw_data.extend(Span<const uint8_t>(slot.in_buffer, slot.size));
+        return {};
+    }
+    return write_block({slot.out_buffer, compressed_size});
+}
+
+Result<void, StreamError> WriteStream::emit_pending_block(BlockSlot &slot) {
+    const size_t compressed_size = slot.compressed_size.await();
+    slot.compressed_size = {};
+    return emit_block(slot, compressed_size);
 }
 
 Result<void, StreamError> WriteStream::flush_block() {
     VULL_ASSERT(m_compress_head != 0);
     m_entry.size += m_compress_head;
 
-    // Compress accumulated data into output buffer.
-    uint64_t compressed_size = ZSTD_compress2(m_cctx, m_out_buffer, k_output_block_size, m_in_buffer, m_compress_head);
-    if (ZSTD_isError(compressed_size) != 0u) {
-        return StreamError::Unknown;
+    // Compress accumulated data into the slot's output buffer.
+    auto &slot = m_slots[m_fill_index];
+    slot.size = vull::exchange(m_compress_head, 0u);
+    // There's no need to compress any more blocks once the entry is known to be stored raw.
+    auto compress = [cctx = slot.cctx, in_buffer = slot.in_buffer, out_buffer = slot.out_buffer, size = slot.size,
+                     store_raw = m_store_raw]() -> size_t {
+        return store_raw ? 0 : ZSTD_compress2(cctx, out_buffer, k_output_block_size, in_buffer, size);
+    };
+    if (m_slot_limit == 1) {
+        return emit_block(slot, compress());
+    }
+    slot.compressed_size = tasklet::schedule(vull::move(compress));
+
+    // Move on to the next slot in the ring, which if already in use holds the oldest block in flight.
+    m_fill_index = (m_fill_index + 1) % m_slot_limit;
+    if (m_fill_index == m_slots.size()) {
+        acquire_slot();
+    } else if (m_slots[m_fill_index].compressed_size.is_valid()) {
+        VULL_TRY(emit_pending_block(m_slots[m_fill_index]));
     }
-    m_compress_head = 0;
+    m_in_buffer = m_slots[m_fill_index].in_buffer;
+    return {};
+}
 
+Result<void, StreamError> WriteStream::write_block(Span<const uint8_t> block) {
     // Allocate space for compressed data + block link offset.
-    const uint64_t block_offset = m_writer.allocate_space(compressed_size + sizeof(uint64_t));
+    const uint64_t block_offset = m_writer.allocate_space(block.size() + sizeof(uint64_t));
     if (m_entry.first_block == 0) {
         m_entry.first_block = block_offset;
     }
@@ -243,11 +720,19 @@ Result<void, StreamError> WriteStream::flush_block() {
     // erroneous clang-tidy warning.
     constexpr auto block_link_sentinel = UINT64_MAX;
     VULL_TRY(m_stream->seek(block_offset, SeekMode::Set));
-    VULL_TRY(m_stream->write({m_out_buffer, compressed_size}));
+    VULL_TRY(m_stream->write(block));
     VULL_TRY(m_stream->write_be(block_link_sentinel));
 
     // Update block link offset.
-    m_block_link_offset = block_offset + compressed_size;
+    m_block_link_offset = block_offset + block.size();
+    return {};
+}
+
+Result<void, StreamError> WriteStream::write_raw() {
+    // Raw entries are stored contiguously with no block links so that they can be read in one go.
+    m_entry.first_block = m_writer.allocate_space(m_raw_data.size());
+    VULL_TRY(m_stream->seek(m_entry.first_block, SeekMode::Set));
+    VULL_TRY(m_stream->write(m_raw_data.span()));
     return {};
 }
 
@@ -255,11 +740,33 @@ Result<void, StreamError> WriteStream::finish() {
     if (m_compress_head > 0) {
         VULL_TRY(flush_block());
     }
+
+    // Drain the blocks still in flight, oldest first.
+    for (uint32_t i = 1; i <= m_slots.size(); i++) {
+        auto &slot = m_slots[(m_fill_index + i) % m_slots.size()];
+        if (slot.compressed_size.is_valid()) {
+            VULL_TRY(emit_pending_block(slot));
+        }
+    }
+
+    if (m_store_raw) {
+        m_entry.codec = EntryCodec::Raw;
+        m_entry.dictionary_name = {};
+    }
+    if (m_entry.codec == EntryCodec::Raw) {
+        VULL_TRY(write_raw());
+    }
     m_writer.add_finished_entry(vull::move(m_entry));
     return {};
 }
 
 Result<void, StreamError> WriteStream::write(Span<const void> data) {
+    if (m_entry.codec == EntryCodec::Raw) {
+        m_raw_data.extend(Span<const uint8_t>(static_cast<const uint8_t *>(data.data()), data.size()));
+        m_entry.size += static_cast<uint32_t>(data.size());
+        return {};
+    }
+
     for (size_t bytes_written = 0; bytes_written < data.size();) {
         const auto to_copy = vull::min(data.size() - bytes_written, k_input_block_size - m_compress_head);
         if (to_copy == 0) {
@@ -274,6 +781,12 @@ Result<void, StreamError> WriteStream::write(Span<const void> data) {
 }
 
 Result<void, StreamError> WriteStream::write_byte(uint8_t byte) {
+    if (m_entry.codec == EntryCodec::Raw) {
+        m_raw_data.push(byte);
+        m_entry.size++;
+        return {};
+    }
+
     if (m_compress_head == k_input_block_size) {
         VULL_TRY(flush_block());
     }
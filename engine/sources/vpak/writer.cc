@@ -1,5 +1,6 @@
 #include <vull/vpak/writer.hh>
 
+#include <vull/container/hash_map.hh>
 #include <vull/container/vector.hh>
 #include <vull/core/log.hh>
 #include <vull/platform/file.hh>
@@ -9,6 +10,7 @@
 #include <vull/support/perfect_hasher.hh>
 #include <vull/support/result.hh>
 #include <vull/support/scoped_lock.hh>
+#include <vull/support/span.hh>
 #include <vull/support/stream.hh>
 #include <vull/support/string.hh>
 #include <vull/support/string_view.hh>
@@ -19,9 +21,14 @@
 #include <vull/vpak/stream.hh>
 
 #include <stdint.h>
+#include <zstd.h>
 
 namespace vull::vpak {
 
+Writer::~Writer() {
+    ZSTD_freeCDict(m_dictionary);
+}
+
 void Writer::add_finished_entry(Entry &&entry) {
     ScopedLock lock(m_mutex);
     m_new_entries.push(vull::move(entry));
@@ -31,21 +38,35 @@ uint64_t Writer::allocate_space(uint64_t size) {
     return m_head.fetch_add(size);
 }
 
-Result<uint64_t, StreamError> Writer::finish(Vector<Entry> &entries) {
-    auto header_stream = m_write_file.create_stream();
-    auto table_stream = m_write_file.create_stream();
-    const auto entry_table_offset = VULL_TRY(table_stream.seek(0, SeekMode::End));
+int Writer::zstd_compression_level() const {
+    switch (m_compression_level) {
+    case CompressionLevel::Fast:
+        return 12;
+    case CompressionLevel::Ultra:
+        return 19;
+    default:
+        return 18;
+    }
+}
 
-    // Append new entries.
-    // TODO: This doesn't handle duplicate entries.
-    entries.extend(m_new_entries);
+Result<uint64_t, StreamError> Writer::finish(Vector<Entry> &entries, PerfectHasher &phf) {
+    auto table_stream = m_write_file.create_stream();
+    m_entry_table_offset = VULL_TRY(table_stream.seek(0, SeekMode::End));
 
-    // Write header.
-    VULL_TRY(header_stream.write_be<uint32_t>(k_magic_number));
-    VULL_TRY(header_stream.write_be<uint32_t>(1u));
-    VULL_TRY(header_stream.write_be<uint32_t>(0u));
-    VULL_TRY(header_stream.write_be<uint32_t>(entries.size()));
-    VULL_TRY(header_stream.write_be<uint64_t>(entry_table_offset));
+    // Append new entries, replacing any existing entries of the same name. Names are heap allocated, so the views stay
+    // valid as the vector grows, and replaced entries are swapped rather than destroyed to keep their names alive.
+    HashMap<StringView, uint32_t> entry_indices;
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        entry_indices.set(entries[i].name.view(), i);
+    }
+    for (auto &entry : m_new_entries) {
+        if (auto index = entry_indices.get(entry.name.view())) {
+            vull::swap(entries[*index], entry);
+            continue;
+        }
+        entry_indices.set(entry.name.view(), entries.size());
+        entries.push(vull::move(entry));
+    }
 
     // Write entry table.
     vull::debug("[vpak] Writing entry table ({} new entries, {} total)", m_new_entries.size(), entries.size());
@@ -56,7 +77,6 @@ Result<uint64_t, StreamError> Writer::finish(Vector<Entry> &entries) {
         keys.push(entry.name);
     }
 
-    PerfectHasher phf;
     phf.build(keys);
     vull::sort(entries, [&](const auto &lhs, const auto &rhs) {
         return phf.hash(lhs.name) > phf.hash(rhs.name);
@@ -70,13 +90,43 @@ Result<uint64_t, StreamError> Writer::finish(Vector<Entry> &entries) {
         VULL_TRY(table_stream.write_string(entry.name));
         VULL_TRY(table_stream.write_varint(entry.size));
         VULL_TRY(table_stream.write_varint(entry.first_block));
+        VULL_TRY(table_stream.write_byte(static_cast<uint8_t>(entry.codec)));
+        if (entry.codec == EntryCodec::ZstdDict) {
+            VULL_TRY(table_stream.write_string(entry.dictionary_name));
+        }
     }
     return VULL_TRY(table_stream.seek(0, SeekMode::Add));
 }
 
-WriteStream Writer::add_entry(String name, EntryType type) {
+Result<void, StreamError> Writer::write_header(uint32_t entry_count) {
+    // The header is written last so that an in-place update only takes effect once everything else is on disk.
+    auto header_stream = m_write_file.create_stream();
+    VULL_TRY(header_stream.write_be<uint32_t>(k_magic_number));
+    VULL_TRY(header_stream.write_be<uint32_t>(k_format_version));
+    VULL_TRY(header_stream.write_be<uint32_t>(0u));
+    VULL_TRY(header_stream.write_be<uint32_t>(entry_count));
+    VULL_TRY(header_stream.write_be<uint64_t>(m_entry_table_offset));
+    return {};
+}
+
+Result<void, StreamError, VpakError> Writer::add_dictionary(String name, Span<const void> data) {
+    // Load the dictionary first so that a bad one doesn't leave an entry behind.
+    auto *dictionary = ZSTD_createCDict(data.data(), data.size(), zstd_compression_level());
+    if (dictionary == nullptr) {
+        return VpakError::BadDictionary;
+    }
+    ZSTD_freeCDict(vull::exchange(m_dictionary, dictionary));
+    m_dictionary_name = String(name);
+
+    auto stream = add_entry(vull::move(name), EntryType::Blob, EntryCodec::Raw);
+    VULL_TRY(stream.write(data));
+    VULL_TRY(stream.finish());
+    return {};
+}
+
+WriteStream Writer::add_entry(String name, EntryType type, EntryCodec codec) {
     auto stream = vull::adopt_unique(m_write_file.create_stream());
-    return {*this, vull::move(stream), vull::move(name), type};
+    return {*this, vull::move(stream), vull::move(name), type, codec};
 }
 
 } // namespace vull::vpak
@@ -0,0 +1,227 @@
+#include <vull/ecs/command_buffer.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/support/assert.hh>
+#include <vull/support/atomic.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/move_tester.hh>
+#include <vull/test/test.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace vull {
+
+struct Stream;
+
+} // namespace vull
+
+namespace {
+
+struct Value {
+    VULL_DECLARE_COMPONENT(0);
+    uint32_t value;
+};
+
+struct Tracked : test::MoveTester {
+    VULL_DECLARE_COMPONENT(1);
+    using test::MoveTester::MoveTester;
+    static Tracked deserialise(Stream &) { VULL_ENSURE_NOT_REACHED(); }
+    static void serialise(Tracked &, Stream &) {}
+};
+
+void register_components(EntityManager &manager) {
+    manager.register_component<Value>();
+    manager.register_component<Tracked>();
+}
+
+} // namespace
+
+TEST_CASE(EntityCommandBuffer, Playback) {
+    EntityManager manager;
+    register_components(manager);
+    Vector<EntityId> entities;
+    for (uint32_t i = 0; i < 10; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Value>(i);
+        entities.push(entity);
+    }
+
+    // Record changes whilst iterating, which would otherwise invalidate the view.
+    EntityCommandBuffer commands;
+    Vector<PendingEntity> pending;
+    for (auto [entity, value] : manager.view<Value>()) {
+        if (value.value % 2 == 0) {
+            commands.destroy_entity(entity);
+            auto created = commands.create_entity();
+            commands.add_component<Value>(created, value.value + 100);
+            pending.push(created);
+        } else if (value.value % 3 == 0) {
+            commands.remove_component<Value>(entity);
+        }
+    }
+    EXPECT_THAT(manager.view<Value>().begin(), is(not_(equal_to(manager.view<Value>().end()))));
+    commands.playback(manager);
+
+    for (uint32_t i = 0; i < 10; i++) {
+        EXPECT_THAT(manager.valid(entities[i]), is(equal_to(i % 2 != 0)));
+        if (i % 2 != 0) {
+            EXPECT_THAT(manager.has_component<Value>(entities[i]), is(equal_to(i % 3 != 0)));
+        }
+    }
+    for (uint32_t i = 0; i < pending.size(); i++) {
+        const auto id = commands.resolve(pending[i]);
+        EXPECT_TRUE(manager.valid(id));
+        EXPECT_THAT(manager.get_component<Value>(id).value, is(equal_to(i * 2 + 100)));
+    }
+}
+
+TEST_CASE(EntityCommandBuffer, CommandsOnDestroyedEntity) {
+    EntityManager manager;
+    register_components(manager);
+    auto entity = manager.create_entity();
+
+    // Commands recorded after a destroy of the same entity are dropped.
+    size_t destruct_count = 0;
+    EntityCommandBuffer commands;
+    commands.add_component<Value>(entity, 1u);
+    commands.destroy_entity(entity);
+    commands.add_component<Tracked>(entity, destruct_count);
+    commands.playback(manager);
+    EXPECT_FALSE(manager.valid(entity));
+    EXPECT_THAT(destruct_count, is(equal_to(1)));
+
+    // Entities with a recycled ID can still be targeted.
+    auto recycled = manager.create_entity();
+    EXPECT_THAT(entity_index(recycled), is(equal_to(entity_index(entity))));
+    commands.add_component<Value>(recycled, 5u);
+    commands.destroy_entity(entity);
+    commands.playback(manager);
+    EXPECT_TRUE(manager.valid(recycled));
+    EXPECT_THAT(manager.get_component<Value>(recycled).value, is(equal_to(5)));
+}
+
+TEST_CASE(EntityCommandBuffer, ComponentLifetime) {
+    size_t destruct_count = 0;
+    {
+        EntityManager manager;
+        register_components(manager);
+        EntityCommandBuffer commands;
+        for (uint32_t i = 0; i < 1000; i++) {
+            commands.add_component<Tracked>(commands.create_entity(), destruct_count);
+        }
+
+        // Clearing should destroy the recorded components.
+        commands.clear();
+        EXPECT_THAT(destruct_count, is(equal_to(1000)));
+        EXPECT_THAT(manager.view<Tracked>().begin(), is(equal_to(manager.view<Tracked>().end())));
+
+        for (uint32_t i = 0; i < 1000; i++) {
+            commands.add_component<Tracked>(commands.create_entity(), destruct_count);
+        }
+        commands.playback(manager);
+
+        // Only the moved-from components should have been destroyed.
+        uint32_t count = 0;
+        for (auto [entity, tracked] : manager.view<Tracked>()) {
+            EXPECT_FALSE(tracked.is_empty());
+            count++;
+        }
+        EXPECT_THAT(count, is(equal_to(1000)));
+        EXPECT_THAT(destruct_count, is(equal_to(1000)));
+    }
+    EXPECT_THAT(destruct_count, is(equal_to(2000)));
+}
+
+TEST_CASE(EntityCommandBuffer, ConcurrentRecording) {
+    EntityManager manager;
+    register_components(manager);
+    EntityCommandBuffer commands;
+
+    constexpr uint32_t tasklet_count = 64;
+    constexpr uint32_t per_tasklet = 500;
+    tasklet::Scheduler scheduler(4, 64, false);
+    scheduler.run([&] {
+        tasklet::Latch latch(tasklet_count);
+        for (uint32_t i = 0; i < tasklet_count; i++) {
+            tasklet::schedule([&commands, &latch, i] {
+                for (uint32_t j = 0; j < per_tasklet; j++) {
+                    commands.add_component<Value>(commands.create_entity(), i * per_tasklet + j);
+                }
+                latch.count_down();
+            });
+        }
+        latch.wait();
+    });
+    commands.playback(manager);
+
+    Vector<bool> seen(tasklet_count * per_tasklet);
+    uint32_t count = 0;
+    for (auto [entity, value] : manager.view<Value>()) {
+        EXPECT_TRUE(value.value < seen.size());
+        EXPECT_FALSE(seen[value.value]);
+        seen[value.value] = true;
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(tasklet_count * per_tasklet)));
+}
+
+TEST_CASE(EntityCommandBuffer, OrderAcrossSuspension) {
+    EntityManager manager;
+    register_components(manager);
+    constexpr uint32_t tasklet_count = 64;
+    constexpr uint32_t per_tasklet = 8;
+    Vector<EntityId> entities;
+    for (uint32_t i = 0; i < tasklet_count * per_tasklet; i++) {
+        entities.push(manager.create_entity());
+    }
+
+    // Each tasklet waits for all of the others between commands, so is likely to resume on a different thread.
+    EntityCommandBuffer commands;
+    tasklet::Scheduler scheduler(4, 128, false);
+    scheduler.run([&] {
+        tasklet::Latch first(tasklet_count);
+        tasklet::Latch second(tasklet_count);
+        tasklet::Latch done(tasklet_count);
+        for (uint32_t i = 0; i < tasklet_count; i++) {
+            tasklet::schedule([&, i] {
+                const auto record = [&](auto fn) {
+                    for (uint32_t j = 0; j < per_tasklet; j++) {
+                        fn(entities[i * per_tasklet + j]);
+                    }
+                };
+                record([&](EntityId id) {
+                    commands.add_component<Value>(id, 1u);
+                });
+                first.count_down();
+                first.wait();
+                record([&](EntityId id) {
+                    commands.remove_component<Value>(id);
+                });
+                second.count_down();
+                second.wait();
+                record([&](EntityId id) {
+                    commands.add_component<Value>(id, 2u);
+                });
+                done.count_down();
+            });
+        }
+        done.wait();
+    });
+    commands.playback(manager);
+
+    for (EntityId id : entities) {
+        EXPECT_TRUE(manager.has_component<Value>(id));
+        EXPECT_THAT(manager.get_component<Value>(id).value, is(equal_to(2u)));
+    }
+}
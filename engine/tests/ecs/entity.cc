@@ -4,14 +4,18 @@
 #include <vull/ecs/component.hh>
 #include <vull/ecs/entity_id.hh>
 #include <vull/support/assert.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/span.hh>
 #include <vull/support/tuple.hh>
 #include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
 #include <vull/test/assertions.hh>
 #include <vull/test/matchers.hh>
 #include <vull/test/move_tester.hh>
 #include <vull/test/test.hh>
 
 #include <stddef.h>
+#include <stdint.h>
 
 using namespace vull;
 using namespace vull::test::matchers;
@@ -42,6 +46,38 @@ struct Bar : BaseComp {
     static Bar deserialise(Stream &) { VULL_ENSURE_NOT_REACHED(); }
 };
 
+struct Counter {
+    VULL_DECLARE_COMPONENT(2);
+    uint32_t visit_count;
+};
+
+struct Weight {
+    VULL_DECLARE_COMPONENT(3);
+    uint32_t value;
+};
+
+struct Link {
+    VULL_DECLARE_COMPONENT(4);
+    EntityId target;
+
+    void remap_entities(Span<const EntityId> ids) { target = ids[entity_index(target)]; }
+};
+
+void check_parallel_for(EntityManager &manager, uint32_t grain_size) {
+    Atomic<uint32_t> visit_count;
+    manager.parallel_for<Counter, const Weight>(
+        [&](Entity, Counter &counter, const Weight &weight) {
+            counter.visit_count += weight.value;
+            visit_count.fetch_add(1, vull::memory_order_relaxed);
+        },
+        grain_size);
+    EXPECT_THAT(visit_count.load(), is(equal_to(5000)));
+    for (auto [entity, counter] : manager.view<Counter>()) {
+        EXPECT_THAT(counter.visit_count, is(equal_to(entity.has<Weight>() ? entity % 7 : 0)));
+        counter.visit_count = 0;
+    }
+}
+
 template <typename... Comps>
 Vector<Tuple<Entity, Comps &...>> sum_view(EntityManager &manager) {
     Vector<Tuple<Entity, Comps &...>> matching;
@@ -175,3 +211,252 @@ TEST_CASE(Entity, ViewNoFirstMatch) {
     auto view = manager.view<Foo, Bar>();
     EXPECT_THAT(view.begin(), is(equal_to(view.end())));
 }
+
+TEST_CASE(Entity, ParallelFor) {
+    EntityManager manager;
+    manager.register_component<Counter>();
+    manager.register_component<Weight>();
+    for (uint32_t i = 0; i < 10000; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Counter>(0u);
+        if (i % 2 == 0) {
+            entity.add<Weight>(i % 7);
+        }
+    }
+
+    // Outside of a tasklet context, everything runs inline.
+    check_parallel_for(manager, 64);
+
+    tasklet::Scheduler scheduler(4, 64, false);
+    scheduler.run([&] {
+        check_parallel_for(manager, 64);
+        check_parallel_for(manager, 1000);
+        check_parallel_for(manager, 20000);
+    });
+}
+
+TEST_CASE(Entity, ViewSmallestSet) {
+    EntityManager manager;
+    manager.register_component<Counter>();
+    manager.register_component<Weight>();
+    for (uint32_t i = 0; i < 1000; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Counter>(i);
+        if (i % 100 == 0) {
+            entity.add<Weight>(i);
+        }
+    }
+
+    // The view should walk the much smaller weight set, but the results are the same either way round.
+    uint32_t count = 0;
+    for (auto [entity, counter, weight] : manager.view<Counter, Weight>()) {
+        EXPECT_THAT(counter.visit_count, is(equal_to(EntityId(entity))));
+        EXPECT_THAT(weight.value, is(equal_to(EntityId(entity))));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(10)));
+    count = 0;
+    for (auto [entity, weight, counter] : manager.view<Weight, Counter>()) {
+        EXPECT_THAT(counter.visit_count, is(equal_to(weight.value)));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(10)));
+}
+
+TEST_CASE(Entity, Group) {
+    EntityManager manager;
+    manager.register_component<Counter>();
+    manager.register_component<Weight>();
+
+    // Some entities exist before the group is created, and some after.
+    Vector<Entity> entities;
+    const auto add_entities = [&](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            auto entity = manager.create_entity();
+            entity.add<Counter>(entity_index(entity));
+            if (entity % 3 == 0) {
+                entity.add<Weight>(entity_index(entity));
+            }
+            entities.push(entity);
+        }
+    };
+    const auto check_group = [&] {
+        uint32_t expected = 0;
+        for (auto [entity, weight] : manager.view<Weight>()) {
+            expected += entity.has<Counter>() ? 1 : 0;
+        }
+        auto group = manager.group<Counter, Weight>();
+        EXPECT_THAT(group.size(), is(equal_to(expected)));
+        uint32_t count = 0;
+        for (auto [entity, counter, weight] : group) {
+            EXPECT_THAT(counter.visit_count, is(equal_to(EntityId(entity))));
+            EXPECT_THAT(weight.value, is(equal_to(EntityId(entity))));
+            count++;
+        }
+        EXPECT_THAT(count, is(equal_to(expected)));
+    };
+
+    add_entities(100);
+    manager.create_group<Counter, Weight>();
+    check_group();
+    add_entities(100);
+    check_group();
+
+    // Remove components from and destroy some grouped entities.
+    for (uint32_t i = 0; i < entities.size(); i += 9) {
+        entities[i].remove<Weight>();
+    }
+    check_group();
+    for (uint32_t i = 3; i < entities.size(); i += 12) {
+        entities[i].remove<Counter>();
+    }
+    check_group();
+    for (uint32_t i = 6; i < entities.size(); i += 15) {
+        entities[i].destroy();
+    }
+    check_group();
+
+    // Weight added after Counter and the other way round.
+    auto entity = manager.create_entity();
+    entity.add<Weight>(entity_index(entity));
+    entity.add<Counter>(entity_index(entity));
+    check_group();
+}
+
+TEST_CASE(Entity, ChangeFilters) {
+    EntityManager manager;
+    manager.register_component<Counter>();
+    manager.register_component<Weight>();
+    Vector<EntityId> entities;
+    for (uint32_t i = 0; i < 100; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Counter>(i);
+        if (i % 2 == 0) {
+            entity.add<Weight>(i);
+        }
+        entities.push(entity);
+    }
+
+    // Everything was added this tick.
+    uint32_t count = 0;
+    for (auto [entity, counter, weight] : manager.view<Added<Counter>, Weight>()) {
+        EXPECT_THAT(counter.visit_count, is(equal_to(weight.value)));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(50)));
+
+    // Nothing has changed since advancing.
+    const auto first_tick = manager.change_tick();
+    manager.advance_tick();
+    EXPECT_THAT(manager.view<Changed<Counter>>().begin(), is(equal_to(manager.view<Changed<Counter>>().end())));
+    EXPECT_THAT(manager.view<Added<Weight>>().begin(), is(equal_to(manager.view<Added<Weight>>().end())));
+
+    for (uint32_t i = 0; i < 100; i += 5) {
+        manager.mark_changed<Counter>(entities[i]);
+    }
+    // Removing entities swaps the ticks along with the components.
+    manager.destroy_entity(entities[0]);
+    manager.destroy_entity(entities[1]);
+
+    count = 0;
+    for (auto [entity, counter] : manager.view<Changed<Counter>>()) {
+        EXPECT_THAT(counter.visit_count % 5, is(equal_to(0)));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(19)));
+
+    count = 0;
+    for (auto [entity, weight, counter] : manager.view<Weight, Changed<Counter>>()) {
+        EXPECT_THAT(counter.visit_count % 10, is(equal_to(0)));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(9)));
+
+    // Both ticks' worth of changes.
+    count = 0;
+    for (auto [entity, counter] : manager.view<Changed<Counter>>(first_tick - 1)) {
+        EXPECT_THAT(counter.visit_count, is(equal_to(entity_index(entity))));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(98)));
+}
+
+TEST_CASE(Entity, RemovedList) {
+    EntityManager manager;
+    manager.register_component<Counter>();
+    manager.register_component<Weight>();
+    manager.track_removed<Weight>();
+
+    auto a = manager.create_entity();
+    a.add<Counter>(0u);
+    a.add<Weight>(0u);
+    auto b = manager.create_entity();
+    b.add<Counter>(0u);
+    b.add<Weight>(0u);
+    EXPECT_THAT(manager.removed<Weight>().size(), is(equal_to(0)));
+
+    a.remove<Weight>();
+    b.destroy();
+    a.remove<Counter>();
+    EXPECT_THAT(manager.removed<Counter>().size(), is(equal_to(0)));
+    EXPECT_THAT(manager.removed<Weight>().size(), is(equal_to(2)));
+    EXPECT_THAT(manager.removed<Weight>()[0], is(equal_to(EntityId(a))));
+    EXPECT_THAT(manager.removed<Weight>()[1], is(equal_to(EntityId(b))));
+
+    manager.advance_tick();
+    EXPECT_THAT(manager.removed<Weight>().size(), is(equal_to(0)));
+}
+
+TEST_CASE(Entity, Merge) {
+    size_t destruct_count = 0;
+    EntityManager manager;
+    manager.register_component<Foo>();
+    manager.register_component<Counter>();
+    manager.register_component<Weight>();
+    manager.register_component<Link>();
+    manager.create_group<Counter, Weight>();
+    for (uint32_t i = 0; i < 10; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Counter>(i);
+        entity.add<Weight>(i);
+    }
+    // Leave a free slot to be recycled.
+    manager.destroy_entity(EntityId(3));
+    manager.advance_tick();
+
+    EntityManager other;
+    other.register_component<Foo>();
+    other.register_component<Counter>();
+    other.register_component<Link>();
+    for (uint32_t i = 0; i < 100; i++) {
+        auto entity = other.create_entity();
+        entity.add<Counter>(i + 100);
+        entity.add<Foo>(destruct_count);
+        entity.add<Link>(EntityId(i == 0 ? 0 : i - 1));
+    }
+    other.destroy_entity(EntityId(50));
+    EXPECT_THAT(destruct_count, is(equal_to(1)));
+
+    auto ids = manager.merge(vull::move(other));
+    EXPECT_THAT(ids.size(), is(equal_to(100)));
+    EXPECT_THAT(ids[50], is(equal_to(~EntityId(0))));
+    EXPECT_THAT(entity_index(ids[0]), is(equal_to(3)));
+    EXPECT_THAT(other.view<Counter>().begin(), is(equal_to(other.view<Counter>().end())));
+
+    // Nothing besides the destroyed entity's component should have been destroyed.
+    EXPECT_THAT(destruct_count, is(equal_to(1)));
+    uint32_t count = 0;
+    for (auto [entity, counter, foo, link] : manager.view<Added<Counter>, Foo, Link>()) {
+        const auto i = counter.visit_count - 100;
+        EXPECT_THAT(entity_index(entity), is(equal_to(entity_index(ids[i]))));
+        EXPECT_FALSE(foo.is_empty());
+        EXPECT_THAT(link.target, is(equal_to(ids[i == 0 ? 0 : i - 1])));
+        count++;
+    }
+    EXPECT_THAT(count, is(equal_to(99)));
+
+    // Merged entities can be grouped.
+    manager.add_component<Weight>(ids[10], 5u);
+    auto group = manager.group<Counter, Weight>();
+    EXPECT_THAT(group.size(), is(equal_to(10)));
+}
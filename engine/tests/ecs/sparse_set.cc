@@ -0,0 +1,79 @@
+#include <vull/ecs/sparse_set.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+struct Value {
+    uint32_t value;
+};
+
+} // namespace
+
+TEST_CASE(SparseSet, EmplaceRemove) {
+    SparseSet<EntityId> set;
+    set.initialise<Value>();
+    for (EntityId i = 0; i < 10000; i += 3) {
+        set.emplace<Value>(i, i * 2);
+    }
+    for (EntityId i = 0; i < 10000; i++) {
+        EXPECT_THAT(set.contains(i), is(equal_to(i % 3 == 0)));
+    }
+    for (EntityId i = 0; i < 10000; i += 6) {
+        set.remove(i);
+    }
+    for (EntityId i = 0; i < 10000; i++) {
+        EXPECT_THAT(set.contains(i), is(equal_to(i % 3 == 0 && i % 6 != 0)));
+        if (set.contains(i)) {
+            EXPECT_THAT(set.at<Value>(i).value, is(equal_to(i * 2)));
+        }
+    }
+}
+
+TEST_CASE(SparseSet, ScatteredMemoryUsage) {
+    // A handful of entities spread across the whole 24-bit index range, each on a different page.
+    Vector<EntityId> indices;
+    for (EntityId i = 0; i < 64; i++) {
+        indices.push(i * 260000u + 1000u);
+    }
+    indices.push(entity_index(~EntityId(0)));
+
+    SparseSet<EntityId> set;
+    set.initialise<Value>();
+    EXPECT_THAT(set.sparse_memory_usage(), is(equal_to(0u)));
+    for (auto index : indices) {
+        set.emplace<Value>(index, index);
+    }
+    for (auto index : indices) {
+        EXPECT_TRUE(set.contains(index));
+        EXPECT_FALSE(set.contains(index - 1));
+        EXPECT_THAT(set.at<Value>(index).value, is(equal_to(index)));
+    }
+
+    // A flat sparse array would need 64 MiB, whereas each entity should only cost a page of around 16 KiB, plus a page
+    // table of a few tens of KiB.
+    const size_t flat_usage = size_t(entity_index(~EntityId(0)) + 1) * sizeof(EntityId);
+    const size_t paged_usage = set.sparse_memory_usage();
+    EXPECT_TRUE(paged_usage < indices.size() * 16500 + 65536);
+    EXPECT_TRUE(paged_usage * 50 < flat_usage);
+
+    // Removing everything should free all of the pages, leaving only the page table.
+    for (auto index : indices) {
+        set.remove(index);
+    }
+    EXPECT_TRUE(set.sparse_memory_usage() <= 65536);
+    EXPECT_TRUE(set.sparse_memory_usage() + indices.size() * 16384 <= paged_usage);
+    for (auto index : indices) {
+        EXPECT_FALSE(set.contains(index));
+    }
+}
@@ -0,0 +1,190 @@
+#include <vull/ecs/system_scheduler.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/support/atomic.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x;
+};
+
+struct Velocity {
+    VULL_DECLARE_COMPONENT(1);
+    float x;
+};
+
+struct Health {
+    VULL_DECLARE_COMPONENT(2);
+    uint32_t value;
+};
+
+} // namespace
+
+TEST_CASE(SystemScheduler, Conflicts) {
+    SystemScheduler scheduler;
+    auto &integrate = scheduler.add_system("integrate", [](EntityManager &) {}).reads<Velocity>().writes<Position>();
+    auto &accelerate = scheduler.add_system("accelerate", [](EntityManager &) {}).writes<Velocity>();
+    auto &render = scheduler.add_system("render", [](EntityManager &) {}).reads<Position>();
+    auto &regen = scheduler.add_system("regen", [](EntityManager &) {}).writes<Health>();
+    auto &spawn = scheduler.add_system("spawn", [](EntityManager &) {}).exclusive();
+    auto &idle = scheduler.add_system("idle", [](EntityManager &) {});
+
+    EXPECT_TRUE(integrate.conflicts_with(accelerate));
+    EXPECT_TRUE(integrate.conflicts_with(render));
+    EXPECT_FALSE(accelerate.conflicts_with(render));
+    EXPECT_FALSE(regen.conflicts_with(integrate));
+    EXPECT_FALSE(idle.conflicts_with(render));
+    EXPECT_TRUE(spawn.conflicts_with(idle));
+
+    // Readers of the same component don't conflict.
+    auto &render2 = scheduler.add_system("render2", [](EntityManager &) {}).reads<Position>();
+    EXPECT_FALSE(render.conflicts_with(render2));
+
+    EntityManager manager;
+    scheduler.run(manager);
+    EXPECT_THAT(integrate.dependency_count(), is(equal_to(0)));
+    EXPECT_THAT(accelerate.dependency_count(), is(equal_to(1)));
+    EXPECT_THAT(render.dependency_count(), is(equal_to(1)));
+    EXPECT_THAT(regen.dependency_count(), is(equal_to(0)));
+    EXPECT_THAT(spawn.dependency_count(), is(equal_to(4)));
+    EXPECT_THAT(idle.dependency_count(), is(equal_to(1)));
+    EXPECT_THAT(render2.dependency_count(), is(equal_to(2)));
+}
+
+TEST_CASE(SystemScheduler, AccessChangedAfterRun) {
+    SystemScheduler scheduler;
+    auto &integrate = scheduler.add_system("integrate", [](EntityManager &) {}).writes<Position>();
+    auto &render = scheduler.add_system("render", [](EntityManager &) {});
+    auto &spawn = scheduler.add_system("spawn", [](EntityManager &) {});
+
+    EntityManager manager;
+    scheduler.run(manager);
+    EXPECT_THAT(render.dependency_count(), is(equal_to(0)));
+    EXPECT_THAT(spawn.dependency_count(), is(equal_to(0)));
+
+    // Declaring access later should still be picked up by the next run.
+    render.reads<Position>();
+    scheduler.run(manager);
+    EXPECT_THAT(render.dependency_count(), is(equal_to(1)));
+    EXPECT_THAT(spawn.dependency_count(), is(equal_to(0)));
+
+    spawn.exclusive();
+    scheduler.run(manager);
+    EXPECT_THAT(integrate.dependency_count(), is(equal_to(0)));
+    EXPECT_THAT(spawn.dependency_count(), is(equal_to(2)));
+}
+
+TEST_CASE(SystemScheduler, Ordering) {
+    EntityManager manager;
+    manager.register_component<Position>();
+    manager.register_component<Velocity>();
+    manager.register_component<Health>();
+    for (uint32_t i = 0; i < 1000; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Position>(0.0f);
+        entity.add<Velocity>(0.0f);
+        entity.add<Health>(0u);
+    }
+
+    // Tracks the order in which systems finish, and how many exclusive systems are running alongside others.
+    Atomic<uint32_t> step;
+    Atomic<uint32_t> running;
+    Atomic<uint32_t> overlap_count;
+    uint32_t accelerate_step = 0;
+    uint32_t integrate_step = 0;
+    uint32_t check_step = 0;
+    uint32_t regen_step = 0;
+
+    SystemScheduler scheduler;
+    const auto enter = [&] {
+        running.fetch_add(1);
+        tasklet::yield();
+    };
+    const auto leave = [&](uint32_t &system_step) {
+        system_step = step.fetch_add(1) + 1;
+        running.fetch_sub(1);
+    };
+    scheduler
+        .add_system("accelerate",
+                    [&](EntityManager &manager) {
+                        enter();
+                        for (auto [entity, velocity] : manager.view<Velocity>()) {
+                            velocity.x += 1.0f;
+                        }
+                        leave(accelerate_step);
+                    })
+        .writes<Velocity>();
+    scheduler
+        .add_system("integrate",
+                    [&](EntityManager &manager) {
+                        enter();
+                        for (auto [entity, position, velocity] : manager.view<Position, Velocity>()) {
+                            position.x += velocity.x;
+                        }
+                        leave(integrate_step);
+                    })
+        .reads<Velocity>()
+        .writes<Position>();
+    scheduler
+        .add_system("regen",
+                    [&](EntityManager &manager) {
+                        enter();
+                        for (auto [entity, health] : manager.view<Health>()) {
+                            health.value++;
+                        }
+                        leave(regen_step);
+                    })
+        .writes<Health>();
+    scheduler
+        .add_system("check",
+                    [&](EntityManager &) {
+                        if (running.fetch_add(1) != 0) {
+                            overlap_count.fetch_add(1);
+                        }
+                        leave(check_step);
+                    })
+        .exclusive();
+
+    tasklet::Scheduler tasklet_scheduler(4, 64, false);
+    tasklet_scheduler.run([&] {
+        for (uint32_t frame = 1; frame <= 10; frame++) {
+            step.store(0);
+            scheduler.run(manager);
+            EXPECT_TRUE(accelerate_step < integrate_step);
+            EXPECT_THAT(check_step, is(equal_to(4)));
+            EXPECT_THAT(running.load(), is(equal_to(0)));
+            for (auto [entity, position, velocity, health] : manager.view<Position, Velocity, Health>()) {
+                EXPECT_THAT(velocity.x, is(equal_to(float(frame))));
+                EXPECT_THAT(position.x, is(equal_to(float(frame * (frame + 1) / 2))));
+                EXPECT_THAT(health.value, is(equal_to(frame)));
+            }
+        }
+    });
+    EXPECT_THAT(overlap_count.load(), is(equal_to(0)));
+    EXPECT_TRUE(regen_step != 0);
+    for (const auto &system : scheduler.systems()) {
+        EXPECT_TRUE(system->duration() >= 0.0f);
+    }
+
+    // Outside of a tasklet context, everything runs inline in order.
+    step.store(0);
+    scheduler.run(manager);
+    EXPECT_THAT(accelerate_step, is(equal_to(1)));
+    EXPECT_THAT(integrate_step, is(equal_to(2)));
+    EXPECT_THAT(regen_step, is(equal_to(3)));
+    EXPECT_THAT(check_step, is(equal_to(4)));
+}
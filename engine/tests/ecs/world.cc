@@ -0,0 +1,120 @@
+#include <vull/ecs/world.hh>
+
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/common.hh>
+#include <vull/platform/file.hh>
+#include <vull/support/result.hh>
+#include <vull/support/stream.hh>
+#include <vull/support/string.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+#include <vull/vpak/defs.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/stream.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+// Trivially copyable, so takes the bulk read path.
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x, y, z;
+};
+
+// Has its own (de)serialise functions, so must be read one at a time.
+struct Score {
+    VULL_DECLARE_COMPONENT(1);
+    uint32_t value;
+
+    explicit Score(uint32_t value) : value(value) {}
+
+    static Score deserialise(Stream &stream) { return Score(VULL_EXPECT(stream.read_varint<uint32_t>())); }
+    static void serialise(Score &score, Stream &stream) { VULL_EXPECT(stream.write_varint(score.value)); }
+};
+
+void register_components(World &world) {
+    world.register_component<Position>();
+    world.register_component<Score>();
+}
+
+void check_round_trip(EntityIdEncoding id_encoding, bool grouped = false) {
+    constexpr uint32_t entity_count = 20000;
+    VULL_IGNORE(platform::unlink_path("world.vpak"));
+    {
+        World world;
+        register_components(world);
+        for (uint32_t i = 0; i < entity_count; i++) {
+            auto entity = world.create_entity();
+            if (i % 3 != 0) {
+                entity.add<Position>(float(i), float(i) * 2.0f, -float(i));
+            }
+            if (i % 5 == 0) {
+                entity.add<Score>(i * 7);
+            }
+        }
+
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("world.vpak"));
+        auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+        VULL_EXPECT(world.serialise(writer, "world", id_encoding));
+        VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+    }
+
+    auto pack_file = VULL_EXPECT(vpak::PackFile::open("world.vpak"));
+    auto stream = pack_file.open_entry("world");
+    EXPECT_TRUE(stream);
+
+    World world;
+    register_components(world);
+    if (grouped) {
+        world.create_group<Position, Score>();
+    }
+    VULL_EXPECT(world.deserialise(*stream));
+    for (EntityId id = 0; id < entity_count; id++) {
+        EXPECT_THAT(world.has_component<Position>(id), is(equal_to(id % 3 != 0)));
+        EXPECT_THAT(world.has_component<Score>(id), is(equal_to(id % 5 == 0)));
+        if (id % 3 != 0) {
+            const auto &position = world.get_component<Position>(id);
+            EXPECT_THAT(position.x, is(equal_to(float(id))));
+            EXPECT_THAT(position.y, is(equal_to(float(id) * 2.0f)));
+            EXPECT_THAT(position.z, is(equal_to(-float(id))));
+        }
+        if (id % 5 == 0) {
+            EXPECT_THAT(world.get_component<Score>(id).value, is(equal_to(id * 7)));
+        }
+    }
+    if (grouped) {
+        // Entities with both components, with IDs which are multiples of five but not three.
+        uint32_t count = 0;
+        for (auto [entity, position, score] : world.group<Position, Score>()) {
+            EXPECT_THAT(position.x, is(equal_to(float(entity_index(entity)))));
+            EXPECT_THAT(score.value, is(equal_to(entity_index(entity) * 7)));
+            count++;
+        }
+        EXPECT_THAT(count, is(equal_to(entity_count / 5 - vull::ceil_div(entity_count, 15u))));
+    }
+    VULL_IGNORE(platform::unlink_path("world.vpak"));
+}
+
+} // namespace
+
+TEST_CASE(World, RoundTripVarintIds) {
+    check_round_trip(EntityIdEncoding::Varint);
+}
+
+TEST_CASE(World, RoundTripFixedWidthIds) {
+    check_round_trip(EntityIdEncoding::FixedWidth);
+}
+
+TEST_CASE(World, RoundTripIntoGroup) {
+    check_round_trip(EntityIdEncoding::FixedWidth, true);
+}
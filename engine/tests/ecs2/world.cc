@@ -1,5 +1,10 @@
+#include <vull/container/vector.hh>
+#include <vull/ecs/component.hh>
 #include <vull/ecs2/entity.hh>
 #include <vull/ecs2/world.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
 #include <vull/test/assertions.hh>
 #include <vull/test/matchers.hh>
 #include <vull/test/test.hh>
@@ -53,3 +58,140 @@ TEST_CASE(EcsWorld, VersionLimit) {
     world.create();
     EXPECT_FALSE(world.is_valid(first));
 }
+
+namespace {
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x;
+    float y;
+};
+
+struct Velocity {
+    VULL_DECLARE_COMPONENT(1);
+    float dx;
+    float dy;
+};
+
+struct Name {
+    VULL_DECLARE_COMPONENT(2);
+    String name;
+};
+
+struct Tracked {
+    VULL_DECLARE_COMPONENT(3);
+    int *live_count;
+
+    explicit Tracked(int *live_count) : live_count(live_count) { ++*live_count; }
+    Tracked(const Tracked &) = delete;
+    Tracked(Tracked &&other) : live_count(other.live_count) { ++*live_count; }
+    ~Tracked() { --*live_count; }
+
+    Tracked &operator=(const Tracked &) = delete;
+    Tracked &operator=(Tracked &&) = delete;
+};
+
+} // namespace
+
+TEST_CASE(EcsWorld, AddGetRemove) {
+    ecs::World world;
+    auto entity = world.create();
+    EXPECT_FALSE(world.has_component<Position>(entity));
+
+    world.add_component<Position>(entity, 1.0f, 2.0f);
+    world.add_component<Name>(entity, String("foo"));
+    EXPECT_TRUE((world.has_component<Position, Name>(entity)));
+    EXPECT_FALSE((world.has_component<Position, Velocity>(entity)));
+    EXPECT_THAT(world.get_component<Position>(entity).y, is(equal_to(2.0f)));
+    EXPECT_THAT(world.get_component<Name>(entity).name.view(), is(equal_to(StringView("foo"))));
+
+    world.remove_component<Position>(entity);
+    EXPECT_FALSE(world.has_component<Position>(entity));
+    EXPECT_TRUE(world.has_component<Name>(entity));
+    EXPECT_THAT(world.get_component<Name>(entity).name.view(), is(equal_to(StringView("foo"))));
+
+    // The root archetype, {Position}, {Position, Name}, and {Name}.
+    EXPECT_THAT(world.archetype_count(), is(equal_to(4)));
+}
+
+TEST_CASE(EcsWorld, ForEach) {
+    ecs::World world;
+    Vector<ecs::Entity> entities;
+    for (uint32_t i = 0; i < 10000; i++) {
+        auto entity = world.create();
+        world.add_component<Position>(entity, static_cast<float>(i), 0.0f);
+        if (i % 2 == 0) {
+            world.add_component<Velocity>(entity, 1.0f, 2.0f);
+        }
+        if (i % 3 == 0) {
+            world.add_component<Name>(entity, vull::format("{}", i));
+        }
+        entities.push(entity);
+    }
+
+    uint32_t count = 0;
+    world.for_each<Position, Velocity>([&](ecs::Entity entity, Position &position, Velocity &velocity) {
+        EXPECT_THAT(position.x, is(equal_to(static_cast<float>(entity.index()))));
+        position.x += velocity.dx;
+        position.y += velocity.dy;
+        count++;
+    });
+    EXPECT_THAT(count, is(equal_to(5000)));
+
+    count = 0;
+    world.for_each<Position, Velocity, Name>([&](ecs::Entity entity, Position &position, Velocity &, Name &name) {
+        EXPECT_THAT(name.name.view(), is(equal_to(vull::format("{}", entity.index()).view())));
+        EXPECT_THAT(position.y, is(equal_to(2.0f)));
+        count++;
+    });
+    EXPECT_THAT(count, is(equal_to(1667)));
+
+    // Destroying entities moves others into their rows.
+    for (uint32_t i = 0; i < entities.size(); i += 4) {
+        world.destroy(entities[i]);
+    }
+    for (uint32_t i = 0; i < entities.size(); i++) {
+        if (i % 4 == 0) {
+            EXPECT_FALSE(world.is_valid(entities[i]));
+            continue;
+        }
+        const auto &position = world.get_component<Position>(entities[i]);
+        EXPECT_THAT(position.x, is(equal_to(static_cast<float>(i) + (i % 2 == 0 ? 1.0f : 0.0f))));
+        if (i % 3 == 0) {
+            EXPECT_THAT(world.get_component<Name>(entities[i]).name.view(),
+                        is(equal_to(vull::format("{}", i).view())));
+        }
+    }
+    count = 0;
+    world.for_each<Position>([&](ecs::Entity, Position &) {
+        count++;
+    });
+    EXPECT_THAT(count, is(equal_to(7500)));
+}
+
+TEST_CASE(EcsWorld, ComponentLifetime) {
+    int live_count = 0;
+    {
+        ecs::World world;
+        Vector<ecs::Entity> entities;
+        for (uint32_t i = 0; i < 1000; i++) {
+            auto entity = world.create();
+            world.add_component<Tracked>(entity, &live_count);
+            entities.push(entity);
+        }
+        EXPECT_THAT(live_count, is(equal_to(1000)));
+
+        // Moving between archetypes shouldn't leak or double destroy.
+        for (uint32_t i = 0; i < 500; i++) {
+            world.add_component<Position>(entities[i], 0.0f, 0.0f);
+        }
+        EXPECT_THAT(live_count, is(equal_to(1000)));
+        for (uint32_t i = 0; i < 100; i++) {
+            world.remove_component<Tracked>(entities[i]);
+        }
+        EXPECT_THAT(live_count, is(equal_to(900)));
+        world.destroy(entities[999]);
+        EXPECT_THAT(live_count, is(equal_to(899)));
+    }
+    EXPECT_THAT(live_count, is(equal_to(0)));
+}
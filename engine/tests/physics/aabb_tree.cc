@@ -0,0 +1,110 @@
+#include <vull/physics/aabb_tree.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/maths/random.hh>
+#include <vull/maths/vec.hh>
+#include <vull/physics/aabb.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+Aabb random_aabb() {
+    const auto centre = vull::linear_rand(Vec3f(-50.0f), Vec3f(50.0f));
+    const auto half_extents = vull::linear_rand(Vec3f(0.1f), Vec3f(2.0f));
+    return {centre - half_extents, centre + half_extents};
+}
+
+// Checks that a query finds exactly the proxies whose fat AABBs overlap, and that every proxy's fat AABB contains its
+// tight AABB.
+void check_query(const AabbTree &tree, const Vector<uint32_t> &proxies, const Vector<Aabb> &aabbs, const Aabb &bounds) {
+    Vector<bool> found(proxies.size());
+    tree.query(bounds, [&](uint32_t proxy) {
+        const auto index = tree.user_data(proxy);
+        EXPECT_THAT(proxies[index], is(equal_to(proxy)));
+        EXPECT_FALSE(found[index]);
+        found[index] = true;
+        return true;
+    });
+    for (uint32_t i = 0; i < proxies.size(); i++) {
+        if (proxies[i] == AabbTree::k_null_proxy) {
+            EXPECT_FALSE(found[i]);
+            continue;
+        }
+        EXPECT_TRUE(tree.fat_aabb(proxies[i]).contains(aabbs[i]));
+        EXPECT_THAT(found[i], is(equal_to(tree.fat_aabb(proxies[i]).overlaps(bounds))));
+    }
+}
+
+} // namespace
+
+TEST_CASE(AabbTree, Empty) {
+    AabbTree tree;
+    tree.query(Aabb{Vec3f(-1.0f), Vec3f(1.0f)}, [](uint32_t) {
+        EXPECT_TRUE(false);
+        return true;
+    });
+    EXPECT_THAT(tree.proxy_count(), is(equal_to(0)));
+    EXPECT_THAT(tree.height(), is(equal_to(0)));
+}
+
+TEST_CASE(AabbTree, MoveWithinMargin) {
+    AabbTree tree;
+    const auto proxy = tree.create_proxy(Aabb{Vec3f(0.0f), Vec3f(1.0f)}, 0);
+    EXPECT_FALSE(tree.move_proxy(proxy, Aabb{Vec3f(0.05f), Vec3f(1.05f)}, Vec3f(0.05f)));
+    EXPECT_TRUE(tree.move_proxy(proxy, Aabb{Vec3f(1.0f), Vec3f(2.0f)}, Vec3f(1.0f, 0.0f, 0.0f)));
+
+    // The fat AABB is extended along the direction of movement.
+    const auto &fat_aabb = tree.fat_aabb(proxy);
+    EXPECT_TRUE(fat_aabb.max.x() > 2.0f + AabbTree::k_margin);
+    EXPECT_THAT(fat_aabb.min.x(), is(equal_to(1.0f - AabbTree::k_margin)));
+    EXPECT_THAT(fat_aabb.max.y(), is(equal_to(2.0f + AabbTree::k_margin)));
+}
+
+TEST_CASE(AabbTree, MatchesBruteForce) {
+    vull::seed_rand(1234);
+    AabbTree tree;
+    Vector<uint32_t> proxies;
+    Vector<Aabb> aabbs;
+    for (uint32_t i = 0; i < 1000; i++) {
+        aabbs.push(random_aabb());
+        proxies.push(tree.create_proxy(aabbs[i], i));
+    }
+    EXPECT_THAT(tree.proxy_count(), is(equal_to(1000)));
+
+    // A balanced tree of 1000 leaves shouldn't be much taller than log2(1000).
+    EXPECT_TRUE(tree.height() < 20);
+
+    for (uint32_t round = 0; round < 20; round++) {
+        for (uint32_t i = 0; i < proxies.size(); i++) {
+            const auto action = vull::linear_rand(0u, 9u);
+            if (proxies[i] == AabbTree::k_null_proxy) {
+                if (action == 0) {
+                    aabbs[i] = random_aabb();
+                    proxies[i] = tree.create_proxy(aabbs[i], i);
+                }
+                continue;
+            }
+            if (action == 0) {
+                tree.destroy_proxy(proxies[i]);
+                proxies[i] = AabbTree::k_null_proxy;
+            } else if (action < 5) {
+                const auto displacement = vull::linear_rand(Vec3f(-1.0f), Vec3f(1.0f));
+                aabbs[i] = {aabbs[i].min + displacement, aabbs[i].max + displacement};
+                tree.move_proxy(proxies[i], aabbs[i], displacement);
+            }
+        }
+        for (uint32_t i = 0; i < 10; i++) {
+            auto bounds = random_aabb();
+            bounds = bounds.fattened(5.0f);
+            check_query(tree, proxies, aabbs, bounds);
+        }
+        EXPECT_TRUE(tree.height() < 20);
+    }
+}
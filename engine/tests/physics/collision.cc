@@ -0,0 +1,141 @@
+#include <vull/physics/collision.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/quat.hh>
+#include <vull/maths/vec.hh>
+#include <vull/physics/shape.hh>
+#include <vull/scene/transform.hh>
+#include <vull/support/utility.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+Transform make_transform(const Vec3f &position, const Quatf &rotation = {}) {
+    return {~EntityId(0), position, rotation};
+}
+
+float penetration(const CollisionResult &result, uint32_t index) {
+    return vull::dot(result.points2[index] - result.points1[index], result.normal);
+}
+
+} // namespace
+
+TEST_CASE(Collision, SphereSphere) {
+    SphereShape sphere(1.0f);
+    CollisionResult result;
+    ASSERT_TRUE(collide(sphere, make_transform(Vec3f(1.5f, 0.0f, 0.0f)), sphere, make_transform(Vec3f(0.0f)), result));
+    EXPECT_THAT(result.point_count, is(equal_to(1)));
+    EXPECT_THAT(result.normal.x(), is(close_to(1.0f)));
+    EXPECT_THAT(penetration(result, 0), is(close_to(0.5f)));
+    EXPECT_THAT(result.points1[0].x(), is(close_to(0.5f)));
+    EXPECT_THAT(result.points2[0].x(), is(close_to(1.0f)));
+
+    CollisionResult separated;
+    EXPECT_FALSE(collide(sphere, make_transform(Vec3f(2.5f, 0.0f, 0.0f)), sphere, make_transform(Vec3f(0.0f)),
+                         separated));
+}
+
+TEST_CASE(Collision, SphereBox) {
+    SphereShape sphere(0.5f);
+    BoxShape box(Vec3f(1.0f));
+    const auto box_transform = make_transform(Vec3f(0.0f), vull::angle_axis(0.5f, Vec3f(0.0f, 1.0f, 0.0f)));
+    CollisionResult result;
+    ASSERT_TRUE(collide(sphere, make_transform(Vec3f(0.0f, 1.25f, 0.0f)), box, box_transform, result));
+    EXPECT_THAT(result.point_count, is(equal_to(1)));
+    EXPECT_THAT(result.normal.y(), is(close_to(1.0f)));
+    EXPECT_THAT(penetration(result, 0), is(close_to(0.25f)));
+
+    // A sphere centre inside the box is pushed out through the nearest face.
+    CollisionResult inside;
+    ASSERT_TRUE(collide(sphere, make_transform(Vec3f(0.0f, 0.9f, 0.0f)), box, make_transform(Vec3f(0.0f)), inside));
+    EXPECT_THAT(inside.normal.y(), is(close_to(1.0f)));
+    EXPECT_THAT(penetration(inside, 0), is(close_to(0.6f)));
+}
+
+TEST_CASE(Collision, BoxSphereSwapped) {
+    // There is only a sphere-box test, so box-sphere must swap the shapes back and flip the normal.
+    SphereShape sphere(0.5f);
+    BoxShape box(Vec3f(1.0f));
+    CollisionResult result;
+    ASSERT_TRUE(collide(box, make_transform(Vec3f(0.0f)), sphere, make_transform(Vec3f(0.0f, 1.25f, 0.0f)), result));
+    EXPECT_THAT(result.point_count, is(equal_to(1)));
+    EXPECT_THAT(result.normal.y(), is(close_to(-1.0f)));
+    EXPECT_THAT(penetration(result, 0), is(close_to(0.25f)));
+    EXPECT_THAT(result.points1[0].y(), is(close_to(1.0f)));
+    EXPECT_THAT(result.points2[0].y(), is(close_to(0.75f)));
+}
+
+TEST_CASE(Collision, ParallelCapsules) {
+    // Two capsules lying side by side along the X axis should touch along the overlap of their segments.
+    CapsuleShape capsule(1.0f, 0.5f);
+    const auto rotation = vull::angle_axis(vull::half_pi<float>, Vec3f(0.0f, 0.0f, 1.0f));
+    CollisionResult result;
+    ASSERT_TRUE(collide(capsule, make_transform(Vec3f(0.5f, 0.9f, 0.0f), rotation), capsule,
+                        make_transform(Vec3f(0.0f), rotation), result));
+    EXPECT_THAT(result.point_count, is(equal_to(2)));
+    EXPECT_THAT(result.normal.y(), is(close_to(1.0f)));
+    for (uint32_t i = 0; i < result.point_count; i++) {
+        EXPECT_THAT(penetration(result, i), is(close_to(0.1f)));
+    }
+    EXPECT_THAT(vull::abs(result.points1[0].x() - result.points1[1].x()), is(close_to(1.5f)));
+}
+
+TEST_CASE(Collision, BoxOnBox) {
+    BoxShape box(Vec3f(0.5f));
+    BoxShape ground(Vec3f(5.0f, 1.0f, 5.0f));
+    const auto rotation = vull::angle_axis(0.3f, Vec3f(0.0f, 1.0f, 0.0f));
+    CollisionResult result;
+    ASSERT_TRUE(collide(box, make_transform(Vec3f(0.0f, 0.49f, 0.0f), rotation), ground,
+                        make_transform(Vec3f(0.0f, -1.0f, 0.0f)), result));
+    EXPECT_THAT(result.point_count, is(equal_to(4)));
+    EXPECT_THAT(result.normal.y(), is(close_to(1.0f)));
+    for (uint32_t i = 0; i < result.point_count; i++) {
+        EXPECT_THAT(penetration(result, i), is(close_to(0.01f)));
+        EXPECT_THAT(result.points1[i].y(), is(close_to(-0.01f)));
+        EXPECT_THAT(result.points2[i].y(), is(close_to(0.0f)));
+    }
+}
+
+TEST_CASE(Collision, BoxEdgeEdge) {
+    // Two boxes rotated so that an edge of each meet crosswise, which can only be separated by an edge axis.
+    BoxShape box(Vec3f(0.5f));
+    const float edge_distance = vull::sqrt(0.5f);
+    const auto rotation1 = vull::angle_axis(vull::pi<float> / 4.0f, Vec3f(1.0f, 0.0f, 0.0f));
+    const auto rotation2 = vull::angle_axis(vull::pi<float> / 4.0f, Vec3f(0.0f, 0.0f, 1.0f));
+    CollisionResult result;
+    ASSERT_TRUE(collide(box, make_transform(Vec3f(0.0f, edge_distance * 2.0f - 0.05f, 0.0f), rotation1), box,
+                        make_transform(Vec3f(0.0f), rotation2), result));
+    EXPECT_THAT(result.point_count, is(equal_to(1)));
+    EXPECT_THAT(result.normal.y(), is(close_to(1.0f)));
+    EXPECT_THAT(penetration(result, 0), is(close_to(0.05f)));
+
+    CollisionResult separated;
+    EXPECT_FALSE(collide(box, make_transform(Vec3f(0.0f, edge_distance * 2.0f + 0.05f, 0.0f), rotation1), box,
+                         make_transform(Vec3f(0.0f), rotation2), separated));
+}
+
+TEST_CASE(Collision, ConvexHullFallback) {
+    Vector<Vec3f> points;
+    points.push(Vec3f(1.0f, 0.0f, 0.0f));
+    points.push(Vec3f(-1.0f, 0.0f, 0.0f));
+    points.push(Vec3f(0.0f, 2.0f, 0.0f));
+    points.push(Vec3f(0.0f, 0.0f, 1.0f));
+    ConvexHullShape hull(vull::move(points));
+    EXPECT_THAT(hull.furthest_point(Vec3f(0.1f, 1.0f, 0.0f)).y(), is(equal_to(2.0f)));
+    EXPECT_THAT(hull.furthest_point(Vec3f(-1.0f, 0.0f, 0.0f)).x(), is(equal_to(-1.0f)));
+
+    // Convex hulls have no specialised tests and are left to MPR.
+    EXPECT_TRUE(has_collision_test(ShapeType::Box, ShapeType::Sphere));
+    EXPECT_TRUE(has_collision_test(ShapeType::Capsule, ShapeType::Capsule));
+    EXPECT_FALSE(has_collision_test(ShapeType::ConvexHull, ShapeType::Box));
+    EXPECT_FALSE(has_collision_test(ShapeType::Sphere, ShapeType::ConvexHull));
+}
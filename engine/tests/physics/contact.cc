@@ -0,0 +1,90 @@
+#include <vull/physics/contact.hh>
+
+#include <vull/ecs/entity_id.hh>
+#include <vull/maths/vec.hh>
+#include <vull/scene/transform.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+const Vec3f k_normal(0.0f, 1.0f, 0.0f);
+
+ContactPoint make_point(const Vec3f &position, float penetration) {
+    Transform identity(~EntityId(0));
+    return ContactPoint::from_points(position, position + k_normal * penetration, k_normal, identity, identity);
+}
+
+bool has_point(const ContactManifold &manifold, const Vec3f &position) {
+    for (uint32_t i = 0; i < manifold.point_count; i++) {
+        if (vull::distance(manifold.points[i].position, position) < 0.1f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+TEST_CASE(ContactManifold, MergeNearby) {
+    ContactManifold manifold{.normal = k_normal};
+    manifold.add_point(make_point(Vec3f(0.0f), 0.01f));
+    manifold.points[0].normal_impulse = 1.0f;
+
+    // A point within the breaking threshold is merged into the old one, which keeps its anchors and its impulse for
+    // warm starting.
+    manifold.add_point(make_point(Vec3f(0.005f, 0.0f, 0.0f), 0.02f));
+    EXPECT_THAT(manifold.point_count, is(equal_to(1)));
+    EXPECT_THAT(manifold.points[0].normal_impulse, is(equal_to(1.0f)));
+    EXPECT_THAT(manifold.points[0].penetration, is(close_to(0.01f)));
+    EXPECT_THAT(manifold.points[0].position.x(), is(equal_to(0.0f)));
+
+    manifold.add_point(make_point(Vec3f(1.0f, 0.0f, 0.0f), 0.01f));
+    EXPECT_THAT(manifold.point_count, is(equal_to(2)));
+}
+
+TEST_CASE(ContactManifold, ReplaceMaximisesArea) {
+    ContactManifold manifold{.normal = k_normal};
+    manifold.add_point(make_point(Vec3f(0.0f, 0.0f, 0.0f), 0.05f));
+    manifold.add_point(make_point(Vec3f(1.0f, 0.0f, 0.0f), 0.01f));
+    manifold.add_point(make_point(Vec3f(0.0f, 0.0f, 1.0f), 0.01f));
+    manifold.add_point(make_point(Vec3f(0.2f, 0.0f, 0.2f), 0.01f));
+    manifold.add_point(make_point(Vec3f(1.0f, 0.0f, 1.0f), 0.01f));
+    EXPECT_THAT(manifold.point_count, is(equal_to(4)));
+    EXPECT_TRUE(has_point(manifold, Vec3f(0.0f, 0.0f, 0.0f)));
+    EXPECT_TRUE(has_point(manifold, Vec3f(1.0f, 0.0f, 1.0f)));
+    EXPECT_FALSE(has_point(manifold, Vec3f(0.2f, 0.0f, 0.2f)));
+
+    // The deepest point is kept even when dropping it would give a larger area.
+    manifold.add_point(make_point(Vec3f(-1.0f, 0.0f, -1.0f), 0.01f));
+    EXPECT_TRUE(has_point(manifold, Vec3f(0.0f, 0.0f, 0.0f)));
+}
+
+TEST_CASE(ContactManifold, Refresh) {
+    ContactManifold manifold{.normal = k_normal};
+    manifold.add_point(make_point(Vec3f(0.0f, 0.0f, 0.0f), 0.01f));
+    manifold.add_point(make_point(Vec3f(1.0f, 0.0f, 0.0f), 0.01f));
+
+    // Small movements just update the penetration.
+    Transform t1(~EntityId(0), Vec3f(0.0f, 0.005f, 0.0f));
+    Transform t2(~EntityId(0));
+    manifold.refresh(t1, t2);
+    EXPECT_THAT(manifold.point_count, is(equal_to(2)));
+    EXPECT_THAT(manifold.points[0].penetration, is(close_to(0.005f)));
+
+    // Sliding tangentially breaks the points.
+    t1 = Transform(~EntityId(0), Vec3f(0.1f, 0.0f, 0.0f));
+    manifold.refresh(t1, t2);
+    EXPECT_THAT(manifold.point_count, is(equal_to(0)));
+
+    // As does separating along the normal.
+    manifold.add_point(make_point(Vec3f(0.0f), 0.01f));
+    manifold.refresh(Transform(~EntityId(0), Vec3f(0.0f, 0.1f, 0.0f)), t2);
+    EXPECT_THAT(manifold.point_count, is(equal_to(0)));
+}
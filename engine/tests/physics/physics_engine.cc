@@ -0,0 +1,203 @@
+#include <vull/physics/physics_engine.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/ecs/world.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/vec.hh>
+#include <vull/physics/collider.hh>
+#include <vull/physics/rigid_body.hh>
+#include <vull/physics/shape.hh>
+#include <vull/scene/transform.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+void setup_world(World &world) {
+    world.register_component<Transform>();
+    world.register_component<RigidBody>();
+    world.register_component<Collider>();
+
+    auto floor = world.create_entity();
+    floor.add<Transform>(~EntityId(0), Vec3f(0.0f, -1.0f, 0.0f));
+    floor.add<Collider>(vull::make_unique<BoxShape>(Vec3f(50.0f, 1.0f, 50.0f)));
+}
+
+Entity create_box(World &world, const Vec3f &position) {
+    auto box = world.create_entity();
+    box.add<Transform>(~EntityId(0), position);
+    box.add<Collider>(vull::make_unique<BoxShape>(Vec3f(0.5f)));
+    box.add<RigidBody>(1.0f);
+    box.get<RigidBody>().set_shape(box.get<Collider>().shape());
+    return box;
+}
+
+void simulate(PhysicsEngine &engine, World &world, float seconds) {
+    for (float time = 0.0f; time < seconds; time += 1.0f / 60.0f) {
+        engine.step(world, 1.0f / 60.0f);
+    }
+}
+
+} // namespace
+
+TEST_CASE(PhysicsEngine, SleepAndWake) {
+    World world;
+    setup_world(world);
+    auto box = create_box(world, Vec3f(0.0f, 1.0f, 0.0f));
+
+    PhysicsEngine engine;
+    simulate(engine, world, 3.0f);
+    auto &body = box.get<RigidBody>();
+    EXPECT_TRUE(body.is_sleeping());
+    const auto resting_position = box.get<Transform>().position();
+    EXPECT_TRUE(resting_position.y() > 0.0f && resting_position.y() < 1.0f);
+
+    // Sleeping bodies don't fall.
+    simulate(engine, world, 1.0f);
+    EXPECT_THAT(box.get<Transform>().position().y(), is(equal_to(resting_position.y())));
+
+    body.apply_impulse(Vec3f(0.0f, 5.0f, 0.0f), Vec3f(0.0f));
+    EXPECT_FALSE(body.is_sleeping());
+    engine.step(world, 1.0f / 60.0f);
+    EXPECT_TRUE(box.get<Transform>().position().y() > resting_position.y());
+}
+
+TEST_CASE(PhysicsEngine, WakeOnContact) {
+    World world;
+    setup_world(world);
+    auto box = create_box(world, Vec3f(0.0f, 1.0f, 0.0f));
+    auto target = create_box(world, Vec3f(2.0f, 1.0f, 0.0f));
+    auto other = create_box(world, Vec3f(10.0f, 1.0f, 0.0f));
+
+    PhysicsEngine engine;
+    simulate(engine, world, 3.0f);
+    EXPECT_TRUE(box.get<RigidBody>().is_sleeping());
+    EXPECT_TRUE(target.get<RigidBody>().is_sleeping());
+    EXPECT_TRUE(other.get<RigidBody>().is_sleeping());
+
+    // Sliding the box into the target wakes the target, but not the unrelated box.
+    box.get<RigidBody>().apply_impulse(Vec3f(4.0f, 0.0f, 0.0f), Vec3f(0.0f));
+    simulate(engine, world, 0.5f);
+    EXPECT_FALSE(target.get<RigidBody>().is_sleeping());
+    EXPECT_TRUE(target.get<Transform>().position().x() > 2.0f);
+    EXPECT_TRUE(other.get<RigidBody>().is_sleeping());
+
+    // Destroying a sleeping body doesn't leave a stale broadphase proxy.
+    other.destroy();
+    engine.step(world, 1.0f / 60.0f);
+    EXPECT_THAT(engine.broadphase().proxy_count(), is(equal_to(3)));
+}
+
+TEST_CASE(PhysicsEngine, FreeEmptyIslands) {
+    World world;
+    setup_world(world);
+    Vector<Entity> boxes;
+    for (uint32_t i = 0; i < 4; i++) {
+        boxes.push(create_box(world, Vec3f(float(i) * 3.0f, 1.0f, 0.0f)));
+    }
+
+    PhysicsEngine engine;
+    simulate(engine, world, 3.0f);
+    EXPECT_THAT(engine.sleeping_island_count(), is(equal_to(4)));
+
+    // Waking every member individually, or destroying them, should free their islands.
+    boxes[0].get<RigidBody>().apply_impulse(Vec3f(0.0f, 5.0f, 0.0f), Vec3f(0.0f));
+    boxes[1].get<RigidBody>().wake();
+    boxes[2].destroy();
+    simulate(engine, world, 0.1f);
+    EXPECT_THAT(engine.sleeping_island_count(), is(equal_to(1)));
+    EXPECT_TRUE(boxes[3].get<RigidBody>().is_sleeping());
+
+    // The woken boxes fall back asleep in islands of their own.
+    simulate(engine, world, 3.0f);
+    EXPECT_THAT(engine.sleeping_island_count(), is(equal_to(3)));
+}
+
+TEST_CASE(PhysicsEngine, Friction) {
+    // Slides a box along the floor, returning how far it got.
+    const auto slide = [](float friction) {
+        World world;
+        setup_world(world);
+        auto box = create_box(world, Vec3f(0.0f, 0.5f, 0.0f));
+        PhysicsEngine engine;
+        engine.set_friction(friction);
+        simulate(engine, world, 0.5f);
+        box.get<RigidBody>().apply_impulse(Vec3f(3.0f, 0.0f, 0.0f), Vec3f(0.0f));
+        simulate(engine, world, 1.0f);
+        return box.get<Transform>().position().x();
+    };
+    const float rough = slide(1.0f);
+    const float smooth = slide(0.0f);
+    EXPECT_TRUE(rough > 0.0f);
+    EXPECT_TRUE(smooth > rough * 2.0f);
+}
+
+TEST_CASE(PhysicsEngine, Stack) {
+    World world;
+    setup_world(world);
+    Vector<Entity> boxes;
+    for (uint32_t i = 0; i < 8; i++) {
+        boxes.push(create_box(world, Vec3f(0.0f, float(i) + 0.5f, 0.0f)));
+    }
+
+    PhysicsEngine engine;
+    engine.set_solver_iterations(8);
+    simulate(engine, world, 3.0f);
+    EXPECT_THAT(engine.manifold_count(), is(equal_to(8)));
+    for (uint32_t i = 0; i < boxes.size(); i++) {
+        const auto position = boxes[i].get<Transform>().position();
+        EXPECT_TRUE(vull::abs(position.x()) < 0.05f && vull::abs(position.z()) < 0.05f);
+        EXPECT_TRUE(vull::abs(position.y() - (float(i) + 0.5f)) < 0.05f);
+        EXPECT_TRUE(boxes[i].get<RigidBody>().is_sleeping());
+    }
+}
+
+TEST_CASE(PhysicsEngine, ParallelDeterminism) {
+    // Enough bodies for both the narrowphase and the solver batches to be split across threads.
+    const auto run = [](World &world, Vector<Entity> &boxes) {
+        setup_world(world);
+        for (uint32_t i = 0; i < 128; i++) {
+            const auto x = float(i % 16) * 1.5f - 12.0f;
+            const auto z = float(i / 16 % 4) * 1.5f - 3.0f;
+            const auto y = float(i / 64) * 1.2f + 0.6f;
+            boxes.push(create_box(world, Vec3f(x, y, z)));
+            boxes.last().get<RigidBody>().apply_impulse(Vec3f(float(i % 3) - 1.0f, 0.0f, float(i % 5) - 2.0f),
+                                                        Vec3f(0.0f, 0.5f, 0.0f));
+        }
+        PhysicsEngine engine;
+        simulate(engine, world, 0.5f);
+    };
+
+    World serial_world;
+    Vector<Entity> serial_boxes;
+    run(serial_world, serial_boxes);
+
+    World parallel_world;
+    Vector<Entity> parallel_boxes;
+    tasklet::Scheduler scheduler(4, 64, false);
+    scheduler.run([&] {
+        run(parallel_world, parallel_boxes);
+    });
+
+    for (uint32_t i = 0; i < serial_boxes.size(); i++) {
+        const auto &serial = serial_boxes[i].get<Transform>();
+        const auto &parallel = parallel_boxes[i].get<Transform>();
+        EXPECT_THAT(parallel.position().x(), is(equal_to(serial.position().x())));
+        EXPECT_THAT(parallel.position().y(), is(equal_to(serial.position().y())));
+        EXPECT_THAT(parallel.position().z(), is(equal_to(serial.position().z())));
+        EXPECT_THAT(parallel.rotation().x(), is(equal_to(serial.rotation().x())));
+        EXPECT_THAT(parallel.rotation().y(), is(equal_to(serial.rotation().y())));
+        EXPECT_THAT(parallel.rotation().z(), is(equal_to(serial.rotation().z())));
+        EXPECT_THAT(parallel.rotation().w(), is(equal_to(serial.rotation().w())));
+    }
+}
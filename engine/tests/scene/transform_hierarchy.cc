@@ -0,0 +1,207 @@
+#include <vull/scene/transform_hierarchy.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/ecs/world.hh>
+#include <vull/maths/epsilon.hh>
+#include <vull/maths/mat.hh>
+#include <vull/maths/quat.hh>
+#include <vull/maths/vec.hh>
+#include <vull/scene/transform.hh>
+#include <vull/scene/world_transform.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+constexpr EntityId k_no_parent = ~EntityId(0);
+
+Mat4f reference_matrix(World &world, EntityId entity) {
+    const auto &transform = world.get_component<Transform>(entity);
+    if (transform.parent() == k_no_parent || !world.has_component<Transform>(transform.parent())) {
+        return transform.matrix();
+    }
+    return reference_matrix(world, transform.parent()) * transform.matrix();
+}
+
+bool matches_reference(World &world, EntityId entity) {
+    const auto expected = reference_matrix(world, entity);
+    const auto &actual = world.get_component<WorldTransform>(entity).matrix();
+    for (unsigned col = 0; col < 4; col++) {
+        if (!vull::fuzzy_equal(actual[col], expected[col])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void register_components(World &world) {
+    world.register_component<Transform>();
+    world.register_component<WorldTransform>();
+}
+
+// Creates a forest of trees, each a root with a few chains of children hanging off of it.
+Vector<EntityId> build_forest(World &world, uint32_t tree_count) {
+    Vector<EntityId> entities;
+    for (uint32_t tree = 0; tree < tree_count; tree++) {
+        auto root = world.create_entity();
+        root.add<Transform>(k_no_parent, Vec3f(float(tree), 0.0f, 0.0f));
+        entities.push(root);
+        for (uint32_t chain = 0; chain < 3; chain++) {
+            EntityId parent = root;
+            for (uint32_t depth = 0; depth < 4; depth++) {
+                auto child = world.create_entity();
+                child.add<Transform>(parent, Vec3f(0.0f, 1.0f, float(chain)),
+                                     vull::angle_axis(0.1f * float(depth + 1), Vec3f(0.0f, 1.0f, 0.0f)),
+                                     Vec3f(1.0f + 0.1f * float(chain)));
+                entities.push(child);
+                parent = child;
+            }
+        }
+    }
+    return entities;
+}
+
+void check_all(World &world, const Vector<EntityId> &entities) {
+    for (EntityId entity : entities) {
+        EXPECT_TRUE(world.has_component<WorldTransform>(entity));
+        EXPECT_TRUE(matches_reference(world, entity));
+    }
+}
+
+} // namespace
+
+TEST_CASE(TransformHierarchy, MatchesRecursive) {
+    World world;
+    register_components(world);
+    auto entities = build_forest(world, 10);
+
+    TransformHierarchy hierarchy;
+    hierarchy.update(world);
+    check_all(world, entities);
+
+    // Moving a root should update its whole tree.
+    world.advance_tick();
+    world.get_component<Transform>(entities[0]).set_position({&world, entities[0]}, Vec3f(5.0f, 2.0f, 1.0f));
+    hierarchy.update(world);
+    check_all(world, entities);
+
+    // Rotating something in the middle of a chain. Changes marked after an update in the same tick are still seen.
+    world.get_component<Transform>(entities[15])
+        .set_rotation({&world, entities[15]}, vull::angle_axis(1.0f, Vec3f(1.0f, 0.0f, 0.0f)));
+    world.get_component<Transform>(entities[30]).set_scale({&world, entities[30]}, Vec3f(2.0f));
+    hierarchy.update(world);
+    check_all(world, entities);
+}
+
+TEST_CASE(TransformHierarchy, OnlyDirtySubtrees) {
+    World world;
+    register_components(world);
+    auto entities = build_forest(world, 2);
+
+    // Transforms are seen as changed by the first update after the tick they were added in too, so let that pass.
+    TransformHierarchy hierarchy;
+    hierarchy.update(world);
+    world.advance_tick();
+    hierarchy.update(world);
+    world.advance_tick();
+
+    // Overwrite the cached matrices, which should only be recomputed below a changed transform.
+    const Mat4f poison(7.0f);
+    for (EntityId entity : entities) {
+        world.get_component<WorldTransform>(entity).set_matrix(poison);
+    }
+    // Second child in the first chain of the first tree.
+    world.get_component<Transform>(entities[2]).set_position({&world, entities[2]}, Vec3f(0.0f, 3.0f, 0.0f));
+    hierarchy.update(world);
+
+    for (uint32_t i = 0; i < entities.size(); i++) {
+        const bool in_subtree = i >= 2 && i <= 4;
+        const auto &matrix = world.get_component<WorldTransform>(entities[i]).matrix();
+        EXPECT_THAT(vull::fuzzy_equal(matrix[3], poison[3]), is(equal_to(!in_subtree)));
+    }
+}
+
+TEST_CASE(TransformHierarchy, StructuralChanges) {
+    World world;
+    register_components(world);
+    auto entities = build_forest(world, 4);
+
+    TransformHierarchy hierarchy;
+    hierarchy.update(world);
+
+    // Destroy a subtree's parent. Its children should now be treated as roots.
+    world.destroy_entity(entities[2]);
+    entities.clear();
+    for (auto [entity, transform] : world.view<Transform>()) {
+        entities.push(entity);
+    }
+
+    // And add a new child to an existing entity.
+    auto child = world.create_entity();
+    child.add<Transform>(entities[5], Vec3f(1.0f, 2.0f, 3.0f));
+    entities.push(child);
+
+    hierarchy.update(world);
+    check_all(world, entities);
+    EXPECT_THAT(world.component_count<WorldTransform>(), is(equal_to(entities.size())));
+
+    // Removing a transform should remove the world transform too.
+    world.remove_component<Transform>(child);
+    entities.pop();
+    hierarchy.update(world);
+    EXPECT_FALSE(world.has_component<WorldTransform>(child));
+    check_all(world, entities);
+}
+
+TEST_CASE(TransformHierarchy, SwappedTransform) {
+    World world;
+    register_components(world);
+    auto entities = build_forest(world, 2);
+
+    TransformHierarchy hierarchy;
+    hierarchy.update(world);
+    world.advance_tick();
+    hierarchy.update(world);
+    world.advance_tick();
+
+    // One entity loses its transform but keeps its world transform, whilst another gains one, leaving both counts the
+    // same as before.
+    const auto leaf = entities.take_last();
+    world.remove_component<Transform>(leaf);
+    auto entity = world.create_entity();
+    entity.add<Transform>(entities[0], Vec3f(1.0f, 2.0f, 3.0f));
+    entities.push(entity);
+
+    hierarchy.update(world);
+    EXPECT_FALSE(world.has_component<WorldTransform>(leaf));
+    check_all(world, entities);
+}
+
+TEST_CASE(TransformHierarchy, Parallel) {
+    World world;
+    register_components(world);
+    auto entities = build_forest(world, 200);
+
+    tasklet::Scheduler scheduler(4, 64, false);
+    scheduler.run([&] {
+        TransformHierarchy hierarchy;
+        hierarchy.update(world, 32);
+        check_all(world, entities);
+
+        for (uint32_t i = 0; i < entities.size(); i += 7) {
+            Entity entity(&world, entities[i]);
+            entity.get<Transform>().set_position(entity, Vec3f(float(i), 1.0f, 2.0f));
+        }
+        hierarchy.update(world, 32);
+        check_all(world, entities);
+    });
+}
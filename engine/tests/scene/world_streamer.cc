@@ -0,0 +1,174 @@
+#include <vull/scene/world_streamer.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs/entity_id.hh>
+#include <vull/ecs/world.hh>
+#include <vull/maths/common.hh>
+#include <vull/maths/vec.hh>
+#include <vull/platform/file.hh>
+#include <vull/scene/transform.hh>
+#include <vull/support/algorithm.hh>
+#include <vull/support/result.hh>
+#include <vull/support/stream.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+#include <vull/vpak/defs.hh>
+#include <vull/vpak/file_system.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/stream.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+constexpr float k_cell_size = 10.0f;
+
+void register_components(World &world) {
+    world.register_component<Transform>();
+}
+
+// Writes a row of cells along the X axis, each with a root entity at the cell's centre and a child of it.
+void write_cells(String path, StringView scene_name, int32_t first_x, int32_t cell_count) {
+    VULL_IGNORE(platform::unlink_path(path));
+    auto pack_file = VULL_EXPECT(vpak::PackFile::open(vull::move(path)));
+    auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+    for (int32_t x = first_x; x < first_x + cell_count; x++) {
+        World world;
+        register_components(world);
+        const auto centre = (float(x) + 0.5f) * k_cell_size;
+        auto root = world.create_entity();
+        root.add<Transform>(~EntityId(0), Vec3f(centre, 0.0f, k_cell_size * 0.5f));
+        auto child = world.create_entity();
+        child.add<Transform>(root, Vec3f(0.0f, 1.0f, 0.0f));
+        VULL_EXPECT(world.serialise(writer, WorldCellManifest::cell_name(scene_name, Vec2i(x, 0))));
+    }
+
+    auto manifest = writer.add_entry(WorldCellManifest::manifest_name(scene_name), vpak::EntryType::Blob);
+    VULL_EXPECT(manifest.write_le(vull::bit_cast<uint32_t>(k_cell_size)));
+    VULL_EXPECT(manifest.write_varint(static_cast<uint32_t>(cell_count)));
+    for (int32_t x = first_x; x < first_x + cell_count; x++) {
+        VULL_EXPECT(manifest.write_le(static_cast<uint32_t>(x)));
+        VULL_EXPECT(manifest.write_le(0u));
+    }
+    VULL_EXPECT(manifest.finish());
+    VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+}
+
+// Checks that each loaded child still points at its own root, and returns the X coordinates of the loaded roots.
+Vector<int32_t> loaded_cells(World &world) {
+    Vector<int32_t> cells;
+    for (auto [entity, transform] : world.view<Transform>()) {
+        if (transform.parent() == ~EntityId(0)) {
+            cells.push(static_cast<int32_t>(vull::floor(transform.position().x() / k_cell_size)));
+            continue;
+        }
+        EXPECT_TRUE(world.valid(transform.parent()));
+        EXPECT_THAT(world.get_component<Transform>(transform.parent()).parent(), is(equal_to(~EntityId(0))));
+    }
+    vull::sort(cells, [](int32_t lhs, int32_t rhs) {
+        return lhs > rhs;
+    });
+    return cells;
+}
+
+} // namespace
+
+TEST_CASE(WorldStreamer, LoadUnload) {
+    write_cells("streamer_a.vpak", "/scenes/a", -2, 6);
+    vpak::load_vpak("streamer_a", "streamer_a.vpak");
+
+    World world;
+    register_components(world);
+    auto streamer = VULL_EXPECT(WorldStreamer::open("/scenes/a", &register_components));
+    EXPECT_THAT(streamer->cell_count(), is(equal_to(6)));
+    streamer->set_load_radius(k_cell_size);
+    streamer->set_unload_radius(k_cell_size * 2.0f);
+
+    // Outside of a tasklet context, loads happen straight away.
+    streamer->update(world, Vec3f(5.0f, 0.0f, 5.0f));
+    auto cells = loaded_cells(world);
+    EXPECT_THAT(cells.size(), is(equal_to(3)));
+    EXPECT_THAT(cells[0], is(equal_to(-1)));
+    EXPECT_THAT(cells[1], is(equal_to(0)));
+    EXPECT_THAT(cells[2], is(equal_to(1)));
+    EXPECT_THAT(streamer->loaded_cell_count(), is(equal_to(3)));
+
+    // Cells within the unload radius are kept.
+    streamer->update(world, Vec3f(25.0f, 0.0f, 5.0f));
+    cells = loaded_cells(world);
+    EXPECT_THAT(cells.size(), is(equal_to(4)));
+    EXPECT_THAT(cells[0], is(equal_to(0)));
+    EXPECT_THAT(cells[3], is(equal_to(3)));
+
+    streamer->update(world, Vec3f(1000.0f, 0.0f, 5.0f));
+    EXPECT_THAT(loaded_cells(world).size(), is(equal_to(0)));
+    EXPECT_THAT(streamer->resident_bytes(), is(equal_to(0)));
+
+    // Only the nearest cell fits in the budget.
+    streamer->update(world, Vec3f(-15.0f, 0.0f, 5.0f));
+    const auto cell_bytes = streamer->resident_bytes() / 2;
+    streamer->update(world, Vec3f(1000.0f, 0.0f, 5.0f));
+    streamer->set_memory_budget(cell_bytes);
+    streamer->update(world, Vec3f(-12.0f, 0.0f, 5.0f));
+    cells = loaded_cells(world);
+    EXPECT_THAT(cells.size(), is(equal_to(1)));
+    EXPECT_THAT(cells[0], is(equal_to(-2)));
+
+    // Cells over the cell budget are never loaded, even with room left in the memory budget.
+    streamer->update(world, Vec3f(1000.0f, 0.0f, 5.0f));
+    streamer->set_memory_budget(cell_bytes * 10);
+    streamer->set_cell_budget(cell_bytes / 2);
+    streamer->update(world, Vec3f(5.0f, 0.0f, 5.0f));
+    EXPECT_THAT(loaded_cells(world).size(), is(equal_to(0)));
+    EXPECT_THAT(streamer->resident_bytes(), is(equal_to(0)));
+    streamer->set_cell_budget(cell_bytes * 2);
+    streamer->update(world, Vec3f(5.0f, 0.0f, 5.0f));
+    EXPECT_THAT(loaded_cells(world).size(), is(equal_to(3)));
+}
+
+TEST_CASE(WorldStreamer, AsyncLoad) {
+    write_cells("streamer_b.vpak", "/scenes/b", 0, 50);
+    vpak::load_vpak("streamer_b", "streamer_b.vpak");
+
+    World world;
+    register_components(world);
+    tasklet::Scheduler scheduler(4, 64, false);
+    scheduler.run([&] {
+        auto streamer = VULL_EXPECT(WorldStreamer::open("/scenes/b", &register_components));
+        streamer->set_load_radius(k_cell_size * 10.0f);
+        streamer->set_unload_radius(k_cell_size * 10.0f);
+        for (uint32_t i = 0; i < 50; i++) {
+            streamer->update(world, Vec3f(float(i) * k_cell_size, 0.0f, 5.0f));
+        }
+        streamer->flush(world, Vec3f(49.0f * k_cell_size, 0.0f, 5.0f));
+
+        // Cells 39 to 49 are in range at the end.
+        const auto cells = loaded_cells(world);
+        EXPECT_THAT(cells.size(), is(equal_to(11)));
+        for (uint32_t i = 0; i < cells.size(); i++) {
+            EXPECT_THAT(cells[i], is(equal_to(int32_t(i) + 39)));
+        }
+        EXPECT_THAT(streamer->loaded_cell_count(), is(equal_to(11)));
+
+        // Start loading more cells, but discard them rather than merging them in.
+        const auto resident_bytes = streamer->resident_bytes();
+        streamer->set_load_radius(k_cell_size * 20.0f);
+        streamer->update(world, Vec3f(49.0f * k_cell_size, 0.0f, 5.0f));
+        EXPECT_TRUE(streamer->resident_bytes() > resident_bytes);
+        streamer->wait_idle();
+        EXPECT_THAT(streamer->resident_bytes(), is(equal_to(resident_bytes)));
+        EXPECT_THAT(streamer->loaded_cell_count(), is(equal_to(11)));
+        EXPECT_THAT(loaded_cells(world).size(), is(equal_to(11)));
+    });
+}
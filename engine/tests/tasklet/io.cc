@@ -1,5 +1,10 @@
+#include <vull/container/array.hh>
+#include <vull/platform/async_file.hh>
 #include <vull/platform/event.hh>
+#include <vull/platform/file.hh>
 #include <vull/support/atomic.hh>
+#include <vull/support/shared_ptr.hh>
+#include <vull/support/span.hh>
 #include <vull/tasklet/functions.hh>
 #include <vull/tasklet/future.hh>
 #include <vull/tasklet/io.hh>
@@ -8,6 +13,9 @@
 #include <vull/test/matchers.hh>
 #include <vull/test/test.hh>
 
+#include <stdint.h>
+#include <string.h>
+
 using namespace vull;
 using namespace vull::test::matchers;
 
@@ -42,3 +50,158 @@ TEST_CASE(TaskletIo, PollWaitEvent) {
         EXPECT_TRUE(second_value.load());
     });
 }
+
+TEST_CASE(TaskletIo, ReadWriteFile) {
+    tasklet::Scheduler scheduler(4, 64, false);
+    scheduler.run([] {
+        auto file = VULL_EXPECT(platform::AsyncFile::open(
+            ".", platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Write,
+                                     platform::OpenMode::TempFile)));
+
+        Array<uint8_t, 4096> data;
+        for (uint32_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<uint8_t>(i * 7);
+        }
+        EXPECT_THAT(file.write(data.span(), 0).await(), is(equal_to(4096)));
+        EXPECT_THAT(VULL_EXPECT(file.size()), is(equal_to(4096u)));
+
+        Array<uint8_t, 1024> read_data{};
+        EXPECT_THAT(file.read(read_data.span(), 1024).await(), is(equal_to(1024)));
+        for (uint32_t i = 0; i < read_data.size(); i++) {
+            EXPECT_THAT(read_data[i], is(equal_to(data[i + 1024])));
+        }
+
+        // Short read at the end of the file.
+        EXPECT_THAT(file.read(read_data.span(), 3584).await(), is(equal_to(512)));
+    });
+}
+
+TEST_CASE(TaskletIo, ReadWriteFileVectored) {
+    tasklet::Scheduler scheduler(4, 64, false);
+    scheduler.run([] {
+        auto file = VULL_EXPECT(platform::AsyncFile::open(
+            ".", platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Write,
+                                     platform::OpenMode::TempFile)));
+
+        Array<uint8_t, 16> first{};
+        Array<uint8_t, 48> second{};
+        memset(first.data(), 1, first.size());
+        memset(second.data(), 2, second.size());
+        Array<Span<const void>, 2> write_buffers{first.span(), second.span()};
+        EXPECT_THAT(file.write_vectored(write_buffers.span(), 8).await(), is(equal_to(64)));
+
+        Array<uint8_t, 32> read_first{};
+        Array<uint8_t, 40> read_second{};
+        Array<Span<void>, 2> read_buffers{read_first.span(), read_second.span()};
+        EXPECT_THAT(file.read_vectored(read_buffers.span(), 0).await(), is(equal_to(72)));
+        for (uint32_t i = 0; i < 8; i++) {
+            EXPECT_THAT(read_first[i], is(equal_to(0)));
+        }
+        for (uint32_t i = 8; i < 24; i++) {
+            EXPECT_THAT(read_first[i], is(equal_to(1)));
+        }
+        for (uint32_t i = 24; i < 32; i++) {
+            EXPECT_THAT(read_first[i], is(equal_to(2)));
+        }
+        for (uint8_t byte : read_second) {
+            EXPECT_THAT(byte, is(equal_to(2)));
+        }
+    });
+}
+
+TEST_CASE(TaskletIo, ReadFixed) {
+    tasklet::IoConfig io_config{
+        .fixed_file_count = 4,
+        .fixed_buffer_count = 2,
+        .fixed_buffer_size = 4096,
+    };
+    tasklet::Scheduler scheduler(4, 64, false, tasklet::SchedulingMode::Shared, io_config);
+    scheduler.run([&] {
+        auto file = VULL_EXPECT(platform::AsyncFile::open(
+            ".", platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Write,
+                                     platform::OpenMode::TempFile)));
+
+        Array<uint8_t, 8192> data;
+        for (uint32_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<uint8_t>(i * 13);
+        }
+        EXPECT_THAT(file.write(data.span(), 0).await(), is(equal_to(8192)));
+        EXPECT_TRUE(file.register_fixed());
+        EXPECT_TRUE(file.is_fixed());
+
+        auto first = scheduler.acquire_fixed_buffer();
+        auto second = scheduler.acquire_fixed_buffer();
+        EXPECT_FALSE(scheduler.try_acquire_fixed_buffer().has_value());
+        EXPECT_THAT(first.size(), is(equal_to(4096u)));
+
+        auto first_future = file.read_fixed(first, 4096, 0);
+        auto second_future = file.read_fixed(second, 2048, 6144);
+        EXPECT_THAT(first_future.await(), is(equal_to(4096)));
+        EXPECT_THAT(second_future.await(), is(equal_to(2048)));
+        for (uint32_t i = 0; i < 4096; i++) {
+            EXPECT_THAT(first.data()[i], is(equal_to(data[i])));
+        }
+        for (uint32_t i = 0; i < 2048; i++) {
+            EXPECT_THAT(second.data()[i], is(equal_to(data[i + 6144])));
+        }
+
+        scheduler.release_fixed_buffer(first);
+        scheduler.release_fixed_buffer(second);
+        file.unregister_fixed();
+        EXPECT_FALSE(file.is_fixed());
+    });
+}
+
+TEST_CASE(TaskletIo, SubmitTogether) {
+    tasklet::IoConfig io_config{
+        .fixed_buffer_count = 4,
+        .fixed_buffer_size = 4096,
+    };
+    tasklet::Scheduler scheduler(4, 64, false, tasklet::SchedulingMode::Shared, io_config);
+    scheduler.run([&] {
+        auto file = VULL_EXPECT(platform::AsyncFile::open(
+            ".", platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Write,
+                                     platform::OpenMode::TempFile)));
+        Array<uint8_t, 16384> data;
+        for (uint32_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<uint8_t>(i * 7);
+        }
+        EXPECT_THAT(file.write(data.span(), 0).await(), is(equal_to(16384)));
+
+        Array<tasklet::FixedBuffer, 4> buffers;
+        Array<SharedPtr<tasklet::IoRequest>, 4> requests;
+        for (uint32_t i = 0; i < buffers.size(); i++) {
+            buffers[i] = scheduler.acquire_fixed_buffer();
+            requests[i] = file.make_read_fixed(buffers[i], 4096, i * 4096);
+        }
+        tasklet::submit_io_requests(requests.span());
+        for (uint32_t i = 0; i < buffers.size(); i++) {
+            EXPECT_THAT(tasklet::Future<tasklet::IoResult>(requests[i]).await(), is(equal_to(4096)));
+            for (uint32_t j = 0; j < 4096; j++) {
+                EXPECT_THAT(buffers[i].data()[j], is(equal_to(data[i * 4096 + j])));
+            }
+            scheduler.release_fixed_buffer(buffers[i]);
+        }
+    });
+}
+
+TEST_CASE(TaskletIo, DestroyFixedOutsideTasklet) {
+    tasklet::IoConfig io_config{
+        .fixed_file_count = 4,
+    };
+    platform::AsyncFile file;
+    {
+        tasklet::Scheduler scheduler(4, 64, false, tasklet::SchedulingMode::Shared, io_config);
+        scheduler.run([&] {
+            file = VULL_EXPECT(platform::AsyncFile::open(
+                ".", platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Write,
+                                         platform::OpenMode::TempFile)));
+            EXPECT_TRUE(file.register_fixed());
+        });
+    }
+
+    // Destroying a still registered file after the scheduler has gone must not try to submit to its IO queue.
+    EXPECT_TRUE(file.is_fixed());
+    file = {};
+    EXPECT_FALSE(file.is_fixed());
+}
@@ -1,10 +1,14 @@
+#include <vull/support/atomic.hh>
 #include <vull/tasklet/functions.hh>
 #include <vull/tasklet/future.hh>
+#include <vull/tasklet/latch.hh>
 #include <vull/tasklet/scheduler.hh>
 #include <vull/test/assertions.hh>
 #include <vull/test/matchers.hh>
 #include <vull/test/test.hh>
 
+#include <stdint.h>
+
 using namespace vull;
 using namespace vull::test::matchers;
 
@@ -27,3 +31,40 @@ TEST_CASE(Tasklet, InTaskletContext) {
     });
     EXPECT_FALSE(tasklet::in_tasklet_context());
 }
+
+TEST_CASE(Tasklet, WorkStealingNested) {
+    tasklet::Scheduler scheduler(4, 64, false, tasklet::SchedulingMode::WorkStealing);
+    scheduler.run([] {
+        Atomic<uint32_t> counter;
+        tasklet::Latch latch(1024);
+        for (uint32_t i = 0; i < 32; i++) {
+            tasklet::schedule([&] {
+                for (uint32_t j = 0; j < 32; j++) {
+                    tasklet::schedule([&] {
+                        counter.fetch_add(1);
+                        latch.count_down();
+                    });
+                }
+            });
+        }
+        latch.wait();
+        EXPECT_THAT(counter.load(), is(equal_to(1024)));
+    });
+}
+
+TEST_CASE(Tasklet, WorkStealingOverflow) {
+    // Spawn more tasklets from one worker than its local queue can hold.
+    tasklet::Scheduler scheduler(2, 64, false, tasklet::SchedulingMode::WorkStealing);
+    scheduler.run([] {
+        Atomic<uint32_t> counter;
+        tasklet::Latch latch(4096);
+        for (uint32_t i = 0; i < 4096; i++) {
+            tasklet::schedule([&] {
+                counter.fetch_add(1);
+                latch.count_down();
+            });
+        }
+        latch.wait();
+        EXPECT_THAT(counter.load(), is(equal_to(4096)));
+    });
+}
@@ -0,0 +1,83 @@
+#include <vull/vpak/file_system.hh>
+
+#include <vull/container/vector.hh>
+#include <vull/platform/file.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+#include <vull/vpak/defs.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/stream.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+// Writes a pack whose entries contain a single byte identifying the pack they came from.
+void write_pack(String path, uint32_t first_entry, uint32_t entry_count, uint8_t tag) {
+    VULL_IGNORE(platform::unlink_path(path));
+    auto pack_file = VULL_EXPECT(vpak::PackFile::open(vull::move(path)));
+    auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+    for (uint32_t i = first_entry; i < first_entry + entry_count; i++) {
+        auto stream = writer.add_entry(vull::format("entry{}", i), vpak::EntryType::Blob, vpak::EntryCodec::Raw);
+        VULL_EXPECT(stream.write(Span<const uint8_t>(&tag, 1)));
+        VULL_EXPECT(stream.finish());
+    }
+    VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+}
+
+uint8_t read_tag(StringView name) {
+    auto stream = vpak::open(name);
+    EXPECT_TRUE(stream);
+    uint8_t tag = 0;
+    EXPECT_THAT(VULL_EXPECT(stream->read(Span<uint8_t>(&tag, 1))), is(equal_to(1u)));
+    return tag;
+}
+
+} // namespace
+
+TEST_CASE(VpakFileSystem, MergedIndex) {
+    // Nothing loaded yet.
+    EXPECT_FALSE(vpak::stat("entry0").has_value());
+    EXPECT_FALSE(vpak::open("entry0"));
+
+    // The second pack overlaps the upper half of the first, and the third adds an empty pack.
+    write_pack("fs_a.vpak", 0, 100, 1);
+    write_pack("fs_b.vpak", 50, 100, 2);
+    write_pack("fs_c.vpak", 0, 0, 3);
+    vpak::load_vpak("fs_a", "fs_a.vpak");
+    vpak::load_vpak("fs_b", "fs_b.vpak");
+    vpak::load_vpak("fs_c", "fs_c.vpak");
+
+    for (uint32_t i = 0; i < 150; i++) {
+        const auto name = vull::format("entry{}", i);
+        auto entry = vpak::stat(name);
+        EXPECT_TRUE(entry.has_value());
+        EXPECT_THAT(entry->size, is(equal_to(1u)));
+        EXPECT_THAT(read_tag(name), is(equal_to(i < 50 ? 1 : 2)));
+    }
+    EXPECT_FALSE(vpak::stat("entry150").has_value());
+    EXPECT_FALSE(vpak::open("entry"));
+
+    // Loading another pack invalidates the index.
+    write_pack("fs_d.vpak", 0, 1, 4);
+    vpak::load_vpak("fs_d", "fs_d.vpak");
+    EXPECT_THAT(read_tag("entry0"), is(equal_to(4)));
+    EXPECT_THAT(read_tag("entry1"), is(equal_to(1)));
+
+    const StringView paths[]{"fs_a.vpak", "fs_b.vpak", "fs_c.vpak", "fs_d.vpak"};
+    for (auto path : paths) {
+        VULL_IGNORE(platform::unlink_path(path));
+    }
+}
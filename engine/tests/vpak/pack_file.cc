@@ -0,0 +1,482 @@
+#include <vull/container/vector.hh>
+#include <vull/platform/file.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/unique_ptr.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/test/assertions.hh>
+#include <vull/test/matchers.hh>
+#include <vull/test/test.hh>
+#include <vull/vpak/defs.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/stream.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+#include <string.h>
+
+using namespace vull;
+using namespace vull::test::matchers;
+
+namespace {
+
+Vector<uint8_t> make_data(uint32_t size, uint32_t seed) {
+    // Mix of compressible runs and noise.
+    Vector<uint8_t> data(size);
+    uint32_t state = seed;
+    for (uint32_t i = 0; i < size; i++) {
+        state = state * 1664525u + 1013904223u;
+        data[i] = (i / 512) % 2 == 0 ? static_cast<uint8_t>(i / 512) : static_cast<uint8_t>(state >> 24);
+    }
+    return data;
+}
+
+void write_pack(String path, const Vector<uint32_t> &sizes, uint32_t block_parallelism = 1) {
+    VULL_IGNORE(platform::unlink_path(path));
+    auto pack_file = VULL_EXPECT(vpak::PackFile::open(vull::move(path)));
+    auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+    writer.set_block_parallelism(block_parallelism);
+    for (uint32_t i = 0; i < sizes.size(); i++) {
+        auto stream = writer.add_entry(vull::format("entry{}", i), vpak::EntryType::Blob);
+        auto data = make_data(sizes[i], i);
+        VULL_EXPECT(stream.write(data.span()));
+        VULL_EXPECT(stream.finish());
+    }
+    VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+}
+
+Vector<uint8_t> make_noise(uint32_t size, uint32_t seed) {
+    Vector<uint8_t> data(size);
+    uint32_t state = seed;
+    for (uint32_t i = 0; i < size; i++) {
+        state = state * 1664525u + 1013904223u;
+        data[i] = static_cast<uint8_t>(state >> 24);
+    }
+    return data;
+}
+
+void check_entry(const vpak::PackFile &pack_file, StringView name, const Vector<uint8_t> &expected) {
+    auto stream = pack_file.open_entry(name);
+    EXPECT_TRUE(stream);
+    Vector<uint8_t> actual(expected.size() + 1);
+    EXPECT_THAT(VULL_EXPECT(stream->read(actual.span())), is(equal_to(expected.size())));
+    for (uint32_t i = 0; i < expected.size(); i++) {
+        EXPECT_THAT(actual[i], is(equal_to(expected[i])));
+    }
+}
+
+uint64_t file_size(String path) {
+    auto file = VULL_EXPECT(platform::open_file(vull::move(path), platform::OpenMode::Read));
+    return VULL_EXPECT(file.size());
+}
+
+void add_entries(vpak::PackFile &pack_file, const Vector<uint32_t> &sizes, uint32_t seed, vpak::WriteMode write_mode) {
+    auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast, write_mode));
+    for (uint32_t i = 0; i < sizes.size(); i++) {
+        auto stream = writer.add_entry(vull::format("entry{}", i), vpak::EntryType::Blob);
+        auto data = make_data(sizes[i], seed + i);
+        VULL_EXPECT(stream.write(data.span()));
+        VULL_EXPECT(stream.finish());
+    }
+    VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+}
+
+void check_pack(const vpak::PackFile &pack_file, const Vector<uint32_t> &sizes, uint32_t readahead = 0) {
+    for (uint32_t i = 0; i < sizes.size(); i++) {
+        auto stream = pack_file.open_entry(vull::format("entry{}", i));
+        EXPECT_TRUE(stream);
+        if (readahead != 0) {
+            stream->enable_readahead(readahead);
+        }
+        auto expected = make_data(sizes[i], i);
+        Vector<uint8_t> actual(sizes[i] + 1);
+        EXPECT_THAT(VULL_EXPECT(stream->read(actual.span())), is(equal_to(sizes[i])));
+        for (uint32_t j = 0; j < sizes[i]; j++) {
+            EXPECT_THAT(actual[j], is(equal_to(expected[j])));
+        }
+    }
+    EXPECT_FALSE(pack_file.open_entry("missing"));
+}
+
+} // namespace
+
+TEST_CASE(VpakPackFile, StreamRead) {
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(100);
+        sizes.push(1u << 17u);
+        sizes.push(300'000);
+        write_pack("vpak_stream_test.vpak", sizes);
+
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_stream_test.vpak"));
+        EXPECT_FALSE(pack_file.is_mapped());
+        check_pack(pack_file, sizes);
+        VULL_IGNORE(platform::unlink_path("vpak_stream_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, MappedRead) {
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(100);
+        sizes.push(1u << 17u);
+        sizes.push(300'000);
+        write_pack("vpak_mapped_test.vpak", sizes);
+
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_mapped_test.vpak", vpak::ReadMode::Mapped));
+        EXPECT_TRUE(pack_file.is_mapped());
+        check_pack(pack_file, sizes);
+        VULL_IGNORE(platform::unlink_path("vpak_mapped_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, Readahead) {
+    tasklet::Scheduler scheduler(2, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(100);
+        sizes.push(1u << 18u);
+        sizes.push(1'300'000);
+        write_pack("vpak_readahead_test.vpak", sizes);
+
+        const vpak::ReadMode read_modes[]{vpak::ReadMode::Stream, vpak::ReadMode::Mapped};
+        for (auto read_mode : read_modes) {
+            auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_readahead_test.vpak", read_mode));
+            check_pack(pack_file, sizes, 1);
+            check_pack(pack_file, sizes, 4);
+            check_pack(pack_file, sizes, 64);
+        }
+        VULL_IGNORE(platform::unlink_path("vpak_readahead_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, ReadaheadPartial) {
+    tasklet::Scheduler scheduler(2, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(1'300'000);
+        write_pack("vpak_readahead_partial_test.vpak", sizes);
+
+        // Destroying a stream with blocks still in flight must wait for them.
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_readahead_partial_test.vpak"));
+        auto stream = pack_file.open_entry("entry0");
+        stream->enable_readahead(4);
+        auto expected = make_data(sizes[0], 0);
+        for (uint32_t i = 0; i < 200'000; i++) {
+            EXPECT_THAT(VULL_EXPECT(stream->read_byte()), is(equal_to(expected[i])));
+        }
+        stream.clear();
+        VULL_IGNORE(platform::unlink_path("vpak_readahead_partial_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, ReadaheadFixed) {
+    // Ample fixed buffers, and too few to hold a whole block.
+    const tasklet::IoConfig io_configs[]{
+        {.fixed_file_count = 4, .fixed_buffer_count = 16, .fixed_buffer_size = 65536},
+        {.fixed_buffer_count = 2, .fixed_buffer_size = 4096},
+    };
+    for (const auto &io_config : io_configs) {
+        tasklet::Scheduler scheduler(2, 64, false, tasklet::SchedulingMode::Shared, io_config);
+        scheduler.run([] {
+            VULL_IGNORE(platform::unlink_path("vpak_readahead_fixed_test.vpak"));
+            Vector<uint32_t> sizes;
+            sizes.push(100);
+            sizes.push(1'300'000);
+            sizes.push(700'000);
+            {
+                // Write the last two entries at the same time so that their block chains are interleaved.
+                auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_readahead_fixed_test.vpak"));
+                auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+                writer.set_block_parallelism(1);
+                auto first_stream = writer.add_entry("entry0", vpak::EntryType::Blob);
+                VULL_EXPECT(first_stream.write(make_data(sizes[0], 0).span()));
+                VULL_EXPECT(first_stream.finish());
+
+                auto second_data = make_data(sizes[1], 1);
+                auto third_data = make_data(sizes[2], 2);
+                auto second_stream = writer.add_entry("entry1", vpak::EntryType::Blob);
+                auto third_stream = writer.add_entry("entry2", vpak::EntryType::Blob);
+                for (uint32_t offset = 0; offset < sizes[1]; offset += 100'000) {
+                    const auto second_size = vull::min(sizes[1] - offset, 100'000u);
+                    VULL_EXPECT(second_stream.write(second_data.span().subspan(offset, second_size)));
+                    if (offset < sizes[2]) {
+                        const auto third_size = vull::min(sizes[2] - offset, 100'000u);
+                        VULL_EXPECT(third_stream.write(third_data.span().subspan(offset, third_size)));
+                    }
+                }
+                VULL_EXPECT(second_stream.finish());
+                VULL_EXPECT(third_stream.finish());
+                VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+            }
+
+            auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_readahead_fixed_test.vpak"));
+            check_pack(pack_file, sizes, 1);
+            check_pack(pack_file, sizes, 4);
+            check_pack(pack_file, sizes, 64);
+            VULL_IGNORE(platform::unlink_path("vpak_readahead_fixed_test.vpak"));
+        });
+    }
+}
+
+TEST_CASE(VpakPackFile, ParallelCompression) {
+    tasklet::Scheduler scheduler(4, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(100);
+        sizes.push(1u << 17u);
+        sizes.push(1u << 20u);
+        sizes.push(1'300'000);
+        write_pack("vpak_parallel_test.vpak", sizes, 4);
+
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_parallel_test.vpak"));
+        check_pack(pack_file, sizes);
+        VULL_IGNORE(platform::unlink_path("vpak_parallel_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, ParallelCompressionReproducible) {
+    // With a single worker thread, the output must be byte-identical to compressing inline.
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(1'300'000);
+        sizes.push(100);
+        sizes.push(1u << 20u);
+        write_pack("vpak_inline_test.vpak", sizes, 1);
+        write_pack("vpak_parallel_test.vpak", sizes, 8);
+
+        Vector<uint8_t> inline_bytes;
+        Vector<uint8_t> parallel_bytes;
+        VULL_EXPECT(platform::read_entire_file("vpak_inline_test.vpak", inline_bytes));
+        VULL_EXPECT(platform::read_entire_file("vpak_parallel_test.vpak", parallel_bytes));
+        EXPECT_THAT(parallel_bytes.size(), is(equal_to(inline_bytes.size())));
+        EXPECT_TRUE(memcmp(inline_bytes.data(), parallel_bytes.data(), inline_bytes.size()) == 0);
+        VULL_IGNORE(platform::unlink_path("vpak_inline_test.vpak"));
+        VULL_IGNORE(platform::unlink_path("vpak_parallel_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, Codecs) {
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        VULL_IGNORE(platform::unlink_path("vpak_codec_test.vpak"));
+        auto compressible = make_data(200'000, 1);
+        auto noise = make_noise(200'000, 2);
+        auto dictionary = make_data(4096, 3);
+
+        // Whether to store raw is decided from the first block alone.
+        auto mixed = make_data(1u << 17u, 4);
+        mixed.extend(make_noise(100'000, 5));
+        {
+            auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_codec_test.vpak"));
+            auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+            writer.set_raw_threshold(1.1f);
+            VULL_EXPECT(writer.add_dictionary("/dict", dictionary.span()));
+
+            auto write_entry = [&](String name, vpak::EntryCodec codec, const Vector<uint8_t> &data) {
+                auto stream = writer.add_entry(vull::move(name), vpak::EntryType::Blob, codec);
+                VULL_EXPECT(stream.write(data.span()));
+                VULL_EXPECT(stream.finish());
+            };
+            write_entry("compressible", vpak::EntryCodec::Zstd, compressible);
+            write_entry("noise", vpak::EntryCodec::Zstd, noise);
+            write_entry("raw", vpak::EntryCodec::Raw, compressible);
+            write_entry("dict", vpak::EntryCodec::ZstdDict, compressible);
+            write_entry("empty", vpak::EntryCodec::Zstd, {});
+            write_entry("mixed", vpak::EntryCodec::Zstd, mixed);
+            VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+        }
+
+        const vpak::ReadMode read_modes[]{vpak::ReadMode::Stream, vpak::ReadMode::Mapped};
+        for (auto read_mode : read_modes) {
+            auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_codec_test.vpak", read_mode));
+            EXPECT_THAT(pack_file.stat("compressible")->codec, is(equal_to(vpak::EntryCodec::Zstd)));
+            EXPECT_THAT(pack_file.stat("noise")->codec, is(equal_to(vpak::EntryCodec::Raw)));
+            EXPECT_THAT(pack_file.stat("raw")->codec, is(equal_to(vpak::EntryCodec::Raw)));
+            EXPECT_THAT(pack_file.stat("dict")->codec, is(equal_to(vpak::EntryCodec::ZstdDict)));
+            EXPECT_THAT(pack_file.stat("mixed")->codec, is(equal_to(vpak::EntryCodec::Zstd)));
+            check_entry(pack_file, "compressible", compressible);
+            check_entry(pack_file, "noise", noise);
+            check_entry(pack_file, "raw", compressible);
+            check_entry(pack_file, "dict", compressible);
+            check_entry(pack_file, "empty", {});
+            check_entry(pack_file, "mixed", mixed);
+
+            // Raw entries can only be viewed directly when mapped.
+            auto view = pack_file.raw_view("noise");
+            EXPECT_THAT(view.has_value(), is(equal_to(read_mode == vpak::ReadMode::Mapped)));
+            if (view) {
+                EXPECT_THAT(view->size(), is(equal_to(noise.size())));
+                EXPECT_THAT((*view)[1234], is(equal_to(noise[1234])));
+            }
+            EXPECT_FALSE(pack_file.raw_view("compressible").has_value());
+        }
+        VULL_IGNORE(platform::unlink_path("vpak_codec_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, BadDictionary) {
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        VULL_IGNORE(platform::unlink_path("vpak_bad_dictionary_test.vpak"));
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_bad_dictionary_test.vpak"));
+        auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+
+        // A zstd dictionary magic number followed by garbage.
+        auto dictionary = make_noise(4096, 11);
+        dictionary[0] = 0x37;
+        dictionary[1] = 0xa4;
+        dictionary[2] = 0x30;
+        dictionary[3] = 0xec;
+        auto result = writer.add_dictionary("/dict", dictionary.span());
+        EXPECT_TRUE(result.is_error());
+        EXPECT_THAT(result.error().get<vpak::VpakError>(), is(equal_to(vpak::VpakError::BadDictionary)));
+        VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+        EXPECT_TRUE(pack_file.entries().empty());
+        VULL_IGNORE(platform::unlink_path("vpak_bad_dictionary_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, ReplaceEntry) {
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(1000);
+        sizes.push(300'000);
+        write_pack("vpak_replace_test.vpak", sizes);
+        const auto original_size = file_size("vpak_replace_test.vpak");
+
+        // Rewrite both entries with different contents. The replaced data shouldn't be carried over.
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_replace_test.vpak"));
+        Vector<uint32_t> new_sizes;
+        new_sizes.push(1000);
+        new_sizes.push(200'000);
+        add_entries(pack_file, new_sizes, 100, vpak::WriteMode::Copy);
+        EXPECT_THAT(pack_file.entries().size(), is(equal_to(2u)));
+        const auto replaced_size = file_size("vpak_replace_test.vpak");
+        EXPECT_TRUE(replaced_size < original_size);
+
+        // Replacing only the first entry copies the second over as is. The new data compresses about as well as the
+        // old, so the size should barely change.
+        Vector<uint32_t> first_size;
+        first_size.push(1000);
+        add_entries(pack_file, first_size, 200, vpak::WriteMode::Copy);
+        EXPECT_TRUE(file_size("vpak_replace_test.vpak") < replaced_size + 64);
+
+        auto reopened = VULL_EXPECT(vpak::PackFile::open("vpak_replace_test.vpak"));
+        EXPECT_THAT(reopened.entries().size(), is(equal_to(2u)));
+        check_entry(reopened, "entry0", make_data(1000, 200));
+        check_entry(reopened, "entry1", make_data(200'000, 101));
+        VULL_IGNORE(platform::unlink_path("vpak_replace_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, InPlaceAppend) {
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(1'000'000);
+        write_pack("vpak_in_place_test.vpak", sizes);
+        const auto original_size = file_size("vpak_in_place_test.vpak");
+
+        // Add a small entry in place, which shouldn't rewrite the existing data.
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_in_place_test.vpak", vpak::ReadMode::Mapped));
+        {
+            auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast, vpak::WriteMode::InPlace));
+            auto stream = writer.add_entry("small", vpak::EntryType::Blob);
+            auto data = make_data(100, 7);
+            VULL_EXPECT(stream.write(data.span()));
+            VULL_EXPECT(stream.finish());
+            VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+        }
+        EXPECT_TRUE(file_size("vpak_in_place_test.vpak") < original_size + 1024);
+        check_entry(pack_file, "small", make_data(100, 7));
+        check_pack(pack_file, sizes);
+
+        auto reopened = VULL_EXPECT(vpak::PackFile::open("vpak_in_place_test.vpak"));
+        EXPECT_THAT(reopened.entries().size(), is(equal_to(2u)));
+        check_entry(reopened, "small", make_data(100, 7));
+        check_pack(reopened, sizes);
+        VULL_IGNORE(platform::unlink_path("vpak_in_place_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, StreamOpenAcrossWrite) {
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        Vector<uint32_t> sizes;
+        sizes.push(1'000'000);
+
+        // Streams opened before a write must keep reading the old data, even though the file is remapped or replaced.
+        const vpak::ReadMode read_modes[]{vpak::ReadMode::Stream, vpak::ReadMode::Mapped};
+        const vpak::WriteMode write_modes[]{vpak::WriteMode::InPlace, vpak::WriteMode::Copy};
+        for (auto read_mode : read_modes) {
+            for (auto write_mode : write_modes) {
+                write_pack("vpak_open_across_write_test.vpak", sizes);
+                auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_open_across_write_test.vpak", read_mode));
+                auto stream = pack_file.open_entry("entry0");
+                auto expected = make_data(sizes[0], 0);
+                Vector<uint8_t> actual(sizes[0] + 1);
+                EXPECT_THAT(VULL_EXPECT(stream->read(actual.span().subspan(0, 1000))), is(equal_to(1000u)));
+
+                Vector<uint32_t> new_sizes;
+                new_sizes.push(2'000'000);
+                add_entries(pack_file, new_sizes, 50, write_mode);
+                EXPECT_THAT(VULL_EXPECT(stream->read(actual.span().subspan(1000))), is(equal_to(sizes[0] - 1000)));
+                for (uint32_t i = 0; i < sizes[0]; i++) {
+                    EXPECT_THAT(actual[i], is(equal_to(expected[i])));
+                }
+                stream.clear();
+                check_entry(pack_file, "entry0", make_data(2'000'000, 50));
+            }
+        }
+        VULL_IGNORE(platform::unlink_path("vpak_open_across_write_test.vpak"));
+    });
+}
+
+TEST_CASE(VpakPackFile, Compact) {
+    tasklet::Scheduler scheduler(1, 64, false);
+    scheduler.run([] {
+        VULL_IGNORE(platform::unlink_path("vpak_compact_test.vpak"));
+        auto noise = make_noise(300'000, 9);
+        Vector<uint32_t> sizes;
+        sizes.push(0);
+        sizes.push(100);
+        sizes.push(1u << 17u);
+        sizes.push(1'000'000);
+        {
+            auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_compact_test.vpak"));
+            add_entries(pack_file, sizes, 0, vpak::WriteMode::Copy);
+
+            // Replace every entry twice in place, leaving behind stale data and entry tables, and add a raw entry.
+            add_entries(pack_file, sizes, 0, vpak::WriteMode::InPlace);
+            auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast, vpak::WriteMode::InPlace));
+            auto stream = writer.add_entry("noise", vpak::EntryType::Blob, vpak::EntryCodec::Raw);
+            VULL_EXPECT(stream.write(noise.span()));
+            VULL_EXPECT(stream.finish());
+            VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+            add_entries(pack_file, sizes, 0, vpak::WriteMode::InPlace);
+        }
+
+        const auto bloated_size = file_size("vpak_compact_test.vpak");
+        auto pack_file = VULL_EXPECT(vpak::PackFile::open("vpak_compact_test.vpak", vpak::ReadMode::Mapped));
+        const auto compacted_size = VULL_EXPECT(pack_file.compact());
+        EXPECT_THAT(file_size("vpak_compact_test.vpak"), is(equal_to(compacted_size)));
+        EXPECT_TRUE(compacted_size * 2 < bloated_size);
+        check_pack(pack_file, sizes);
+        check_entry(pack_file, "noise", noise);
+
+        auto reopened = VULL_EXPECT(vpak::PackFile::open("vpak_compact_test.vpak"));
+        EXPECT_THAT(reopened.entries().size(), is(equal_to(5u)));
+        check_pack(reopened, sizes);
+        check_entry(reopened, "noise", noise);
+        VULL_IGNORE(platform::unlink_path("vpak_compact_test.vpak"));
+    });
+}
@@ -42,7 +42,7 @@ void FpsController::update(const platform::Window &window, float dt) {
     m_right = vull::normalise(vull::cross(m_forward, k_world_up));
 
     auto &transform = m_entity.get<Transform>();
-    transform.set_rotation(vull::angle_axis(vull::half_pi<float> - m_yaw, k_world_up));
+    transform.set_rotation(m_entity, vull::angle_axis(vull::half_pi<float> - m_yaw, k_world_up));
 
     Vec3f desired_direction(0.0f);
     if (window.is_key_pressed(Key::W)) {
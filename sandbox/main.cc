@@ -7,8 +7,10 @@
 #include <vull/core/application.hh>
 #include <vull/core/input.hh>
 #include <vull/core/tracing.hh>
+#include <vull/ecs/command_buffer.hh>
 #include <vull/ecs/entity.hh>
 #include <vull/ecs/entity_id.hh>
+#include <vull/ecs/system_scheduler.hh>
 #include <vull/ecs/world.hh>
 #include <vull/graphics/default_renderer.hh>
 #include <vull/graphics/deferred_renderer.hh>
@@ -26,6 +28,7 @@
 #include <vull/physics/shape.hh>
 #include <vull/platform/timer.hh>
 #include <vull/platform/window.hh>
+#include <vull/scene/camera.hh>
 #include <vull/scene/scene.hh>
 #include <vull/scene/transform.hh>
 #include <vull/support/args_parser.hh>
@@ -67,12 +70,6 @@
 
 using namespace vull;
 
-namespace vull {
-
-class Camera;
-
-} // namespace vull
-
 namespace {
 
 class Sandbox {
@@ -87,6 +84,7 @@ class Sandbox {
     ui::Tree m_ui_tree;
     ui::Renderer m_ui_renderer;
     ui::FontAtlas m_font_atlas;
+    ui::Painter m_ui_painter;
 
     ui::TimeGraph *m_cpu_time_graph;
     ui::TimeGraph *m_gpu_time_graph;
@@ -98,6 +96,8 @@ class Sandbox {
     platform::Timer m_frame_timer;
     PhysicsEngine m_physics_engine;
     Scene m_scene;
+    SystemScheduler m_system_scheduler;
+    float m_frame_dt{0.0f};
     Entity m_player;
     UniquePtr<FpsController> m_fps_controller;
     float m_suzanne_yaw{0.0f};
@@ -110,6 +110,8 @@ public:
     create(bool enable_validation);
 
     Sandbox(UniquePtr<platform::Window> &&window, UniquePtr<vk::Context> &&context, vk::Swapchain &&swapchain);
+    Camera &active_camera();
+    void add_systems();
     void load_scene(StringView scene_name);
     tasklet::Future<void> render_frame(FramePacer &frame_pacer);
     void start_loop();
@@ -241,6 +243,73 @@ Sandbox::Sandbox(UniquePtr<platform::Window> &&window, UniquePtr<vk::Context> &&
     });
 
     m_cpu_time_graph->new_bar();
+    add_systems();
+}
+
+Camera &Sandbox::active_camera() {
+    if (!m_free_camera_active && m_fps_controller) {
+        return *m_fps_controller;
+    }
+    return m_free_camera;
+}
+
+void Sandbox::add_systems() {
+    m_system_scheduler
+        .add_system("destroy-far-bodies",
+                    [this](EntityManager &world) {
+                        EntityCommandBuffer commands;
+                        for (auto [entity, body, transform] : world.view<RigidBody, Transform>()) {
+                            if (entity == m_player) {
+                                continue;
+                            }
+                            if (vull::distance(transform.position(), m_player.get<Transform>().position()) >= 100.0f) {
+                                commands.destroy_entity(entity);
+                            }
+                        }
+                        commands.playback(world);
+                    })
+        .exclusive();
+
+    m_system_scheduler
+        .add_system("step-physics",
+                    [this](EntityManager &) {
+                        m_physics_engine.step(m_scene.world(), m_frame_dt);
+                    })
+        .reads<Collider>()
+        .writes<RigidBody, Transform>();
+
+    // The FPS controller moves the player's body.
+    m_system_scheduler
+        .add_system("update-cameras",
+                    [this](EntityManager &) {
+                        if (m_free_camera_active) {
+                            m_free_camera.update(*m_window, m_frame_dt);
+                        } else if (m_fps_controller) {
+                            m_fps_controller->update(*m_window, m_frame_dt);
+                        }
+                    })
+        .writes<RigidBody, Transform>();
+
+    // Doesn't touch the world, so can run alongside everything else.
+    m_system_scheduler.add_system("render-ui", [this](EntityManager &) {
+        m_ui_painter.bind_atlas(m_font_atlas);
+        m_ui_tree.render(m_ui_painter);
+    });
+
+    m_system_scheduler
+        .add_system("stream-cells",
+                    [this](EntityManager &) {
+                        m_scene.update_streaming(active_camera().position());
+                    })
+        .exclusive();
+
+    // Creates missing world transforms.
+    m_system_scheduler
+        .add_system("update-transforms",
+                    [this](EntityManager &) {
+                        m_scene.update_transforms();
+                    })
+        .exclusive();
 }
 
 void Sandbox::load_scene(StringView scene_name) {
@@ -323,41 +392,17 @@ tasklet::Future<void> Sandbox::render_frame(FramePacer &frame_pacer) {
         m_suzanne_timer = 0.1f;
     }
 
-    for (auto [entity, body, transform] : m_scene.world().view<RigidBody, Transform>()) {
-        if (entity == m_player) {
-            continue;
-        }
-        if (vull::distance(transform.position(), m_player.get<Transform>().position()) >= 100.0f) {
-            entity.destroy();
-        }
-    }
-
-    // Step physics.
-    platform::Timer physics_timer;
-    m_physics_engine.step(m_scene.world(), dt);
-    m_cpu_time_graph->push_section("step-physics", physics_timer.elapsed());
-
-    // Update cameras.
-    if (m_free_camera_active) {
-        m_free_camera.update(*m_window, dt);
-    } else if (m_fps_controller) {
-        m_fps_controller->update(*m_window, dt);
-    }
-
-    platform::Timer ui_timer;
-    ui::Painter ui_painter;
-    ui_painter.bind_atlas(m_font_atlas);
-    m_ui_tree.render(ui_painter);
+    // Run physics, camera, transform and UI systems, concurrently where their component access allows.
+    m_frame_dt = dt;
+    m_system_scheduler.run(m_scene.world());
     m_cpu_time_graph->new_bar();
-    m_cpu_time_graph->push_section("render-ui", ui_timer.elapsed());
+    for (const auto &system : m_system_scheduler.systems()) {
+        m_cpu_time_graph->push_section(system->name(), system->duration());
+    }
 
     m_deferred_renderer.set_exposure(m_exposure_slider->value());
     m_default_renderer.set_cull_view_locked(m_window->is_key_pressed(Key::H));
 
-    Camera *active_camera = &m_free_camera;
-    if (!m_free_camera_active && m_fps_controller) {
-        active_camera = m_fps_controller.ptr();
-    }
     m_free_camera.set_fov(m_fov_slider->value() * (vull::pi<float> / 180.0f));
 
     platform::Timer build_rg_timer;
@@ -365,14 +410,17 @@ tasklet::Future<void> Sandbox::render_frame(FramePacer &frame_pacer) {
     auto output_id = graph.import("output-image", frame_info.swapchain_image);
 
     auto gbuffer = m_deferred_renderer.create_gbuffer(graph, m_swapchain.extent());
-    auto frame_ubo = m_default_renderer.build_pass(graph, gbuffer, m_scene, *active_camera);
+    auto frame_ubo = m_default_renderer.build_pass(graph, gbuffer, m_scene, active_camera());
     m_deferred_renderer.build_pass(graph, gbuffer, frame_ubo, output_id);
     m_skybox_renderer.build_pass(graph, gbuffer.depth, frame_ubo, output_id);
-    m_ui_renderer.build_pass(graph, output_id, vull::move(ui_painter));
+    m_ui_renderer.build_pass(graph, output_id, vull::exchange(m_ui_painter, ui::Painter()));
 
     graph.add_pass("submit", vk::PassFlag::None).read(output_id, vk::ReadFlag::Present);
     m_cpu_time_graph->push_section("build-rg", build_rg_timer.elapsed());
 
+    // Everything this frame has seen the frame's changes.
+    m_scene.world().advance_tick();
+
     platform::Timer compile_rg_timer;
     graph.compile(output_id);
     m_cpu_time_graph->push_section("compile-rg", compile_rg_timer.elapsed());
@@ -410,6 +458,11 @@ void Sandbox::start_loop() {
         tracing::ScopedTrace trace("Render Frame");
         frame_pacer.submit_frame(render_frame(frame_pacer));
     }
+
+    // In-flight cell loads must finish before the scheduler shuts down.
+    if (auto *streamer = m_scene.streamer()) {
+        streamer->wait_idle();
+    }
 }
 
 void Sandbox::close() {
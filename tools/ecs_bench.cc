@@ -0,0 +1,165 @@
+#include <vull/core/log.hh>
+#include <vull/ecs/component.hh>
+#include <vull/ecs/entity.hh>
+#include <vull/ecs2/entity.hh>
+#include <vull/ecs2/world.hh>
+#include <vull/maths/common.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/args_parser.hh>
+#include <vull/support/tuple.hh>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace vull;
+
+namespace {
+
+struct Position {
+    VULL_DECLARE_COMPONENT(0);
+    float x, y, z;
+};
+
+struct Velocity {
+    VULL_DECLARE_COMPONENT(1);
+    float x, y, z;
+};
+
+struct Mass {
+    VULL_DECLARE_COMPONENT(2);
+    float inverse_mass;
+};
+
+struct Health {
+    VULL_DECLARE_COMPONENT(3);
+    uint32_t health;
+};
+
+// Which components entity i has. Every entity has a position and velocity, three in four have a mass, and one in five
+// has health, giving a few archetypes and a 3-component query that skips some entities.
+bool has_mass(uint32_t i) {
+    return i % 4 != 0;
+}
+bool has_health(uint32_t i) {
+    return i % 5 == 0;
+}
+
+void integrate(Position &position, Velocity &velocity, Mass &mass) {
+    velocity.y -= 9.81f * mass.inverse_mass * 0.01f;
+    position.x += velocity.x * 0.01f;
+    position.y += velocity.y * 0.01f;
+    position.z += velocity.z * 0.01f;
+}
+
+template <typename F>
+void run_timed(const char *name, uint32_t iterations, F fn) {
+    float best_time = 1e9f;
+    for (uint32_t i = 0; i < iterations; i++) {
+        platform::Timer timer;
+        const auto count = fn();
+        const float elapsed = timer.elapsed();
+        vull::debug("[bench] {} visited {} entities in {} ms", name, count, elapsed * 1000.0f);
+        best_time = vull::min(best_time, elapsed);
+    }
+    vull::info("[bench] Best {} query time: {} ms", name, best_time * 1000.0f);
+}
+
+void bench_entity_manager(uint32_t entity_count, uint32_t iterations) {
+    EntityManager manager;
+    manager.register_component<Position>();
+    manager.register_component<Velocity>();
+    manager.register_component<Mass>();
+    manager.register_component<Health>();
+
+    platform::Timer timer;
+    for (uint32_t i = 0; i < entity_count; i++) {
+        auto entity = manager.create_entity();
+        entity.add<Position>(0.0f, 0.0f, 0.0f);
+        if (has_health(i)) {
+            entity.add<Health>(100u);
+        }
+        entity.add<Velocity>(1.0f, 0.0f, 1.0f);
+        if (has_mass(i)) {
+            entity.add<Mass>(1.0f);
+        }
+    }
+    vull::info("[bench] EntityManager created {} entities in {} ms", entity_count, timer.elapsed() * 1000.0f);
+
+    run_timed("EntityManager", iterations, [&] {
+        uint32_t count = 0;
+        for (auto [entity, position, velocity, mass] : manager.view<Position, Velocity, Mass>()) {
+            integrate(position, velocity, mass);
+            count++;
+        }
+        return count;
+    });
+
+    // Only one in five entities has health, so this should walk the health set rather than the position set.
+    run_timed("EntityManager sparse", iterations, [&] {
+        uint32_t count = 0;
+        for (auto [entity, position, health] : manager.view<Position, Health>()) {
+            health.health -= position.y > 0.0f ? 1 : 0;
+            count++;
+        }
+        return count;
+    });
+
+    // Owning groups keep the matching entities packed at the start of each set.
+    manager.create_group<Position, Velocity, Mass>();
+    run_timed("EntityManager group", iterations, [&] {
+        uint32_t count = 0;
+        for (auto [entity, position, velocity, mass] : manager.group<Position, Velocity, Mass>()) {
+            integrate(position, velocity, mass);
+            count++;
+        }
+        return count;
+    });
+}
+
+void bench_archetype_world(uint32_t entity_count, uint32_t iterations) {
+    ecs::World world;
+    platform::Timer timer;
+    for (uint32_t i = 0; i < entity_count; i++) {
+        auto entity = world.create();
+        world.add_component<Position>(entity, 0.0f, 0.0f, 0.0f);
+        if (has_health(i)) {
+            world.add_component<Health>(entity, 100u);
+        }
+        world.add_component<Velocity>(entity, 1.0f, 0.0f, 1.0f);
+        if (has_mass(i)) {
+            world.add_component<Mass>(entity, 1.0f);
+        }
+    }
+    vull::info("[bench] ecs2::World created {} entities in {} archetypes in {} ms", entity_count,
+               world.archetype_count(), timer.elapsed() * 1000.0f);
+
+    run_timed("ecs2::World", iterations, [&] {
+        uint32_t count = 0;
+        world.for_each<Position, Velocity, Mass>([&](ecs::Entity, Position &position, Velocity &velocity, Mass &mass) {
+            integrate(position, velocity, mass);
+            count++;
+        });
+        return count;
+    });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    uint32_t entity_count = 1000000;
+    uint32_t iterations = 10;
+
+    ArgsParser args_parser("ecs-bench", "ECS Query Benchmarks", "0.1.0");
+    args_parser.add_option(entity_count, "Number of entities to create", "entities", 'e');
+    args_parser.add_option(iterations, "Number of times to run each query", "iterations", 'i');
+    if (auto result = args_parser.parse_args(argc, argv); result != ArgsParseResult::Continue) {
+        return result == ArgsParseResult::ExitSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    vull::open_log();
+    vull::set_log_colours_enabled(true);
+
+    bench_entity_manager(entity_count, iterations);
+    bench_archetype_world(entity_count, iterations);
+    return EXIT_SUCCESS;
+}
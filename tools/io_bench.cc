@@ -0,0 +1,192 @@
+#include <vull/container/vector.hh>
+#include <vull/core/log.hh>
+#include <vull/maths/common.hh>
+#include <vull/platform/async_file.hh>
+#include <vull/platform/file.hh>
+#include <vull/platform/thread.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/args_parser.hh>
+#include <vull/support/atomic.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/string.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/functions.hh>
+#include <vull/tasklet/future.hh>
+#include <vull/tasklet/io.hh>
+#include <vull/tasklet/latch.hh>
+#include <vull/tasklet/scheduler.hh>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace vull;
+
+namespace {
+
+enum class ReadMode {
+    Regular,
+    Fixed,
+};
+
+struct BenchConfig {
+    uint64_t file_size;
+    uint32_t block_size;
+    uint32_t depth;
+};
+
+bool fill_file(const platform::AsyncFile &file, const BenchConfig &config) {
+    Vector<uint8_t> block(config.block_size);
+    for (uint32_t i = 0; i < config.block_size; i++) {
+        block[i] = static_cast<uint8_t>(i * 31);
+    }
+    for (uint64_t offset = 0; offset < config.file_size; offset += config.block_size) {
+        const auto size = static_cast<uint32_t>(vull::min(config.file_size - offset, uint64_t(config.block_size)));
+        if (file.write(block.span().subspan(0, size), offset).await() != static_cast<int32_t>(size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads the whole file with depth tasklets each keeping a single block read in flight.
+uint64_t read_file(const platform::AsyncFile &file, const BenchConfig &config, ReadMode mode) {
+    auto &scheduler = tasklet::Scheduler::current();
+    const uint64_t block_count = vull::ceil_div(config.file_size, uint64_t(config.block_size));
+    Atomic<uint64_t> bytes_read;
+    tasklet::Latch latch(config.depth);
+    for (uint32_t i = 0; i < config.depth; i++) {
+        tasklet::schedule([&, i] {
+            tasklet::FixedBuffer fixed_buffer;
+            Vector<uint8_t> buffer;
+            if (mode == ReadMode::Fixed) {
+                fixed_buffer = scheduler.acquire_fixed_buffer();
+            } else {
+                buffer.ensure_size(config.block_size);
+            }
+
+            uint64_t total = 0;
+            for (uint64_t block = i; block < block_count; block += config.depth) {
+                const uint64_t offset = block * config.block_size;
+                tasklet::IoResult result;
+                if (mode == ReadMode::Fixed) {
+                    result = file.read_fixed(fixed_buffer, config.block_size, offset).await();
+                } else {
+                    result = file.read(buffer.span(), offset).await();
+                }
+                if (result < 0) {
+                    vull::error("[bench] Read failed: {}", result);
+                    break;
+                }
+                total += static_cast<uint64_t>(result);
+            }
+
+            if (mode == ReadMode::Fixed) {
+                scheduler.release_fixed_buffer(fixed_buffer);
+            }
+            bytes_read.fetch_add(total, vull::memory_order_relaxed);
+            latch.count_down();
+        });
+    }
+    latch.wait();
+    return bytes_read.load(vull::memory_order_relaxed);
+}
+
+void run_bench(const platform::AsyncFile &file, const BenchConfig &config, ReadMode mode, uint32_t iterations) {
+    const char *name = mode == ReadMode::Fixed ? "fixed" : "regular";
+    float best_rate = 0.0f;
+    for (uint32_t i = 0; i < iterations; i++) {
+        platform::Timer timer;
+        const auto bytes_read = read_file(file, config, mode);
+        const float elapsed = timer.elapsed();
+        if (bytes_read != config.file_size) {
+            vull::error("[bench] Short {} read ({} of {} bytes)", name, bytes_read, config.file_size);
+            return;
+        }
+        const float rate = static_cast<float>(bytes_read) / (1024.0f * 1024.0f) / elapsed;
+        vull::info("[bench] {} read of {} MiB in {} ms ({} MiB/s)", name, bytes_read / (1024 * 1024),
+                   elapsed * 1000.0f, rate);
+        best_rate = vull::max(best_rate, rate);
+    }
+    vull::info("[bench] Best {} read throughput: {} MiB/s", name, best_rate);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    String path;
+    bool sqpoll = false;
+    uint32_t block_size_kib = 128;
+    uint32_t depth = 32;
+    uint32_t file_size_mib = 1024;
+    uint32_t iterations = 3;
+    uint32_t ring_size = 256;
+    uint32_t thread_count = vull::max(platform::core_count() / 2, 1);
+
+    ArgsParser args_parser("io-bench", "IO Benchmarks", "0.1.0");
+    args_parser.add_flag(sqpoll, "Use a kernel submission queue polling thread", "sqpoll");
+    args_parser.add_option(block_size_kib, "Read block size in KiB", "block-size", 'b');
+    args_parser.add_option(depth, "Number of reads in flight", "depth", 'd');
+    args_parser.add_option(file_size_mib, "Size of the generated file in MiB", "size", 's');
+    args_parser.add_option(iterations, "Number of times to read the file per mode", "iterations", 'i');
+    args_parser.add_option(ring_size, "IO ring submission queue size", "ring-size");
+    args_parser.add_option(thread_count, "Tasklet worker thread count", "threads", 't');
+    args_parser.add_argument(path, "file", false);
+    if (auto result = args_parser.parse_args(argc, argv); result != ArgsParseResult::Continue) {
+        return result == ArgsParseResult::ExitSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    vull::open_log();
+    vull::set_log_colours_enabled(true);
+
+    tasklet::IoConfig io_config{
+        .ring_size = ring_size,
+        .fixed_file_count = 1,
+        .fixed_buffer_count = depth,
+        .fixed_buffer_size = block_size_kib * 1024,
+        .sqpoll = sqpoll,
+    };
+    tasklet::Scheduler scheduler(thread_count, 256, false, tasklet::SchedulingMode::Shared, io_config);
+    const bool success = scheduler.run([&] {
+        // Use the given file, or otherwise generate an anonymous temporary one.
+        BenchConfig config{
+            .block_size = block_size_kib * 1024,
+            .depth = vull::min(depth, scheduler.io_config().fixed_buffer_count),
+        };
+        platform::AsyncFile file;
+        if (!path.empty()) {
+            auto file_or_error = platform::AsyncFile::open(path, platform::OpenMode::Read);
+            if (file_or_error.is_error()) {
+                vull::error("[bench] Failed to open {}", path);
+                return false;
+            }
+            file = file_or_error.disown_value();
+            config.file_size = VULL_EXPECT(file.size());
+        } else {
+            auto file_or_error = platform::AsyncFile::open(
+                ".", platform::OpenModes(platform::OpenMode::Read, platform::OpenMode::Write,
+                                         platform::OpenMode::TempFile));
+            if (file_or_error.is_error()) {
+                vull::error("[bench] Failed to create temporary file");
+                return false;
+            }
+            file = file_or_error.disown_value();
+            config.file_size = uint64_t(file_size_mib) * 1024 * 1024;
+            if (!fill_file(file, config)) {
+                vull::error("[bench] Failed to write temporary file");
+                return false;
+            }
+        }
+
+        // Note that unless the file is larger than memory, the reads will mostly be served from the page cache, which
+        // isolates the per-request overhead that fixed files and buffers avoid.
+        run_bench(file, config, ReadMode::Regular, iterations);
+        if (!file.register_fixed()) {
+            vull::warn("[bench] Failed to register file, using regular file descriptor");
+        }
+        run_bench(file, config, ReadMode::Fixed, iterations);
+        file.unregister_fixed();
+        return true;
+    });
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,3 +1,4 @@
+#include <vull/container/array.hh>
 #include <vull/container/vector.hh>
 #include <vull/core/log.hh>
 #include <vull/maths/common.hh>
@@ -144,6 +145,52 @@ uint32_t find_primes(uint32_t tasklet_count) {
     return primes.size();
 }
 
+void spawn_tree(tasklet::Latch &latch, uint32_t depth) {
+    if (depth == 0) {
+        latch.count_down();
+        return;
+    }
+    for (uint32_t i = 0; i < 2; i++) {
+        tasklet::schedule([&latch, depth] {
+            spawn_tree(latch, depth - 1);
+        });
+    }
+}
+
+void spawn_trees(uint32_t tree_count) {
+    // Keep each tree small enough that a breadth-first expansion of it can't overflow the shared queue.
+    for (uint32_t i = 0; i < tree_count; i++) {
+        tasklet::Latch latch(1024);
+        spawn_tree(latch, 10);
+        latch.wait();
+    }
+}
+
+void do_scaling_comparison(uint32_t fiber_limit, bool pin_threads) {
+    constexpr uint32_t tree_count = 128;
+    constexpr Array k_modes{tasklet::SchedulingMode::Shared, tasklet::SchedulingMode::WorkStealing};
+    for (uint32_t thread_count = 2; thread_count <= 64; thread_count *= 2) {
+        Array<float, k_modes.size()> times{};
+        Array<float, k_modes.size()> wakes_per_tasklet{};
+        for (uint32_t i = 0; i < k_modes.size(); i++) {
+            const bool pin = pin_threads && thread_count <= platform::core_count();
+            tasklet::Scheduler scheduler(thread_count, fiber_limit, pin, k_modes[i]);
+            times[i] = scheduler.run([&] {
+                // Warmup scheduler.
+                spawn_trees(1);
+
+                platform::Timer timer;
+                const auto wake_count = scheduler.wake_count();
+                spawn_trees(tree_count);
+                wakes_per_tasklet[i] = static_cast<float>(scheduler.wake_count() - wake_count) / (tree_count * 2046);
+                return timer.elapsed() * 1000.0f;
+            });
+        }
+        vull::info("[scaling] {} threads: shared {} ms, work-stealing {} ms ({}x), wakes per tasklet {} vs {}",
+                   thread_count, times[0], times[1], times[0] / times[1], wakes_per_tasklet[0], wakes_per_tasklet[1]);
+    }
+}
+
 void do_stress_test(uint32_t tasklet_count) {
     vull::info("[stress] Spawning {} tasklets", tasklet_count);
     Atomic<uint32_t> atomic_counter;
@@ -179,13 +226,17 @@ void do_stress_test(uint32_t tasklet_count) {
 
 int main(int argc, char **argv) {
     bool pin_threads = false;
+    bool scaling = false;
     bool stress_test = false;
+    bool work_stealing = false;
     uint32_t fiber_limit = 256;
     uint32_t thread_count = vull::max(platform::core_count() / 2, 1);
 
     ArgsParser args_parser("tasklet-bench", "Tasklet Benchmarks", "0.1.0");
     args_parser.add_flag(pin_threads, "Pin worker threads to cores", "pin", 'p');
+    args_parser.add_flag(scaling, "Compare scheduling modes from 2 to 64 threads", "scaling");
     args_parser.add_flag(stress_test, "Run stress test", "stress", 's');
+    args_parser.add_flag(work_stealing, "Use work-stealing scheduling", "work-stealing", 'w');
     args_parser.add_option(fiber_limit, "Tasklet fiber limit", "fiber-limit");
     args_parser.add_option(thread_count, "Tasklet worker thread count", "threads", 't');
     if (auto result = args_parser.parse_args(argc, argv); result != ArgsParseResult::Continue) {
@@ -195,7 +246,13 @@ int main(int argc, char **argv) {
     vull::open_log();
     vull::set_log_colours_enabled(true);
 
-    tasklet::Scheduler scheduler(thread_count, fiber_limit, pin_threads);
+    if (scaling) {
+        do_scaling_comparison(fiber_limit, pin_threads);
+        return EXIT_SUCCESS;
+    }
+
+    const auto mode = work_stealing ? tasklet::SchedulingMode::WorkStealing : tasklet::SchedulingMode::Shared;
+    tasklet::Scheduler scheduler(thread_count, fiber_limit, pin_threads, mode);
     scheduler.run([&] {
         // Warmup scheduler.
         tasklet::Latch latch(512);
@@ -247,5 +304,14 @@ int main(int argc, char **argv) {
             uint32_t prime_count = find_primes(256);
             vull::info("[bench] Found {} primes in {} ms", prime_count, timer.elapsed() * 1000.0f);
         }
+
+        // Recursive spawning of many tiny tasklets.
+        {
+            platform::Timer timer;
+            const auto wake_count = scheduler.wake_count();
+            spawn_trees(128);
+            vull::info("[bench] Spawned {} tasklets in {} ms with {} worker wakes", 128 * 2046,
+                       timer.elapsed() * 1000.0f, scheduler.wake_count() - wake_count);
+        }
     });
 }
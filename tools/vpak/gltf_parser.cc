@@ -21,11 +21,13 @@
 #include <vull/json/tree.hh>
 #include <vull/maths/colour.hh>
 #include <vull/maths/common.hh>
+#include <vull/maths/mat.hh>
 #include <vull/maths/quat.hh>
 #include <vull/maths/vec.hh>
 #include <vull/platform/file_stream.hh>
 #include <vull/platform/thread.hh>
 #include <vull/scene/transform.hh>
+#include <vull/scene/world_streamer.hh>
 #include <vull/support/assert.hh>
 #include <vull/support/enum.hh>
 #include <vull/support/optional.hh>
@@ -69,6 +71,7 @@ class Converter {
     vpak::Writer &m_pack_writer;
     json::Value &m_document;
     const bool m_max_resolution;
+    const float m_cell_size;
 
     HashMap<uint64_t, String> m_albedo_paths;
     HashMap<uint64_t, String> m_normal_paths;
@@ -81,10 +84,21 @@ class Converter {
     HashMap<String, MeshBounds> m_mesh_bounds;
     tasklet::Mutex m_mesh_bounds_mutex;
 
+    // A node to be placed in a world cell, along with the mesh-less ancestors which need to be replicated into it.
+    struct CellNode {
+        Vector<uint64_t> ancestors;
+        uint64_t index;
+    };
+    struct Cell {
+        Vec2i coord;
+        Vector<CellNode> nodes;
+    };
+
 public:
-    Converter(Span<uint8_t> binary_blob, vpak::Writer &pack_writer, json::Value &document, bool max_resolution)
+    Converter(Span<uint8_t> binary_blob, vpak::Writer &pack_writer, json::Value &document, bool max_resolution,
+              float cell_size)
         : m_binary_blob(binary_blob), m_pack_writer(pack_writer), m_document(document),
-          m_max_resolution(max_resolution) {}
+          m_max_resolution(max_resolution), m_cell_size(cell_size) {}
 
     GltfResult<Tuple<uint64_t, uint64_t>> get_blob_info(const json::Object &accessor);
     GltfResult<uint64_t> get_blob_offset(const json::Object &accessor);
@@ -96,7 +110,11 @@ public:
     GltfResult<> process_primitive(const json::Object &primitive, String &&name);
 
     GltfResult<Optional<Material>> make_material(const json::Object &primitive);
+    GltfResult<Transform> node_transform(const json::Object &node, EntityId parent_id);
     GltfResult<> visit_node(World &world, EntityId parent_id, uint64_t index);
+    GltfResult<> partition_node(uint64_t index, const Mat4f &parent_matrix, Vector<uint64_t> &ancestors,
+                                Vector<Cell> &cells, HashMap<uint64_t, uint32_t> &cell_indices);
+    GltfResult<> process_scene_cells(const json::Array &root_node_array, StringView entry_name);
     GltfResult<> process_scene(const json::Object &scene, StringView name);
 
     GltfResult<> convert();
@@ -500,6 +518,15 @@ GltfResult<> Converter::process_primitive(const json::Object &primitive, String
     return {};
 }
 
+// Registers the components of a converted scene, in the same order as Scene::register_components.
+void register_components(World &world) {
+    world.register_component<Transform>();
+    world.register_component<Mesh>();
+    world.register_component<Material>();
+    world.register_component<BoundingBox>();
+    world.register_component<BoundingSphere>();
+}
+
 GltfResult<> array_to_vec(const json::Array &array, auto &vec) {
     if (array.size() != vull::remove_ref<decltype(vec)>::length) {
         return GltfError::BadVectorArrayLength;
@@ -522,8 +549,7 @@ GltfResult<Optional<Material>> Converter::make_material(const json::Object &prim
     return Optional<Material>(Material(vull::move(albedo_path), vull::move(normal_path)));
 }
 
-GltfResult<> Converter::visit_node(World &world, EntityId parent_id, uint64_t index) {
-    const auto &node = VULL_TRY(m_document["nodes"][index].get<json::Object>());
+GltfResult<Transform> Converter::node_transform(const json::Object &node, EntityId parent_id) {
     if (node["matrix"]) {
         return GltfError::UnsupportedNodeMatrix;
     }
@@ -542,9 +568,13 @@ GltfResult<> Converter::visit_node(World &world, EntityId parent_id, uint64_t in
     if (auto scale_array = node["scale"].get<json::Array>().to_optional()) {
         VULL_TRY(array_to_vec(*scale_array, scale));
     }
+    return Transform(parent_id, position, rotation, scale);
+}
 
+GltfResult<> Converter::visit_node(World &world, EntityId parent_id, uint64_t index) {
+    const auto &node = VULL_TRY(m_document["nodes"][index].get<json::Object>());
     auto entity = world.create_entity();
-    entity.add<Transform>(parent_id, position, rotation, scale);
+    entity.add<Transform>(VULL_TRY(node_transform(node, parent_id)));
 
     // TODO: Make this much simpler by not using name strings as keys?
     if (auto mesh_index = node["mesh"].get<int64_t>().to_optional()) {
@@ -585,26 +615,103 @@ GltfResult<> Converter::visit_node(World &world, EntityId parent_id, uint64_t in
     return {};
 }
 
+GltfResult<> Converter::partition_node(uint64_t index, const Mat4f &parent_matrix, Vector<uint64_t> &ancestors,
+                                       Vector<Cell> &cells, HashMap<uint64_t, uint32_t> &cell_indices) {
+    const auto &node = VULL_TRY(m_document["nodes"][index].get<json::Object>());
+    const auto matrix = parent_matrix * VULL_TRY(node_transform(node, ~EntityId(0))).matrix();
+
+    // Descend through grouping nodes so that a scene with a single root still gets split up.
+    auto children_array = node["children"].get<json::Array>().to_optional();
+    if (!node["mesh"] && children_array && children_array->size() != 0) {
+        ancestors.push(index);
+        for (uint64_t i = 0; i < children_array->size(); i++) {
+            auto child_index = static_cast<uint64_t>(VULL_TRY((*children_array)[i].get<int64_t>()));
+            VULL_TRY(partition_node(child_index, matrix, ancestors, cells, cell_indices));
+        }
+        ancestors.pop();
+        return {};
+    }
+
+    const Vec3f position = matrix[3];
+    const Vec2i coord(vull::floor(position.x() / m_cell_size), vull::floor(position.z() / m_cell_size));
+    const auto key = (uint64_t(static_cast<uint32_t>(coord.x())) << 32u) | static_cast<uint32_t>(coord.y());
+    if (!cell_indices.contains(key)) {
+        cell_indices.set(key, cells.size());
+        cells.push({.coord = coord});
+    }
+
+    auto &cell_node = cells[*cell_indices.get(key)].nodes.emplace();
+    cell_node.ancestors.extend(ancestors);
+    cell_node.index = index;
+    return {};
+}
+
+GltfResult<> Converter::process_scene_cells(const json::Array &root_node_array, StringView entry_name) {
+    Vector<Cell> cells;
+    HashMap<uint64_t, uint32_t> cell_indices;
+    Vector<uint64_t> ancestors;
+    for (uint64_t i = 0; i < root_node_array.size(); i++) {
+        const auto index = static_cast<uint64_t>(VULL_TRY(root_node_array[i].get<int64_t>()));
+        VULL_TRY(partition_node(index, Mat4f(1.0f), ancestors, cells, cell_indices));
+    }
+
+    for (const auto &cell : cells) {
+        World world;
+        register_components(world);
+
+        // Each cell gets its own copy of the ancestors of its nodes.
+        HashMap<uint64_t, EntityId> ancestor_entities;
+        for (const auto &cell_node : cell.nodes) {
+            EntityId parent_id = ~EntityId(0);
+            for (const auto ancestor_index : cell_node.ancestors) {
+                if (auto existing = ancestor_entities.get(ancestor_index)) {
+                    parent_id = *existing;
+                    continue;
+                }
+                const auto &ancestor = VULL_TRY(m_document["nodes"][ancestor_index].get<json::Object>());
+                auto entity = world.create_entity();
+                entity.add<Transform>(VULL_TRY(node_transform(ancestor, parent_id)));
+                ancestor_entities.set(ancestor_index, entity);
+                parent_id = entity;
+            }
+            VULL_TRY(visit_node(world, parent_id, cell_node.index));
+        }
+        const auto cell_name = WorldCellManifest::cell_name(entry_name, cell.coord);
+        VULL_TRY(world.serialise(m_pack_writer, cell_name, EntityIdEncoding::FixedWidth));
+    }
+
+    auto manifest = m_pack_writer.add_entry(WorldCellManifest::manifest_name(entry_name), vpak::EntryType::Blob);
+    VULL_TRY(manifest.write_le(vull::bit_cast<uint32_t>(m_cell_size)));
+    VULL_TRY(manifest.write_varint(cells.size()));
+    for (const auto &cell : cells) {
+        VULL_TRY(manifest.write_le(static_cast<uint32_t>(cell.coord.x())));
+        VULL_TRY(manifest.write_le(static_cast<uint32_t>(cell.coord.y())));
+    }
+    VULL_TRY(manifest.finish());
+    vull::info("[gltf] Split {} into {} cells", entry_name, cells.size());
+    return {};
+}
+
 GltfResult<> Converter::process_scene(const json::Object &scene, StringView name) {
     tracing::ScopedTrace trace("Process Scene");
     trace.add_text(name);
 
+    const auto entry_name = vull::format("/scenes/{}", name);
+    const auto &root_node_array = VULL_TRY(scene["nodes"].get<json::Array>());
+    if (m_cell_size > 0.0f) {
+        return process_scene_cells(root_node_array, entry_name);
+    }
+
     World world;
-    world.register_component<Transform>();
-    world.register_component<Mesh>();
-    world.register_component<Material>();
-    world.register_component<BoundingBox>();
-    world.register_component<BoundingSphere>();
+    register_components(world);
 
-    const auto &root_node_array = VULL_TRY(scene["nodes"].get<json::Array>());
     for (uint64_t i = 0; i < root_node_array.size(); i++) {
         const auto index = static_cast<uint64_t>(VULL_TRY(root_node_array[i].get<int64_t>()));
         VULL_TRY(visit_node(world, ~EntityId(0), index));
     }
 
     // Serialise to vpak.
-    const auto entry_name = vull::format("/scenes/{}", name);
-    VULL_TRY(world.serialise(m_pack_writer, entry_name));
+    VULL_TRY(world.serialise(m_pack_writer, entry_name, EntityIdEncoding::FixedWidth));
     return {};
 }
 
@@ -700,7 +807,8 @@ Result<void, GlbError, StreamError> GltfParser::parse_glb() {
     return {};
 }
 
-GltfResult<> GltfParser::convert(vpak::Writer &pack_writer, bool max_resolution, bool reproducible) {
+GltfResult<> GltfParser::convert(vpak::Writer &pack_writer, bool max_resolution, bool reproducible,
+                                 float cell_size) {
     tracing::ScopedTrace json_trace("Parse JSON");
     auto document = VULL_TRY(json::parse(m_json));
     if (auto generator = document["asset"]["generator"].get<String>()) {
@@ -715,11 +823,15 @@ GltfResult<> GltfParser::convert(vpak::Writer &pack_writer, bool max_resolution,
         }
     }
 
-    // Use only one thread if reproducible.
+    // Use only one thread if reproducible. Block-parallel compression would be pointless then, and would also let
+    // entries interleave differently whenever a stream waits on a block.
     const auto thread_count = reproducible ? 1 : (platform::core_count() / 2);
+    if (reproducible) {
+        pack_writer.set_block_parallelism(1);
+    }
     tasklet::Scheduler scheduler(thread_count, 256, true);
     VULL_TRY(scheduler.run([&] -> GltfResult<> {
-        Converter converter(m_binary_blob.span(), pack_writer, document, max_resolution);
+        Converter converter(m_binary_blob.span(), pack_writer, document, max_resolution, cell_size);
         VULL_TRY(converter.convert());
         return {};
     }));
@@ -49,7 +49,8 @@ public:
     explicit GltfParser(platform::FileStream &&stream) : m_stream(vull::move(stream)) {}
 
     Result<void, GlbError, StreamError> parse_glb();
-    GltfResult<> convert(vpak::Writer &pack_writer, bool max_resolution, bool reproducible);
+    // Scenes are split into streamable cells (see WorldCellManifest) if cell_size is non-zero.
+    GltfResult<> convert(vpak::Writer &pack_writer, bool max_resolution, bool reproducible, float cell_size = 0.0f);
 
     const String &json() const { return m_json; }
 };
@@ -31,12 +31,19 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <zdict.h>
 #include <zstd.h>
 
 using namespace vull;
 
 namespace {
 
+// Entries which don't compress to at least this ratio, such as already block-compressed textures, are stored raw.
+constexpr float k_raw_threshold = 1.05f;
+
+// Maximum size of a trained dictionary, matching the zstd CLI default.
+constexpr uint32_t k_max_dictionary_size = 112640;
+
 void print_usage(StringView executable) {
     String whitespace(executable.length());
     memset(whitespace.data(), ' ', whitespace.length());
@@ -44,42 +51,97 @@ void print_usage(StringView executable) {
     StringBuilder sb;
     sb.append("usage:\n");
     sb.append("  {} <command> [<args>]\n", executable);
-    sb.append("  {} add [--fast|--ultra] <vpak> <file> <entry>\n", executable);
+    sb.append("  {} add [--fast|--ultra] [--dict|--raw] [--in-place] <vpak> <file> <entry>\n", executable);
     sb.append("  {} add-gltf [--dump-json] [--fast|--ultra] [--max-resolution]\n", executable);
-    sb.append("  {}          [--reproducible] <vpak> <gltf>\n", whitespace);
+    sb.append("  {}          [--reproducible] [--in-place] [--cell-size=<m>] <vpak> <gltf>\n", whitespace);
     sb.append("  {} add-png <vpak> <png> <entry>\n", executable);
     sb.append("  {} add-skybox <vpak> <entry> <faces>\n", executable);
     sb.append("  {} get <vpak> <entry> <file>\n", executable);
     sb.append("  {} help\n", executable);
     sb.append("  {} ls <vpak>\n", executable);
     sb.append("  {} stat <vpak> <entry>\n", executable);
+    sb.append("  {} vacuum <vpak>\n", executable);
     sb.append("\narguments:\n");
     sb.append("  <vpak>           The vpak file to be inspected/modified\n");
+    sb.append("  --cell-size=<m>  Split scenes into cells of <m> metres for streaming\n");
+    sb.append("  --dict           Train a shared Zstd dictionary from the input files\n");
+    sb.append("                   (useful for many small, similar entries)\n");
     sb.append("  --dump-json      Dump the JSON scene data contained in the glTF\n");
     sb.append("  --fast           Use the lowest Zstd compression level (negative)\n");
+    sb.append("  --in-place       Append to the vpak rather than writing a new copy\n");
+    sb.append("                   (replaced data is kept until the next vacuum)\n");
     sb.append("  --max-resolution Don't discard the top mip for textures >1K\n");
+    sb.append("  --raw            Store the entries uncompressed\n");
     sb.append("  --reproducible   Limit the writer to one thread\n");
     sb.append("                   (only relevant for add-gltf)\n");
     sb.append("  --ultra          Use the highest Zstd compression level\n");
     sb.append("                   (warning: will increase memory usage by a lot)\n");
     sb.append("\nexamples:\n");
     sb.append("  {} add shaders.vpak my_shader.spv /shaders/my_shader\n", executable);
+    sb.append("  {} add --dict shaders.vpak a.spv /shaders/a b.spv /shaders/b\n", executable);
     sb.append("  {} add-gltf --fast sponza.vpak sponza.glb\n", executable);
     sb.append("  {} add-gltf sponza.vpak player_model.glb\n", executable);
+    sb.append("  {} add-gltf --cell-size=64 city.vpak city.glb\n", executable);
     sb.append("  {} ls sounds.vpak\n", executable);
-    sb.append("  {} stat textures.vpak /default_albedo", executable);
+    sb.append("  {} stat textures.vpak /default_albedo\n", executable);
+    sb.append("  {} vacuum sponza.vpak", executable);
     vull::println(sb.build());
 }
 
+Optional<Vector<uint8_t>> read_file(StringView path) {
+    auto file_or_error = platform::open_file(path, platform::OpenMode::Read);
+    if (file_or_error.is_error()) {
+        return vull::nullopt;
+    }
+    auto stream = file_or_error.disown_value().create_stream();
+    Vector<uint8_t> data;
+    Array<uint8_t, 128 * 1024> buffer;
+    size_t bytes_read;
+    while ((bytes_read = VULL_EXPECT(stream.read(buffer.span()))) > 0) {
+        data.extend(buffer.span().subspan(0, static_cast<uint32_t>(bytes_read)));
+    }
+    return vull::move(data);
+}
+
+// Trains a dictionary on the given samples, returning an empty vector if training failed.
+Vector<uint8_t> train_dictionary(const Vector<Vector<uint8_t>> &samples) {
+    Vector<uint8_t> sample_data;
+    Vector<size_t> sample_sizes;
+    for (const auto &sample : samples) {
+        sample_data.extend(sample.span());
+        sample_sizes.push(sample.size());
+    }
+
+    Vector<uint8_t> dictionary(vull::min(k_max_dictionary_size, sample_data.size() / 4));
+    const auto size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), sample_data.data(),
+                                            sample_sizes.data(), sample_sizes.size());
+    if (ZDICT_isError(size) != 0) {
+        vull::warn("[main] Failed to train dictionary: {}", ZDICT_getErrorName(size));
+        return {};
+    }
+    Vector<uint8_t> trimmed;
+    trimmed.extend(dictionary.span().subspan(0, static_cast<uint32_t>(size)));
+    return trimmed;
+}
+
 int add(const Vector<StringView> &args) {
+    bool dict = false;
     bool fast = false;
+    bool in_place = false;
+    bool raw = false;
     bool ultra = false;
     StringView vpak_path;
     Vector<Tuple<StringView, StringView>> inputs;
     StringView next_input_path;
     for (const auto arg : vull::slice(args, 2u)) {
-        if (arg == "--fast") {
+        if (arg == "--dict") {
+            dict = true;
+        } else if (arg == "--fast") {
             fast = true;
+        } else if (arg == "--in-place") {
+            in_place = true;
+        } else if (arg == "--raw") {
+            raw = true;
         } else if (arg == "--ultra") {
             ultra = true;
         } else if (arg[0] == '-') {
@@ -99,6 +161,10 @@ int add(const Vector<StringView> &args) {
         vull::println("fatal: cannot have --fast and --ultra");
         return EXIT_FAILURE;
     }
+    if (dict && raw) {
+        vull::println("fatal: cannot have --dict and --raw");
+        return EXIT_FAILURE;
+    }
 
     if (vpak_path.empty()) {
         vull::println("fatal: missing <vpak> argument");
@@ -113,23 +179,36 @@ int add(const Vector<StringView> &args) {
         compression_level = vpak::CompressionLevel::Ultra;
     }
 
-    auto pack_file = VULL_EXPECT(vpak::PackFile::open(vpak_path));
-    auto pack_writer = VULL_EXPECT(pack_file.make_writer(compression_level));
-    for (auto [input_path, entry_name] : inputs) {
-        auto input_file_or_error = platform::open_file(input_path, platform::OpenMode::Read);
-        if (input_file_or_error.is_error()) {
-            vull::println("fatal: failed to open input file {}", input_path);
+    Vector<Vector<uint8_t>> input_datas;
+    for (const auto &input : inputs) {
+        auto data = read_file(vull::get<0>(input));
+        if (!data) {
+            vull::println("fatal: failed to open input file {}", vull::get<0>(input));
             return EXIT_FAILURE;
         }
-        auto input_file = input_file_or_error.disown_value();
-        auto input_stream = input_file.create_stream();
-
-        auto entry_stream = pack_writer.add_entry(entry_name, vpak::EntryType::Blob);
-        Array<uint8_t, 128 * 1024> buffer;
-        size_t bytes_read;
-        while ((bytes_read = VULL_EXPECT(input_stream.read(buffer.span()))) > 0) {
-            VULL_EXPECT(entry_stream.write({buffer.data(), bytes_read}));
+        input_datas.push(vull::move(*data));
+    }
+
+    const auto write_mode = in_place ? vpak::WriteMode::InPlace : vpak::WriteMode::Copy;
+    auto pack_file = VULL_EXPECT(vpak::PackFile::open(vpak_path));
+    auto pack_writer = VULL_EXPECT(pack_file.make_writer(compression_level, write_mode));
+    pack_writer.set_raw_threshold(k_raw_threshold);
+
+    auto codec = raw ? vpak::EntryCodec::Raw : vpak::EntryCodec::Zstd;
+    if (dict) {
+        // Fall back to regular compression if there isn't enough sample data to train on.
+        auto dictionary = train_dictionary(input_datas);
+        if (!dictionary.empty()) {
+            auto dictionary_name = vull::format("/.dict/{}", pack_file.entries().size());
+            VULL_EXPECT(pack_writer.add_dictionary(vull::move(dictionary_name), dictionary.span()));
+            codec = vpak::EntryCodec::ZstdDict;
         }
+    }
+
+    for (uint32_t i = 0; i < inputs.size(); i++) {
+        auto entry_name = vull::get<1>(inputs[i]);
+        auto entry_stream = pack_writer.add_entry(entry_name, vpak::EntryType::Blob, codec);
+        VULL_EXPECT(entry_stream.write(input_datas[i].span()));
         VULL_EXPECT(entry_stream.finish());
     }
     VULL_EXPECT(pack_file.finish_writing(vull::move(pack_writer)));
@@ -139,16 +218,27 @@ int add(const Vector<StringView> &args) {
 int add_gltf(const Vector<StringView> &args) {
     bool dump_json = false;
     bool fast = false;
+    bool in_place = false;
     bool max_resolution = false;
     bool reproducible = false;
     bool ultra = false;
+    uint32_t cell_size = 0;
     StringView vpak_path;
     StringView gltf_path;
     for (const auto arg : vull::slice(args, 2u)) {
-        if (arg == "--dump-json") {
+        if (arg.starts_with("--cell-size=")) {
+            auto parsed = arg.substr(12).to_integral<uint32_t>();
+            if (!parsed || *parsed == 0) {
+                vull::println("fatal: invalid cell size {}", arg.substr(12));
+                return EXIT_FAILURE;
+            }
+            cell_size = *parsed;
+        } else if (arg == "--dump-json") {
             dump_json = true;
         } else if (arg == "--fast") {
             fast = true;
+        } else if (arg == "--in-place") {
+            in_place = true;
         } else if (arg == "--max-resolution") {
             max_resolution = true;
         } else if (arg == "--reproducible") {
@@ -201,9 +291,11 @@ int add_gltf(const Vector<StringView> &args) {
         return EXIT_SUCCESS;
     }
 
+    const auto write_mode = in_place ? vpak::WriteMode::InPlace : vpak::WriteMode::Copy;
     auto pack_file = VULL_EXPECT(vpak::PackFile::open(vpak_path));
-    auto pack_writer = VULL_EXPECT(pack_file.make_writer(compression_level));
-    if (gltf_parser.convert(pack_writer, max_resolution, reproducible).is_error()) {
+    auto pack_writer = VULL_EXPECT(pack_file.make_writer(compression_level, write_mode));
+    pack_writer.set_raw_threshold(k_raw_threshold);
+    if (gltf_parser.convert(pack_writer, max_resolution, reproducible, float(cell_size)).is_error()) {
         return EXIT_FAILURE;
     }
 
@@ -228,6 +320,7 @@ int add_png(const Vector<StringView> &args) {
 
     auto pack_file = VULL_EXPECT(vpak::PackFile::open(args[2]));
     auto pack_writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Normal));
+    pack_writer.set_raw_threshold(k_raw_threshold);
     auto entry_stream = pack_writer.add_entry(args[4], vpak::EntryType::Blob);
     for (uint32_t y = 0; y < png_stream.height(); y++) {
         Array<uint8_t, 32768> row_buffer;
@@ -257,6 +350,7 @@ int add_skybox(const Vector<StringView> &args) {
 
     auto pack_file = VULL_EXPECT(vpak::PackFile::open(args[2]));
     auto pack_writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Normal));
+    pack_writer.set_raw_threshold(k_raw_threshold);
     auto entry_stream = pack_writer.add_entry(args[3], vpak::EntryType::Blob);
     for (auto &stream : face_streams) {
         auto png_stream = VULL_EXPECT(PngStream::create(stream.clone_unique()));
@@ -318,6 +412,19 @@ int ls(const Vector<StringView> &args) {
     return EXIT_SUCCESS;
 }
 
+StringView codec_string(vpak::EntryCodec codec) {
+    switch (codec) {
+    case vpak::EntryCodec::Raw:
+        return "raw";
+    case vpak::EntryCodec::Zstd:
+        return "zstd";
+    case vpak::EntryCodec::ZstdDict:
+        return "zstd (dictionary)";
+    default:
+        return "unknown";
+    }
+}
+
 StringView type_string(vpak::EntryType type) {
     switch (type) {
     case vpak::EntryType::Blob:
@@ -344,6 +451,23 @@ int stat(const Vector<StringView> &args) {
     }
     vull::println("Size: {} bytes (uncompressed)", entry->size);
     vull::println("Type: {}", type_string(entry->type));
+    vull::println("Codec: {}", codec_string(entry->codec));
+    if (entry->codec == vpak::EntryCodec::ZstdDict) {
+        vull::println("Dictionary: {}", entry->dictionary_name);
+    }
+    return EXIT_SUCCESS;
+}
+
+int vacuum(const Vector<StringView> &args) {
+    if (args.size() != 3) {
+        vull::println("fatal: invalid usage");
+        return EXIT_FAILURE;
+    }
+    auto pack_file = VULL_EXPECT(vpak::PackFile::open(args[2]));
+    auto file = VULL_EXPECT(platform::open_file(args[2], platform::OpenMode::Read));
+    const auto old_size = VULL_EXPECT(file.size());
+    const auto new_size = VULL_EXPECT(pack_file.compact());
+    vull::println("Reclaimed {} bytes ({} -> {} bytes)", old_size - vull::min(old_size, new_size), old_size, new_size);
     return EXIT_SUCCESS;
 }
 
@@ -404,6 +528,9 @@ int main(int argc, char **argv) {
     if (command == "stat") {
         return stat(args);
     }
+    if (command == "vacuum") {
+        return vacuum(args);
+    }
 
     bc7enc_compress_block_init();
     auto lut = load_lut(argv[0]);
@@ -0,0 +1,138 @@
+#include <vull/container/vector.hh>
+#include <vull/core/log.hh>
+#include <vull/maths/common.hh>
+#include <vull/platform/file.hh>
+#include <vull/platform/thread.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/args_parser.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_view.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/vpak/defs.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/stream.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace vull;
+
+namespace {
+
+constexpr StringView k_entry_name = "/bench";
+
+bool write_pack(const String &path, uint64_t size, uint32_t block_parallelism) {
+    VULL_IGNORE(platform::unlink_path(path));
+    auto pack_file_or_error = vpak::PackFile::open(String(path));
+    if (pack_file_or_error.is_error()) {
+        return false;
+    }
+    auto pack_file = pack_file_or_error.disown_value();
+    auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+    writer.set_block_parallelism(block_parallelism);
+
+    platform::Timer timer;
+    auto stream = writer.add_entry(k_entry_name, vpak::EntryType::Blob);
+
+    // Alternate runs and noise so that the data compresses roughly 2:1, similar to typical mesh data.
+    Vector<uint8_t> chunk(1024 * 1024);
+    uint32_t state = 1;
+    for (uint64_t written = 0; written < size; written += chunk.size()) {
+        for (uint32_t i = 0; i < chunk.size(); i++) {
+            state = state * 1664525u + 1013904223u;
+            chunk[i] = (i / 512) % 2 == 0 ? static_cast<uint8_t>(i / 512) : static_cast<uint8_t>(state >> 24);
+        }
+        const auto to_write = static_cast<uint32_t>(vull::min(size - written, uint64_t(chunk.size())));
+        VULL_EXPECT(stream.write(chunk.span().subspan(0, to_write)));
+    }
+    VULL_EXPECT(stream.finish());
+    VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+
+    const float elapsed = timer.elapsed();
+    const float rate = static_cast<float>(size) / (1000.0f * 1000.0f) / elapsed;
+    vull::info("[bench] Wrote with block parallelism {} in {} ms ({} MB/s)", block_parallelism, elapsed * 1000.0f,
+               rate);
+    return true;
+}
+
+void run_bench(const vpak::PackFile &pack_file, uint32_t readahead, uint32_t iterations) {
+    const char *mode = pack_file.is_mapped() ? "mapped" : "stream";
+    const auto entry_size = pack_file.stat(k_entry_name)->size;
+    Vector<uint8_t> buffer(1024 * 1024);
+    float best_rate = 0.0f;
+    for (uint32_t i = 0; i < iterations; i++) {
+        platform::Timer timer;
+        auto stream = pack_file.open_entry(k_entry_name);
+        if (readahead != 0) {
+            stream->enable_readahead(readahead);
+        }
+        uint64_t total = 0;
+        while (const auto bytes_read = VULL_EXPECT(stream->read(buffer.span()))) {
+            total += bytes_read;
+        }
+        const float elapsed = timer.elapsed();
+        if (total != entry_size) {
+            vull::error("[bench] Short read ({} of {} bytes)", total, entry_size);
+            return;
+        }
+        const float rate = static_cast<float>(total) / (1000.0f * 1000.0f) / elapsed;
+        vull::info("[bench] {} read with readahead {} in {} ms ({} MB/s)", mode, readahead, elapsed * 1000.0f, rate);
+        best_rate = vull::max(best_rate, rate);
+    }
+    vull::info("[bench] Best {} throughput with readahead {}: {} MB/s", mode, readahead, best_rate);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    String path;
+    bool keep = false;
+    uint32_t block_parallelism = 8;
+    uint32_t entry_size_mib = 256;
+    uint32_t iterations = 3;
+    uint32_t readahead = 8;
+    uint32_t thread_count = vull::max(platform::core_count() / 2, 1);
+
+    ArgsParser args_parser("vpak-bench", "vpak Read Benchmarks", "0.1.0");
+    args_parser.add_flag(keep, "Keep the generated vpak file", "keep");
+    args_parser.add_option(block_parallelism, "Number of blocks to compress in parallel", "block-parallelism", 'p');
+    args_parser.add_option(entry_size_mib, "Uncompressed size of the generated entry in MiB", "size", 's');
+    args_parser.add_option(iterations, "Number of times to read the entry per mode", "iterations", 'i');
+    args_parser.add_option(readahead, "Number of blocks to decompress ahead", "readahead", 'r');
+    args_parser.add_option(thread_count, "Tasklet worker thread count", "threads", 't');
+    args_parser.add_argument(path, "vpak", false);
+    if (auto result = args_parser.parse_args(argc, argv); result != ArgsParseResult::Continue) {
+        return result == ArgsParseResult::ExitSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (path.empty()) {
+        path = "vpak_bench.vpak";
+    }
+
+    vull::open_log();
+    vull::set_log_colours_enabled(true);
+
+    tasklet::Scheduler scheduler(thread_count, 256, false);
+    const bool success = scheduler.run([&] {
+        if (!write_pack(path, uint64_t(entry_size_mib) * 1024 * 1024, block_parallelism)) {
+            vull::error("[bench] Failed to create {}", path);
+            return false;
+        }
+
+        // Compare synchronous decompression against readahead, both through the page cache and a mapping.
+        const vpak::ReadMode read_modes[]{vpak::ReadMode::Stream, vpak::ReadMode::Mapped};
+        for (auto read_mode : read_modes) {
+            auto pack_file = VULL_EXPECT(vpak::PackFile::open(String(path), read_mode));
+            run_bench(pack_file, 0, iterations);
+            run_bench(pack_file, readahead, iterations);
+        }
+        if (!keep) {
+            VULL_IGNORE(platform::unlink_path(path));
+        }
+        return true;
+    });
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,155 @@
+#include <vull/container/vector.hh>
+#include <vull/core/log.hh>
+#include <vull/maths/common.hh>
+#include <vull/platform/file.hh>
+#include <vull/platform/thread.hh>
+#include <vull/platform/timer.hh>
+#include <vull/support/args_parser.hh>
+#include <vull/support/optional.hh>
+#include <vull/support/result.hh>
+#include <vull/support/span.hh>
+#include <vull/support/string.hh>
+#include <vull/support/string_builder.hh>
+#include <vull/support/utility.hh>
+#include <vull/tasklet/scheduler.hh>
+#include <vull/vpak/defs.hh>
+#include <vull/vpak/file_system.hh>
+#include <vull/vpak/pack_file.hh>
+#include <vull/vpak/stream.hh>
+#include <vull/vpak/writer.hh>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace vull;
+
+namespace {
+
+String entry_name(uint32_t index) {
+    return vull::format("/entry/{}", index);
+}
+
+String pack_path(const String &prefix, uint32_t index) {
+    return vull::format("{}{}.vpak", prefix, index);
+}
+
+bool write_pack(const String &path, uint32_t first_entry, uint32_t entry_count) {
+    VULL_IGNORE(platform::unlink_path(path));
+    auto pack_file_or_error = vpak::PackFile::open(String(path));
+    if (pack_file_or_error.is_error()) {
+        return false;
+    }
+    auto pack_file = pack_file_or_error.disown_value();
+    auto writer = VULL_EXPECT(pack_file.make_writer(vpak::CompressionLevel::Fast));
+    for (uint32_t i = first_entry; i < first_entry + entry_count; i++) {
+        auto stream = writer.add_entry(entry_name(i), vpak::EntryType::Blob, vpak::EntryCodec::Raw);
+        VULL_EXPECT(stream.write(Span<const uint32_t>(&i, 1)));
+        VULL_EXPECT(stream.finish());
+    }
+    VULL_EXPECT(pack_file.finish_writing(vull::move(writer)));
+    return true;
+}
+
+Vector<String> make_lookup_names(uint32_t total_entry_count, uint32_t lookup_count) {
+    Vector<String> names;
+    names.ensure_capacity(lookup_count);
+    uint32_t state = 1;
+    for (uint32_t i = 0; i < lookup_count; i++) {
+        state = state * 1664525u + 1013904223u;
+        names.push(entry_name(state % total_entry_count));
+    }
+    return names;
+}
+
+template <typename F>
+void run_lookups(const char *name, Span<const String> names, F lookup) {
+    platform::Timer timer;
+    uint32_t found_count = 0;
+    for (const auto &entry_name : names) {
+        if (lookup(entry_name.view())) {
+            found_count++;
+        }
+    }
+    const float elapsed = timer.elapsed();
+    if (found_count != names.size()) {
+        vull::error("[bench] {} lookups missed {} of {} entries", name, names.size() - found_count, names.size());
+        return;
+    }
+    vull::info("[bench] {} lookups of {} entries in {} ms ({} ns per lookup)", name, names.size(), elapsed * 1000.0f,
+               elapsed * 1e9f / static_cast<float>(names.size()));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    String prefix;
+    bool keep = false;
+    uint32_t pack_count = 100;
+    uint32_t entries_per_pack = 10000;
+    uint32_t lookup_count = 1000000;
+    uint32_t baseline_lookup_count = 100000;
+
+    ArgsParser args_parser("vpak-index-bench", "vpak Name Index Benchmarks", "0.1.0");
+    args_parser.add_flag(keep, "Keep the generated vpak files", "keep");
+    args_parser.add_option(pack_count, "Number of vpaks to generate", "packs", 'p');
+    args_parser.add_option(entries_per_pack, "Number of entries per vpak", "entries", 'e');
+    args_parser.add_option(lookup_count, "Number of random lookups through the global index", "lookups", 'l');
+    args_parser.add_option(baseline_lookup_count, "Number of random lookups searching each vpak in turn",
+                           "baseline-lookups", 'b');
+    args_parser.add_argument(prefix, "prefix", false);
+    if (auto result = args_parser.parse_args(argc, argv); result != ArgsParseResult::Continue) {
+        return result == ArgsParseResult::ExitSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (prefix.empty()) {
+        prefix = "vpak_index_bench_";
+    }
+
+    vull::open_log();
+    vull::set_log_colours_enabled(true);
+
+    tasklet::Scheduler scheduler(1, 256, false);
+    const bool success = scheduler.run([&] {
+        platform::Timer write_timer;
+        for (uint32_t i = 0; i < pack_count; i++) {
+            if (!write_pack(pack_path(prefix, i), i * entries_per_pack, entries_per_pack)) {
+                vull::error("[bench] Failed to create {}", pack_path(prefix, i));
+                return false;
+            }
+        }
+        const uint32_t total_entry_count = pack_count * entries_per_pack;
+        vull::info("[bench] Wrote {} vpaks with {} entries in {} ms", pack_count, total_entry_count,
+                   write_timer.elapsed() * 1000.0f);
+
+        Vector<vpak::PackFile> pack_files;
+        for (uint32_t i = 0; i < pack_count; i++) {
+            vpak::load_vpak(pack_path(prefix, i), pack_path(prefix, i));
+            pack_files.push(VULL_EXPECT(vpak::PackFile::open(pack_path(prefix, i))));
+        }
+
+        // The first lookup after loading builds the merged index.
+        platform::Timer index_timer;
+        VULL_IGNORE(vpak::stat(entry_name(0)));
+        vull::info("[bench] Built index of {} entries in {} ms", total_entry_count, index_timer.elapsed() * 1000.0f);
+
+        const auto names = make_lookup_names(total_entry_count, vull::max(lookup_count, baseline_lookup_count));
+        run_lookups("Indexed", names.span().subspan(0, lookup_count), [](StringView name) {
+            return vpak::stat(name).has_value();
+        });
+        run_lookups("Per-pack", names.span().subspan(0, baseline_lookup_count), [&](StringView name) {
+            for (const auto &pack_file : pack_files) {
+                if (pack_file.stat(name)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+
+        if (!keep) {
+            for (uint32_t i = 0; i < pack_count; i++) {
+                VULL_IGNORE(platform::unlink_path(pack_path(prefix, i)));
+            }
+        }
+        return true;
+    });
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}